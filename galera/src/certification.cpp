@@ -9,6 +9,7 @@
 #include "gu_throw.hpp"
 
 #include <map>
+#include <limits>
 
 using namespace galera;
 
@@ -29,7 +30,19 @@ static std::string const CERT_PARAM_MAX_LENGTH   (CERT_PARAM_PREFIX +
 static std::string const CERT_PARAM_LENGTH_CHECK (CERT_PARAM_PREFIX +
                                                   "length_check");
 
+std::string const galera::Certification::PARAM_PURGE_SLICE(CERT_PARAM_PREFIX +
+                                                           "purge_slice");
+std::string const
+galera::Certification::PARAM_PURGE_SLICE_TIME(CERT_PARAM_PREFIX +
+                                              "purge_slice_time");
+
 static std::string const CERT_PARAM_LOG_CONFLICTS_DEFAULT("no");
+static std::string const CERT_PARAM_PURGE_SLICE_DEFAULT("1024");
+static std::string const CERT_PARAM_PURGE_SLICE_TIME_DEFAULT("PT0.001S");
+
+/* purge duration histogram bins, seconds */
+static std::string const CERT_PURGE_HS_BINS(
+    "0.0,0.0001,0.00031623,0.001,0.0031623,0.01,0.031623,0.1,0.31623,1.");
 
 /*** It is EXTREMELY important that these constants are the same on all nodes.
  *** Don't change them ever!!! ***/
@@ -40,6 +53,9 @@ void
 galera::Certification::register_params(gu::Config& cnf)
 {
     cnf.add(CERT_PARAM_LOG_CONFLICTS, CERT_PARAM_LOG_CONFLICTS_DEFAULT);
+    cnf.add(Certification::PARAM_PURGE_SLICE, CERT_PARAM_PURGE_SLICE_DEFAULT);
+    cnf.add(Certification::PARAM_PURGE_SLICE_TIME,
+            CERT_PARAM_PURGE_SLICE_TIME_DEFAULT);
     /* The defaults below are deliberately not reflected in conf: people
      * should not know about these dangerous setting unless they read RTFM. */
     cnf.add(CERT_PARAM_MAX_LENGTH);
@@ -66,6 +82,21 @@ length_check(const gu::Config& conf)
         return gu::Config::from_config<int>(CERT_PARAM_LENGTH_CHECK_DEFAULT);
 }
 
+static size_t
+purge_slice(const gu::Config& conf)
+{
+    long long const ret(conf.get<long long>(Certification::PARAM_PURGE_SLICE));
+
+    if (ret <= 0)
+    {
+        gu_throw_error(EINVAL) << "Bad value for '"
+                               << Certification::PARAM_PURGE_SLICE << "': "
+                               << ret << ", must be positive";
+    }
+
+    return ret;
+}
+
 void
 galera::Certification::purge_for_trx_v1to2(TrxHandle* trx)
 {
@@ -813,6 +844,7 @@ galera::Certification::Certification(gu::Config& conf, ServiceThd& thd)
     initial_position_      (-1),
     position_              (-1),
     safe_to_discard_seqno_ (-1),
+    purge_seqno_           (-1),
     last_pa_unsafe_        (-1),
     last_preordered_seqno_ (position_),
     last_preordered_id_    (0),
@@ -821,10 +853,15 @@ galera::Certification::Certification(gu::Config& conf, ServiceThd& thd)
     deps_dist_             (0),
     cert_interval_         (0),
     index_size_            (0),
+    purge_hs_              (CERT_PURGE_HS_BINS),
+    purge_slice_hs_        (CERT_PURGE_HS_BINS),
+    purge_time_            (0),
     key_count_             (0),
 
     max_length_            (max_length(conf)),
     max_length_check_      (length_check(conf)),
+    purge_slice_           (purge_slice(conf)),
+    purge_slice_time_      (conf.get(Certification::PARAM_PURGE_SLICE_TIME)),
     log_conflicts_         (conf.get<bool>(CERT_PARAM_LOG_CONFLICTS))
 {}
 
@@ -900,6 +937,7 @@ void galera::Certification::assign_initial_position(wsrep_seqno_t seqno,
     initial_position_      = seqno;
     position_              = seqno;
     safe_to_discard_seqno_ = seqno;
+    purge_seqno_           = seqno;
     last_pa_unsafe_        = seqno;
     last_preordered_seqno_ = position_;
     last_preordered_id_    = 0;
@@ -942,19 +980,82 @@ wsrep_seqno_t galera::Certification::get_safe_to_discard_seqno_() const
 
 
 wsrep_seqno_t
-galera::Certification::purge_trxs_upto_(wsrep_seqno_t const seqno,
-                                        bool const          handle_gcache)
+galera::Certification::purge_trxs_upto(wsrep_seqno_t const seqno,
+                                       bool const          handle_gcache)
+{
+    gu::datetime::Date const start(gu::datetime::Date::monotonic());
+    wsrep_seqno_t            upto;
+    bool                     done;
+
+    /* Purge at most one slice per call, so that the caller (and whatever
+     * it holds, e.g. local monitor) is not stalled for long periods.
+     * The rest of the purge is done by subsequent calls. */
+    {
+        gu::Lock lock(mutex_);
+        purge_seqno_ = std::max(purge_seqno_, seqno);
+        // assert(seqno <= get_safe_to_discard_seqno());
+        // Note: setting trx committed is not done in total order so
+        // safe to discard seqno may decrease. Enable assertion above when
+        // this issue is fixed.
+        // Remembered target is checked against the current safe to discard
+        // seqno, as trxs certified since it was set may still need index.
+        upto = std::min(purge_seqno_, get_safe_to_discard_seqno_());
+
+        if (upto <= 0) return upto;
+
+        done = purge_trxs_slice_(upto, purge_slice_,
+                                 start + purge_slice_time_);
+
+        if (!done) upto = trx_map_.begin()->first - 1;
+    }
+
+    if (handle_gcache) service_thd_.release_seqno(upto);
+
+    long long const slice_time
+        ((gu::datetime::Date::monotonic() - start).get_nsecs());
+    {
+        gu::Lock lock(stats_mutex_);
+        purge_slice_hs_.insert(double(slice_time)/gu::datetime::Sec);
+
+        purge_time_ += slice_time;
+
+        if (done)
+        {
+            purge_hs_.insert(double(purge_time_)/gu::datetime::Sec);
+            purge_time_ = 0;
+        }
+    }
+
+    return upto;
+}
+
+
+bool
+galera::Certification::purge_trxs_slice_(wsrep_seqno_t const      seqno,
+                                         size_t const             max_trxs,
+                                         gu::datetime::Date const deadline)
 {
     assert (seqno > 0);
 
-    TrxMap::iterator purge_bound(trx_map_.upper_bound(seqno));
+    TrxMap::iterator const purge_bound(trx_map_.upper_bound(seqno));
+    TrxMap::iterator       i(trx_map_.begin());
 
     cert_debug << "purging index up to " << seqno;
 
-    for_each(trx_map_.begin(), purge_bound, PurgeAndDiscard(*this));
-    trx_map_.erase(trx_map_.begin(), purge_bound);
+    for (size_t n(1); i != purge_bound; ++n)
+    {
+        PurgeAndDiscard(*this)(i->second);
+
+        ++i;
 
-    if (handle_gcache) service_thd_.release_seqno(seqno);
+        if (n >= max_trxs) break;
+
+        /* don't query the clock for every trx */
+        if (0 == (n & 0x3f) && deadline < gu::datetime::Date::monotonic())
+            break;
+    }
+
+    trx_map_.erase(trx_map_.begin(), i);
 
     if (0 == ((trx_map_.size() + 1) % 10000))
     {
@@ -963,6 +1064,19 @@ galera::Certification::purge_trxs_upto_(wsrep_seqno_t const seqno,
                   << ", real purge seqno: " << trx_map_.begin()->first - 1;
     }
 
+    return (i == purge_bound);
+}
+
+
+wsrep_seqno_t
+galera::Certification::purge_trxs_upto_(wsrep_seqno_t const seqno,
+                                        bool const          handle_gcache)
+{
+    purge_trxs_slice_(seqno, std::numeric_limits<size_t>::max(),
+                      gu::datetime::Date::max());
+
+    if (handle_gcache) service_thd_.release_seqno(seqno);
+
     return seqno;
 }
 
@@ -1060,7 +1174,8 @@ wsrep_seqno_t galera::Certification::set_trx_committed(TrxHandle* trx)
             deps_set_.erase(i);
         }
 
-        if (gu_unlikely(index_purge_required()))
+        /* keep requesting commit cuts until unfinished purge is done */
+        if (gu_unlikely(index_purge_required() || purge_pending_()))
         {
             ret = get_safe_to_discard_seqno_();
         }
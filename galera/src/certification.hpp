@@ -12,6 +12,9 @@
 #include "gu_unordered.hpp"
 #include "gu_lock.hpp"
 #include "gu_config.hpp"
+#include "gu_datetime.hpp"
+#include "gu_histogram.hpp"
+#include "gu_status.hpp"
 
 #include <map>
 #include <set>
@@ -24,6 +27,8 @@ namespace galera
     public:
 
         static std::string const PARAM_LOG_CONFLICTS;
+        static std::string const PARAM_PURGE_SLICE;
+        static std::string const PARAM_PURGE_SLICE_TIME;
 
         static void register_params(gu::Config&);
 
@@ -63,17 +68,11 @@ namespace galera
             return get_safe_to_discard_seqno_();
         }
 
+        // Purge index up to seqno. Only one slice is purged per call, the
+        // rest is left for subsequent calls. Returns seqno up to which
+        // the index has been purged so far.
         wsrep_seqno_t
-        purge_trxs_upto(wsrep_seqno_t const seqno, bool const handle_gcache)
-        {
-            gu::Lock lock(mutex_);
-            const wsrep_seqno_t stds(get_safe_to_discard_seqno_());
-            // assert(seqno <= get_safe_to_discard_seqno());
-            // Note: setting trx committed is not done in total order so
-            // safe to discard seqno may decrease. Enable assertion above when
-            // this issue is fixed.
-            return purge_trxs_upto_(std::min(seqno, stds), handle_gcache);
-        }
+        purge_trxs_upto(wsrep_seqno_t seqno, bool handle_gcache);
 
         // Set trx corresponding to handle committed. Return purge seqno if
         // index purge is required, -1 otherwise.
@@ -103,6 +102,16 @@ namespace galera
             deps_dist_ = 0;
             n_certified_ = 0;
             index_size_ = 0;
+            purge_hs_.clear();
+            purge_slice_hs_.clear();
+        }
+
+        // purge duration histograms
+        void get_status(gu::Status& status) const
+        {
+            gu::Lock lock(stats_mutex_);
+            status.insert("cert_purge_hs", purge_hs_.to_string());
+            status.insert("cert_purge_slice_hs", purge_slice_hs_.to_string());
         }
 
         bool index_purge_required()
@@ -129,6 +138,14 @@ namespace galera
         // unprotected variants for internal use
         wsrep_seqno_t get_safe_to_discard_seqno_() const;
         wsrep_seqno_t purge_trxs_upto_(wsrep_seqno_t, bool sync);
+        bool purge_pending_() const
+        {
+            return (!trx_map_.empty() &&
+                    trx_map_.begin()->first <=
+                    std::min(purge_seqno_, get_safe_to_discard_seqno_()));
+        }
+        bool purge_trxs_slice_(wsrep_seqno_t, size_t max_trxs,
+                               gu::datetime::Date deadline);
 
         class PurgeAndDiscard
         {
@@ -137,9 +154,13 @@ namespace galera
             PurgeAndDiscard(Certification& cert) : cert_(cert) { }
 
             void operator()(TrxMap::value_type& vt) const
+            {
+                (*this)(vt.second);
+            }
+
+            void operator()(TrxHandle* const trx) const
             {
                 {
-                    TrxHandle* trx(vt.second);
                     TrxHandleLock lock(*trx);
 
                     if (trx->is_committed() == false)
@@ -159,7 +180,7 @@ namespace galera
                                   << " refcnt " << trx->refcnt();
                     }
                 }
-                vt.second->unref();
+                trx->unref();
             }
 
             PurgeAndDiscard(const PurgeAndDiscard& other) : cert_(other.cert_)
@@ -182,6 +203,7 @@ namespace galera
         wsrep_seqno_t initial_position_;
         wsrep_seqno_t position_;
         wsrep_seqno_t safe_to_discard_seqno_;
+        wsrep_seqno_t purge_seqno_; // target of unfinished sliced purge
         wsrep_seqno_t last_pa_unsafe_;
         wsrep_seqno_t last_preordered_seqno_;
         wsrep_trx_id_t last_preordered_id_;
@@ -190,6 +212,9 @@ namespace galera
         wsrep_seqno_t deps_dist_;
         wsrep_seqno_t cert_interval_;
         size_t        index_size_;
+        gu::Histogram purge_hs_;       // all slices of one purge
+        gu::Histogram purge_slice_hs_; // single purge slice
+        long long     purge_time_;     // nsecs spent in unfinished purge
 
         gu::Atomic<long>    key_count_;
 
@@ -203,6 +228,12 @@ namespace galera
         unsigned int const max_length_check_; /* Mask how often to check */
         static int   const purge_interval_ = (1UL<<10);
 
+        /* Index purge is done in slices of at most purge_slice_ trxs,
+         * one slice per purge_trxs_upto() call. Slice is cut short if it
+         * takes longer than purge_slice_time_. */
+        size_t               const purge_slice_;
+        gu::datetime::Period const purge_slice_time_;
+
         bool               log_conflicts_;
     };
 }
@@ -43,6 +43,32 @@ private:
     gcache::GCache&    gcache_;
 };
 
+// Releases all actions of a batch, including those left unprocessed
+// by an exception
+class ReleaseBatch
+{
+public:
+    ReleaseBatch(struct gcs_action* acts, long num, gcache::GCache& gcache)
+        :
+        acts_  (acts),
+        num_   (num),
+        gcache_(gcache)
+    {}
+
+    ~ReleaseBatch()
+    {
+        for (long i(0); i < num_; ++i) Release release(acts_[i], gcache_);
+    }
+
+private:
+    ReleaseBatch(const ReleaseBatch&);
+    void operator=(const ReleaseBatch&);
+
+    struct gcs_action* const acts_;
+    long               const num_;
+    gcache::GCache&          gcache_;
+};
+
 
 static galera::Replicator::State state2repl(const gcs_act_conf_t& conf)
 {
@@ -170,15 +196,57 @@ void galera::GcsActionSource::dispatch(void* const              recv_ctx,
 
 ssize_t galera::GcsActionSource::process(void* recv_ctx, bool& exit_loop)
 {
-    struct gcs_action act;
+    long const batch(recv_batch_());
+
+    if (batch <= 1)
+    {
+        struct gcs_action act;
+
+        ssize_t rc(gcs_.recv(act));
+        if (rc > 0)
+        {
+            Release release(act, gcache_);
+            ++received_;
+            received_bytes_ += rc;
+            gu_trace(dispatch(recv_ctx, act, exit_loop));
+        }
+        return rc;
+    }
+
+    // Consecutive actions are dispatched in order by this thread, so they
+    // enter monitors in the same order as if received one by one.
+    struct gcs_action acts[GCS_RECV_BATCH_MAX];
 
-    ssize_t rc(gcs_.recv(act));
+    ssize_t rc(gcs_.recv_batch(acts, batch));
     if (rc > 0)
     {
-        Release release(act, gcache_);
-        ++received_;
-        received_bytes_ += rc;
-        gu_trace(dispatch(recv_ctx, act, exit_loop));
+        ReleaseBatch release(acts, rc, gcache_);
+        long long bytes(0);
+
+        for (ssize_t i(0); i < rc; ++i) bytes += acts[i].size;
+
+        received_       += rc;
+        received_bytes_ += bytes;
+
+        for (ssize_t i(0); i < rc; ++i)
+        {
+            bool exit_act(false);
+            gu_trace(dispatch(recv_ctx, acts[i], exit_act));
+            exit_loop = exit_loop || exit_act;
+        }
     }
     return rc;
 }
+
+
+void galera::GcsActionSource::set_recv_batch(long const batch)
+{
+    if (batch < 1 || batch > GCS_RECV_BATCH_MAX)
+    {
+        gu_throw_error(EINVAL) << "Receive batch " << batch
+                               << " out of range [1, "
+                               << GCS_RECV_BATCH_MAX << ']';
+    }
+
+    recv_batch_ = batch;
+}
@@ -30,7 +30,8 @@ namespace galera
             replicator_    (replicator),
             gcache_        (gcache    ),
             received_      (0         ),
-            received_bytes_(0         )
+            received_bytes_(0         ),
+            recv_batch_    (1         )
         { }
 
         ~GcsActionSource()
@@ -42,6 +43,10 @@ namespace galera
         long long received()       const { return received_(); }
         long long received_bytes() const { return received_bytes_(); }
 
+        /*! Sets the maximum number of actions taken from GCS at once.
+         *  @throws gu::Exception if out of [1, GCS_RECV_BATCH_MAX] range */
+        void      set_recv_batch(long batch);
+
     private:
 
         void dispatch(void*, const gcs_action&, bool& exit_loop);
@@ -52,6 +57,7 @@ namespace galera
         gcache::GCache&       gcache_;
         gu::Atomic<long long> received_;
         gu::Atomic<long long> received_bytes_;
+        gu::Atomic<long>      recv_batch_;
     };
 
     class GcsActionTrx
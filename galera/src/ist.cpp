@@ -19,6 +19,13 @@ namespace
 {
     static std::string const CONF_KEEP_KEYS     ("ist.keep_keys");
     static bool        const CONF_KEEP_KEYS_DEFAULT (true);
+    static std::string const CONF_ZERO_COPY     ("ist.zero_copy");
+    static bool        const CONF_ZERO_COPY_DEFAULT (true);
+    static std::string const CONF_COMPRESSION   ("ist.compression");
+    static int         const CONF_COMPRESSION_DEFAULT (0);
+
+    // max number of buffers fetched from gcache at a time
+    static size_t      const SEND_BATCH (4096);
 }
 
 
@@ -69,11 +76,17 @@ namespace galera
 std::string const
 galera::ist::Receiver::RECV_ADDR("ist.recv_addr");
 
+size_t const galera::ist::Receiver::MAX_QUEUED_TRXS;
+size_t const galera::ist::Receiver::MAX_QUEUED_BYTES;
+size_t const galera::ist::Receiver::MAX_BATCH;
+
 void
 galera::ist::register_params(gu::Config& conf)
 {
     conf.add(Receiver::RECV_ADDR);
     conf.add(CONF_KEEP_KEYS);
+    conf.add(CONF_ZERO_COPY);
+    conf.add(CONF_COMPRESSION);
 }
 
 galera::ist::Receiver::Receiver(gu::Config&           conf,
@@ -84,18 +97,29 @@ galera::ist::Receiver::Receiver(gu::Config&           conf,
     acceptor_     (io_service_),
     ssl_ctx_      (io_service_, asio::ssl::context::sslv23),
     mutex_        (),
-    cond_         (),
-    consumers_    (),
+    recv_cond_    (),
+    parse_cond_   (),
+    apply_cond_   (),
+    parse_queue_  (),
+    apply_queue_  (),
+    queued_       (0),
+    queued_bytes_ (0),
+    waiting_      (0),
     current_seqno_(-1),
     last_seqno_   (-1),
     conf_         (conf),
     trx_pool_     (sp),
     thread_       (),
+    parse_thread_ (),
     error_code_   (0),
+    parse_error_  (0),
     version_      (-1),
     use_ssl_      (false),
     running_      (false),
-    ready_        (false)
+    ready_        (false),
+    recv_waiting_ (false),
+    parse_waiting_(false),
+    apply_eof_    (false)
 {
     std::string recv_addr;
 
@@ -130,6 +154,13 @@ extern "C" void* run_receiver_thread(void* arg)
     return 0;
 }
 
+extern "C" void* run_parser_thread(void* arg)
+{
+    galera::ist::Receiver* receiver(static_cast<galera::ist::Receiver*>(arg));
+    receiver->parse();
+    return 0;
+}
+
 static std::string
 IST_determine_recv_addr (gu::Config& conf)
 {
@@ -211,8 +242,11 @@ galera::ist::Receiver::prepare(wsrep_seqno_t first_seqno,
                                wsrep_seqno_t last_seqno,
                                int           version)
 {
-    ready_ = false;
-    version_ = version;
+    ready_       = false;
+    apply_eof_   = false;
+    error_code_  = 0;
+    parse_error_ = 0;
+    version_     = version;
     recv_addr_ = IST_determine_recv_addr(conf_);
     gu::URI     const uri(recv_addr_);
     try
@@ -303,6 +337,16 @@ void galera::ist::Receiver::run()
     }
     acceptor_.close();
     int ec(0);
+    bool eof(false);
+    int err;
+    if ((err = pthread_create(&parse_thread_, 0, &run_parser_thread, this)))
+    {
+        // no one to catch it here, report through recv() instead
+        log_error << "Unable to create IST parser thread: " << err
+                  << " (" << strerror(err) << ")";
+        ec = err;
+        goto close;
+    }
     try
     {
         Proto p(trx_pool_, version_,
@@ -320,40 +364,42 @@ void galera::ist::Receiver::run()
             p.recv_handshake_response(socket);
             p.send_ctrl(socket, Ctrl::C_OK);
         }
+        // Network stage: only reads messages and passes them on, parsing
+        // is done by the parser thread concurrently with the next read.
         while (true)
         {
             TrxHandle* trx;
+            wsrep_seqno_t seqno_g(WSREP_SEQNO_UNDEFINED);
+            wsrep_seqno_t seqno_d(WSREP_SEQNO_UNDEFINED);
             if (use_ssl_ == true)
             {
-                trx = p.recv_trx(ssl_stream);
+                trx = p.recv_trx(ssl_stream, seqno_g, seqno_d);
             }
             else
             {
-                trx = p.recv_trx(socket);
+                trx = p.recv_trx(socket, seqno_g, seqno_d);
             }
             if (trx != 0)
             {
-                if (trx->global_seqno() != current_seqno_)
+                if (seqno_g != current_seqno_)
                 {
-                    log_error << "unexpected trx seqno: " << trx->global_seqno()
+                    log_error << "unexpected trx seqno: " << seqno_g
                               << " expected: " << current_seqno_;
+                    trx->unref();
                     ec = EINVAL;
                     goto err;
                 }
                 ++current_seqno_;
             }
-            gu::Lock lock(mutex_);
-            while (ready_ == false || consumers_.empty())
+            if (enqueue(trx, seqno_g, seqno_d) == false)
             {
-                lock.wait(cond_);
+                // parser has failed, error will be picked up below
+                goto err;
             }
-            Consumer* cons(consumers_.top());
-            consumers_.pop();
-            cons->trx(trx);
-            cons->cond().signal();
             if (trx == 0)
             {
                 log_debug << "eof received, closing socket";
+                eof = true;
                 break;
             }
         }
@@ -373,6 +419,18 @@ void galera::ist::Receiver::run()
     }
 
 err:
+    if (eof == false)
+    {
+        // make sure parser thread sees the end of stream
+        (void)enqueue(0, WSREP_SEQNO_UNDEFINED, WSREP_SEQNO_UNDEFINED);
+    }
+
+    if ((err = pthread_join(parse_thread_, 0)) != 0)
+    {
+        log_warn << "Failed to join IST parser thread: " << err;
+    }
+
+close:
     gu::Lock lock(mutex_);
     if (use_ssl_ == true)
     {
@@ -385,6 +443,10 @@ err:
     }
 
     running_ = false;
+    if (ec == 0 && parse_error_ != 0)
+    {
+        ec = parse_error_;
+    }
     if (ec != EINTR && current_seqno_ - 1 < last_seqno_)
     {
         log_error << "IST didn't contain all write sets, expected last: "
@@ -395,10 +457,140 @@ err:
     {
         error_code_ = ec;
     }
-    while (consumers_.empty() == false)
+    apply_cond_.broadcast();
+}
+
+
+// Queues received trx for parsing, waits if too many trxs are in flight.
+// Returns false if parser has failed and receiving should stop.
+bool galera::ist::Receiver::enqueue(TrxHandle*    const trx,
+                                    wsrep_seqno_t const seqno_g,
+                                    wsrep_seqno_t const seqno_d)
+{
+    size_t const size(trx != 0 && seqno_d != WSREP_SEQNO_UNDEFINED ?
+                      trx->write_set_collection().size() : 0);
+
+    gu::Lock lock(mutex_);
+
+    while (trx != 0 && parse_error_ == 0 && queued_ > 0 &&
+           (queued_ >= MAX_QUEUED_TRXS ||
+            queued_bytes_ + size > MAX_QUEUED_BYTES))
+    {
+        recv_waiting_ = true;
+        lock.wait(recv_cond_);
+    }
+    recv_waiting_ = false;
+
+    if (trx != 0 && parse_error_ != 0)
+    {
+        trx->unref();
+        return false;
+    }
+
+    Received const r = { trx, seqno_g, seqno_d, size };
+    parse_queue_.push_back(r);
+
+    if (trx != 0)
     {
-        consumers_.top()->cond().signal();
-        consumers_.pop();
+        ++queued_;
+        queued_bytes_ += size;
+    }
+
+    if (parse_waiting_) parse_cond_.signal();
+
+    return true;
+}
+
+
+void galera::ist::Receiver::parse()
+{
+    std::deque<Received> batch;
+    std::vector<Received> parsed;
+    bool eof(false);
+
+    while (eof == false)
+    {
+        {
+            gu::Lock lock(mutex_);
+            while (parse_queue_.empty())
+            {
+                parse_waiting_ = true;
+                lock.wait(parse_cond_);
+            }
+            parse_waiting_ = false;
+            batch.swap(parse_queue_);
+        }
+
+        int err(0);
+        size_t discarded(0);
+        size_t discarded_bytes(0);
+
+        for (std::deque<Received>::iterator i(batch.begin());
+             i != batch.end(); ++i)
+        {
+            if (i->trx_ == 0)
+            {
+                eof = true;
+                break;
+            }
+
+            if (err == 0)
+            {
+                try
+                {
+                    Proto::parse_trx(*i->trx_, i->seqno_g_, i->seqno_d_);
+                    parsed.push_back(*i);
+                    continue;
+                }
+                catch (gu::Exception& e)
+                {
+                    log_error << "got exception while parsing ist stream: "
+                              << e.what();
+                    err = e.get_errno() != 0 ? e.get_errno() : EPROTO;
+                }
+            }
+
+            i->trx_->unref();
+            ++discarded;
+            discarded_bytes += i->size_;
+        }
+
+        batch.clear();
+
+        gu::Lock lock(mutex_);
+
+        if (err != 0 && parse_error_ == 0)
+        {
+            parse_error_ = err;
+        }
+
+        if (parse_error_ != 0)
+        {
+            // stop handing trxs over, but keep draining the queue so that
+            // the network stage does not block
+            for (size_t i(0); i < parsed.size(); ++i)
+            {
+                parsed[i].trx_->unref();
+                discarded_bytes += parsed[i].size_;
+            }
+            discarded += parsed.size();
+            parsed.clear();
+        }
+
+        queued_       -= discarded;
+        queued_bytes_ -= discarded_bytes;
+        if (discarded > 0 && recv_waiting_) recv_cond_.signal();
+
+        if (parsed.empty() == false)
+        {
+            apply_queue_.insert(apply_queue_.end(),
+                                parsed.begin(), parsed.end());
+            parsed.clear();
+        }
+
+        if (eof == true && parse_error_ == 0) apply_eof_ = true;
+
+        if (waiting_ > 0) apply_cond_.broadcast();
     }
 }
 
@@ -407,33 +599,52 @@ void galera::ist::Receiver::ready()
 {
     gu::Lock lock(mutex_);
     ready_ = true;
-    cond_.signal();
+    apply_cond_.broadcast();
 }
 
-int galera::ist::Receiver::recv(TrxHandle** trx)
+
+int galera::ist::Receiver::recv(std::vector<TrxHandle*>& trxs)
 {
-    Consumer cons;
+    trxs.clear();
+
     gu::Lock lock(mutex_);
-    if (running_ == false)
+
+    while (true)
     {
-        if (error_code_ != 0)
+        if (apply_queue_.empty() == false)
         {
-            gu_throw_error(error_code_) << "IST receiver reported error";
+            if (ready_ == true) break;
         }
-        return EINTR;
-    }
-    consumers_.push(&cons);
-    cond_.signal();
-    lock.wait(cons.cond());
-    if (cons.trx() == 0)
-    {
-        if (error_code_ != 0)
+        else if (running_ == false || apply_eof_ == true)
         {
-            gu_throw_error(error_code_) << "IST receiver reported error";
+            if (error_code_ != 0)
+            {
+                gu_throw_error(error_code_) << "IST receiver reported error";
+            }
+            return EINTR;
         }
-        return EINTR;
+        ++waiting_;
+        lock.wait(apply_cond_);
+        --waiting_;
+    }
+
+    // share what is available between waiting consumers so that they can
+    // apply in parallel, but take at least one
+    size_t n(apply_queue_.size() / (waiting_ + 1));
+    n = std::max<size_t>(1, std::min<size_t>(n, MAX_BATCH));
+
+    size_t bytes(0);
+    for (size_t i(0); i < n; ++i)
+    {
+        bytes += apply_queue_.front().size_;
+        trxs.push_back(apply_queue_.front().trx_);
+        apply_queue_.pop_front();
     }
-    *trx = cons.trx();
+
+    queued_       -= n;
+    queued_bytes_ -= bytes;
+    if (recv_waiting_) recv_cond_.signal();
+
     return 0;
 }
 
@@ -460,11 +671,16 @@ wsrep_seqno_t galera::ist::Receiver::finished()
 
         running_ = false;
 
-        while (consumers_.empty() == false)
+        // release whatever was not consumed
+        while (apply_queue_.empty() == false)
         {
-            consumers_.top()->cond().signal();
-            consumers_.pop();
+            apply_queue_.front().trx_->unref();
+            apply_queue_.pop_front();
         }
+        queued_       = 0;
+        queued_bytes_ = 0;
+
+        apply_cond_.broadcast();
 
         recv_addr_ = "";
     }
@@ -604,7 +820,9 @@ void galera::ist::Sender::send(wsrep_seqno_t first, wsrep_seqno_t last)
     {
         TrxHandle::SlavePool unused(1, 0, "");
         Proto p(unused, version_,
-                conf_.get(CONF_KEEP_KEYS, CONF_KEEP_KEYS_DEFAULT));
+                conf_.get(CONF_KEEP_KEYS, CONF_KEEP_KEYS_DEFAULT),
+                conf_.get(CONF_ZERO_COPY, CONF_ZERO_COPY_DEFAULT),
+                conf_.get(CONF_COMPRESSION, CONF_COMPRESSION_DEFAULT));
         int32_t ctrl;
 
         if (use_ssl_ == true)
@@ -625,11 +843,17 @@ void galera::ist::Sender::send(wsrep_seqno_t first, wsrep_seqno_t last)
                 << "ist send failed, peer reported error: " << ctrl;
         }
 
+        // history is read sequentially, so gcache is asked to read ahead
+        // and buffers are dropped from page cache once sent
         std::vector<gcache::GCache::Buffer> buf_vec(
             std::min(static_cast<size_t>(last - first + 1),
-                     static_cast<size_t>(1024)));
+                     SEND_BATCH));
+        // compressed history is decompressed here, not shared with
+        // other senders
+        std::vector<gu::byte_t> inflated;
         ssize_t n_read;
-        while ((n_read = gcache_.seqno_get_buffers(buf_vec, first)) > 0)
+        while ((n_read = gcache_.seqno_get_buffers(buf_vec, inflated, first,
+                                                   true)) > 0)
         {
             GU_DBUG_SYNC_WAIT("ist_sender_send_after_get_buffers")
             //log_info << "read " << first << " + " << n_read << " from gcache";
@@ -679,10 +903,13 @@ void galera::ist::Sender::send(wsrep_seqno_t first, wsrep_seqno_t last)
                     return;
                 }
             }
+            // must be done before seqno lock is moved past sent buffers
+            gcache_.seqno_drop_buffers(buf_vec, n_read);
+
             first += n_read;
             // resize buf_vec to avoid scanning gcache past last
             size_t next_size(std::min(static_cast<size_t>(last - first + 1),
-                                      static_cast<size_t>(1024)));
+                                      SEND_BATCH));
 
             if (buf_vec.size() != next_size)
             {
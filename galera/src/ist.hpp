@@ -16,7 +16,8 @@
 #include "gu_monitor.hpp"
 #include "gu_asio.hpp"
 
-#include <stack>
+#include <deque>
+#include <vector>
 #include <set>
 
 namespace gcache
@@ -42,49 +43,63 @@ namespace galera
 
             std::string   prepare(wsrep_seqno_t, wsrep_seqno_t, int);
             void          ready();
-            int           recv(TrxHandle** trx);
+            // Returns a batch of consecutive trxs in seqno order or
+            // EINTR when the stream has ended.
+            int           recv(std::vector<TrxHandle*>& trxs);
             wsrep_seqno_t finished();
             void          run();
+            void          parse();
 
         private:
 
             void interrupt();
+            bool enqueue(TrxHandle* trx, wsrep_seqno_t seqno_g,
+                         wsrep_seqno_t seqno_d);
+
+            // Received trx on its way through parser to consumers.
+            struct Received
+            {
+                TrxHandle*    trx_;
+                wsrep_seqno_t seqno_g_;
+                wsrep_seqno_t seqno_d_;
+                size_t        size_;
+            };
+
+            // Trxs received from the network but not yet handed over to
+            // consumers are limited both in number and in total size.
+            static size_t const MAX_QUEUED_TRXS  = 256;
+            static size_t const MAX_QUEUED_BYTES = (128 << 20);
+            // Max number of trxs handed over to a consumer at a time.
+            static size_t const MAX_BATCH        = 16;
 
             std::string                                   recv_addr_;
             asio::io_service                              io_service_;
             asio::ip::tcp::acceptor                       acceptor_;
             asio::ssl::context                            ssl_ctx_;
             gu::Mutex                                     mutex_;
-            gu::Cond                                      cond_;
-
-            class Consumer
-            {
-            public:
-
-                Consumer() : cond_(), trx_(0) { }
-                ~Consumer() { }
-
-                gu::Cond&  cond()              { return cond_; }
-                void       trx(TrxHandle* trx) { trx_ = trx;   }
-                TrxHandle* trx() const         { return trx_;  }
-
-            private:
-
-                gu::Cond   cond_;
-                TrxHandle* trx_;
-            };
-
-            std::stack<Consumer*> consumers_;
-            wsrep_seqno_t         current_seqno_;
-            wsrep_seqno_t         last_seqno_;
-            gu::Config&           conf_;
-            TrxHandle::SlavePool& trx_pool_;
-            pthread_t             thread_;
-            int                   error_code_;
-            int                   version_;
-            bool                  use_ssl_;
-            bool                  running_;
-            bool                  ready_;
+            gu::Cond                                      recv_cond_;
+            gu::Cond                                      parse_cond_;
+            gu::Cond                                      apply_cond_;
+            std::deque<Received>                          parse_queue_;
+            std::deque<Received>                          apply_queue_;
+            size_t                                        queued_;
+            size_t                                        queued_bytes_;
+            size_t                                        waiting_;
+            wsrep_seqno_t                                 current_seqno_;
+            wsrep_seqno_t                                 last_seqno_;
+            gu::Config&                                   conf_;
+            TrxHandle::SlavePool&                         trx_pool_;
+            pthread_t                                     thread_;
+            pthread_t                                     parse_thread_;
+            int                                           error_code_;
+            int                                           parse_error_;
+            int                                           version_;
+            bool                                          use_ssl_;
+            bool                                          running_;
+            bool                                          ready_;
+            bool                                          recv_waiting_;
+            bool                                          parse_waiting_;
+            bool                                          apply_eof_;
         };
 
         class Sender
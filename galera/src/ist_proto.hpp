@@ -12,6 +12,13 @@
 #include "gu_logger.hpp"
 #include "gu_serialize.hpp"
 #include "gu_vector.hpp"
+#include "gu_datetime.hpp"
+#include "gu_lz.h"
+
+#if defined(__linux__)
+#include <sys/sendfile.h>
+#include <poll.h>
+#endif
 
 //
 // Sender                            Receiver
@@ -24,6 +31,13 @@
 // send_ctrl(EOF)            ----->
 //                          <-----   close()
 // close()
+//
+// Receiver advertises that it accepts compressed stream by setting
+// F_COMPRESSION flag in handshake. If sender has compression enabled, it
+// sets the same flag in handshake response and from then on everything
+// it sends (trx and ctrl messages) goes as a byte stream split into
+// T_COMPRESSED frames, each frame carrying many messages. Peers which
+// don't know about compression never set the flag.
 
 //
 // Note about protocol/message versioning:
@@ -46,7 +60,8 @@ namespace galera
                 T_HANDSHAKE = 1,
                 T_HANDSHAKE_RESPONSE = 2,
                 T_CTRL = 3,
-                T_TRX = 4
+                T_TRX = 4,
+                T_COMPRESSED = 5
             } Type;
 
             Message(int       version = -1,
@@ -180,18 +195,24 @@ namespace galera
         class Handshake : public Message
         {
         public:
-            Handshake(int version = -1)
+            enum
+            {
+                // in handshake: receiver accepts compressed stream,
+                // in response:  sender stream will be compressed
+                F_COMPRESSION = 1 << 0
+            };
+            Handshake(int version = -1, uint8_t flags = 0)
                 :
-                Message(version, Message::T_HANDSHAKE, 0, 0, 0)
+                Message(version, Message::T_HANDSHAKE, flags, 0, 0)
             { }
         };
 
         class HandshakeResponse : public Message
         {
         public:
-            HandshakeResponse(int version = -1)
+            HandshakeResponse(int version = -1, uint8_t flags = 0)
                 :
-                Message(version, Message::T_HANDSHAKE_RESPONSE, 0, 0, 0)
+                Message(version, Message::T_HANDSHAKE_RESPONSE, flags, 0, 0)
             { }
         };
 
@@ -219,18 +240,47 @@ namespace galera
             { }
         };
 
+        // Frame of compressed message stream: 4 bytes of uncompressed size
+        // followed by compressed data, len covers both.
+        class Compressed : public Message
+        {
+        public:
+            enum
+            {
+                F_STORED = 1 << 0 // data did not compress, stored as is
+            };
+            Compressed(int version = -1, uint8_t flags = 0, uint64_t len = 0)
+                :
+                Message(version, Message::T_COMPRESSED, flags, 0, len)
+            { }
+        };
+
 
         class Proto
         {
         public:
 
-            Proto(TrxHandle::SlavePool& sp, int version, bool keep_keys)
+            Proto(TrxHandle::SlavePool& sp, int version, bool keep_keys,
+                  bool zero_copy = false, int compression = 0)
                 :
-                trx_pool_ (sp),
-                raw_sent_ (0),
-                real_sent_(0),
-                version_  (version),
-                keep_keys_(keep_keys)
+                trx_pool_  (sp),
+                raw_sent_  (0),
+                real_sent_ (0),
+                file_sent_ (0),
+                raw_recv_  (0),
+                real_recv_ (0),
+                start_     (gu::datetime::Date::monotonic()),
+                version_   (version),
+                keep_keys_ (keep_keys),
+                zero_copy_ (zero_copy),
+                zlevel_    (compression),
+                zout_      (false),
+                zin_       (false),
+                peer_flags_(0),
+                zraw_      (),
+                zbuf_      (),
+                zwork_     (),
+                zpos_      (0)
             { }
 
             ~Proto()
@@ -243,14 +293,32 @@ namespace galera
                              << real_sent_
                              << " frac: "
                              << (raw_sent_ == 0 ? 0. :
-                                 static_cast<double>(real_sent_)/raw_sent_);
+                                 static_cast<double>(real_sent_)/raw_sent_)
+                             << " rate: " << rate(raw_sent_) << " B/s";
+                }
+
+                if (raw_recv_ > 0)
+                {
+                    log_info << "ist proto finished, raw received: "
+                             << raw_recv_
+                             << " real received: "
+                             << real_recv_
+                             << " frac: "
+                             << static_cast<double>(real_recv_)/raw_recv_
+                             << " rate: " << rate(raw_recv_) << " B/s";
+                }
+
+                if (file_sent_ > 0)
+                {
+                    log_info << "ist proto finished, sent " << file_sent_
+                             << " bytes directly from gcache files";
                 }
             }
 
             template <class ST>
             void send_handshake(ST& socket)
             {
-                Handshake  hs(version_);
+                Handshake  hs(version_, Handshake::F_COMPRESSION);
                 gu::Buffer buf(hs.serial_size());
                 size_t offset(hs.serialize(&buf[0], buf.size(), 0));
                 size_t n(asio::write(socket, asio::buffer(&buf[0],
@@ -278,6 +346,8 @@ namespace galera
                 log_debug << "handshake msg: " << msg.version() << " "
                           << msg.type() << " " << msg.len();
 
+                peer_flags_ = msg.flags();
+
                 switch (msg.type())
                 {
                 case Message::T_HANDSHAKE:
@@ -309,7 +379,27 @@ namespace galera
             template <class ST>
             void send_handshake_response(ST& socket)
             {
-                HandshakeResponse hsr(version_);
+                uint8_t flags(0);
+
+                if (zlevel_ > 0)
+                {
+                    if (peer_flags_ & Handshake::F_COMPRESSION)
+                    {
+                        flags |= Handshake::F_COMPRESSION;
+                        zout_  = true;
+                        zwork_.resize(gu_lz_work_size());
+                        zraw_.reserve(ZFRAME_SIZE);
+                        log_info << "IST stream compression level "
+                                 << zlevel_;
+                    }
+                    else
+                    {
+                        log_info << "IST receiver does not support "
+                                 << "compression, sending uncompressed";
+                    }
+                }
+
+                HandshakeResponse hsr(version_, flags);
                 gu::Buffer buf(hsr.serial_size());
                 size_t offset(hsr.serialize(&buf[0], buf.size(), 0));
                 size_t n(asio::write(socket, asio::buffer(&buf[0], buf.size())));
@@ -341,6 +431,11 @@ namespace galera
                 switch (msg.type())
                 {
                 case Message::T_HANDSHAKE_RESPONSE:
+                    zin_ = (msg.flags() & Handshake::F_COMPRESSION);
+                    if (zin_)
+                    {
+                        log_info << "receiving compressed IST stream";
+                    }
                     break;
                 case Message::T_CTRL:
                     switch (msg.ctrl())
@@ -363,7 +458,18 @@ namespace galera
                 Ctrl       ctrl(version_, code);
                 gu::Buffer buf(ctrl.serial_size());
                 size_t offset(ctrl.serialize(&buf[0], buf.size(), 0));
-                size_t n(asio::write(socket, asio::buffer(&buf[0],buf.size())));
+                size_t n;
+
+                if (zout_)
+                {
+                    boost::array<asio::const_buffer, 1> const cbs =
+                        {{ asio::const_buffer(&buf[0], buf.size()) }};
+                    n = send_compressed(socket, cbs, true);
+                }
+                else
+                {
+                    n = asio::write(socket, asio::buffer(&buf[0],buf.size()));
+                }
                 if (n != offset)
                 {
                     gu_throw_error(EPROTO) << "error sending ctrl message";
@@ -452,13 +558,23 @@ namespace galera
                                         &buf[0], buf.size(), offset);
                 cbs[0] = asio::const_buffer(&buf[0], buf.size());
 
-                if (gu_likely(payload_size))
+                if (zout_)
                 {
-                    sent = asio::write(socket, cbs);
+                    sent = send_compressed(socket, cbs, false);
                 }
                 else
                 {
-                    sent = asio::write(socket, asio::buffer(cbs[0]));
+                    if (gu_likely(payload_size))
+                    {
+                        sent = send_buffers(socket, cbs, buffer);
+                    }
+                    else
+                    {
+                        sent = asio::write(socket, asio::buffer(cbs[0]));
+                    }
+
+                    raw_sent_  += sent;
+                    real_sent_ += sent;
                 }
 
                 log_debug << "sent " << sent << " bytes";
@@ -468,10 +584,25 @@ namespace galera
             template <class ST>
             galera::TrxHandle*
             recv_trx(ST& socket)
+            {
+                wsrep_seqno_t seqno_g, seqno_d;
+                galera::TrxHandle* const trx(recv_trx(socket, seqno_g,
+                                                      seqno_d));
+                if (trx != 0) parse_trx(*trx, seqno_g, seqno_d);
+                return trx;
+            }
+
+            // Reads trx message from the socket, but does not parse the
+            // write set. parse_trx() must be called on returned trx before
+            // it can be used, possibly from another thread.
+            template <class ST>
+            galera::TrxHandle*
+            recv_trx(ST& socket,
+                     wsrep_seqno_t& seqno_g, wsrep_seqno_t& seqno_d)
             {
                 Message    msg(version_);
                 gu::Buffer buf(msg.serial_size());
-                size_t n(asio::read(socket, asio::buffer(&buf[0], buf.size())));
+                size_t n(recv_data(socket, asio::buffer(&buf[0], buf.size())));
 
                 if (n != buf.size())
                 {
@@ -491,11 +622,9 @@ namespace galera
                     // be a part of msg object above, so that we can skip this
                     // read. The overhead is tiny given that vast majority of
                     // messages will be trx writesets.
-                    wsrep_seqno_t seqno_g, seqno_d;
-
                     buf.resize(sizeof(seqno_g) + sizeof(seqno_d));
 
-                    n = asio::read(socket, asio::buffer(&buf[0], buf.size()));
+                    n = recv_data(socket, asio::buffer(&buf[0], buf.size()));
                     if (n != buf.size())
                     {
                         gu_throw_error(EPROTO) << "error reading trx meta data";
@@ -523,23 +652,16 @@ namespace galera
                         size_t const wsize(msg.len() - offset);
                         wbuf.resize(wsize);
 
-                        n = asio::read(socket,
-                                       asio::buffer(&wbuf[0], wbuf.size()));
+                        n = recv_data(socket,
+                                      asio::buffer(&wbuf[0], wbuf.size()));
 
                         if (gu_unlikely(n != wbuf.size()))
                         {
                             gu_throw_error(EPROTO)
                                 << "error reading write set data";
                         }
-
-                        trx->unserialize(&wbuf[0], wbuf.size(), 0);
                     }
 
-                    trx->set_received(0, -1, seqno_g);
-                    trx->set_depends_seqno(seqno_d);
-                    trx->mark_certified();
-
-                    log_debug << "received trx body: " << *trx;
                     return trx;
                 }
                 case Message::T_CTRL:
@@ -567,14 +689,339 @@ namespace galera
                 return 0; // keep compiler happy
             }
 
+            static void parse_trx(galera::TrxHandle&  trx,
+                                  wsrep_seqno_t const seqno_g,
+                                  wsrep_seqno_t const seqno_d)
+            {
+                if (seqno_d != WSREP_SEQNO_UNDEFINED)
+                {
+                    MappedBuffer& wbuf(trx.write_set_collection());
+                    trx.unserialize(&wbuf[0], wbuf.size(), 0);
+                }
+
+                trx.set_received(0, -1, seqno_g);
+                trx.set_depends_seqno(seqno_d);
+                trx.mark_certified();
+
+                log_debug << "received trx body: " << trx;
+            }
+
         private:
 
+            // uncompressed size of compressed stream frame
+            static size_t const ZFRAME_SIZE = 1 << 18;
+            // max frame size accepted by receiver
+            static size_t const ZFRAME_MAX  = 1 << 24;
+
+            double rate(uint64_t const bytes) const
+            {
+                long long const nsecs
+                    ((gu::datetime::Date::monotonic() - start_).get_nsecs());
+                return (nsecs > 0 ? bytes * 1.0e9 / nsecs : 0.);
+            }
+
+            // Appends buffers to the stream, sends frames as they fill up.
+            // Returns number of bytes consumed.
+            template <class ST, class BS>
+            size_t send_compressed(ST& socket, const BS& cbs, bool const flush)
+            {
+                size_t ret(0);
+
+                for (typename BS::const_iterator i(cbs.begin());
+                     i != cbs.end(); ++i)
+                {
+                    const gu::byte_t* ptr
+                        (asio::buffer_cast<const gu::byte_t*>(*i));
+                    size_t size(asio::buffer_size(*i));
+
+                    ret += size;
+
+                    while (size > 0)
+                    {
+                        size_t const n(std::min(size,
+                                                ZFRAME_SIZE - zraw_.size()));
+                        zraw_.insert(zraw_.end(), ptr, ptr + n);
+                        ptr  += n;
+                        size -= n;
+
+                        if (zraw_.size() == ZFRAME_SIZE) send_frame(socket);
+                    }
+                }
+
+                if (flush && !zraw_.empty()) send_frame(socket);
+
+                return ret;
+            }
+
+            template <class ST>
+            void send_frame(ST& socket)
+            {
+                assert(!zraw_.empty());
+
+                zbuf_.resize(gu_lz_bound(zraw_.size()));
+
+                size_t zsize(gu_lz_compress(&zraw_[0], zraw_.size(),
+                                            &zbuf_[0], zbuf_.size(),
+                                            zlevel_, &zwork_[0]));
+                const gu::byte_t* zptr(&zbuf_[0]);
+                uint8_t flags(0);
+
+                if (0 == zsize || zsize >= zraw_.size())
+                {
+                    flags = Compressed::F_STORED;
+                    zsize = zraw_.size();
+                    zptr  = &zraw_[0];
+                }
+
+                Compressed msg(version_, flags, sizeof(uint32_t) + zsize);
+                gu::Buffer buf(msg.serial_size() + sizeof(uint32_t));
+                size_t offset(msg.serialize(&buf[0], buf.size(), 0));
+                offset = gu::serialize4(uint32_t(zraw_.size()),
+                                        &buf[0], buf.size(), offset);
+
+                boost::array<asio::const_buffer, 2> const cbs =
+                    {{ asio::const_buffer(&buf[0], buf.size()),
+                       asio::const_buffer(zptr, zsize) }};
+                asio::write(socket, cbs);
+
+                raw_sent_  += zraw_.size();
+                real_sent_ += buf.size() + zsize;
+                zraw_.clear();
+            }
+
+            template <class ST>
+            size_t recv_data(ST& socket, const asio::mutable_buffer& mb)
+            {
+                gu::byte_t* const ptr(asio::buffer_cast<gu::byte_t*>(mb));
+                size_t      const size(asio::buffer_size(mb));
+
+                if (!zin_)
+                {
+                    size_t const n(asio::read(socket, asio::buffer(ptr, size)));
+                    raw_recv_  += n;
+                    real_recv_ += n;
+                    return n;
+                }
+
+                size_t n(0);
+
+                while (n < size)
+                {
+                    if (zpos_ == zraw_.size()) recv_frame(socket);
+
+                    size_t const chunk(std::min(size - n,
+                                                zraw_.size() - zpos_));
+                    ::memcpy(ptr + n, &zraw_[zpos_], chunk);
+                    zpos_ += chunk;
+                    n     += chunk;
+                }
+
+                return n;
+            }
+
+            template <class ST>
+            void recv_frame(ST& socket)
+            {
+                Message    msg(version_);
+                gu::Buffer buf(msg.serial_size() + sizeof(uint32_t));
+                size_t n(asio::read(socket, asio::buffer(&buf[0], buf.size())));
+
+                if (n != buf.size())
+                {
+                    gu_throw_error(EPROTO) << "error receiving frame header";
+                }
+
+                size_t offset(msg.unserialize(&buf[0], buf.size(), 0));
+
+                if (msg.type() != Message::T_COMPRESSED ||
+                    msg.len() < sizeof(uint32_t))
+                {
+                    gu_throw_error(EPROTO) << "unexpected message type: "
+                                           << msg.type() << ", len: "
+                                           << msg.len();
+                }
+
+                uint32_t raw_size;
+                offset = gu::unserialize4(&buf[0], buf.size(), offset,
+                                          raw_size);
+                size_t const zsize(msg.len() - sizeof(uint32_t));
+
+                if (0 == raw_size || raw_size > ZFRAME_MAX ||
+                    0 == zsize    || zsize > gu_lz_bound(raw_size))
+                {
+                    gu_throw_error(EPROTO) << "invalid frame size: "
+                                           << zsize << '/' << raw_size;
+                }
+
+                zraw_.resize(raw_size);
+                zpos_ = 0;
+
+                bool const stored(msg.flags() & Compressed::F_STORED);
+
+                if (stored && zsize != raw_size)
+                {
+                    gu_throw_error(EPROTO) << "invalid stored frame size: "
+                                           << zsize << '/' << raw_size;
+                }
+
+                gu::Buffer& dst(stored ? zraw_ : zbuf_);
+                dst.resize(zsize);
+                n = asio::read(socket, asio::buffer(&dst[0], zsize));
+
+                if (n != zsize)
+                {
+                    gu_throw_error(EPROTO) << "error receiving frame";
+                }
+
+                if (!stored &&
+                    gu_lz_decompress(&zbuf_[0], zsize, &zraw_[0], raw_size) !=
+                    ssize_t(raw_size))
+                {
+                    gu_throw_error(EPROTO) << "corrupted compressed frame";
+                }
+
+                raw_recv_  += raw_size;
+                real_recv_ += buf.size() + zsize;
+            }
+
+            typedef boost::array<asio::const_buffer, 3> TrxBuffers;
+
+            template <class ST>
+            size_t send_buffers(ST&                           socket,
+                                const TrxBuffers&             cbs,
+                                const gcache::GCache::Buffer&)
+            {
+                return asio::write(socket, cbs);
+            }
+
+            size_t send_buffers(asio::ip::tcp::socket&        socket,
+                                const TrxBuffers&             cbs,
+                                const gcache::GCache::Buffer& buffer)
+            {
+#if defined(__linux__)
+                if (zero_copy_ && buffer.fd() >= 0)
+                {
+                    return send_zero_copy(socket, cbs, buffer);
+                }
+#endif
+                return asio::write(socket, cbs);
+            }
+
+#if defined(__linux__)
+            /* Plain TCP socket: payload pieces which reside in gcache
+             * ring buffer or page file are handed to the kernel with
+             * sendfile(), so that only the framing goes through user space.
+             * Other pieces are sent with MSG_MORE to be coalesced with
+             * the following payload. */
+            size_t send_zero_copy(asio::ip::tcp::socket&        socket,
+                                  const TrxBuffers&             cbs,
+                                  const gcache::GCache::Buffer& buffer)
+            {
+                const gu::byte_t* const begin(buffer.ptr());
+                const gu::byte_t* const end  (begin + buffer.size());
+
+                size_t sent(0);
+
+                for (size_t i(0); i < cbs.size(); ++i)
+                {
+                    const gu::byte_t* const ptr
+                        (asio::buffer_cast<const gu::byte_t*>(cbs[i]));
+                    size_t const size(asio::buffer_size(cbs[i]));
+
+                    if (0 == size) continue;
+
+                    if (zero_copy_ && ptr >= begin && ptr + size <= end)
+                    {
+                        off_t const offset(buffer.offset() + (ptr - begin));
+
+                        if (gu_likely(send_file(socket.native(), buffer.fd(),
+                                                offset, size)))
+                        {
+                            sent       += size;
+                            file_sent_ += size;
+                            continue;
+                        }
+
+                        log_warn << "sendfile() is not supported for gcache "
+                                 << "files, falling back to copying IST";
+                        zero_copy_ = false;
+                    }
+
+                    for (size_t off(0); off < size;)
+                    {
+                        off += socket.send(asio::buffer(ptr + off, size - off),
+                                           MSG_MORE);
+                    }
+                    sent += size;
+                }
+
+                return sent;
+            }
+
+            /* @return false if sendfile() is not supported for the file */
+            static bool send_file(int const sock, int const fd, off_t offset,
+                                  size_t const size)
+            {
+                size_t sent(0);
+
+                while (sent < size)
+                {
+                    ssize_t const n(::sendfile(sock, fd, &offset, size - sent));
+
+                    if (gu_likely(n > 0))
+                    {
+                        sent += n;
+                        continue;
+                    }
+
+                    if (0 == n)
+                    {
+                        gu_throw_error(EIO) << "sendfile(): unexpected end of "
+                                            << "file at offset " << offset;
+                    }
+
+                    switch (errno)
+                    {
+                    case EINTR:
+                        break;
+                    case EAGAIN:
+                    {
+                        struct pollfd pfd = { sock, POLLOUT, 0 };
+                        (void)::poll(&pfd, 1, -1);
+                        break;
+                    }
+                    case EINVAL:
+                    case ENOSYS:
+                        if (0 == sent) return false;
+                        /* fall through */
+                    default:
+                        gu_throw_error(errno) << "sendfile() failed";
+                    }
+                }
+
+                return true;
+            }
+#endif /* __linux__ */
+
             TrxHandle::SlavePool& trx_pool_;
 
             uint64_t raw_sent_;
             uint64_t real_sent_;
+            uint64_t file_sent_;
+            uint64_t raw_recv_;
+            uint64_t real_recv_;
+            gu::datetime::Date start_;
             int      version_;
             bool     keep_keys_;
+            bool     zero_copy_;
+            int      zlevel_;     // compression level, 0 - no compression
+            bool     zout_;       // outgoing stream is compressed
+            bool     zin_;        // incoming stream is compressed
+            uint8_t  peer_flags_; // handshake flags of the receiver
+            gu::Buffer zraw_;     // uncompressed frame
+            gu::Buffer zbuf_;     // compressed frame
+            gu::Buffer zwork_;    // compressor work area
+            size_t   zpos_;       // read position in zraw_
         };
     }
 }
@@ -0,0 +1,782 @@
+//
+// Copyright (C) 2010-2014 Codership Oy
+//
+
+/*!
+ * @file Monitor with a lock-free fast path
+ *
+ * Has the same interface and semantics as Monitor (monitor.hpp), but
+ * last_entered_, last_left_ and process states are atomic. A process that
+ * may enter right away, or that leaves without anybody waiting on monitor
+ * state change, does not touch the monitor mutex. The mutex is taken only
+ * on the slow path: when a process has to wait, to wake up waiters, and by
+ * the rarely called methods (interrupt(), self_cancel(), drain(), ...).
+ *
+ * Lost wakeups are avoided in Dekker fashion: waiter increments waiters_
+ * and then checks last_left_, while leaver advances last_left_ and then
+ * checks waiters_. All atomic operations are sequentially consistent.
+ *
+ * Each process slot is a single word which combines the seqno of the
+ * process that uses the slot with process state. If the seqno in the slot
+ * is not the one of the process in question, the process is S_IDLE. This
+ * way slots don't need to be reset when last_left_ advances past them.
+ *
+ * Slot words are packed in an array which is sized to the actual process
+ * window: it starts small, doubles when a process does not fit in it and
+ * shrinks back when the window observed during resize_interval_ seqnos is
+ * much smaller than the array. Resize happens under mutex_: all words of
+ * the old array get S_FROZEN bit first, so lock-free writers that still use
+ * it fail their CAS and retry under mutex_. Frozen words can still be read,
+ * their content remains valid. Since words are unfrozen only after the array
+ * is published, successful CAS always happens on the current array. Arrays
+ * are freed only by destructor and reused when their size is needed again.
+ *
+ * Condition variables are shared between slots by hashing seqno: waiting is
+ * rare and all waits recheck their condition.
+ */
+
+#ifndef GALERA_MONITOR_NG_HPP
+#define GALERA_MONITOR_NG_HPP
+
+#include "trx_handle.hpp"
+#include <gu_lock.hpp> // for gu::Mutex and gu::Cond
+#include <gu_atomic.hpp>
+
+#include <algorithm>
+
+namespace galera
+{
+    template <class C>
+    class MonitorNG
+    {
+    private:
+
+        enum State
+        {
+            S_IDLE,     // Slot is free
+            S_WAITING,  // Waiting to enter applying critical section
+            S_CANCELED,
+            S_APPLYING, // Applying
+            S_FINISHED  // Finished
+        };
+
+        typedef wsrep_seqno_t Word;
+
+        static const int  state_bits_ = 4;
+        static const Word state_mask_ = 0x07;
+        static const Word S_FROZEN    = 0x08; // word may not be modified
+
+        static Word make_word(wsrep_seqno_t const seqno, State const state)
+        {
+            return (seqno * (1 << state_bits_) + state);
+        }
+
+        static wsrep_seqno_t word_seqno(Word const w)
+        {
+            return (w >> state_bits_);
+        }
+
+        static State word_state(Word const w)
+        {
+            return State(w & state_mask_);
+        }
+
+        static bool frozen(Word const w) { return (w & S_FROZEN); }
+
+        class Slots
+        {
+        public:
+
+            explicit Slots(size_t const size)
+                :
+                mask_ (size - 1),
+                words_(new gu::Atomic<Word>[size]),
+                objs_ (new const C*[size])
+            {
+                clear(0);
+            }
+
+            ~Slots()
+            {
+                delete[] words_;
+                delete[] objs_;
+            }
+
+            ssize_t size() const { return mask_ + 1; }
+
+            gu::Atomic<Word>& word(wsrep_seqno_t const seqno)
+            {
+                return words_[seqno & mask_];
+            }
+
+            const C*& obj(wsrep_seqno_t const seqno)
+            {
+                return objs_[seqno & mask_];
+            }
+
+            State state(wsrep_seqno_t const seqno) const
+            {
+                Word const w(words_[seqno & mask_]() & ~S_FROZEN);
+                return (word_seqno(w) == seqno ? word_state(w) : S_IDLE);
+            }
+
+            void clear(Word const flags)
+            {
+                for (size_t i(0); i <= mask_; ++i)
+                {
+                    words_[i] = make_word(-1, S_IDLE) | flags;
+                    objs_[i]  = 0;
+                }
+            }
+
+            // makes concurrent CAS on the words fail
+            void freeze()
+            {
+                for (size_t i(0); i <= mask_; ++i)
+                {
+                    Word w;
+                    do { w = words_[i](); }
+                    while (!words_[i].compare_and_swap(w, w | S_FROZEN));
+                }
+            }
+
+            // nobody modifies frozen words, so no CAS needed here
+            void unfreeze()
+            {
+                for (size_t i(0); i <= mask_; ++i)
+                {
+                    words_[i] = words_[i]() & ~S_FROZEN;
+                }
+            }
+
+        private:
+
+            Slots(const Slots&);
+            void operator=(const Slots&);
+
+            size_t const            mask_;
+            gu::Atomic<Word>* const words_;
+            const C**         const objs_;
+        };
+
+        /* counts threads that wait for monitor state change */
+        class Waiter
+        {
+        public:
+            Waiter(gu::Atomic<long>& w) : w_(w) { ++w_; }
+            ~Waiter() { --w_; }
+        private:
+            Waiter(const Waiter&);
+            void operator=(const Waiter&);
+            gu::Atomic<long>& w_;
+        };
+
+        static const int     min_slots_log2_  = 8;
+        static const int     max_slots_log2_  = 16;
+        static const ssize_t process_size_    = (1ULL << max_slots_log2_);
+        static const size_t  conds_size_      = 64;
+        static const size_t  conds_mask_      = conds_size_ - 1;
+        static const wsrep_seqno_t resize_interval_ = (1 << 14);
+
+    public:
+
+        MonitorNG()
+            :
+            mutex_(),
+            cond_(),
+            last_entered_(-1),
+            last_left_(-1),
+            drain_seqno_(LLONG_MAX),
+            waiters_(0),
+            slots_(new Slots(1 << min_slots_log2_)),
+            entered_(0),
+            oooe_(0),
+            oool_(0),
+            win_size_(0),
+            win_max_(0)
+        {
+            std::fill(all_slots_, all_slots_ + max_slots_log2_ + 1,
+                      static_cast<Slots*>(0));
+            all_slots_[min_slots_log2_] = slots_();
+        }
+
+        ~MonitorNG()
+        {
+            for (int i(0); i <= max_slots_log2_; ++i) delete all_slots_[i];
+
+            if (entered_ > 0)
+            {
+                log_info << "mon: entered " << entered_
+                         << " oooe fraction " << double(oooe_)/entered_
+                         << " oool fraction " << double(oool_)/entered_;
+            }
+            else
+            {
+                log_info << "apply mon: entered 0";
+            }
+        }
+
+        void set_initial_position(wsrep_seqno_t seqno)
+        {
+            gu::Lock lock(mutex_);
+            if (last_entered_() == -1 || seqno == -1)
+            {
+                // first call or reset, seqnos may be reused: clear slots
+                slots_()->clear(0);
+                last_entered_ = seqno;
+                last_left_    = seqno;
+            }
+            else
+            {
+                // drain monitor up to seqno but don't reset last_entered_
+                // or last_left_
+                Waiter w(waiters_);
+                drain_common(seqno, lock);
+                drain_seqno_ = LLONG_MAX;
+            }
+            if (seqno != -1)
+            {
+                wait_cond(seqno).broadcast();
+            }
+        }
+
+        void enter(C& obj)
+        {
+            const wsrep_seqno_t obj_seqno(obj.seqno());
+
+            assert(obj_seqno > last_left_());
+
+#ifndef GU_DBUG_ON /* debug sync points are on the slow path */
+            Slots& s(*slots_());
+
+            if (gu_likely(obj_seqno - last_left_() < s.size() &&
+                          obj_seqno <= drain_seqno_()))
+            {
+                update_last_entered(obj_seqno);
+
+                gu::Atomic<Word>& word(s.word(obj_seqno));
+                Word const        w(word());
+
+                if (word_seqno(w) != obj_seqno && !frozen(w) &&
+                    may_enter(obj) &&
+                    word.compare_and_swap(w, make_word(obj_seqno,
+                                                       S_APPLYING)))
+                {
+                    entered(obj_seqno);
+                    return;
+                }
+                // else canceled, has to wait or slots are being resized
+            }
+#endif /* GU_DBUG_ON */
+
+            enter_slow(obj);
+        }
+
+        void leave(const C& obj)
+        {
+#ifndef NDEBUG
+            wsrep_seqno_t const obj_seqno(obj.seqno());
+            State const state(slots_()->state(obj_seqno));
+#endif /* NDEBUG */
+
+            assert(state == S_APPLYING || state == S_CANCELED);
+
+            post_leave(obj.seqno(), 0);
+        }
+
+        void self_cancel(C& obj)
+        {
+            wsrep_seqno_t const obj_seqno(obj.seqno());
+            gu::Lock lock(mutex_);
+            Waiter   w(waiters_);
+
+            assert(obj_seqno > last_left_());
+
+            while (!fits(obj_seqno))
+                // TODO: exit on error
+            {
+                log_warn << "Trying to self-cancel seqno out of process "
+                         << "space: obj_seqno - last_left_ = " << obj_seqno
+                         << " - " << last_left_() << " = "
+                         << (obj_seqno - last_left_())
+                         << ", process_size_: "  << process_size_
+                         << ". Deadlock is very likely.";
+                obj.unlock();
+                lock.wait(cond_);
+                obj.lock();
+            }
+
+            assert(slots_()->state(obj_seqno) == S_IDLE ||
+                   slots_()->state(obj_seqno) == S_CANCELED);
+
+            update_last_entered(obj_seqno);
+
+            if (obj_seqno <= drain_seqno_())
+            {
+                post_leave(obj_seqno, &lock);
+            }
+            else
+            {
+                slots_()->word(obj_seqno) = make_word(obj_seqno, S_FINISHED);
+            }
+        }
+
+        void interrupt(const C& obj)
+        {
+            wsrep_seqno_t const obj_seqno(obj.seqno());
+            gu::Lock lock(mutex_);
+            Waiter   w(waiters_);
+
+            while (!fits(obj_seqno))
+                // TODO: exit on error
+            {
+                lock.wait(cond_);
+            }
+
+            Slots&            s    (*slots_());
+            gu::Atomic<Word>& word (s.word(obj_seqno));
+            Word const        old  (word());
+            State const       state(s.state(obj_seqno));
+
+            if (((state == S_IDLE && obj_seqno > last_left_()) ||
+                 state == S_WAITING) &&
+                // fails if process has just entered on the fast path
+                word.compare_and_swap(old, make_word(obj_seqno, S_CANCELED)))
+            {
+                cond(obj_seqno).broadcast();
+                // since last_left + 1 cannot be <= S_WAITING we're not
+                // modifying a window here. No broadcasting of cond_.
+            }
+            else
+            {
+                log_debug << "interrupting " << obj_seqno
+                          << " state " << s.state(obj_seqno)
+                          << " le " << last_entered_()
+                          << " ll " << last_left_();
+            }
+        }
+
+        wsrep_seqno_t last_left()   const { return last_left_(); }
+        ssize_t       size()        const { return process_size_; }
+
+        /* current size of the slot array */
+        ssize_t       slots()       const { return slots_()->size(); }
+
+        bool would_block (wsrep_seqno_t seqno) const
+        {
+            // slot array grows on demand up to process_size_
+            return (seqno - last_left_() >= process_size_ ||
+                    seqno > drain_seqno_());
+        }
+
+        void drain(wsrep_seqno_t seqno)
+        {
+            gu::Lock lock(mutex_);
+            Waiter   w(waiters_);
+
+            while (drain_seqno_() != LLONG_MAX)
+            {
+                lock.wait(cond_);
+            }
+
+            drain_common(seqno, lock);
+
+            // there can be some stale canceled entries
+            wsrep_seqno_t first, last;
+            if (update_last_left(first, last)) notify(first, last);
+
+            drain_seqno_ = LLONG_MAX;
+            cond_.broadcast();
+        }
+
+        void wait(wsrep_seqno_t seqno)
+        {
+            gu::Lock lock(mutex_);
+            Waiter   w(waiters_);
+
+            while (last_left_() < seqno) // conds are shared by seqnos
+            {
+                lock.wait(wait_cond(seqno));
+            }
+        }
+
+        void wait(wsrep_seqno_t seqno, const gu::datetime::Date& wait_until)
+        {
+            gu::Lock lock(mutex_);
+            Waiter   w(waiters_);
+
+            while (last_left_() < seqno)
+            {
+                lock.wait(wait_cond(seqno), wait_until);
+            }
+        }
+
+        void get_stats(double* oooe, double* oool, double* win_size)
+        {
+            long const entered(entered_);
+
+            if (entered > 0)
+            {
+                *oooe     = double(oooe_)/entered;
+                *oool     = double(oool_)/entered;
+                *win_size = double(win_size_)/entered;
+            }
+            else
+            {
+                *oooe = .0; *oool = .0; *win_size = .0;
+            }
+        }
+
+        void flush_stats()
+        {
+            oooe_ = 0; oool_ = 0; win_size_ = 0; entered_ = 0;
+        }
+
+    private:
+
+        gu::Cond& cond(wsrep_seqno_t const seqno)
+        {
+            return conds_[seqno & conds_mask_];
+        }
+
+        gu::Cond& wait_cond(wsrep_seqno_t const seqno)
+        {
+            return wait_conds_[seqno & conds_mask_];
+        }
+
+        bool may_enter(const C& obj) const
+        {
+            return obj.condition(last_entered_(), last_left_());
+        }
+
+        void update_last_entered(wsrep_seqno_t const seqno)
+        {
+            wsrep_seqno_t le(last_entered_());
+
+            while (le < seqno && !last_entered_.compare_and_swap(le, seqno))
+            {
+                le = last_entered_();
+            }
+        }
+
+        void entered(wsrep_seqno_t const obj_seqno)
+        {
+            wsrep_seqno_t const last_left(last_left_());
+            wsrep_seqno_t const win(last_entered_() - last_left);
+
+            ++entered_;
+            if ((last_left + 1) < obj_seqno) ++oooe_;
+            win_size_ += win;
+            if (win_max_ < win) win_max_ = win;
+        }
+
+        void enter_slow(C& obj)
+        {
+            const wsrep_seqno_t obj_seqno(obj.seqno());
+            gu::Lock            lock(mutex_);
+            Waiter              w(waiters_);
+
+            pre_enter(obj, lock);
+
+            /* all transitions from and to S_WAITING happen under mutex_,
+             * slots_ may be replaced while we wait */
+            if (gu_likely(slots_()->state(obj_seqno) != S_CANCELED))
+            {
+                assert(slots_()->state(obj_seqno) == S_IDLE);
+
+                slots_()->obj(obj_seqno)  = &obj;
+                slots_()->word(obj_seqno) = make_word(obj_seqno, S_WAITING);
+
+#ifdef GU_DBUG_ON
+                obj.debug_sync(mutex_);
+#endif // GU_DBUG_ON
+                while (may_enter(obj) == false &&
+                       slots_()->state(obj_seqno) == S_WAITING)
+                {
+                    obj.unlock();
+                    lock.wait(cond(obj_seqno));
+                    obj.lock();
+                }
+
+                Slots& s(*slots_());
+
+                s.obj(obj_seqno) = 0;
+
+                if (s.state(obj_seqno) != S_CANCELED)
+                {
+                    assert(s.state(obj_seqno) == S_WAITING ||
+                           s.state(obj_seqno) == S_APPLYING);
+
+                    s.word(obj_seqno) = make_word(obj_seqno, S_APPLYING);
+
+                    entered(obj_seqno);
+                    return;
+                }
+            }
+
+            assert(slots_()->state(obj_seqno) == S_CANCELED);
+            slots_()->word(obj_seqno) = make_word(obj_seqno, S_IDLE);
+
+            gu_throw_error(EINTR);
+        }
+
+        // wait until it is possible to grab slot in monitor,
+        // update last entered
+        void pre_enter(C& obj, gu::Lock& lock)
+        {
+            assert(last_left_() <= last_entered_());
+
+            const wsrep_seqno_t obj_seqno(obj.seqno());
+
+            while (obj_seqno > drain_seqno_() || !fits(obj_seqno))
+                // TODO: exit on error
+            {
+                obj.unlock();
+                lock.wait(cond_);
+                obj.lock();
+            }
+
+            update_last_entered(obj_seqno);
+        }
+
+        // must be called under mutex_: returns true if seqno fits in the
+        // slot array, growing the array if needed and possible
+        bool fits(wsrep_seqno_t const seqno)
+        {
+            wsrep_seqno_t const win(seqno - last_left_());
+
+            if (gu_likely(win < slots_()->size())) return true;
+            if (win >= process_size_)              return false;
+
+            bool const ret(resize(win + 1));
+            assert(ret); // growing can't fail
+
+            return ret;
+        }
+
+        // must be called under mutex_: replaces slot array with the one of
+        // at least min_size, returns false if processes don't fit in it
+        bool resize(wsrep_seqno_t const min_size)
+        {
+            int log2(min_slots_log2_);
+            while ((1LL << log2) < min_size) ++log2;
+            assert(log2 <= max_slots_log2_);
+
+            Slots* const from(slots_());
+
+            if ((1LL << log2) == from->size()) return true;
+
+            Slots*& to(all_slots_[log2]);
+
+            if (to)
+                to->clear(S_FROZEN); // stale writers may still hold it
+            else
+                to = new Slots(1 << log2);
+
+            from->freeze();
+
+            wsrep_seqno_t const ll(last_left_());
+
+            for (wsrep_seqno_t i(0); i < from->size(); ++i)
+            {
+                Word const          w(from->word(i)() & ~S_FROZEN);
+                wsrep_seqno_t const seqno(word_seqno(w));
+
+                if (word_state(w) == S_IDLE || seqno <= ll) continue;
+
+                if (seqno - ll >= to->size())
+                {
+                    log_debug << "Monitor slots resize " << from->size()
+                              << " -> " << to->size() << " aborted: seqno "
+                              << seqno << ", last left " << ll;
+                    from->unfreeze();
+                    return false;
+                }
+
+                to->word(seqno) = w | S_FROZEN;
+                to->obj(seqno)  = from->obj(seqno);
+            }
+
+            slots_ = to;
+            to->unfreeze();
+
+            log_debug << "Monitor slots resized " << from->size() << " -> "
+                      << to->size();
+
+            // leavers could not finish while words were frozen
+            wsrep_seqno_t first, last;
+            if (update_last_left(first, last)) notify(first, last);
+
+            return true;
+        }
+
+        // must be called under mutex_: shrinks slot array if the window
+        // observed since the last call was much smaller than the array
+        void check_shrink()
+        {
+            wsrep_seqno_t const want(2 * win_max_ + 1);
+
+            win_max_ = 0;
+
+            if (slots_()->size() > (1 << min_slots_log2_) &&
+                want * 4 <= slots_()->size())
+            {
+                resize(want);
+            }
+        }
+
+        // advance last_left_ over finished processes, return true and
+        // the range of seqnos left if it was advanced
+        bool update_last_left(wsrep_seqno_t& first, wsrep_seqno_t& last)
+        {
+            bool ret(false);
+
+            while (true)
+            {
+                wsrep_seqno_t const ll(last_left_());
+                wsrep_seqno_t const i(ll + 1);
+
+                // slots_ must be loaded after last_left_
+                Word const w(slots_()->word(i)() & ~S_FROZEN);
+
+                if (w != make_word(i, S_FINISHED)) break;
+
+                // CAS makes sure only one thread advances past i
+                if (last_left_.compare_and_swap(ll, i))
+                {
+                    if (!ret) first = i;
+                    last = i;
+                    ret  = true;
+                }
+            }
+
+            return ret;
+        }
+
+        // must be called under mutex_
+        void wake_up_next()
+        {
+            Slots& s(*slots_());
+
+            for (wsrep_seqno_t i = last_left_() + 1; i <= last_entered_(); ++i)
+            {
+                if (s.state(i)         == S_WAITING &&
+                    may_enter(*s.obj(i)) == true)
+                {
+                    // We need to set state to APPLYING here because if
+                    // it is  the last_left_ + 1 and it gets canceled in
+                    // the race  that follows exit from this function,
+                    // there will be  nobody to clean up and advance
+                    // last_left_.
+                    s.word(i) = make_word(i, S_APPLYING);
+                    cond(i).broadcast();
+                }
+            }
+        }
+
+        // must be called under mutex_
+        void notify(wsrep_seqno_t const first, wsrep_seqno_t const last)
+        {
+            for (wsrep_seqno_t i(first);
+                 i <= last && i - first < wsrep_seqno_t(conds_size_); ++i)
+            {
+                wait_cond(i).broadcast();
+            }
+
+            // wake up waiters that may remain above us (last_left_
+            // now is max)
+            wake_up_next();
+
+            // occupied window shrinked, also notifies drain
+            cond_.broadcast();
+        }
+
+        // returns false if the word is frozen by resize()
+        bool finish(wsrep_seqno_t const obj_seqno)
+        {
+            gu::Atomic<Word>& word(slots_()->word(obj_seqno));
+            Word const        w(word());
+
+            return (!frozen(w) &&
+                    word.compare_and_swap(w, make_word(obj_seqno,
+                                                       S_FINISHED)));
+        }
+
+        void post_leave(wsrep_seqno_t const obj_seqno, gu::Lock* const lock)
+        {
+            if (gu_unlikely(!finish(obj_seqno)))
+            {
+                assert(!lock); // nothing is frozen while we hold mutex_
+                gu::Lock l(mutex_);
+                if (!finish(obj_seqno))
+                {
+                    gu_throw_fatal << "Failed to leave monitor: " << obj_seqno;
+                }
+            }
+
+            wsrep_seqno_t first, last;
+
+            bool const left(update_last_left(first, last));
+            bool const check(0 == (obj_seqno & (resize_interval_ - 1)));
+
+            if (left && first == obj_seqno && last > obj_seqno) ++oool_;
+
+            if ((left && waiters_() > 0) || gu_unlikely(check))
+            {
+                if (lock)
+                {
+                    if (left)  notify(first, last);
+                    if (check) check_shrink();
+                }
+                else
+                {
+                    gu::Lock l(mutex_);
+                    if (left)  notify(first, last);
+                    if (check) check_shrink();
+                }
+            }
+        }
+
+        void drain_common(wsrep_seqno_t seqno, gu::Lock& lock)
+        {
+            log_debug << "draining up to " << seqno;
+
+            drain_seqno_ = seqno;
+
+            if (last_left_() > drain_seqno_())
+            {
+                log_debug << "last left greater than drain seqno";
+                for (wsrep_seqno_t i = drain_seqno_(); i <= last_left_(); ++i)
+                {
+                    log_debug << "applier " << i
+                              << " in state " << slots_()->state(i);
+                }
+            }
+
+            while (last_left_() < drain_seqno_()) lock.wait(cond_);
+        }
+
+        MonitorNG(const MonitorNG&);
+        void operator=(const MonitorNG&);
+
+        gu::Mutex mutex_;
+        gu::Cond  cond_;
+        gu::Atomic<wsrep_seqno_t> last_entered_;
+        gu::Atomic<wsrep_seqno_t> last_left_;
+        gu::Atomic<wsrep_seqno_t> drain_seqno_;
+        gu::Atomic<long>          waiters_;
+        gu::Atomic<Slots*>        slots_;
+        Slots*                    all_slots_[max_slots_log2_ + 1];
+        gu::Cond                  conds_[conds_size_];      // enter
+        gu::Cond                  wait_conds_[conds_size_]; // wait()
+        /* statistics are updated without synchronization on the fast path
+         * and are approximate, locked instructions are too expensive here */
+        long entered_;  // entered
+        long oooe_;     // out of order entered
+        long oool_;     // out of order left
+        long win_size_; // window between last_left_ and last_entered_
+        long win_max_;  // max window since the last check_shrink()
+    };
+}
+
+#endif // GALERA_MONITOR_NG_HPP
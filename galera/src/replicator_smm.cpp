@@ -230,6 +230,9 @@ galera::ReplicatorSMM::ReplicatorSMM(const struct wsrep_init_args* args)
 
     local_monitor_.set_initial_position(0);
 
+    gcs_as_.set_recv_batch(
+        gu::from_string<long>(config_.get(Param::recv_batch)));
+
     wsrep_uuid_t  uuid;
     wsrep_seqno_t seqno;
 
@@ -303,7 +306,17 @@ wsrep_status_t galera::ReplicatorSMM::connect(const std::string& cluster_name,
         ret = WSREP_NODE_FAIL;
     }
 
-    gcache_.reset();
+    // history recovered on startup can be kept to serve IST only if it
+    // ends exactly at initial position
+    if (gcache_.history_matches(to_gu_uuid(gcs_uuid), seqno))
+    {
+        log_info << "Keeping GCache history of " << gcs_uuid << " from "
+                 << gcache_.seqno_min() << " to " << seqno;
+    }
+    else
+    {
+        gcache_.reset();
+    }
 
     if (ret == WSREP_OK &&
         (err = gcs_.connect(cluster_name, cluster_url, bootstrap)) != 0)
@@ -1256,6 +1269,8 @@ void galera::ReplicatorSMM::process_commit_cut(wsrep_seqno_t seq,
 
     gu_trace(local_monitor_.enter(lo));
 
+    /* purges at most one slice of certification index, so that local
+     * monitor is not held for long, the rest is purged on next commit cuts */
     if (seq >= cc_seqno_) /* Refs #782. workaround for
                            * assert(seqno >= seqno_released_) in gcache. */
         cert_.purge_trxs_upto(seq, true);
@@ -1839,6 +1854,12 @@ galera::ReplicatorSMM::update_state_uuid (const wsrep_uuid_t& uuid)
                 sizeof(state_uuid_str_));
     }
 
+    // history of another group is of no use
+    if (gcache_.gid() != to_gu_uuid(uuid))
+    {
+        gcache_.seqno_reset(to_gu_uuid(uuid));
+    }
+
     st_.set(uuid, WSREP_SEQNO_UNDEFINED);
 }
 
@@ -15,7 +15,13 @@
 #include "gu_init.h"
 #include "GCache.hpp"
 #include "gcs.hpp"
+#ifdef GALERA_USE_MONITOR_NG
+#include "monitor_ng.hpp"
+#define GALERA_MONITOR MonitorNG
+#else
 #include "monitor.hpp"
+#define GALERA_MONITOR Monitor
+#endif /* GALERA_USE_MONITOR_NG */
 #include "wsdb.hpp"
 #include "certification.hpp"
 #include "trx_handle.hpp"
@@ -176,6 +182,7 @@ namespace galera
             static const std::string commit_order;
             static const std::string causal_read_timeout;
             static const std::string max_write_set_size;
+            static const std::string recv_batch;
         };
 
         typedef std::pair<std::string, std::string> Default;
@@ -547,9 +554,9 @@ namespace galera
         Certification   cert_;
 
         // concurrency control
-        Monitor<LocalOrder>  local_monitor_;
-        Monitor<ApplyOrder>  apply_monitor_;
-        Monitor<CommitOrder> commit_monitor_;
+        GALERA_MONITOR<LocalOrder>  local_monitor_;
+        GALERA_MONITOR<ApplyOrder>  apply_monitor_;
+        GALERA_MONITOR<CommitOrder> commit_monitor_;
         gu::datetime::Period causal_read_timeout_;
 
         // counters
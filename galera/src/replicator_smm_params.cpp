@@ -25,6 +25,8 @@ const std::string galera::ReplicatorSMM::Param::key_format =
     common_prefix + "key_format";
 const std::string galera::ReplicatorSMM::Param::max_write_set_size =
     common_prefix + "max_ws_size";
+const std::string galera::ReplicatorSMM::Param::recv_batch =
+    common_prefix + "recv_batch";
 
 int const galera::ReplicatorSMM::MAX_PROTO_VER(7);
 
@@ -39,6 +41,7 @@ galera::ReplicatorSMM::Defaults::Defaults() : map_()
     const int max_write_set_size(galera::WriteSetNG::MAX_SIZE);
     map_.insert(Default(Param::max_write_set_size,
                         gu::to_string(max_write_set_size)));
+    map_.insert(Default(Param::recv_batch, "1"));
 }
 
 const galera::ReplicatorSMM::Defaults galera::ReplicatorSMM::defaults;
@@ -163,6 +166,10 @@ galera::ReplicatorSMM::set_param (const std::string& key,
     {
         trx_params_.max_write_set_size_ = gu::from_string<int>(value);
     }
+    else if (key == Param::recv_batch)
+    {
+        gcs_as_.set_recv_batch(gu::from_string<long>(value));
+    }
     else
     {
         log_warn << "parameter '" << key << "' not found";
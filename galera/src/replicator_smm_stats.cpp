@@ -228,14 +228,14 @@ galera::ReplicatorSMM::stats_get() const
     double oooe;
     double oool;
     double win;
-    const_cast<Monitor<ApplyOrder>&>(apply_monitor_).
+    const_cast<GALERA_MONITOR<ApplyOrder>&>(apply_monitor_).
         get_stats(&oooe, &oool, &win);
 
     sv[STATS_APPLY_OOOE          ].value._double = oooe;
     sv[STATS_APPLY_OOOL          ].value._double = oool;
     sv[STATS_APPLY_WINDOW        ].value._double = win;
 
-    const_cast<Monitor<CommitOrder>&>(commit_monitor_).
+    const_cast<GALERA_MONITOR<CommitOrder>&>(commit_monitor_).
         get_stats(&oooe, &oool, &win);
 
     sv[STATS_COMMIT_OOOE         ].value._double = oooe;
@@ -251,6 +251,9 @@ galera::ReplicatorSMM::stats_get() const
     // Get gcs backend status
     gu::Status status;
     gcs_.get_status(status);
+    cert_.get_status(status);
+    gcache_.get_status(status);
+    WriteSetIn::get_status(status);
 #ifdef GU_DBUG_ON
     status.insert("debug_sync_waiters", gu_debug_sync_waiters());
 #endif // GU_DBUG_ON
@@ -341,6 +344,8 @@ galera::ReplicatorSMM::stats_reset()
     commit_monitor_.flush_stats();
 
     cert_.stats_reset();
+
+    WriteSetIn::stats_reset();
 }
 
 void
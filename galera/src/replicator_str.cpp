@@ -663,7 +663,7 @@ ReplicatorSMM::request_state_transfer (void* recv_ctx,
     sst_state_ = SST_WAIT;
     /* while waiting for state transfer to complete is a good point
      * to reset gcache, since it may involve some IO too */
-    gcache_.seqno_reset();
+    gcache_.seqno_reset(to_gu_uuid(group_uuid));
 
     if (sst_req_len != 0)
     {
@@ -746,42 +746,42 @@ void ReplicatorSMM::recv_IST(void* recv_ctx)
 {
     try
     {
-        while (true)
+        std::vector<TrxHandle*> trxs;
+
+        while (ist_receiver_.recv(trxs) == 0)
         {
-            TrxHandle* trx(0);
-            int err;
-            if ((err = ist_receiver_.recv(&trx)) == 0)
+            assert(trxs.empty() == false);
+
+            for (size_t i(0); i < trxs.size(); ++i)
             {
-                assert(trx != 0);
-                TrxHandleLock lock(*trx);
-                // Verify checksum before applying. This is also required
-                // to synchronize with possible background checksum thread.
-                trx->verify_checksum();
-                if (trx->depends_seqno() == -1)
+                TrxHandle* const trx(trxs[i]);
                 {
-                    ApplyOrder ao(*trx);
-                    apply_monitor_.self_cancel(ao);
-                    if (co_mode_ != CommitOrder::BYPASS)
+                    TrxHandleLock lock(*trx);
+                    // Verify checksum before applying. This is also required
+                    // to synchronize with possible background checksum thread.
+                    trx->verify_checksum();
+                    if (trx->depends_seqno() == -1)
                     {
-                        CommitOrder co(*trx, co_mode_);
-                        commit_monitor_.self_cancel(co);
+                        ApplyOrder ao(*trx);
+                        apply_monitor_.self_cancel(ao);
+                        if (co_mode_ != CommitOrder::BYPASS)
+                        {
+                            CommitOrder co(*trx, co_mode_);
+                            commit_monitor_.self_cancel(co);
+                        }
+                    }
+                    else
+                    {
+                        // replicating and certifying stages have been
+                        // processed on donor, just adjust states here
+                        trx->set_state(TrxHandle::S_REPLICATING);
+                        trx->set_state(TrxHandle::S_CERTIFYING);
+                        apply_trx(recv_ctx, trx);
+                        GU_DBUG_SYNC_WAIT("recv_IST_after_apply_trx")
                     }
                 }
-                else
-                {
-                    // replicating and certifying stages have been
-                    // processed on donor, just adjust states here
-                    trx->set_state(TrxHandle::S_REPLICATING);
-                    trx->set_state(TrxHandle::S_CERTIFYING);
-                    apply_trx(recv_ctx, trx);
-                    GU_DBUG_SYNC_WAIT("recv_IST_after_apply_trx")
-                }
-            }
-            else
-            {
-                return;
+                trx->unref();
             }
-            trx->unref();
         }
     }
     catch (gu::Exception& e)
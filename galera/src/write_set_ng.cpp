@@ -8,9 +8,14 @@
 #include "gu_time.h"
 
 #include <gu_macros.hpp>
+#include <gu_atomic.hpp>
+#include <gu_utils.hpp>
 
+#include <algorithm>
 #include <iomanip>
 
+#include <unistd.h>
+
 namespace galera
 {
 
@@ -208,98 +213,213 @@ WriteSetIn::init (ssize_t const st)
         if (size_ >= st)
         {
             /* buffer too big, start checksumming in background */
-            int const err(pthread_create (&check_thr_id_, NULL,
-                                          checksum_thread, this));
-
-            if (gu_likely(0 == err))
-            {
-                check_thr_ = true;
-                return;
-            }
+            checksum(true);
 
-            log_warn << "Starting checksum thread failed: " << err
-                     << '(' << ::strerror(err) << ')';
+            if (gu_likely(check_thr_)) return;
 
-            /* fall through to checksum in foreground */
+            /* fall through to checksum result check */
+        }
+        else
+        {
+            checksum(false);
         }
 
-        checksum();
         checksum_fin();
     }
     else /* checksum skipped, pretend it's alright */
     {
+        /* record sets still need to be located for gather() */
+        gu_trace(parse_payload());
+        check_jobs_num_ = 0;
         check_ = true;
     }
 }
 
 
+/* Checksum statistics: bytes checksummed and time spent on it. Updated
+ * once per writeset, when the results of its jobs are collected. */
+static gu::Atomic<long long> check_bytes(0);
+static gu::Atomic<long long> check_nsec (0);
+
+void
+WriteSetIn::CheckJob::run()
+{
+    long long const start(gu_time_monotonic());
+
+    try
+    {
+        rset_->checksum();
+        ok_ = true;
+    }
+    catch (std::exception& e)
+    {
+        log_error << e.what();
+    }
+
+    nsec_ = gu_time_monotonic() - start;
+}
+
+
+gu::ThreadPool&
+WriteSetIn::check_pool()
+{
+    /* at most one job per record set, queue up to 4 writesets per thread */
+    static long const cpus(sysconf(_SC_NPROCESSORS_ONLN));
+    static size_t const threads(std::min(std::max(cpus, 1L), 8L));
+    static gu::ThreadPool pool(threads, threads * 4 * CHECK_JOBS_MAX);
+
+    return pool;
+}
+
+
 void
-WriteSetIn::checksum()
+WriteSetIn::parse_payload()
 {
     const gu::byte_t* pptr (header_.payload());
     ssize_t           psize(size_ - header_.size());
 
     assert (psize >= 0);
+    assert (0 == check_jobs_num_);
 
-    try
+    if (keys_.size() > 0)
     {
-        if (keys_.size() > 0)
-        {
-            gu_trace(keys_.checksum());
-            psize -= keys_.size();
-            assert (psize >= 0);
-            pptr  += keys_.size();
-        }
+        check_jobs_[check_jobs_num_++].init(keys_);
+        psize -= keys_.size();
+        assert (psize >= 0);
+        pptr  += keys_.size();
+    }
 
-        DataSet::Version const dver(header_.dataset_ver());
+    DataSet::Version const dver(header_.dataset_ver());
 
-        if (gu_likely(dver != DataSet::EMPTY))
+    if (gu_likely(dver != DataSet::EMPTY))
+    {
+        assert (psize > 0);
+        gu_trace(data_.init(dver, pptr, psize));
+        check_jobs_[check_jobs_num_++].init(data_);
+        size_t tmpsize(data_.size());
+        psize -= tmpsize;
+        pptr  += tmpsize;
+        assert (psize >= 0);
+
+        if (header_.has_unrd())
         {
-            assert (psize > 0);
-            gu_trace(data_.init(dver, pptr, psize));
-            gu_trace(data_.checksum());
-            size_t tmpsize(data_.size());
+            gu_trace(unrd_.init(dver, pptr, psize));
+            check_jobs_[check_jobs_num_++].init(unrd_);
+            size_t tmpsize(unrd_.size());
             psize -= tmpsize;
             pptr  += tmpsize;
-            assert (psize >= 0);
-
-            if (header_.has_unrd())
-            {
-                gu_trace(unrd_.init(dver, pptr, psize));
-                gu_trace(unrd_.checksum());
-                size_t tmpsize(unrd_.size());
-                psize -= tmpsize;
-                pptr  += tmpsize;
-            }
-
-            if (header_.has_annt())
-            {
-                annt_ = new DataSetIn();
-                gu_trace(annt_->init(dver, pptr, psize));
-                // we don't care for annotation checksum - it is not a reason
-                // to throw an exception and abort execution
-                // gu_trace(annt_->checksum());
+        }
+
+        if (header_.has_annt())
+        {
+            annt_ = new DataSetIn();
+            gu_trace(annt_->init(dver, pptr, psize));
+            // we don't care for annotation checksum - it is not a reason
+            // to throw an exception and abort execution
 #ifndef NDEBUG
-                psize -= annt_->size();
+            psize -= annt_->size();
 #endif
-            }
         }
+    }
 #ifndef NDEBUG
-        assert (psize == 0);
+    assert (psize == 0);
 #endif
-        check_ = true;
+}
+
+
+void
+WriteSetIn::checksum(bool const background)
+{
+    try
+    {
+        parse_payload();
     }
     catch (std::exception& e)
     {
         log_error << e.what();
+        check_jobs_num_ = 0;
+        return;
     }
     catch (...)
     {
         log_error << "Non-standard exception in WriteSet::checksum()";
+        check_jobs_num_ = 0;
+        return;
+    }
+
+    assert (check_jobs_num_ <= CHECK_JOBS_MAX);
+
+    if (0 == check_jobs_num_)
+    {
+        /* no record sets, nothing to verify */
+        check_ = true;
+    }
+    else if (background)
+    {
+        /* record sets are checksummed in parallel: the last one is usually
+         * the biggest, so it goes first */
+        gu::ThreadPool& pool(check_pool());
+        for (int i(check_jobs_num_ - 1); i >= 0; --i)
+        {
+            pool.submit(check_jobs_[i]);
+        }
+        check_thr_ = true;
+    }
+    else
+    {
+        for (int i(0); i < check_jobs_num_; ++i) check_jobs_[i].run();
+        checksum_wait();
+    }
+}
+
+
+void
+WriteSetIn::checksum_wait() const
+{
+    bool      ok(true);
+    long long bytes(0);
+    long long nsec(0);
+
+    for (int i(0); i < check_jobs_num_; ++i)
+    {
+        if (check_thr_) check_pool().wait(check_jobs_[i]);
+        ok     = ok && check_jobs_[i].ok();
+        bytes += check_jobs_[i].size();
+        nsec  += check_jobs_[i].nsec();
+    }
+
+    check_     = ok;
+    check_thr_ = false;
+
+    if (check_jobs_num_ > 0)
+    {
+        check_bytes += bytes;
+        check_nsec  += nsec;
     }
 }
 
 
+void
+WriteSetIn::get_status(gu::Status& status)
+{
+    long long const bytes(check_bytes());
+    long long const nsec (check_nsec());
+
+    status.insert("ws_checksum_threads", gu::to_string(check_pool().size()));
+    status.insert("ws_checksum_bytes",   gu::to_string(bytes));
+    status.insert("ws_checksum_rate",    /* bytes per second */
+                  gu::to_string(nsec > 0 ? bytes * 1.0e9 / nsec : 0.0));
+}
+
+
+void
+WriteSetIn::stats_reset()
+{
+    check_bytes = 0;
+    check_nsec  = 0;
+}
+
+
 void
 WriteSetIn::write_annotation(std::ostream& os) const
 {
@@ -20,13 +20,13 @@
 
 #include "gu_serialize.hpp"
 #include "gu_vector.hpp"
+#include "gu_thread_pool.hpp"
+#include "gu_status.hpp"
 
 #include <vector>
 #include <string>
 #include <iomanip>
 
-#include <pthread.h>
-
 namespace galera
 {
     class WriteSetNG
@@ -679,7 +679,8 @@ namespace galera
               data_  (),
               unrd_  (),
               annt_  (NULL),
-              check_thr_id_(),
+              check_jobs_(),
+              check_jobs_num_(0),
               check_thr_(false),
               check_ (false)
         {
@@ -693,7 +694,8 @@ namespace galera
               data_  (),
               unrd_  (),
               annt_  (NULL),
-              check_thr_id_(),
+              check_jobs_(),
+              check_jobs_num_(0),
               check_thr_(false),
               check_ (false)
         {}
@@ -721,8 +723,8 @@ namespace galera
         {
             if (gu_unlikely(check_thr_))
             {
-                /* checksum was performed in a parallel thread */
-                pthread_join (check_thr_id_, NULL);
+                /* checksum is being performed in pool threads */
+                checksum_wait();
             }
 
             delete annt_;
@@ -757,9 +759,8 @@ namespace galera
         {
             if (gu_unlikely(check_thr_))
             {
-                /* checksum was performed in a parallel thread */
-                pthread_join (check_thr_id_, NULL);
-                check_thr_ = false;
+                /* checksum was performed in pool threads */
+                checksum_wait();
                 checksum_fin();
             }
         }
@@ -790,21 +791,68 @@ namespace galera
         size_t gather(GatherVector& out,
                       bool include_keys, bool include_unrd) const;
 
+        /* background checksum pool size and throughput */
+        static void get_status(gu::Status& status);
+        static void stats_reset();
+
     private:
 
+        /* checksums a single record set, possibly in a pool thread */
+        class CheckJob : public gu::ThreadPool::Job
+        {
+        public:
+
+            CheckJob() : rset_(NULL), nsec_(0), ok_(false) {}
+
+            void init(const gu::RecordSetInBase& rset)
+            {
+                rset_ = &rset;
+                nsec_ = 0;
+                ok_   = false;
+            }
+
+            void run();
+
+            bool      ok()   const { return ok_; }
+            long long nsec() const { return nsec_; }     /* time spent */
+            size_t    size() const { return rset_->size(); }
+
+        private:
+
+            CheckJob(const CheckJob&);
+            void operator=(const CheckJob&);
+
+            const gu::RecordSetInBase* rset_;
+            long long                  nsec_;
+            bool                       ok_;
+        };
+
+        static int const CHECK_JOBS_MAX = 3; /* keys, data, unordered */
+
         WriteSetNG::Header header_;
         ssize_t            size_;
         KeySetIn           keys_;
         DataSetIn          data_;
         DataSetIn          unrd_;
         DataSetIn*         annt_;
-        pthread_t          check_thr_id_;
+        CheckJob mutable   check_jobs_[CHECK_JOBS_MAX];
+        int                check_jobs_num_;
         bool mutable       check_thr_;
-        bool               check_;
+        bool mutable       check_;
 
         static size_t const SIZE_THRESHOLD = 1 << 22; /* 4Mb */
 
-        void checksum (); /* checksums writeset, stores result in check_ */
+        static gu::ThreadPool& check_pool();
+
+        /* checksums writeset, stores result in check_ unless it is done
+         * in background */
+        /* locates record sets in the payload and prepares check jobs */
+        void parse_payload ();
+
+        void checksum (bool background);
+
+        /* waits for background checksum, stores result in check_ */
+        void checksum_wait() const;
 
         void checksum_fin() const
         {
@@ -814,13 +862,6 @@ namespace galera
             }
         }
 
-        static void* checksum_thread (void* arg)
-        {
-            WriteSetIn* ws(reinterpret_cast<WriteSetIn*>(arg));
-            ws->checksum();
-            return NULL;
-        }
-
         /* late initialization after default constructor */
         void init (ssize_t size_threshold);
 
@@ -0,0 +1,320 @@
+/*
+ * Copyright (C) 2014 Codership Oy <info@codership.com>
+ */
+
+/*!
+ * @file Certification index microbenchmark
+ *
+ * Certifies a stream of version 3 write sets in total order while another
+ * thread purges the certification index, and reports certification
+ * throughput and index purge durations. As in ReplicatorSMM,
+ * certification and purge are serialized by local monitor.
+ *
+ * To run:
+ * cert_bench [<N trxs> [<keys per trx> [<key space>]]]
+ */
+
+#include "certification.hpp"
+#include "replicator_smm.hpp"
+#include "galera_service_thd.hpp"
+#include "write_set_ng.hpp"
+
+#include "gu_logger.hpp"
+#include "gu_lock.hpp"
+#include "gu_uuid.h"
+
+#include <cstdlib>
+#include <cstdio>
+#include <vector>
+
+#include <sys/time.h>
+#include <unistd.h>
+
+using namespace galera;
+
+static double
+now()
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return double(tv.tv_sec) + 1.e-6 * tv.tv_usec;
+}
+
+namespace
+{
+    class BenchEnv
+    {
+    public:
+
+        BenchEnv()
+            :
+            conf_   (),
+            init_   (conf_, NULL, NULL),
+            name_   ("cert_bench.gcache"),
+            gcache_ (gcache_conf(conf_, name_), "."),
+            gcs_    (conf_, gcache_),
+            thd_    (gcs_, gcache_)
+        {}
+
+        ~BenchEnv() { unlink(name_.c_str()); }
+
+        gu::Config& conf() { return conf_; }
+        ServiceThd& thd()  { return thd_;  }
+
+    private:
+
+        static gu::Config&
+        gcache_conf(gu::Config& conf, const std::string& name)
+        {
+            conf.set("gcache.name", name);
+            conf.set("gcache.size", "4M");
+            return conf;
+        }
+
+        gu::Config                  conf_;
+        ReplicatorSMM::InitConfig   init_;
+        std::string const           name_;
+        gcache::GCache              gcache_;
+        DummyGcs                    gcs_;
+        ServiceThd                  thd_;
+    };
+
+    /* same ordering as ReplicatorSMM::LocalOrder */
+    class LocalOrder
+    {
+    public:
+
+        LocalOrder(wsrep_seqno_t seqno) : seqno_(seqno) { }
+
+        void lock()   { }
+        void unlock() { }
+
+        wsrep_seqno_t seqno() const { return seqno_; }
+
+        bool condition(wsrep_seqno_t last_entered,
+                       wsrep_seqno_t last_left) const
+        {
+            return (last_left + 1 == seqno_);
+        }
+
+#ifdef GU_DBUG_ON
+        void debug_sync(gu::Mutex&) { }
+#endif // GU_DBUG_ON
+
+    private:
+
+        wsrep_seqno_t const seqno_;
+    };
+
+    typedef GALERA_MONITOR<LocalOrder> LocalMonitor;
+
+    /* purges certification index from a separate thread, ordered with
+     * certification by local monitor like ReplicatorSMM::process_commit_cut()
+     * does for commit cuts delivered to another receiver thread */
+    class Purger
+    {
+    public:
+
+        Purger(Certification& cert, LocalMonitor& mon)
+            :
+            cert_(cert), mon_(mon), mtx_(), cond_(),
+            seqno_l_(-1), upto_(-1), done_(false), thd_()
+        {
+            pthread_create(&thd_, NULL, run, this);
+        }
+
+        ~Purger()
+        {
+            {
+                gu::Lock lock(mtx_);
+                done_ = true;
+                cond_.signal();
+            }
+            pthread_join(thd_, NULL);
+        }
+
+        /* purge up to seqno in local order seqno_l */
+        void purge(wsrep_seqno_t const seqno_l, wsrep_seqno_t const seqno)
+        {
+            gu::Lock lock(mtx_);
+            seqno_l_ = seqno_l;
+            upto_    = seqno;
+            cond_.signal();
+        }
+
+    private:
+
+        static void* run(void* arg)
+        {
+            Purger* const p(static_cast<Purger*>(arg));
+            wsrep_seqno_t done_l(-1);
+
+            while (true)
+            {
+                wsrep_seqno_t seqno_l;
+                wsrep_seqno_t upto;
+                {
+                    gu::Lock lock(p->mtx_);
+                    while (p->seqno_l_ <= done_l && !p->done_)
+                        lock.wait(p->cond_);
+                    if (p->seqno_l_ <= done_l) break;
+                    seqno_l = p->seqno_l_;
+                    upto    = p->upto_;
+                }
+
+                LocalOrder lo(seqno_l);
+                p->mon_.enter(lo);
+                p->cert_.purge_trxs_upto(upto, false);
+                p->mon_.leave(lo);
+                done_l = seqno_l;
+            }
+
+            return NULL;
+        }
+
+        Purger(const Purger&);
+        Purger& operator=(const Purger&);
+
+        Certification& cert_;
+        LocalMonitor&  mon_;
+        gu::Mutex      mtx_;
+        gu::Cond       cond_;
+        wsrep_seqno_t  seqno_l_;
+        wsrep_seqno_t  upto_;
+        bool           done_;
+        pthread_t      thd_;
+    };
+}
+
+typedef std::vector<gu::byte_t> Buffer;
+
+static void
+make_write_sets(std::vector<Buffer>& wss, long const n_trx, int const n_keys,
+                long const key_space)
+{
+    wsrep_uuid_t source;
+    gu_uuid_generate(reinterpret_cast<gu_uuid_t*>(&source), NULL, 0);
+
+    unsigned int seed(1);
+    wss.resize(n_trx);
+
+    for (long i(0); i < n_trx; ++i)
+    {
+        WriteSetOut wso(".", i + 1, KeySet::FLAT8A, 0, 0, 0,
+                        WriteSetNG::VER3);
+
+        for (int k(0); k < n_keys; ++k)
+        {
+            long const row(rand_r(&seed) % key_space);
+            wsrep_buf_t const parts[3] =
+            {
+                { "db", 3 },
+                { "tbl", 4 },
+                { &row, sizeof(row) }
+            };
+            wso.append_key(KeyData(3, parts, 3, WSREP_KEY_EXCLUSIVE, true));
+        }
+
+        long const data(i);
+        wso.append_data(&data, sizeof(data), true);
+
+        WriteSetNG::GatherVector out;
+        size_t const size(wso.gather(source, 0, i + 1, out));
+        /* all trxs have seen all preceding ones: no conflicts, only deps */
+        wso.set_last_seen(i);
+
+        Buffer& buf(wss[i]);
+        buf.reserve(size);
+        for (size_t j(0); j < out->size(); ++j)
+        {
+            const gu::byte_t* const ptr
+                (static_cast<const gu::byte_t*>(out[j].ptr));
+            buf.insert(buf.end(), ptr, ptr + out[j].size);
+        }
+    }
+}
+
+static double
+run_bench(const std::vector<Buffer>& wss, gu::Status& status)
+{
+    BenchEnv             env;
+    /* must outlive cert: it holds trx handles till destruction */
+    TrxHandle::SlavePool sp(sizeof(TrxHandle), 1024, "cert_bench_pool");
+    Certification        cert(env.conf(), env.thd());
+    cert.assign_initial_position(0, 3);
+
+    LocalMonitor mon;
+    mon.set_initial_position(0);
+    wsrep_seqno_t seqno_l(0);
+
+    double begin, end;
+    {
+        Purger purger(cert, mon);
+
+        begin = now();
+
+        for (size_t i(0); i < wss.size(); ++i)
+        {
+            TrxHandle* const trx(TrxHandle::New(sp));
+            trx->unserialize(&wss[i][0], wss[i].size(), 0);
+            trx->set_received(0, ++seqno_l, i + 1);
+
+            LocalOrder lo(seqno_l);
+            mon.enter(lo);
+
+            if (cert.append_trx(trx) != Certification::TEST_OK)
+            {
+                log_fatal << "Unexpected certification failure: " << *trx;
+                abort();
+            }
+
+            mon.leave(lo);
+
+            wsrep_seqno_t const purge_seqno(cert.set_trx_committed(trx));
+            trx->unref();
+
+            /* commit cut takes its own place in local order */
+            if (purge_seqno > 0) purger.purge(++seqno_l, purge_seqno);
+        }
+
+        end = now();
+    }
+
+    cert.get_status(status);
+
+    return wss.size() / (end - begin);
+}
+
+int main(int argc, char* argv[])
+{
+    long const n_trx     (argc > 1 ? strtol(argv[1], NULL, 10) : 200000);
+    int  const n_keys    (argc > 2 ? strtol(argv[2], NULL, 10) : 8);
+    long const key_space (argc > 3 ? strtol(argv[3], NULL, 10) : 1000000);
+
+    if (n_trx <= 0 || n_keys <= 0 || key_space <= 0)
+    {
+        fprintf(stderr, "Usage: %s [<N trxs> [<keys per trx> [<key space>]]]\n",
+                argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    gu_conf_self_tstamp_on();
+
+    std::vector<Buffer> wss;
+    make_write_sets(wss, n_trx, n_keys, key_space);
+
+    printf("%ld trxs, %d keys per trx, key space %ld\n",
+           n_trx, n_keys, key_space);
+
+    gu::Status   status;
+    double const rate(run_bench(wss, status));
+
+    printf("%10.0f trx/s\n", rate);
+
+    for (gu::Status::const_iterator i(status.begin()); i != status.end(); ++i)
+    {
+        printf("%s: %s\n", i->first.c_str(), i->second.c_str());
+    }
+
+    return EXIT_SUCCESS;
+}
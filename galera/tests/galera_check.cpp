@@ -20,6 +20,7 @@ extern Suite* trx_handle_suite();
 extern Suite* service_thd_suite();
 extern Suite* ist_suite();
 extern Suite* saved_state_suite();
+extern Suite* monitor_suite();
 
 static suite_creator_t suites[] =
 {
@@ -31,6 +32,7 @@ static suite_creator_t suites[] =
     service_thd_suite,
     ist_suite,
     saved_state_suite,
+    monitor_suite,
     0
 };
 
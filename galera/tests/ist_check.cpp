@@ -92,16 +92,22 @@ struct sender_args
     wsrep_seqno_t first_;
     wsrep_seqno_t last_;
     int version_;
+    bool zero_copy_;
+    bool keep_keys_;
+    int  compression_;
     sender_args(gcache::GCache& gcache,
                 const std::string& peer,
                 wsrep_seqno_t first, wsrep_seqno_t last,
-                int version)
+                int version, bool zero_copy, bool keep_keys, int compression)
         :
         gcache_(gcache),
         peer_  (peer),
         first_ (first),
         last_  (last),
-        version_(version)
+        version_(version),
+        zero_copy_(zero_copy),
+        keep_keys_(keep_keys),
+        compression_(compression)
     { }
 };
 
@@ -114,17 +120,22 @@ struct receiver_args
     size_t        n_receivers_;
     TrxHandle::SlavePool& trx_pool_;
     int           version_;
+    useconds_t    ready_delay_;
+    size_t        max_batch_;
 
     receiver_args(const std::string listen_addr,
                   wsrep_seqno_t first, wsrep_seqno_t last,
-                  size_t n_receivers, TrxHandle::SlavePool& sp, int version)
+                  size_t n_receivers, TrxHandle::SlavePool& sp, int version,
+                  useconds_t ready_delay)
         :
         listen_addr_(listen_addr),
         first_      (first),
         last_       (last),
         n_receivers_(n_receivers),
         trx_pool_   (sp),
-        version_    (version)
+        version_    (version),
+        ready_delay_(ready_delay),
+        max_batch_  (0)
     { }
 };
 
@@ -132,10 +143,16 @@ struct trx_thread_args
 {
     galera::ist::Receiver& receiver_;
     galera::Monitor<TestOrder> monitor_;
-    trx_thread_args(galera::ist::Receiver& receiver)
+    useconds_t ready_delay_;
+    gu::Mutex  mutex_;
+    size_t     max_batch_;
+    trx_thread_args(galera::ist::Receiver& receiver, useconds_t ready_delay)
         :
         receiver_(receiver),
-        monitor_()
+        monitor_(),
+        ready_delay_(ready_delay),
+        mutex_(),
+        max_batch_(0)
     { }
 };
 
@@ -147,6 +164,9 @@ extern "C" void* sender_thd(void* arg)
 
     gu::Config conf;
     galera::ReplicatorSMM::InitConfig(conf, NULL, NULL);
+    conf.set("ist.zero_copy", sargs->zero_copy_);
+    conf.set("ist.keep_keys", sargs->keep_keys_);
+    conf.set("ist.compression", sargs->compression_);
     pthread_barrier_wait(&start_barrier);
     galera::ist::Sender sender(conf, sargs->gcache_, sargs->peer_,
                                sargs->version_);
@@ -159,22 +179,39 @@ extern "C" void* trx_thread(void* arg)
 {
     trx_thread_args* targs(reinterpret_cast<trx_thread_args*>(arg));
     pthread_barrier_wait(&start_barrier);
+    // let trxs pile up in receiver before consuming them
+    if (targs->ready_delay_ > 0) usleep(targs->ready_delay_);
     targs->receiver_.ready();
 
+    std::vector<galera::TrxHandle*> trxs;
+
     while (true)
     {
-        galera::TrxHandle* trx(0);
         int err;
-        if ((err = targs->receiver_.recv(&trx)) != 0)
+        if ((err = targs->receiver_.recv(trxs)) != 0)
         {
-            assert(trx == 0);
+            assert(trxs.empty());
             log_info << "terminated with " << err;
             return 0;
         }
-        TestOrder to(*trx);
-        targs->monitor_.enter(to);
-        targs->monitor_.leave(to);
-        trx->unref();
+        fail_if(trxs.empty());
+        {
+            gu::Lock lock(targs->mutex_);
+            targs->max_batch_ = std::max(targs->max_batch_, trxs.size());
+        }
+        for (size_t i(0); i < trxs.size(); ++i)
+        {
+            // batch must consist of consecutive trxs
+            fail_unless(trxs[i]->global_seqno() ==
+                        trxs[0]->global_seqno() + wsrep_seqno_t(i),
+                        "batch position %zu: expected seqno %lld, got %lld",
+                        i, (long long)(trxs[0]->global_seqno() + i),
+                        (long long)trxs[i]->global_seqno());
+            TestOrder to(*trxs[i]);
+            targs->monitor_.enter(to);
+            targs->monitor_.leave(to);
+            trxs[i]->unref();
+        }
     }
     return 0;
 }
@@ -198,7 +235,7 @@ extern "C" void* receiver_thd(void* arg)
     mark_point();
 
     std::vector<pthread_t> threads(rargs->n_receivers_);
-    trx_thread_args trx_thd_args(receiver);
+    trx_thread_args trx_thd_args(receiver, rargs->ready_delay_);
     for (size_t i(0); i < threads.size(); ++i)
     {
         log_info << "starting trx thread " << i;
@@ -215,6 +252,7 @@ extern "C" void* receiver_thd(void* arg)
         pthread_join(threads[i], 0);
     }
 
+    rargs->max_batch_ = trx_thd_args.max_batch_;
     receiver.finished();
     return 0;
 }
@@ -239,7 +277,11 @@ static int select_trx_version(int protocol_version)
 }
 
 
-static void test_ist_common(int const version)
+static void test_ist_common(int const version,
+                            bool const zero_copy = true,
+                            bool const keep_keys = true,
+                            int  const compression = 0,
+                            useconds_t const ready_delay = 0)
 {
     using galera::KeyData;
     using galera::TrxHandle;
@@ -322,8 +364,9 @@ static void test_ist_common(int const version)
 
     mark_point();
 
-    receiver_args rargs(receiver_addr, 1, 10, 1, sp, version);
-    sender_args sargs(*gcache, rargs.listen_addr_, 1, 10, version);
+    receiver_args rargs(receiver_addr, 1, 10, 1, sp, version, ready_delay);
+    sender_args sargs(*gcache, rargs.listen_addr_, 1, 10, version,
+                      zero_copy, keep_keys, compression);
 
     pthread_barrier_init(&start_barrier, 0, 1 + 1 + rargs.n_receivers_);
 
@@ -340,6 +383,13 @@ static void test_ist_common(int const version)
 
     mark_point();
 
+    if (ready_delay > 0)
+    {
+        // whole stream should have been queued by the time consumers
+        // became ready, so they must have got it in batches
+        fail_if(rargs.max_batch_ < 2, "max batch size: %zu", rargs.max_batch_);
+    }
+
     delete gcache;
 
     mark_point();
@@ -380,6 +430,36 @@ START_TEST(test_ist_v5)
 }
 END_TEST
 
+START_TEST(test_ist_v5_copy)
+{
+    test_ist_common(5, false);
+}
+END_TEST
+
+START_TEST(test_ist_v5_no_keys)
+{
+    test_ist_common(5, true, false);
+}
+END_TEST
+
+START_TEST(test_ist_v5_batch)
+{
+    test_ist_common(5, true, true, 0, 500000);
+}
+END_TEST
+
+START_TEST(test_ist_v2_compressed)
+{
+    test_ist_common(2, true, true, 1);
+}
+END_TEST
+
+START_TEST(test_ist_v5_compressed)
+{
+    test_ist_common(5, true, false, 9);
+}
+END_TEST
+
 Suite* ist_suite()
 {
     Suite* s  = suite_create("ist");
@@ -414,5 +494,30 @@ Suite* ist_suite()
     tcase_add_test(tc, test_ist_v5);
     suite_add_tcase(s, tc);
 
+    tc = tcase_create("test_ist_v5_copy");
+    tcase_set_timeout(tc, 60);
+    tcase_add_test(tc, test_ist_v5_copy);
+    suite_add_tcase(s, tc);
+
+    tc = tcase_create("test_ist_v5_no_keys");
+    tcase_set_timeout(tc, 60);
+    tcase_add_test(tc, test_ist_v5_no_keys);
+    suite_add_tcase(s, tc);
+
+    tc = tcase_create("test_ist_v5_batch");
+    tcase_set_timeout(tc, 60);
+    tcase_add_test(tc, test_ist_v5_batch);
+    suite_add_tcase(s, tc);
+
+    tc = tcase_create("test_ist_v2_compressed");
+    tcase_set_timeout(tc, 60);
+    tcase_add_test(tc, test_ist_v2_compressed);
+    suite_add_tcase(s, tc);
+
+    tc = tcase_create("test_ist_v5_compressed");
+    tcase_set_timeout(tc, 60);
+    tcase_add_test(tc, test_ist_v5_compressed);
+    suite_add_tcase(s, tc);
+
     return s;
 }
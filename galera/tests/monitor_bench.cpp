@@ -0,0 +1,175 @@
+/*
+ * Copyright (C) 2014 Codership Oy <info@codership.com>
+ */
+
+/*!
+ * @file Monitor microbenchmark
+ *
+ * Compares Monitor and MonitorNG throughput for a range of applier thread
+ * counts. In "ordered" mode each process depends on the previous one (like
+ * commit monitor without out-of-order commits), in "parallel" mode processes
+ * don't depend on each other (like non-conflicting trxs in apply monitor).
+ *
+ * To run:
+ * monitor_bench [<N seqnos> [<max threads>]]
+ */
+
+#include "monitor.hpp"
+#include "monitor_ng.hpp"
+
+#include "gu_atomic.hpp"
+
+#include <cstdlib>
+#include <cstdio>
+#include <vector>
+
+#include <pthread.h>
+#include <sys/time.h>
+
+static double
+now()
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return double(tv.tv_sec) + 1.e-6 * tv.tv_usec;
+}
+
+namespace
+{
+    class BenchOrder
+    {
+    public:
+
+        BenchOrder(wsrep_seqno_t seqno, wsrep_seqno_t depends)
+            : seqno_(seqno), depends_(depends) { }
+
+        void lock()   { }
+        void unlock() { }
+
+        wsrep_seqno_t seqno() const { return seqno_; }
+
+        bool condition(wsrep_seqno_t last_entered,
+                       wsrep_seqno_t last_left) const
+        {
+            return (last_left >= depends_);
+        }
+
+#ifdef GU_DBUG_ON
+        void debug_sync(gu::Mutex&) { }
+#endif // GU_DBUG_ON
+
+    private:
+
+        wsrep_seqno_t const seqno_;
+        wsrep_seqno_t const depends_;
+    };
+
+    template <class M>
+    class Bench
+    {
+    public:
+
+        Bench(wsrep_seqno_t const n, bool const ordered)
+            : mon_(), next_(0), max_(n), ordered_(ordered)
+        {
+            mon_.set_initial_position(0);
+        }
+
+        double run(int const n_threads)
+        {
+            std::vector<pthread_t> threads(n_threads);
+
+            double const begin(now());
+
+            for (int i(0); i < n_threads; ++i)
+            {
+                if (pthread_create(&threads[i], NULL, thread_func, this))
+                {
+                    perror("pthread_create()");
+                    abort();
+                }
+            }
+
+            for (int i(0); i < n_threads; ++i)
+            {
+                pthread_join(threads[i], NULL);
+            }
+
+            double const end(now());
+
+            if (mon_.last_left() != max_)
+            {
+                fprintf(stderr, "last left: %lld, expected: %lld\n",
+                        static_cast<long long>(mon_.last_left()),
+                        static_cast<long long>(max_));
+                abort();
+            }
+
+            return max_ / (end - begin);
+        }
+
+    private:
+
+        static void* thread_func(void* arg)
+        {
+            Bench* const b(static_cast<Bench*>(arg));
+
+            for (wsrep_seqno_t seqno(b->next_.add_and_fetch(1));
+                 seqno <= b->max_; seqno = b->next_.add_and_fetch(1))
+            {
+                BenchOrder o(seqno, b->ordered_ ? seqno - 1 : 0);
+                b->mon_.enter(o);
+                b->mon_.leave(o);
+            }
+
+            return NULL;
+        }
+
+        Bench(const Bench&);
+        Bench& operator=(const Bench&);
+
+        M                         mon_;
+        gu::Atomic<wsrep_seqno_t> next_;
+        wsrep_seqno_t const       max_;
+        bool const                ordered_;
+    };
+}
+
+template <class M>
+static double
+bench(wsrep_seqno_t const n, bool const ordered, int const n_threads)
+{
+    Bench<M> b(n, ordered);
+    return b.run(n_threads);
+}
+
+int main(int argc, char* argv[])
+{
+    long const n          (argc > 1 ? strtol(argv[1], NULL, 10) : 1000000);
+    int  const max_threads(argc > 2 ? strtol(argv[2], NULL, 10) : 64);
+
+    if (n <= 0 || max_threads <= 0)
+    {
+        fprintf(stderr, "Usage: %s [<N seqnos> [<max threads>]]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    printf("%ld seqnos\n%8s %7s %14s %14s\n", n, "mode", "threads",
+           "Monitor/s", "MonitorNG/s");
+
+    for (int ordered(1); ordered >= 0; --ordered)
+    {
+        for (int t(1); t <= max_threads; t <<= 1)
+        {
+            double const old_rate
+                (bench<galera::Monitor<BenchOrder> >(n, ordered, t));
+            double const new_rate
+                (bench<galera::MonitorNG<BenchOrder> >(n, ordered, t));
+
+            printf("%8s %7d %14.0f %14.0f\n",
+                   ordered ? "ordered" : "parallel", t, old_rate, new_rate);
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,383 @@
+/*
+ * Copyright (C) 2014 Codership Oy <info@codership.com>
+ */
+
+#include "../src/monitor_ng.hpp"
+
+#include "gu_atomic.hpp"
+#include "gu_throw.hpp"
+
+#include <check.h>
+#include <errno.h>
+#include <pthread.h>
+
+#include <vector>
+
+namespace
+{
+    class TestOrder
+    {
+    public:
+
+        TestOrder(wsrep_seqno_t seqno, wsrep_seqno_t depends)
+            : seqno_(seqno), depends_(depends) { }
+
+        void lock()   { }
+        void unlock() { }
+
+        wsrep_seqno_t seqno() const { return seqno_; }
+
+        bool condition(wsrep_seqno_t last_entered,
+                       wsrep_seqno_t last_left) const
+        {
+            return (last_left >= depends_);
+        }
+
+#ifdef GU_DBUG_ON
+        void debug_sync(gu::Mutex&) { }
+#endif // GU_DBUG_ON
+
+    private:
+
+        wsrep_seqno_t const seqno_;
+        wsrep_seqno_t const depends_;
+    };
+
+    typedef galera::MonitorNG<TestOrder> TestMonitor;
+
+    struct ThreadArgs
+    {
+        ThreadArgs(TestMonitor& m, wsrep_seqno_t const n, bool const o)
+            : mon(&m), next(0), max(n), ordered(o), last(0), errors(0),
+              inside(0), max_inside(0) { }
+
+        TestMonitor*              mon;
+        gu::Atomic<wsrep_seqno_t> next;
+        wsrep_seqno_t             max;
+        bool                      ordered;
+        gu::Atomic<wsrep_seqno_t> last;    // last applied seqno
+        gu::Atomic<long>          errors;
+        gu::Atomic<long>          inside;  // concurrently applying
+        gu::Atomic<long>          max_inside;
+    };
+
+    void* apply_thread(void* arg)
+    {
+        ThreadArgs& a(*static_cast<ThreadArgs*>(arg));
+
+        for (wsrep_seqno_t seqno(a.next.add_and_fetch(1)); seqno <= a.max;
+             seqno = a.next.add_and_fetch(1))
+        {
+            TestOrder to(seqno, a.ordered ? seqno - 1 : 0);
+
+            a.mon->enter(to);
+
+            long const inside(a.inside.add_and_fetch(1));
+            if (inside > a.max_inside()) a.max_inside = inside;
+
+            if (a.ordered)
+            {
+                if (a.last() != seqno - 1) ++a.errors;
+                a.last = seqno;
+            }
+
+            a.inside.sub_and_fetch(1);
+
+            a.mon->leave(to);
+        }
+
+        return 0;
+    }
+
+    void run_threads(ThreadArgs& args, int const n_threads)
+    {
+        std::vector<pthread_t> threads(n_threads);
+
+        for (int i(0); i < n_threads; ++i)
+        {
+            fail_if(pthread_create(&threads[i], 0, apply_thread, &args));
+        }
+
+        for (int i(0); i < n_threads; ++i)
+        {
+            pthread_join(threads[i], 0);
+        }
+    }
+}
+
+START_TEST(test_monitor_ng_sequential)
+{
+    TestMonitor mon;
+    mon.set_initial_position(0);
+
+    for (wsrep_seqno_t seqno(1); seqno <= 100000; ++seqno)
+    {
+        TestOrder to(seqno, seqno - 1);
+        mon.enter(to);
+        mon.leave(to);
+        fail_unless(mon.last_left() == seqno);
+    }
+
+    double oooe, oool, win;
+    mon.get_stats(&oooe, &oool, &win);
+    fail_if(oooe != 0.0 || oool != 0.0);
+}
+END_TEST
+
+START_TEST(test_monitor_ng_ordered)
+{
+    TestMonitor mon;
+    mon.set_initial_position(0);
+
+    ThreadArgs args(mon, 100000, true);
+
+    run_threads(args, 8);
+
+    fail_if(args.errors() != 0, "%ld ordering violations", args.errors());
+    fail_if(args.max_inside() != 1, "max inside: %ld", args.max_inside());
+    fail_if(mon.last_left() != args.max);
+}
+END_TEST
+
+START_TEST(test_monitor_ng_unordered)
+{
+    TestMonitor mon;
+    mon.set_initial_position(0);
+
+    ThreadArgs args(mon, 100000, false);
+
+    run_threads(args, 8);
+
+    fail_if(mon.last_left() != args.max, "last left: %lld",
+            static_cast<long long>(mon.last_left()));
+}
+END_TEST
+
+START_TEST(test_monitor_ng_out_of_order_leave)
+{
+    TestMonitor mon;
+    mon.set_initial_position(0);
+
+    TestOrder to1(1, 0), to2(2, 0), to3(3, 0);
+
+    mon.enter(to1);
+    mon.enter(to2);
+    mon.enter(to3);
+
+    mon.leave(to3);
+    fail_unless(mon.last_left() == 0);
+    mon.leave(to2);
+    fail_unless(mon.last_left() == 0);
+    mon.leave(to1);
+    fail_unless(mon.last_left() == 3);
+
+    double oooe, oool, win;
+    mon.get_stats(&oooe, &oool, &win);
+    fail_if(oool == 0.0);
+}
+END_TEST
+
+START_TEST(test_monitor_ng_interrupt)
+{
+    TestMonitor mon;
+    mon.set_initial_position(0);
+
+    TestOrder to1(1, 0), to2(2, 1), to3(3, 0);
+
+    mon.enter(to1);
+
+    // interrupt before enter
+    mon.interrupt(to2);
+
+    try
+    {
+        mon.enter(to2);
+        fail("enter() after interrupt() must throw");
+    }
+    catch (gu::Exception& e)
+    {
+        fail_if(e.get_errno() != EINTR);
+    }
+
+    mon.self_cancel(to2);
+    fail_unless(mon.last_left() == 0);
+
+    // interrupt after enter does nothing
+    mon.enter(to3);
+    mon.interrupt(to3);
+
+    mon.leave(to1);
+    fail_unless(mon.last_left() == 2);
+    mon.leave(to3);
+    fail_unless(mon.last_left() == 3);
+}
+END_TEST
+
+START_TEST(test_monitor_ng_resize)
+{
+    TestMonitor mon;
+    mon.set_initial_position(0);
+
+    ssize_t const min_slots(mon.slots());
+    wsrep_seqno_t const wide(min_slots * 3);
+
+    std::vector<TestOrder> to;
+    to.reserve(wide);
+    for (wsrep_seqno_t seqno(1); seqno <= wide; ++seqno)
+    {
+        to.push_back(TestOrder(seqno, 0));
+    }
+
+    // interrupt a seqno in the initial array, it must survive resizes
+    TestOrder canceled(2, 0);
+    mon.interrupt(canceled);
+
+    for (wsrep_seqno_t seqno(1); seqno <= wide; ++seqno)
+    {
+        if (seqno != canceled.seqno()) mon.enter(to[seqno - 1]);
+    }
+
+    try
+    {
+        mon.enter(canceled);
+        fail("enter() after interrupt() must throw");
+    }
+    catch (gu::Exception& e)
+    {
+        fail_if(e.get_errno() != EINTR);
+    }
+
+    fail_if(mon.slots() <= wide, "slots: %zd, window: %lld", mon.slots(),
+            static_cast<long long>(wide));
+
+    // leave in reverse order, nothing can be left before seqno 1
+    for (wsrep_seqno_t seqno(wide); seqno > 2; --seqno)
+    {
+        mon.leave(to[seqno - 1]);
+        fail_if(mon.last_left() != 0);
+    }
+
+    mon.self_cancel(canceled);
+    fail_if(mon.last_left() != 0);
+    mon.leave(to[0]);
+    fail_if(mon.last_left() != wide, "last left: %lld",
+            static_cast<long long>(mon.last_left()));
+
+    // after a long period of narrow window slot array must shrink back
+    for (wsrep_seqno_t seqno(wide + 1); seqno <= wide + (1 << 15); ++seqno)
+    {
+        TestOrder o(seqno, seqno - 1);
+        mon.enter(o);
+        mon.leave(o);
+    }
+
+    fail_if(mon.slots() != min_slots, "slots: %zd, expected %zd",
+            mon.slots(), min_slots);
+}
+END_TEST
+
+START_TEST(test_monitor_ng_resize_mt)
+{
+    TestMonitor mon;
+    mon.set_initial_position(0);
+
+    // many more threads than initial slots, window is determined by the
+    // number of threads entered concurrently
+    ThreadArgs args(mon, 100000, false);
+
+    run_threads(args, mon.slots() + 16);
+
+    fail_if(mon.last_left() != args.max, "last left: %lld",
+            static_cast<long long>(mon.last_left()));
+}
+END_TEST
+
+namespace
+{
+    struct WaitArgs
+    {
+        TestMonitor*  mon;
+        wsrep_seqno_t seqno;
+        bool          done;
+    };
+
+    void* wait_thread(void* arg)
+    {
+        WaitArgs& a(*static_cast<WaitArgs*>(arg));
+        TestOrder to(a.seqno, a.seqno - 1);
+        a.mon->enter(to); // must block until predecessor leaves
+        a.done = true;
+        a.mon->leave(to);
+        return 0;
+    }
+}
+
+START_TEST(test_monitor_ng_wait)
+{
+    TestMonitor mon;
+    mon.set_initial_position(0);
+
+    TestOrder to1(1, 0);
+    mon.enter(to1);
+
+    WaitArgs args = { &mon, 2, false };
+    pthread_t thd;
+    pthread_create(&thd, 0, wait_thread, &args);
+
+    usleep(100000);
+    fail_if(args.done, "seqno 2 entered before seqno 1 left");
+
+    mon.leave(to1);
+    mon.wait(2);
+    fail_unless(mon.last_left() == 2);
+
+    pthread_join(thd, 0);
+    fail_unless(args.done);
+
+    mon.drain(2);
+    fail_unless(mon.last_left() == 2);
+}
+END_TEST
+
+Suite* monitor_suite()
+{
+    Suite* s = suite_create("monitor");
+    TCase* tc;
+
+    tc = tcase_create("test_monitor_ng_sequential");
+    tcase_add_test(tc, test_monitor_ng_sequential);
+    suite_add_tcase(s, tc);
+
+    tc = tcase_create("test_monitor_ng_ordered");
+    tcase_add_test(tc, test_monitor_ng_ordered);
+    tcase_set_timeout(tc, 60);
+    suite_add_tcase(s, tc);
+
+    tc = tcase_create("test_monitor_ng_unordered");
+    tcase_add_test(tc, test_monitor_ng_unordered);
+    tcase_set_timeout(tc, 60);
+    suite_add_tcase(s, tc);
+
+    tc = tcase_create("test_monitor_ng_out_of_order_leave");
+    tcase_add_test(tc, test_monitor_ng_out_of_order_leave);
+    suite_add_tcase(s, tc);
+
+    tc = tcase_create("test_monitor_ng_interrupt");
+    tcase_add_test(tc, test_monitor_ng_interrupt);
+    suite_add_tcase(s, tc);
+
+    tc = tcase_create("test_monitor_ng_resize");
+    tcase_add_test(tc, test_monitor_ng_resize);
+    suite_add_tcase(s, tc);
+
+    tc = tcase_create("test_monitor_ng_resize_mt");
+    tcase_add_test(tc, test_monitor_ng_resize_mt);
+    tcase_set_timeout(tc, 60);
+    suite_add_tcase(s, tc);
+
+    tc = tcase_create("test_monitor_ng_wait");
+    tcase_add_test(tc, test_monitor_ng_wait);
+    suite_add_tcase(s, tc);
+
+    return s;
+}
@@ -643,6 +643,207 @@ START_TEST(test_trac_726)
 END_TEST
 
 
+/* certifies a pseudo-random stream of v3 write sets purging cert index in
+ * slices of a given size, returns resulting depends_seqno for each
+ * (-1 for failed certification) */
+static void
+cert_v3_stream(const char* const purge_slice,
+               std::vector<wsrep_seqno_t>& deps, long* const purges = 0)
+{
+    wsrep_seqno_t const n_ws(512);
+    // index references key data in write set buffers, keep them all
+    // until cert is destroyed
+    std::vector<std::vector<gu::byte_t> > bufs(n_ws);
+
+    TestEnv env;
+    env.conf().set(Certification::PARAM_PURGE_SLICE, purge_slice);
+    galera::Certification cert(env.conf(), env.thd());
+    int const version(3);
+    cert.assign_initial_position(0, version);
+
+    unsigned int seed(42);
+
+    for (wsrep_seqno_t seqno(1); seqno <= n_ws; ++seqno)
+    {
+        uint8_t const src(1 + rand_r(&seed) % 3);
+        wsrep_uuid_t source = {{ src, }};
+        WriteSetOut wso("", seqno, KeySet::FLAT8A, 0, 0, 0, WriteSetNG::VER3);
+
+        for (int k(rand_r(&seed) % 4); k >= 0; --k)
+        {
+            int const row(rand_r(&seed) % 32);
+            wsrep_buf_t const parts[2] =
+                { { void_cast("t"), 1 }, { &row, sizeof(row) } };
+            wso.append_key(KeyData(version, parts, 2,
+                                   (rand_r(&seed) % 4 ?
+                                    WSREP_KEY_EXCLUSIVE : WSREP_KEY_SHARED),
+                                   true));
+        }
+
+        WriteSetNG::GatherVector out;
+        wso.gather(source, 0, seqno, out);
+        // write set can't have seen less than has been committed
+        // everywhere, otherwise its conflicts could be purged from index
+        wso.set_last_seen(std::max(cert.get_safe_to_discard_seqno(),
+                                   seqno - 1 - rand_r(&seed) % 8));
+
+        std::vector<gu::byte_t>& buf(bufs[seqno - 1]);
+        for (size_t i(0); i < out->size(); ++i)
+        {
+            const gu::byte_t* ptr(static_cast<const gu::byte_t*>(out[i].ptr));
+            buf.insert(buf.end(), ptr, ptr + out[i].size);
+        }
+
+        TrxHandle* trx(TrxHandle::New(sp));
+        trx->unserialize(&buf[0], buf.size(), 0);
+        trx->set_received(0, seqno, seqno);
+
+        Certification::TestResult const result(cert.append_trx(trx));
+        fail_unless((result == Certification::TEST_OK) ==
+                    (trx->depends_seqno() >= 0));
+        deps.push_back(trx->depends_seqno());
+
+        wsrep_seqno_t const purge_seqno(cert.set_trx_committed(trx));
+        if (purge_seqno > 0)
+        {
+            cert.purge_trxs_upto(purge_seqno, true);
+            if (purges) ++(*purges);
+        }
+        trx->unref();
+    }
+
+    gu::Status status;
+    cert.get_status(status);
+    fail_if(status.size() != 2);
+}
+
+START_TEST(test_cert_purge_slices)
+{
+    log_info << "test_cert_purge_slices";
+
+    std::vector<wsrep_seqno_t> deps1;
+    long purges(0);
+    cert_v3_stream("1024", deps1, &purges);
+    fail_if(0 == purges, "no index purges in test stream");
+
+    long failed(0);
+    for (size_t i(0); i < deps1.size(); ++i) failed += (deps1[i] < 0);
+    fail_if(0 == failed, "no certification failures in test stream");
+    fail_if(long(deps1.size()) == failed, "no certified trxs in test stream");
+
+    const char* const slices[] = { "1", "3" };
+
+    for (size_t s(0); s < sizeof(slices)/sizeof(slices[0]); ++s)
+    {
+        std::vector<wsrep_seqno_t> deps;
+        cert_v3_stream(slices[s], deps);
+
+        /* with smaller slices purge lags behind certification, so
+         * depends_seqno may differ, but certification results may not */
+        fail_unless(deps.size() == deps1.size());
+        for (size_t i(0); i < deps.size(); ++i)
+        {
+            fail_if((deps[i] < 0) != (deps1[i] < 0),
+                    "slice: %s, seqno: %zu, deps: %lld, expected: %lld",
+                    slices[s], i + 1, static_cast<long long>(deps[i]),
+                    static_cast<long long>(deps1[i]));
+        }
+    }
+}
+END_TEST
+
+
+/* certifies a v3 write set with a single exclusive key on a given row */
+static TrxHandle*
+cert_v3_trx(Certification& cert, std::vector<gu::byte_t>& buf,
+            wsrep_seqno_t const seqno, int const row,
+            wsrep_seqno_t const last_seen)
+{
+    wsrep_uuid_t source = {{ 1, }};
+    WriteSetOut wso("", seqno, KeySet::FLAT8A, 0, 0, 0, WriteSetNG::VER3);
+    wsrep_buf_t const parts[2] = { { void_cast("t"), 1 },
+                                   { &row, sizeof(row) } };
+    wso.append_key(KeyData(3, parts, 2, WSREP_KEY_EXCLUSIVE, true));
+
+    WriteSetNG::GatherVector out;
+    wso.gather(source, 0, seqno, out);
+    wso.set_last_seen(last_seen);
+
+    for (size_t i(0); i < out->size(); ++i)
+    {
+        const gu::byte_t* ptr(static_cast<const gu::byte_t*>(out[i].ptr));
+        buf.insert(buf.end(), ptr, ptr + out[i].size);
+    }
+
+    TrxHandle* trx(TrxHandle::New(sp));
+    trx->unserialize(&buf[0], buf.size(), 0);
+    trx->set_received(0, seqno, seqno);
+
+    fail_if(cert.append_trx(trx) != Certification::TEST_OK,
+            "certification failed for seqno %lld",
+            static_cast<long long>(seqno));
+
+    return trx;
+}
+
+START_TEST(test_cert_purge_interleaving)
+{
+    log_info << "test_cert_purge_interleaving";
+
+    wsrep_seqno_t const n_ws(256);
+    std::vector<std::vector<gu::byte_t> > bufs(n_ws + 1);
+
+    TestEnv env;
+    env.conf().set(Certification::PARAM_PURGE_SLICE, "16");
+    galera::Certification cert(env.conf(), env.thd());
+    cert.assign_initial_position(0, 3);
+
+    // build up a long purge backlog
+    for (wsrep_seqno_t seqno(1); seqno <= n_ws; ++seqno)
+    {
+        TrxHandle* const trx(cert_v3_trx(cert, bufs[seqno - 1], seqno,
+                                         seqno % 8, seqno - 1));
+        cert.set_trx_committed(trx);
+        trx->unref();
+    }
+
+    // one call purges one slice only
+    wsrep_seqno_t purged(cert.purge_trxs_upto(n_ws, true));
+    fail_if(purged != 16, "purged up to %lld", static_cast<long long>(purged));
+    fail_if(cert.get_trx(16) != 0);
+    TrxHandle* trx(cert.get_trx(17));
+    fail_if(0 == trx);
+    trx->unref();
+
+    // certification goes on while the rest of the purge is pending and
+    // sees the index entries that have not been purged yet
+    trx = cert_v3_trx(cert, bufs[n_ws], n_ws + 1, (n_ws + 1) % 8, n_ws);
+    fail_if(trx->depends_seqno() != n_ws - 7, "depends: %lld",
+            static_cast<long long>(trx->depends_seqno()));
+    fail_if(cert.set_trx_committed(trx) <= 0,
+            "unfinished purge did not request commit cut");
+    trx->unref();
+
+    // the rest of the purge is completed by subsequent calls
+    int calls(1);
+    while (purged < n_ws)
+    {
+        wsrep_seqno_t const prev(purged);
+        purged = cert.purge_trxs_upto(n_ws, true);
+        fail_if(purged <= prev, "purge did not progress: %lld",
+                static_cast<long long>(purged));
+        ++calls;
+    }
+
+    fail_if(calls != n_ws/16, "calls: %d", calls);
+    fail_if(cert.get_trx(n_ws) != 0);
+    trx = cert.get_trx(n_ws + 1);
+    fail_if(0 == trx);
+    trx->unref();
+}
+END_TEST
+
+
 Suite* write_set_suite()
 {
     Suite* s = suite_create("write_set");
@@ -683,5 +884,15 @@ Suite* write_set_suite()
     tcase_set_timeout(tc, 20);
     suite_add_tcase(s, tc);
 
+    tc = tcase_create("test_cert_purge_slices");
+    tcase_add_test(tc, test_cert_purge_slices);
+    tcase_set_timeout(tc, 20);
+    suite_add_tcase(s, tc);
+
+    tc = tcase_create("test_cert_purge_interleaving");
+    tcase_add_test(tc, test_cert_purge_interleaving);
+    tcase_set_timeout(tc, 20);
+    suite_add_tcase(s, tc);
+
     return s;
 }
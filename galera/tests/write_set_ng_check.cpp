@@ -157,6 +157,33 @@ START_TEST (ver3_basic)
 
     mark_point();
 
+    /* background checksum of a valid writeset */
+    {
+        WriteSetIn::stats_reset();
+
+        WriteSetIn wsi(in_buf, 2);
+        mark_point();
+        wsi.verify_checksum();
+        fail_if (wsi.keyset().count()  != 1);
+        fail_if (wsi.dataset().count() != 1);
+
+        gu::Status status;
+        WriteSetIn::get_status(status);
+        fail_if (status.size() != 3);
+
+        long long bytes(0);
+        for (gu::Status::const_iterator i(status.begin()); i != status.end();
+             ++i)
+        {
+            if (i->first == "ws_checksum_bytes")
+                bytes = strtoll(i->second.c_str(), NULL, 10);
+        }
+        fail_if (size_t(bytes) != wsi.keyset().size() + wsi.dataset().size(),
+                 "checksummed %lld bytes", bytes);
+    }
+
+    mark_point();
+
     try /* this is to test checksum after set_seqno() */
     {
         WriteSetIn wsi(in_buf);
@@ -340,11 +367,46 @@ START_TEST (ver3_annotation)
 }
 END_TEST
 
+/* writeset without record sets has nothing to checksum in background */
+START_TEST (ver3_empty)
+{
+    wsrep_uuid_t source;
+    gu_uuid_generate (reinterpret_cast<gu_uuid_t*>(&source), NULL, 0);
+
+    std::string const dir(".");
+    wsrep_trx_id_t trx_id(1);
+    WriteSetOut wso (dir, trx_id, KeySet::FLAT8A, 0, 0, 0, WriteSetNG::VER3);
+    fail_unless (wso.is_empty());
+
+    WriteSetNG::GatherVector out;
+    size_t const out_size(wso.gather(source, 1, 1, out));
+    wso.set_last_seen(1);
+
+    std::vector<gu::byte_t> in;
+    in.reserve(out_size);
+    for (size_t i(0); i < out->size(); ++i)
+    {
+        const gu::byte_t* ptr(static_cast<const gu::byte_t*>(out[i].ptr));
+        in.insert (in.end(), ptr, ptr + out[i].size);
+    }
+
+    gu::Buf const in_buf = { in.data(), static_cast<ssize_t>(in.size()) };
+
+    /* size threshold of 1 requests background checksum */
+    WriteSetIn wsi(in_buf, 1);
+    mark_point();
+    wsi.verify_checksum();
+    fail_if (wsi.keyset().count()  != 0);
+    fail_if (wsi.dataset().count() != 0);
+}
+END_TEST
+
 Suite* write_set_ng_suite ()
 {
     TCase* t = tcase_create ("WriteSet");
     tcase_add_test (t, ver3_basic);
     tcase_add_test (t, ver3_annotation);
+    tcase_add_test (t, ver3_empty);
     tcase_set_timeout(t, 60);
 
     Suite* s = suite_create ("WriteSet");
@@ -25,6 +25,7 @@ extern "C"
 #include "gu_mutex.h"
 #include "gu_dbug.h"
 #include "gu_fifo.h"
+#include "gu_lfq.h"
 #include "gu_uuid.h"
 #include "gu_to.h"
 #include "gu_lock_step.h"
@@ -58,6 +58,15 @@ extern "C" {
 #define gu_atomic_get(ptr, vptr)                        \
     __atomic_load(ptr, vptr, GU_ATOMIC_SYNC_DEFAULT)
 
+// sets contents of ptr to newval if it is equal to oldval,
+// returns true on success
+#define gu_atomic_bool_compare_and_swap(ptr, oldval, newval)       \
+    __extension__ ({                                               \
+        __typeof__(*(ptr)) gu_atomic_old_ = (oldval);              \
+        __atomic_compare_exchange_n(ptr, &gu_atomic_old_, newval,  \
+                                    0, GU_ATOMIC_SYNC_DEFAULT,     \
+                                    GU_ATOMIC_SYNC_DEFAULT); })
+
 #elif defined(__GCC_HAVE_SYNC_COMPARE_AND_SWAP_8) // use __sync_XXX builtins
 
 #define GU_ATOMIC_SYNC_NONE    0
@@ -83,6 +92,8 @@ extern "C" {
 
 #define gu_atomic_get(ptr, vptr) *vptr = __sync_fetch_and_or(ptr, 0)
 
+#define gu_atomic_bool_compare_and_swap __sync_bool_compare_and_swap
+
 #else
 #error "This GCC version does not support 8-byte atomics on this platform. Use GCC >= 4.7.x."
 #endif /* __ATOMIC_RELAXED */
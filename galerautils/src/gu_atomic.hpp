@@ -71,6 +71,12 @@ namespace gu
             return *this;
         }
 
+        /* sets value to i if it is equal to cmp, returns true on success */
+        bool compare_and_swap(I cmp, I i)
+        {
+            return gu_atomic_bool_compare_and_swap(&i_, cmp, i);
+        }
+
         bool operator!=(I i)
         {
             return (operator()() != i);
@@ -1,5 +1,5 @@
 /*
- * Copyright (C) 2013 Codership Oy <info@codership.com>
+ * Copyright (C) 2013-2014 Codership Oy <info@codership.com>
  *
  * $Id$
  */
@@ -9,13 +9,45 @@
 
 #include <assert.h>
 
+#if defined(GU_CRC32C_X3)
+#include <cpuid.h>
+#endif
+
 CRC32CFunctionPtr gu_crc32c_func = crc32cSlicingBy8; // some sensible default
 
+#if defined(GU_CRC32C_X3)
+static bool
+crc32c_have_pclmul()
+{
+    unsigned int eax, ebx, ecx, edx;
+
+    if (!__get_cpuid (1, &eax, &ebx, &ecx, &edx)) return false;
+
+    return (ecx & bit_PCLMUL);
+}
+#endif /* GU_CRC32C_X3 */
+
 void
 gu_crc32c_configure()
 {
     gu_crc32c_func = detectBestCRC32C();
 
+#if defined(GU_CRC32C_X3)
+    if (gu_crc32c_func == crc32cHardware64) {
+        gu_crc32c_x3_init();
+
+        if (crc32c_have_pclmul()) {
+            gu_crc32c_func = gu_crc32c_x3_clmul;
+            gu_info ("CRC-32C: using 3-way hardware acceleration "
+                     "with PCLMULQDQ.");
+        }
+        else {
+            gu_crc32c_func = gu_crc32c_x3_table;
+            gu_info ("CRC-32C: using 3-way hardware acceleration.");
+        }
+    }
+    else
+#endif /* GU_CRC32C_X3 */
 #if !defined(CRC32C_NO_HARDWARE)
     if (gu_crc32c_func == crc32cHardware64 ||
         gu_crc32c_func == crc32cHardware32) {
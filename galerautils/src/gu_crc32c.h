@@ -21,6 +21,25 @@ extern "C" {
 extern void
 gu_crc32c_configure();
 
+#if defined(CRC32C_x86_64) && !defined(CRC32C_NO_HARDWARE)
+#define GU_CRC32C_X3 1
+
+/*! Initializes 3-way kernel constants, called by gu_crc32c_configure() */
+extern void
+gu_crc32c_x3_init();
+
+/*! 3-way interleaved hardware CRC32C, streams combined by table lookup.
+ *  Requires SSE4.2 */
+extern uint32_t
+gu_crc32c_x3_table (uint32_t crc, const void* data, size_t length);
+
+/*! 3-way interleaved hardware CRC32C, streams combined by carry-less
+ *  multiplication. Requires SSE4.2 and PCLMULQDQ */
+extern uint32_t
+gu_crc32c_x3_clmul (uint32_t crc, const void* data, size_t length);
+
+#endif /* CRC32C_x86_64 && !CRC32C_NO_HARDWARE */
+
 extern CRC32CFunctionPtr gu_crc32c_func;
 
 typedef uint32_t gu_crc32c_t;
@@ -0,0 +1,211 @@
+/*
+ * Copyright (C) 2014 Codership Oy <info@codership.com>
+ *
+ * @file 3-way interleaved hardware CRC-32C implementation for x86_64
+ *
+ * CRC32 instruction has a latency of 3 cycles, but can be issued every
+ * cycle. So when the buffer is big enough it is split into 3 streams which
+ * are checksummed in parallel and then combined. Combining requires to
+ * "shift" CRC of the preceding stream over the length of the next one,
+ * which is multiplication by x^(8*len) modulo CRC polynomial. It is done
+ * either by table lookup or by carry-less multiplication (PCLMULQDQ).
+ *
+ * This file must be compiled with -msse4.2 -mpclmul, functions defined here
+ * may be called only if CPU supports the corresponding instructions.
+ *
+ * $Id$
+ */
+
+#include "gu_crc32c.h"
+
+#if defined(GU_CRC32C_X3)
+
+#include <nmmintrin.h> /* SSE4.2 */
+#include <wmmintrin.h> /* PCLMULQDQ */
+
+#include <assert.h>
+#include <stdbool.h>
+
+#define CRC32C_POLY 0x82f63b78 /* reflected */
+
+/* Stream lengths (in bytes) for the long and short interleaving loops */
+#define X3_LONG  8192
+#define X3_SHORT 256
+
+/* a * b modulo CRC polynomial, reflected representation */
+static uint32_t
+gf2_mult (uint32_t a, uint32_t b)
+{
+    uint32_t p = 0;
+    int i;
+
+    for (i = 0; i < 32; i++)
+    {
+        if (a & (0x80000000U >> i)) p ^= b;
+        b = (b & 1) ? (b >> 1) ^ CRC32C_POLY : b >> 1;
+    }
+
+    return p;
+}
+
+/* x^n modulo CRC polynomial, reflected representation */
+static uint32_t
+gf2_xpow (uint64_t n)
+{
+    uint32_t p  = 0x80000000U; /* x^0 */
+    uint32_t sq = 0x40000000U; /* x^1 */
+
+    while (n)
+    {
+        if (n & 1) p = gf2_mult (p, sq);
+        sq = gf2_mult (sq, sq);
+        n >>= 1;
+    }
+
+    return p;
+}
+
+/* lookup tables to shift CRC by a fixed length */
+static uint32_t x3_long_table [4][256];
+static uint32_t x3_short_table[4][256];
+
+/* constants to shift CRC by a fixed length with PCLMULQDQ */
+static uint32_t x3_long_clmul;
+static uint32_t x3_short_clmul;
+
+static bool x3_initialized = false;
+
+static void
+x3_table_init (uint32_t table[4][256], size_t const len)
+{
+    uint32_t const k = gf2_xpow (8 * len);
+    int i, j;
+
+    for (i = 0; i < 4; i++)
+    {
+        for (j = 0; j < 256; j++)
+        {
+            table[i][j] = gf2_mult (k, (uint32_t)j << (8 * i));
+        }
+    }
+}
+
+void
+gu_crc32c_x3_init ()
+{
+    if (x3_initialized) return;
+
+    x3_table_init (x3_long_table,  X3_LONG);
+    x3_table_init (x3_short_table, X3_SHORT);
+
+    /* clmul() of two reflected 32-bit values followed by CRC32 of the 64-bit
+     * product is multiplication by x^33, hence the constant is
+     * x^(8*len - 33) */
+    x3_long_clmul  = gf2_xpow (8 * X3_LONG  - 33);
+    x3_short_clmul = gf2_xpow (8 * X3_SHORT - 33);
+
+    x3_initialized = true;
+}
+
+static GU_FORCE_INLINE uint32_t
+x3_shift_table (uint32_t const table[4][256], uint32_t const crc)
+{
+    return table[0][crc         & 0xff] ^
+           table[1][(crc >>  8) & 0xff] ^
+           table[2][(crc >> 16) & 0xff] ^
+           table[3][crc >> 24];
+}
+
+static GU_FORCE_INLINE uint32_t
+x3_shift_clmul (uint32_t const k, uint32_t const crc)
+{
+    __m128i const prod = _mm_clmulepi64_si128 (_mm_cvtsi32_si128 (crc),
+                                               _mm_cvtsi32_si128 (k), 0);
+
+    return (uint32_t)_mm_crc32_u64 (0, (uint64_t)_mm_cvtsi128_si64 (prod));
+}
+
+#define X3_SHIFT(crc, len)                                              \
+    (clmul ?                                                            \
+     x3_shift_clmul (x3_##len##_clmul, crc) :                           \
+     x3_shift_table ((const uint32_t (*)[256])x3_##len##_table, crc))
+
+/* checksums 3 consecutive streams of len bytes in parallel */
+#define X3_LOOP(len, LEN)                                               \
+    while (length >= 3 * LEN)                                           \
+    {                                                                   \
+        uint64_t crc1 = 0;                                              \
+        uint64_t crc2 = 0;                                              \
+        const uint8_t* const end = p + LEN;                             \
+                                                                        \
+        do                                                              \
+        {                                                               \
+            crc0 = _mm_crc32_u64 (crc0, *(const uint64_t*)(p));         \
+            crc1 = _mm_crc32_u64 (crc1, *(const uint64_t*)(p + LEN));   \
+            crc2 = _mm_crc32_u64 (crc2, *(const uint64_t*)(p + 2*LEN)); \
+            p += sizeof(uint64_t);                                      \
+        }                                                               \
+        while (p < end);                                                \
+                                                                        \
+        crc0 = X3_SHIFT((uint32_t)crc0, len) ^ crc1;                    \
+        crc0 = X3_SHIFT((uint32_t)crc0, len) ^ crc2;                    \
+                                                                        \
+        p      += 2 * LEN;                                              \
+        length -= 3 * LEN;                                              \
+    }
+
+static GU_FORCE_INLINE uint32_t
+crc32c_x3 (uint32_t const crc, const void* const data, size_t length,
+           bool const clmul)
+{
+    const uint8_t* p    = (const uint8_t*)data;
+    uint64_t       crc0 = crc;
+
+    assert (x3_initialized);
+
+    /* align to 8 bytes */
+    while (length > 0 && ((uintptr_t)p & (sizeof(uint64_t) - 1)))
+    {
+        crc0 = _mm_crc32_u8 ((uint32_t)crc0, *p);
+        p++;
+        length--;
+    }
+
+    X3_LOOP(long,  X3_LONG);
+    X3_LOOP(short, X3_SHORT);
+
+    /* serial tail */
+    while (length >= sizeof(uint64_t))
+    {
+        crc0 = _mm_crc32_u64 (crc0, *(const uint64_t*)p);
+        p      += sizeof(uint64_t);
+        length -= sizeof(uint64_t);
+    }
+
+    while (length > 0)
+    {
+        crc0 = _mm_crc32_u8 ((uint32_t)crc0, *p);
+        p++;
+        length--;
+    }
+
+    return (uint32_t)crc0;
+}
+
+uint32_t
+gu_crc32c_x3_table (uint32_t crc, const void* data, size_t length)
+{
+    return crc32c_x3 (crc, data, length, false);
+}
+
+uint32_t
+gu_crc32c_x3_clmul (uint32_t crc, const void* data, size_t length)
+{
+    return crc32c_x3 (crc, data, length, true);
+}
+
+#else
+
+typedef int gu_crc32c_x86_unused_t; /* ISO C forbids empty source files */
+
+#endif /* GU_CRC32C_X3 */
@@ -0,0 +1,583 @@
+/*
+ * Copyright (C) 2015 Codership Oy <info@codership.com>
+ *
+ * Lock-free queue class implementation
+ *
+ * Items are addressed by monotonically increasing positions: consumers
+ * claim the head position by CAS, the only producer publishes items by
+ * advancing the tail. Positions are mapped to rows of items the same way
+ * as in gu_fifo. A row is allocated when the producer gets to its first
+ * item and freed when its last item is popped, so a row is never reused
+ * while a consumer may still be reading from it.
+ */
+
+#define _DEFAULT_SOURCE
+
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <unistd.h>
+
+#include "gu_assert.h"
+#include "gu_atomic.h"
+#include "gu_limits.h"
+#include "gu_macros.h"
+#include "gu_mem.h"
+#include "gu_mutex.h"
+#include "gu_log.h"
+#include "gu_lfq.h"
+
+typedef unsigned long lfq_pos_t;
+
+/* gets are not limited */
+#define LFQ_NO_LIMIT ((lfq_pos_t)-1)
+
+/* keeps head and tail on different cache lines */
+#define LFQ_CACHE_LINE 64
+
+struct lfq_row
+{
+    long done;     /* items popped from the row */
+    long items[];  /* long for alignment */
+};
+
+struct gu_lfq
+{
+    /* consumer side */
+    lfq_pos_t          head;
+    char               head_pad[LFQ_CACHE_LINE - sizeof(lfq_pos_t)];
+
+    /* producer side */
+    lfq_pos_t          tail;
+    struct lfq_row*    tail_row;  /* row being filled */
+    long long          q_len;
+    long long          q_len_samples;
+    long               used_max;
+    char               tail_pad[LFQ_CACHE_LINE];
+
+    lfq_pos_t          limit;     /* gets are canceled from this position */
+    lfq_pos_t*         cancels;   /* queued limits */
+    long               cancels_num;
+    long               cancels_len;
+
+    ulong col_shift;
+    ulong col_mask;
+    ulong row_mask;
+    ulong row_len;
+    ulong length;
+    ulong item_size;
+    ulong stride;
+    long  used_min;
+
+    long volatile get_wait;  /* getters waiting */
+    long volatile get_sig;   /* getters signaled but not yet running */
+    long volatile put_wait;
+    long volatile users;     /* threads in gu_lfq_pop() */
+    bool volatile closed;
+
+    gu_mutex_t lock;
+    gu_cond_t  get_cond;
+    gu_cond_t  put_cond;
+
+    struct lfq_row* volatile rows[];
+};
+
+/* Don't make rows less than 1K */
+#define LFQ_MIN_ROW_POWER 10
+
+#define LFQ_ROW(q,x) (((x) >> q->col_shift) & q->row_mask)
+#define LFQ_COL(q,x) ((x) & q->col_mask)
+#define LFQ_PTR(q,r,x) ((char*)(r)->items + LFQ_COL(q, x) * q->stride)
+
+typedef unsigned long long ull;
+
+static inline lfq_pos_t
+lfq_min (lfq_pos_t const a, lfq_pos_t const b) { return a < b ? a : b; }
+
+/* constructor */
+gu_lfq_t* gu_lfq_create (size_t const length, size_t const item_size)
+{
+    size_t const stride =
+        (item_size + sizeof(long) - 1) / sizeof(long) * sizeof(long);
+    int row_pwr    = LFQ_MIN_ROW_POWER;
+    ull row_len    = 1 << row_pwr;
+    ull row_size   = row_len * stride + sizeof(struct lfq_row);
+    int array_pwr  = 1; // need at least 2 rows for alteration
+    ull array_len  = 1 << array_pwr;
+    ull array_size = array_len * sizeof(void*);
+    gu_lfq_t* ret  = NULL;
+
+    if (0 == length || 0 == item_size) return NULL;
+
+    /* find the best ratio of width and height:
+     * the size of a row array must be equal to that of the row */
+    while (array_len * row_len < length) {
+        if (array_size < row_size) {
+            array_pwr++;
+            array_len  = 1 << array_pwr;
+            array_size = array_len * sizeof(void*);
+        }
+        else {
+            row_pwr++;
+            row_len  = 1 << row_pwr;
+            row_size = row_len * stride + sizeof(struct lfq_row);
+        }
+    }
+
+    ull const alloc_size = array_size + sizeof (gu_lfq_t);
+    ull const max_size   = array_len * row_size + alloc_size;
+
+    if (max_size > (size_t)-1) {
+        gu_error ("Maximum queue size %llu exceeds size_t range %zu",
+                  max_size, (size_t)-1);
+        return NULL;
+    }
+
+    if (max_size > gu_avphys_bytes()) {
+        gu_error ("Maximum queue size %llu exceeds available memory "
+                  "limit %llu", max_size, gu_avphys_bytes());
+        return NULL;
+    }
+
+    if ((array_len * row_len) > (ull)GU_LONG_MAX) {
+        gu_error ("Resulting queue length %llu exceeds max allowed %ld",
+                  array_len * row_len, GU_LONG_MAX);
+        return NULL;
+    }
+
+    gu_debug ("Creating lock-free queue of %llu elements of size %zu, "
+              "memory min used: %llu, max used: %llu",
+              array_len * row_len, item_size, alloc_size, max_size);
+
+    ret = gu_malloc (alloc_size);
+
+    if (ret) {
+        memset (ret, 0, alloc_size);
+        ret->limit     = LFQ_NO_LIMIT;
+        ret->col_shift = row_pwr;
+        ret->col_mask  = row_len - 1;
+        ret->row_mask  = array_len - 1;
+        ret->row_len   = row_len;
+        ret->length    = row_len * array_len;
+        ret->item_size = item_size;
+        ret->stride    = stride;
+        gu_mutex_init (&ret->lock, NULL);
+        gu_cond_init  (&ret->get_cond, NULL);
+        gu_cond_init  (&ret->put_cond, NULL);
+    }
+    else {
+        gu_error ("Failed to allocate %llu bytes for lock-free queue",
+                  alloc_size);
+    }
+
+    return ret;
+}
+
+// defined as macro for proper line reporting
+#define lfq_lock(q)                                     \
+    if (gu_likely (0 == gu_mutex_lock (&q->lock))) {}   \
+    else {                                              \
+        gu_fatal ("Failed to lock queue");              \
+        abort();                                        \
+    }
+
+#define lfq_unlock(q) gu_mutex_unlock (&q->lock)
+
+static inline lfq_pos_t
+lfq_load (lfq_pos_t volatile* const pos)
+{
+    lfq_pos_t ret;
+    gu_atomic_get (pos, &ret);
+    return ret;
+}
+
+static inline long
+lfq_load_long (long volatile* const val)
+{
+    long ret;
+    gu_atomic_get (val, &ret);
+    return ret;
+}
+
+void gu_lfq_close (gu_lfq_t* q)
+{
+    lfq_lock (q);
+
+    q->closed = true;
+    gu_cond_broadcast (&q->get_cond);
+    gu_cond_broadcast (&q->put_cond);
+
+    lfq_unlock (q);
+}
+
+void gu_lfq_open (gu_lfq_t* q)
+{
+    lfq_lock (q);
+
+    q->closed      = false;
+    q->limit       = LFQ_NO_LIMIT;
+    q->cancels_num = 0;
+
+    lfq_unlock (q);
+}
+
+long gu_lfq_length (gu_lfq_t* q)
+{
+    lfq_pos_t const head = lfq_load (&q->head);
+    return lfq_load (&q->tail) - head;
+}
+
+/* destructor - would block until all items are popped */
+void gu_lfq_destroy (gu_lfq_t* q)
+{
+    gu_lfq_close (q);
+
+    if (gu_lfq_length (q) > 0) {
+        gu_warn ("Waiting for %ld items to be popped.", gu_lfq_length (q));
+    }
+
+    /* poppers may still be inside gu_lfq_pop() */
+    while (gu_lfq_length (q) > 0 || lfq_load_long (&q->users) > 0) {
+        usleep (1000);
+    }
+
+    while (gu_cond_destroy (&q->put_cond)) {
+        lfq_lock (q);
+        gu_cond_broadcast (&q->put_cond);
+        lfq_unlock (q);
+    }
+
+    while (gu_cond_destroy (&q->get_cond)) {
+        lfq_lock (q);
+        gu_cond_broadcast (&q->get_cond);
+        lfq_unlock (q);
+    }
+
+    while (gu_mutex_destroy (&q->lock)) continue;
+
+    /* only the row being filled might be left */
+    ulong i;
+    for (i = 0; i <= q->row_mask; i++) {
+        if (q->rows[i]) gu_free (q->rows[i]);
+    }
+
+    gu_free (q->cancels);
+    gu_free (q);
+}
+
+/* waits for the row of the previous round to be freed and allocates it anew,
+ * called by producer */
+static struct lfq_row*
+lfq_row_alloc (gu_lfq_t* q, lfq_pos_t const tail, bool const wait, int* err)
+{
+    ulong const idx = LFQ_ROW(q, tail);
+
+    if (gu_unlikely (NULL != q->rows[idx])) {
+        /* queue is full */
+        if (!wait) {
+            *err = -EAGAIN;
+            return NULL;
+        }
+
+        lfq_lock (q);
+
+        gu_atomic_fetch_and_add (&q->put_wait, 1);
+        while (NULL != q->rows[idx] && !q->closed) {
+            gu_cond_wait (&q->put_cond, &q->lock);
+        }
+        gu_atomic_fetch_and_sub (&q->put_wait, 1);
+
+        lfq_unlock (q);
+
+        if (q->closed) {
+            *err = -ENODATA;
+            return NULL;
+        }
+    }
+
+    struct lfq_row* const row =
+        gu_malloc (sizeof(struct lfq_row) + q->row_len * q->stride);
+
+    if (gu_likely (NULL != row)) {
+        row->done = 0;
+        q->rows[idx] = row; // published by tail advance
+    }
+    else {
+        *err = -ENOMEM;
+    }
+
+    return row;
+}
+
+/* makes gets canceled after position pos is popped */
+static void
+lfq_cancel_after (gu_lfq_t* q, lfq_pos_t const pos)
+{
+    lfq_lock (q);
+
+    if (LFQ_NO_LIMIT == q->limit) {
+        gu_atomic_set (&q->limit, &pos);
+    }
+    else {
+        /* previous cancel is still in effect, queue this one */
+        if (q->cancels_num == q->cancels_len) {
+            long const len = q->cancels_len ? q->cancels_len * 2 : 4;
+            lfq_pos_t* const tmp =
+                gu_realloc (q->cancels, len * sizeof(lfq_pos_t));
+
+            if (!tmp) {
+                gu_fatal ("Failed to allocate queue cancel list");
+                abort();
+            }
+
+            q->cancels     = tmp;
+            q->cancels_len = len;
+        }
+
+        q->cancels[q->cancels_num++] = pos;
+    }
+
+    lfq_unlock (q);
+}
+
+/* wakes up one of the getters unless all of them were signaled already */
+static inline void
+lfq_signal_get (gu_lfq_t* q)
+{
+    long const wait = lfq_load_long (&q->get_wait);
+
+    if (gu_unlikely (wait > lfq_load_long (&q->get_sig))) {
+        lfq_lock (q);
+
+        if (q->get_wait > q->get_sig) {
+            q->get_sig++;
+            gu_cond_signal (&q->get_cond);
+        }
+
+        lfq_unlock (q);
+    }
+}
+
+static inline int
+lfq_push (gu_lfq_t* q, const void* item, bool const cancel, bool const wait)
+{
+    lfq_pos_t const tail = q->tail;
+    struct lfq_row* row  = q->tail_row;
+
+    if (gu_unlikely (q->closed)) return -ENODATA;
+
+    if (0 == LFQ_COL(q, tail)) {
+        int err = 0;
+
+        if (!(row = lfq_row_alloc (q, tail, wait, &err))) return err;
+
+        q->tail_row = row;
+    }
+
+    memcpy (LFQ_PTR(q, row, tail), item, q->item_size);
+
+    if (gu_unlikely (cancel)) lfq_cancel_after (q, tail + 1);
+
+    /* stats are maintained by the producer only */
+    long const used = tail - lfq_load (&q->head);
+
+    q->q_len += used;
+    q->q_len_samples++;
+    if (gu_unlikely (used + 1 > q->used_max)) q->used_max = used + 1;
+
+    lfq_pos_t const next = tail + 1;
+    gu_atomic_set (&q->tail, &next);
+
+    lfq_signal_get (q);
+
+    return 0;
+}
+
+int gu_lfq_push (gu_lfq_t* q, const void* item, bool const cancel)
+{
+    return lfq_push (q, item, cancel, true);
+}
+
+int gu_lfq_try_push (gu_lfq_t* q, const void* item, bool const cancel)
+{
+    return lfq_push (q, item, cancel, false);
+}
+
+/* copies num claimed items starting from pos and frees the rows of which
+ * the last item was taken */
+static inline void
+lfq_take (gu_lfq_t* q, lfq_pos_t const pos, long const num, char* items)
+{
+    lfq_pos_t const end = pos + num;
+    lfq_pos_t       p   = pos;
+
+    while (p < end) {
+        ulong const     idx = LFQ_ROW(q, p);
+        struct lfq_row* row = q->rows[idx];
+        long const      n   = lfq_min (end - p, q->row_len - LFQ_COL(q, p));
+
+        assert (row);
+
+        memcpy (items, LFQ_PTR(q, row, p), n * q->item_size);
+        items += n * q->item_size;
+        p     += n;
+
+        if (gu_unlikely ((ulong)gu_atomic_add_and_fetch (&row->done, n) ==
+                         q->row_len)) {
+            struct lfq_row* const null = NULL;
+            gu_atomic_set (&q->rows[idx], &null);
+            gu_free (row);
+
+            if (lfq_load_long (&q->put_wait) > 0) {
+                lfq_lock (q);
+                gu_cond_signal (&q->put_cond);
+                lfq_unlock (q);
+            }
+        }
+    }
+
+    long const used = lfq_load (&q->tail) - end;
+    if (gu_unlikely (used < q->used_min)) q->used_min = used; // racy, stats
+
+    if (gu_unlikely (end == lfq_load (&q->limit) &&
+                     lfq_load_long (&q->get_wait) > 0)) {
+        /* gets canceled, let waiting getters know */
+        lfq_lock (q);
+        gu_cond_broadcast (&q->get_cond);
+        lfq_unlock (q);
+    }
+}
+
+/* sleeps until something happens to the queue */
+static void
+lfq_wait_get (gu_lfq_t* q, lfq_pos_t const head)
+{
+    lfq_lock (q);
+
+    gu_atomic_fetch_and_add (&q->get_wait, 1);
+
+    if (head == lfq_load (&q->head) && head == lfq_load (&q->tail) &&
+        head <  lfq_load (&q->limit) && !q->closed) {
+        gu_cond_wait (&q->get_cond, &q->lock);
+    }
+
+    gu_atomic_fetch_and_sub (&q->get_wait, 1);
+    if (q->get_sig > 0) q->get_sig--;
+
+    lfq_unlock (q);
+}
+
+long gu_lfq_pop_batch (gu_lfq_t* q, void* items, long const max)
+{
+    long ret;
+
+    assert (max > 0);
+
+    gu_atomic_fetch_and_add (&q->users, 1);
+
+    for (;;) {
+        lfq_pos_t const head  = lfq_load (&q->head);
+        lfq_pos_t const tail  = lfq_load (&q->tail);
+        /* must be loaded after tail: cancels past tail are not pushed yet */
+        lfq_pos_t const limit = lfq_load (&q->limit);
+
+        if (gu_unlikely (head >= limit)) {
+            ret = -ECANCELED;
+            break;
+        }
+
+        if (gu_likely (head < tail)) {
+            long const num = lfq_min (lfq_min (tail, limit) - head, max);
+
+            if (gu_atomic_bool_compare_and_swap (&q->head, head, head + num)) {
+                lfq_take (q, head, num, items);
+                ret = num;
+                break;
+            }
+
+            continue; // another consumer got them
+        }
+
+        if (q->closed) {
+            ret = -ENODATA;
+            break;
+        }
+
+        lfq_wait_get (q, head);
+    }
+
+    gu_atomic_fetch_and_sub (&q->users, 1);
+
+    return ret;
+}
+
+int gu_lfq_pop (gu_lfq_t* q, void* item)
+{
+    long const ret = gu_lfq_pop_batch (q, item, 1);
+
+    return ret > 0 ? 0 : ret;
+}
+
+int gu_lfq_resume_gets (gu_lfq_t* q)
+{
+    int ret;
+
+    lfq_lock (q);
+
+    if (LFQ_NO_LIMIT != q->limit && lfq_load (&q->head) >= q->limit) {
+        lfq_pos_t limit = LFQ_NO_LIMIT;
+
+        if (q->cancels_num > 0) {
+            limit = q->cancels[0];
+            q->cancels_num--;
+            memmove (q->cancels, q->cancels + 1,
+                     q->cancels_num * sizeof(lfq_pos_t));
+        }
+
+        gu_atomic_set (&q->limit, &limit);
+        gu_cond_broadcast (&q->get_cond);
+        ret = 0;
+    }
+    else {
+        gu_error ("Attempt to resume queue gets which were not canceled");
+        ret = -EBADFD;
+    }
+
+    lfq_unlock (q);
+
+    return ret;
+}
+
+void gu_lfq_stats_get (gu_lfq_t* q, int* q_len, int* q_len_max,
+                       int* q_len_min, double* q_len_avg)
+{
+    lfq_lock (q);
+
+    *q_len     = gu_lfq_length (q);
+    *q_len_max = q->used_max;
+    *q_len_min = q->used_min;
+
+    long long const len     = q->q_len;
+    long long const samples = q->q_len_samples;
+
+    lfq_unlock (q);
+
+    if (len >= 0 && samples >= 0) {
+        *q_len_avg = samples > 0 ? ((double)len) / samples : 0.0;
+    }
+    else {
+        *q_len_avg = -1.0;
+    }
+}
+
+void gu_lfq_stats_flush (gu_lfq_t* q)
+{
+    lfq_lock (q);
+
+    q->used_max      = gu_lfq_length (q);
+    q->used_min      = q->used_max;
+    q->q_len         = 0;
+    q->q_len_samples = 0;
+
+    lfq_unlock (q);
+}
@@ -0,0 +1,67 @@
+/*
+ * Copyright (C) 2015 Codership Oy <info@codership.com>
+ *
+ * Lock-free queue class definition
+ *
+ * A bounded single producer, multiple consumer queue of fixed size items.
+ * Like gu_fifo it can be made very long while taking up little memory when
+ * there are few items in it: item rows are allocated as the queue grows and
+ * freed as it shrinks.
+ *
+ * Unlike gu_fifo, pushing and popping do not take a mutex: items are copied
+ * in and out of the queue and consumers claim them by CAS on the queue head.
+ * The mutex is taken only to put a thread to sleep on an empty (or full)
+ * queue and to wake it up, and a wakeup is signaled only once per sleeping
+ * thread, however many items are pushed before it runs.
+ */
+
+#ifndef _gu_lfq_h_
+#define _gu_lfq_h_
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+typedef struct gu_lfq gu_lfq_t;
+
+/*! constructor */
+extern gu_lfq_t* gu_lfq_create  (size_t length, size_t item_size);
+/*! puts queue into closed state, waking up waiting threads */
+extern void      gu_lfq_close   (gu_lfq_t* q);
+/*! (re)opens queue */
+extern void      gu_lfq_open    (gu_lfq_t* q);
+/*! destructor - would block until all items are popped */
+extern void      gu_lfq_destroy (gu_lfq_t* q);
+
+/*! Copies item to the queue tail, blocks while the queue is full.
+ *  Must not be called concurrently with itself.
+ *  @param cancel if true, gets are canceled as soon as this item is popped
+ *  @return 0, -ENODATA if queue is closed or -ENOMEM */
+extern int  gu_lfq_push (gu_lfq_t* q, const void* item, bool cancel);
+/*! Like gu_lfq_push(), but does not block.
+ *  @return 0, -EAGAIN if queue is full, -ENODATA if queue is closed
+ *          or -ENOMEM */
+extern int  gu_lfq_try_push (gu_lfq_t* q, const void* item, bool cancel);
+/*! Copies head item to item and removes it from the queue,
+ *  blocks while the queue is empty.
+ *  @return 0, -ENODATA if queue is closed and empty,
+ *          -ECANCELED if gets were canceled on the queue */
+extern int  gu_lfq_pop  (gu_lfq_t* q, void* item);
+/*! Like gu_lfq_pop(), but copies up to max consecutive items at once to the
+ *  items array. Does not wait for more items once some are available.
+ *  @return number of items popped or error code like gu_lfq_pop() */
+extern long gu_lfq_pop_batch (gu_lfq_t* q, void* items, long max);
+
+/*! Return how many items are in the queue */
+extern long gu_lfq_length     (gu_lfq_t* q);
+/*! Return how many items were in the queue on average per push */
+extern void gu_lfq_stats_get  (gu_lfq_t* q, int* q_len, int* q_len_max,
+                               int* q_len_min, double* q_len_avg);
+/*! Flush stats counters */
+extern void gu_lfq_stats_flush(gu_lfq_t* q);
+
+/*! Resume gets canceled by popping an item pushed with cancel flag.
+ *  @return 0 or -EBADFD if gets were not canceled */
+extern int  gu_lfq_resume_gets (gu_lfq_t* q);
+
+#endif // _gu_lfq_h_
@@ -0,0 +1,319 @@
+/*
+ * Copyright (C) 2014 Codership Oy <info@codership.com>
+ *
+ * @file Fast LZ77 block compression in LZ4 block format.
+ *
+ * Block is a sequence of
+ *   token (4 bits literal length, 4 bits match length - 4),
+ *   [literal length extension bytes], literals,
+ *   2-byte little-endian match offset, [match length extension bytes],
+ * the last sequence consisting of literals only. Length nibble of 15 is
+ * followed by bytes which are added to it until one is not 255.
+ *
+ * $Id$
+ */
+
+#include "gu_lz.h"
+#include "gu_macros.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <stdint.h>
+#include <string.h>
+
+#define LZ_MINMATCH     4
+#define LZ_LASTLITERALS 5  /* last 5 bytes are always literals */
+#define LZ_MFLIMIT      12 /* last match must start 12 bytes before the end */
+#define LZ_MAX_OFFSET   65535
+#define LZ_HASH_LOG     14
+#define LZ_RUN_MASK     15
+
+struct lz_work
+{
+    /* last position (+1) with a given hash, 0 means none */
+    uint32_t head [1 << LZ_HASH_LOG];
+    /* distance to the previous position with the same hash, 0 means none */
+    uint16_t chain[LZ_MAX_OFFSET + 1];
+};
+
+size_t
+gu_lz_work_size (void)
+{
+    return sizeof(struct lz_work);
+}
+
+static GU_FORCE_INLINE uint32_t
+lz_read32 (const uint8_t* const p)
+{
+    uint32_t v;
+    memcpy (&v, p, sizeof(v));
+    return v;
+}
+
+static GU_FORCE_INLINE uint32_t
+lz_hash (uint32_t const v)
+{
+    return (v * 2654435761U) >> (32 - LZ_HASH_LOG);
+}
+
+static GU_FORCE_INLINE void
+lz_insert (struct lz_work* const w, const uint8_t* const base,
+           uint32_t const pos)
+{
+    uint32_t const h    = lz_hash (lz_read32 (base + pos));
+    uint32_t const prev = w->head[h];
+
+    w->chain[pos & LZ_MAX_OFFSET] =
+        (prev > 0 && pos - (prev - 1) <= LZ_MAX_OFFSET) ? pos - (prev - 1) : 0;
+    w->head[h] = pos + 1;
+}
+
+/* number of equal bytes in a and b, b not to go past b_end */
+static GU_FORCE_INLINE size_t
+lz_count (const uint8_t* a, const uint8_t* b, const uint8_t* const b_end)
+{
+    const uint8_t* const start = b;
+
+    while (b + sizeof(uint64_t) <= b_end)
+    {
+        uint64_t x, y;
+        memcpy (&x, a, sizeof(x));
+        memcpy (&y, b, sizeof(y));
+        if (x != y) break;
+        a += sizeof(uint64_t);
+        b += sizeof(uint64_t);
+    }
+
+    while (b < b_end && *a == *b) { a++; b++; }
+
+    return b - start;
+}
+
+static GU_FORCE_INLINE uint8_t*
+lz_put_len (uint8_t* op, size_t len)
+{
+    while (len >= 255) { *op++ = 255; len -= 255; }
+    *op++ = (uint8_t)len;
+    return op;
+}
+
+/* writes a sequence, match_len of 0 means the last (literals only) one,
+ * returns NULL if it does not fit */
+static GU_FORCE_INLINE uint8_t*
+lz_put_seq (uint8_t* op, uint8_t* const oend,
+            const uint8_t* const lit, size_t const lit_len,
+            size_t const offset, size_t match_len)
+{
+    uint8_t* const token = op++;
+
+    if (gu_unlikely(op + lit_len + lit_len / 255 + match_len / 255 + 4 > oend))
+        return NULL;
+
+    if (lit_len >= LZ_RUN_MASK)
+    {
+        *token = LZ_RUN_MASK << 4;
+        op = lz_put_len (op, lit_len - LZ_RUN_MASK);
+    }
+    else
+    {
+        *token = (uint8_t)(lit_len << 4);
+    }
+
+    memcpy (op, lit, lit_len);
+    op += lit_len;
+
+    if (match_len > 0)
+    {
+        assert (match_len >= LZ_MINMATCH);
+        assert (offset > 0 && offset <= LZ_MAX_OFFSET);
+
+        *op++ = (uint8_t)(offset);
+        *op++ = (uint8_t)(offset >> 8);
+
+        match_len -= LZ_MINMATCH;
+
+        if (match_len >= LZ_RUN_MASK)
+        {
+            *token |= LZ_RUN_MASK;
+            op = lz_put_len (op, match_len - LZ_RUN_MASK);
+        }
+        else
+        {
+            *token |= (uint8_t)match_len;
+        }
+    }
+
+    return op;
+}
+
+size_t
+gu_lz_compress (const void* const src, size_t const len,
+                void* const dst, size_t const dst_len,
+                int const level, void* const work)
+{
+    struct lz_work* const w    = (struct lz_work*)work;
+    const uint8_t*  const base = (const uint8_t*)src;
+    const uint8_t*  const iend = base + len;
+    const uint8_t*  const mflimit    = len > LZ_MFLIMIT ?
+                                       iend - LZ_MFLIMIT : base;
+    const uint8_t*  const matchlimit = iend - LZ_LASTLITERALS;
+    const uint8_t*  ip     = base;
+    const uint8_t*  anchor = base;
+    uint8_t*        op     = (uint8_t*)dst;
+    uint8_t* const  oend   = op + dst_len;
+
+    int const lvl      = level < GU_LZ_LEVEL_MIN ? GU_LZ_LEVEL_MIN :
+                         (level > GU_LZ_LEVEL_MAX ? GU_LZ_LEVEL_MAX : level);
+    int const attempts = 1 << (lvl - 1);
+    /* level 1 skips faster over data which does not compress */
+    int const skip_log = lvl > 1 ? 12 : 6;
+
+    assert (len < ((size_t)1 << 31));
+
+    memset (w->head, 0, sizeof(w->head));
+
+    while (ip < mflimit)
+    {
+        uint32_t const pos  = ip - base;
+        uint32_t const seq  = lz_read32 (ip);
+        uint32_t       cand = w->head[lz_hash (seq)];
+        size_t         best_len = 0;
+        size_t         best_off = 0;
+        int            n;
+
+        for (n = attempts;
+             cand > 0 && pos - (cand - 1) <= LZ_MAX_OFFSET && n > 0; n--)
+        {
+            const uint8_t* const ref = base + cand - 1;
+
+            if (lz_read32 (ref) == seq)
+            {
+                size_t const ml = LZ_MINMATCH +
+                    lz_count (ref + LZ_MINMATCH, ip + LZ_MINMATCH, matchlimit);
+
+                if (ml > best_len)
+                {
+                    best_len = ml;
+                    best_off = ip - ref;
+                    if (ip + ml == matchlimit) break;
+                }
+            }
+
+            {
+                uint16_t const d = w->chain[(cand - 1) & LZ_MAX_OFFSET];
+                if (0 == d) break;
+                cand -= d;
+            }
+        }
+
+        lz_insert (w, base, pos);
+
+        if (best_len < LZ_MINMATCH)
+        {
+            ip += 1 + ((ip - anchor) >> skip_log);
+            continue;
+        }
+
+        op = lz_put_seq (op, oend, anchor, ip - anchor, best_off, best_len);
+        if (gu_unlikely(NULL == op)) return 0;
+
+        if (lvl > 1)
+        {
+            uint32_t p;
+            for (p = pos + 1; p < pos + best_len; p++) lz_insert (w, base, p);
+        }
+        else
+        {
+            lz_insert (w, base, pos + best_len - 2);
+        }
+
+        ip    += best_len;
+        anchor = ip;
+    }
+
+    op = lz_put_seq (op, oend, anchor, iend - anchor, 0, 0);
+    if (gu_unlikely(NULL == op)) return 0;
+
+    return op - (uint8_t*)dst;
+}
+
+/* reads length extension bytes, returns false on input overrun */
+static GU_FORCE_INLINE int
+lz_get_len (const uint8_t** const ipp, const uint8_t* const iend,
+            size_t* const len)
+{
+    const uint8_t* ip = *ipp;
+    uint8_t b;
+
+    do
+    {
+        if (gu_unlikely(ip >= iend)) return 0;
+        b = *ip++;
+        *len += b;
+    }
+    while (255 == b);
+
+    *ipp = ip;
+    return 1;
+}
+
+ssize_t
+gu_lz_decompress (const void* const src, size_t const len,
+                  void* const dst, size_t const dst_len)
+{
+    const uint8_t*       ip     = (const uint8_t*)src;
+    const uint8_t* const iend   = ip + len;
+    uint8_t*       const ostart = (uint8_t*)dst;
+    uint8_t*             op     = ostart;
+    uint8_t*       const oend   = op + dst_len;
+
+    while (ip < iend)
+    {
+        unsigned int const token = *ip++;
+        size_t lit_len   = token >> 4;
+        size_t match_len = token & LZ_RUN_MASK;
+        size_t offset;
+
+        if (LZ_RUN_MASK == lit_len && !lz_get_len (&ip, iend, &lit_len))
+            return -EINVAL;
+
+        if (gu_unlikely(lit_len > (size_t)(iend - ip) ||
+                        lit_len > (size_t)(oend - op)))
+            return -EINVAL;
+
+        memcpy (op, ip, lit_len);
+        op += lit_len;
+        ip += lit_len;
+
+        if (ip == iend) break; /* last sequence */
+
+        if (gu_unlikely(iend - ip < 2)) return -EINVAL;
+
+        offset = ip[0] | ((size_t)ip[1] << 8);
+        ip += 2;
+
+        if (gu_unlikely(0 == offset || offset > (size_t)(op - ostart)))
+            return -EINVAL;
+
+        if (LZ_RUN_MASK == match_len && !lz_get_len (&ip, iend, &match_len))
+            return -EINVAL;
+
+        match_len += LZ_MINMATCH;
+
+        if (gu_unlikely(match_len > (size_t)(oend - op))) return -EINVAL;
+
+        if (offset >= match_len)
+        {
+            memcpy (op, op - offset, match_len);
+            op += match_len;
+        }
+        else /* overlapping copy */
+        {
+            const uint8_t* ref = op - offset;
+            uint8_t* const end = op + match_len;
+            while (op < end) *op++ = *ref++;
+        }
+    }
+
+    return op - ostart;
+}
@@ -0,0 +1,65 @@
+/*
+ * Copyright (C) 2014 Codership Oy <info@codership.com>
+ */
+
+/**
+ * @file Fast LZ77 block compression.
+ *
+ * Output is compatible with LZ4 block format, so blocks produced here can be
+ * decoded by any LZ4 block decoder and vice versa. Compression level selects
+ * the depth of match search: level 1 checks one candidate per position and
+ * skips faster over incompressible data, every next level doubles the number
+ * of candidates checked.
+ *
+ * $Id$
+ */
+
+#ifndef _gu_lz_h_
+#define _gu_lz_h_
+
+#include <stddef.h>    // size_t
+#include <sys/types.h> // ssize_t
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define GU_LZ_LEVEL_MIN 1
+#define GU_LZ_LEVEL_MAX 9
+
+/*! @return max size of compressed block for len bytes of input */
+static inline size_t
+gu_lz_bound (size_t const len)
+{
+    return len + len / 255 + 16;
+}
+
+/*! @return size of the work area required by gu_lz_compress() */
+extern size_t
+gu_lz_work_size (void);
+
+/*!
+ * Compresses len bytes from src into dst.
+ *
+ * @param work  work area of gu_lz_work_size() bytes, need not be initialized
+ * @return compressed size or 0 if it does not fit into dst_len bytes
+ *         (it always fits into gu_lz_bound(len) bytes)
+ */
+extern size_t
+gu_lz_compress (const void* src, size_t len, void* dst, size_t dst_len,
+                int level, void* work);
+
+/*!
+ * Decompresses len bytes from src into dst.
+ *
+ * @return decompressed size or -EINVAL if input is malformed or the output
+ *         does not fit into dst_len bytes
+ */
+extern ssize_t
+gu_lz_decompress (const void* src, size_t len, void* dst, size_t dst_len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _gu_lz_h_ */
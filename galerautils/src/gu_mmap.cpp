@@ -10,7 +10,15 @@
 #include "gu_throw.hpp"
 
 #include <cerrno>
+#include <cstdio>
+#include <fstream>
 #include <sys/mman.h>
+#include <unistd.h>
+
+#if defined(__linux__)
+#include <sys/syscall.h>
+#include <linux/mempolicy.h>
+#endif
 
 // to avoid -Wold-style-cast
 extern "C" { static const void* const GU_MAP_FAILED = MAP_FAILED; }
@@ -87,6 +95,101 @@ namespace gu
         log_debug << "Memory unmapped: " << ptr << " (" << size <<" bytes)";
     }
 
+    bool
+    MMap::huge_pages () const
+    {
+#if defined(MADV_HUGEPAGE)
+        if (madvise (ptr, size, MADV_HUGEPAGE))
+        {
+            int const err(errno);
+            log_warn << "Failed to set MADV_HUGEPAGE on " << ptr << ": "
+                     << err << " (" << strerror(err) << ')';
+            return false;
+        }
+
+        return true;
+#else
+        log_warn << "Transparent huge pages are not supported on this "
+                 << "platform";
+        return false;
+#endif
+    }
+
+    bool
+    MMap::bind_node (int const node) const
+    {
+#if defined(__linux__) && defined(SYS_mbind)
+        unsigned long const bits(sizeof(unsigned long) * 8);
+        unsigned long mask[4] = { 0, };
+
+        if (node < 0 || size_t(node) >= sizeof(mask) * 8)
+        {
+            gu_throw_error(EINVAL) << "Invalid NUMA node: " << node;
+        }
+
+        mask[node / bits] = 1UL << (node % bits);
+
+        if (syscall (SYS_mbind, ptr, size, MPOL_BIND, mask,
+                     sizeof(mask) * 8, MPOL_MF_MOVE))
+        {
+            int const err(errno);
+            log_warn << "Failed to bind " << ptr << " to NUMA node " << node
+                     << ": " << err << " (" << strerror(err) << ')';
+            return false;
+        }
+
+        return true;
+#else
+        log_warn << "NUMA binding is not supported on this platform";
+        return false;
+#endif
+    }
+
+    void
+    MMap::page_usage (size_t& page_size, size_t& huge_size) const
+    {
+        page_size = sysconf(_SC_PAGESIZE);
+        huge_size = 0;
+
+#if defined(__linux__)
+        /* the mapping may have been split into several areas */
+        unsigned long const begin(reinterpret_cast<unsigned long>(ptr));
+        unsigned long const end  (begin + size);
+
+        std::ifstream smaps("/proc/self/smaps");
+        std::string   line;
+        bool          ours(false);
+
+        while (std::getline(smaps, line))
+        {
+            unsigned long from, to;
+            char          key[32];
+            unsigned long kb;
+
+            if (2 == sscanf(line.c_str(), "%lx-%lx ", &from, &to))
+            {
+                ours = (from >= begin && to <= end);
+            }
+            else if (ours && 2 == sscanf(line.c_str(), "%31[^:]: %lu kB",
+                                         key, &kb))
+            {
+                std::string const k(key);
+
+                if ("KernelPageSize" == k)
+                {
+                    if (kb * 1024 > page_size) page_size = kb * 1024;
+                }
+                else if ("AnonHugePages"  == k ||
+                         "ShmemPmdMapped" == k ||
+                         "FilePmdMapped"  == k)
+                {
+                    huge_size += kb * 1024;
+                }
+            }
+        }
+#endif /* __linux__ */
+    }
+
     MMap::~MMap ()
     {
         if (mapped) unmap();
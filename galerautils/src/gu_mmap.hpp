@@ -28,6 +28,17 @@ public:
     void sync() const;
     void unmap();
 
+    /* asks for transparent huge pages, returns false if not supported */
+    bool huge_pages() const;
+
+    /* binds memory to NUMA node, moving already resident pages there,
+     * returns false if not supported */
+    bool bind_node(int node) const;
+
+    /* reports the largest page size backing the mapping and the amount of
+     * memory mapped with transparent huge pages (both in bytes) */
+    void page_usage(size_t& page_size, size_t& huge_size) const;
+
 private:
 
     bool mapped;
@@ -0,0 +1,274 @@
+/*
+ * Copyright (C) 2015 Codership Oy <info@codership.com>
+ */
+
+/*!
+ * @file gu_spsc_ring.hpp Single producer, single consumer queue
+ *
+ * Items are copied into a bounded ring of preallocated slots and the only
+ * shared state on the fast path are the producer and consumer positions.
+ * A consumer that finds the queue empty spins for a while before going to
+ * sleep on a condition variable, and the producer takes the mutex to wake it
+ * up only if it actually sleeps.
+ *
+ * Pushing never blocks: when the ring is full, items spill to a mutex
+ * protected overflow list until the consumer catches up. This is so that a
+ * slow consumer can't stall the producer thread (e.g. the network thread).
+ */
+
+#ifndef _gu_spsc_ring_hpp_
+#define _gu_spsc_ring_hpp_
+
+#include "gu_atomic.hpp"
+#include "gu_lock.hpp"
+#include "gu_datetime.hpp"
+#include "gu_throw.hpp"
+
+#include <deque>
+#include <new>
+
+#include <cassert>
+
+namespace gu
+{
+    template <typename T>
+    class SPSCRing
+    {
+    public:
+
+        /*!
+         * @param size  ring capacity, rounded up to a power of 2
+         * @param spins how many times consumer polls empty queue before
+         *              going to sleep
+         */
+        SPSCRing(size_t size, int spins = 1000)
+            :
+            mask_      (capacity(size) - 1),
+            spins_     (spins),
+            ring_      (static_cast<T*>(::operator new(sizeof(T) *
+                                                       (mask_ + 1)))),
+            pad0_      (),
+            head_      (0),
+            head_local_(0),
+            tail_cache_(0),
+            from_ring_ (false),
+            pad1_      (),
+            tail_      (0),
+            tail_local_(0),
+            head_cache_(0),
+            spilling_  (false),
+            pad2_      (),
+            spilled_   (0),
+            waiting_   (0),
+            mutex_     (),
+            cond_      (),
+            overflow_  ()
+        { }
+
+        ~SPSCRing()
+        {
+            for (size_t i(head_local_); i != tail_local_; ++i)
+            {
+                ring_[i & mask_].~T();
+            }
+
+            ::operator delete(ring_);
+        }
+
+        /*! Copies item to the queue tail. Producer only. */
+        void push_back(const T& item)
+        {
+            if (gu_unlikely(spilling_))
+            {
+                Lock lock(mutex_);
+
+                if (overflow_.empty() == false)
+                {
+                    spill(item);
+                    return;
+                }
+
+                // consumer takes from overflow only when the ring is
+                // empty, so now there is room for the item in the ring
+                spilling_ = false;
+            }
+
+            if (gu_likely(tail_local_ - head_cache_ <= mask_ ||
+                          tail_local_ - (head_cache_ = head_()) <= mask_))
+            {
+                new (ring_ + (tail_local_ & mask_)) T(item);
+                tail_ = ++tail_local_;
+
+                if (gu_unlikely(waiting_() != 0))
+                {
+                    Lock lock(mutex_);
+                    cond_.signal();
+                }
+            }
+            else
+            {
+                Lock lock(mutex_);
+                spilling_ = true;
+                spill(item);
+            }
+        }
+
+        /*!
+         * Returns reference to the head item, waiting for one to arrive
+         * if the queue is empty. Consumer only.
+         *
+         * @param timeout absolute time until which to wait
+         * @throws gu::Exception with ETIMEDOUT
+         */
+        const T& front(const datetime::Date& timeout = GU_TIME_ETERNITY)
+        {
+            for (int i(0); i < spins_; ++i)
+            {
+                const T* const ret(peek(false));
+                if (gu_likely(ret != 0)) return *ret;
+            }
+
+            Lock lock(mutex_);
+
+            const T* ret;
+
+            while ((ret = peek(true)) == 0)
+            {
+                Waiting w(waiting_);
+
+                // re-check after announcing waiting, producer might have
+                // pushed before it could see it
+                if ((ret = peek(true)) != 0) break;
+
+                if (gu_likely(timeout == GU_TIME_ETERNITY))
+                {
+                    lock.wait(cond_);
+                }
+                else
+                {
+                    lock.wait(cond_, timeout);
+                }
+            }
+
+            return *ret;
+        }
+
+        /*! Removes item returned by front(). Consumer only. */
+        void pop_front()
+        {
+            if (gu_likely(from_ring_))
+            {
+                assert(head_local_ != tail_cache_);
+                ring_[head_local_ & mask_].~T();
+                head_ = ++head_local_;
+            }
+            else
+            {
+                Lock lock(mutex_);
+                assert(overflow_.empty() == false);
+                overflow_.pop_front();
+                spilled_.sub_and_fetch(1);
+            }
+        }
+
+        /*! Approximate number of items in the queue */
+        size_t size() const
+        {
+            return (tail_() - head_() + spilled_());
+        }
+
+        bool empty() const { return (size() == 0); }
+
+    private:
+
+        class Waiting
+        {
+        public:
+            Waiting (Atomic<int>& w) : w_(w) { w_ = 1; }
+            ~Waiting()                       { w_ = 0; }
+        private:
+            Atomic<int>& w_;
+        };
+
+        static size_t capacity(size_t size)
+        {
+            if (size == 0) gu_throw_error(EINVAL) << "zero ring size";
+
+            size_t ret(1);
+            while (ret < size) ret <<= 1;
+            return ret;
+        }
+
+        // must be called with mutex_ locked
+        void spill(const T& item)
+        {
+            overflow_.push_back(item);
+            spilled_.add_and_fetch(1);
+            cond_.signal();
+        }
+
+        // returns pointer to head item or 0 if the queue is empty,
+        // locked tells if mutex_ is already held by the caller
+        const T* peek(bool const locked)
+        {
+            if (head_local_ != tail_cache_ ||
+                head_local_ != (tail_cache_ = tail_()))
+            {
+                from_ring_ = true;
+                return (ring_ + (head_local_ & mask_));
+            }
+
+            if (spilled_() > 0)
+            {
+                // ring items pushed before spilling are visible by now
+                if (head_local_ != (tail_cache_ = tail_()))
+                {
+                    from_ring_ = true;
+                    return (ring_ + (head_local_ & mask_));
+                }
+
+                // producer does not push to ring until overflow is drained
+                // and deque::push_back() does not invalidate references
+                from_ring_ = false;
+                if (locked) return &overflow_.front();
+                Lock lock(mutex_);
+                return &overflow_.front();
+            }
+
+            return 0;
+        }
+
+        SPSCRing(const SPSCRing&);
+        void operator=(const SPSCRing&);
+
+        static size_t const cache_line_ = 64;
+
+        size_t const  mask_;
+        int    const  spins_;
+        T*     const  ring_;
+
+        // positions are written by different threads, keep them on
+        // separate cache lines together with the writer's private data
+        char           pad0_[cache_line_];
+        Atomic<size_t> head_;       // published consumer position
+        size_t         head_local_;
+        size_t         tail_cache_;
+        bool           from_ring_;  // where front() item came from
+
+        char           pad1_[cache_line_];
+        Atomic<size_t> tail_;       // published producer position
+        size_t         tail_local_;
+        size_t         head_cache_;
+        bool           spilling_;
+
+        char           pad2_[cache_line_];
+        Atomic<size_t> spilled_;    // number of items in overflow_
+        Atomic<int>    waiting_;    // consumer is about to sleep
+
+        Mutex          mutex_;
+        Cond           cond_;
+        std::deque<T>  overflow_;
+    };
+}
+
+#endif /* _gu_spsc_ring_hpp_ */
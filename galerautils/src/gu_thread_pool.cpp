@@ -0,0 +1,156 @@
+/*
+ * Copyright (C) 2014 Codership Oy <info@codership.com>
+ */
+
+#include "gu_thread_pool.hpp"
+#include "gu_logger.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+gu::ThreadPool::ThreadPool(size_t const threads, size_t const queue_max)
+    :
+    mtx_      (),
+    cond_     (),
+    done_cond_(),
+    queue_    (),
+    threads_  (),
+    size_     (threads),
+    queue_max_(queue_max),
+    exit_     (false)
+{}
+
+gu::ThreadPool::~ThreadPool()
+{
+    {
+        Lock lock(mtx_);
+        exit_ = true;
+        cond_.broadcast();
+    }
+
+    for (size_t i(0); i < threads_.size(); ++i)
+    {
+        pthread_join(threads_[i], NULL);
+    }
+
+    assert(queue_.empty());
+}
+
+void*
+gu::ThreadPool::start_thread(void* const arg)
+{
+    static_cast<ThreadPool*>(arg)->run();
+    return NULL;
+}
+
+/* must be called under mtx_ */
+void
+gu::ThreadPool::start()
+{
+    threads_.reserve(size_);
+
+    while (threads_.size() < size_)
+    {
+        pthread_t thd;
+        int const err(pthread_create(&thd, NULL, start_thread, this));
+
+        if (gu_unlikely(err != 0))
+        {
+            log_warn << "Failed to start pool thread: " << err << " ("
+                     << ::strerror(err) << "), running with "
+                     << threads_.size() << " threads";
+            break;
+        }
+
+        threads_.push_back(thd);
+    }
+}
+
+void
+gu::ThreadPool::run()
+{
+    Lock lock(mtx_);
+
+    while (true)
+    {
+        while (queue_.empty() && !exit_) lock.wait(cond_);
+
+        if (queue_.empty()) break; // exit_ is set and nothing left to do
+
+        Job& job(*queue_.front());
+        queue_.pop_front();
+
+        job.state_ = Job::J_RUNNING;
+        mtx_.unlock();
+        exec(job);
+        mtx_.lock();
+        job.state_ = Job::J_IDLE;
+
+        done_cond_.broadcast();
+    }
+}
+
+void
+gu::ThreadPool::exec(Job& job)
+{
+    try
+    {
+        job.run();
+    }
+    catch (std::exception& e)
+    {
+        log_error << "Exception in thread pool job: " << e.what();
+    }
+    catch (...)
+    {
+        log_error << "Non-standard exception in thread pool job";
+    }
+}
+
+void
+gu::ThreadPool::submit(Job& job)
+{
+    assert(Job::J_IDLE == job.state_);
+
+    {
+        Lock lock(mtx_);
+
+        if (gu_unlikely(threads_.size() < size_ && !exit_)) start();
+
+        if (gu_likely(queue_.size() < queue_max_ && !threads_.empty()))
+        {
+            job.state_ = Job::J_QUEUED;
+            queue_.push_back(&job);
+            cond_.signal();
+            return;
+        }
+    }
+
+    exec(job); // queue is full or no threads could be started
+}
+
+void
+gu::ThreadPool::wait(Job& job)
+{
+    {
+        Lock lock(mtx_);
+
+        if (Job::J_QUEUED == job.state_)
+        {
+            /* it will take longer to wait for a free thread */
+            std::deque<Job*>::iterator const i
+                (std::find(queue_.begin(), queue_.end(), &job));
+            assert(i != queue_.end());
+            queue_.erase(i);
+            job.state_ = Job::J_IDLE;
+        }
+        else
+        {
+            while (Job::J_RUNNING == job.state_) lock.wait(done_cond_);
+            return;
+        }
+    }
+
+    exec(job);
+}
@@ -0,0 +1,99 @@
+/*
+ * Copyright (C) 2014 Codership Oy <info@codership.com>
+ */
+
+/*!
+ * @file gu_thread_pool.hpp Persistent pool of worker threads
+ *
+ * Executes short CPU bound jobs (like checksumming of big buffers) in the
+ * background without creating a thread per job. The number of threads and
+ * the length of job queue are bounded: when the queue is full, the job is
+ * executed in the caller thread. Threads are started on first submit().
+ */
+
+#ifndef _gu_thread_pool_hpp_
+#define _gu_thread_pool_hpp_
+
+#include "gu_lock.hpp"
+
+#include <pthread.h>
+
+#include <deque>
+#include <vector>
+
+namespace gu
+{
+    class ThreadPool
+    {
+    public:
+
+        class Job
+        {
+        public:
+
+            Job() : state_(J_IDLE) { }
+            virtual ~Job() { }
+
+            /* should not throw, exceptions are logged and ignored */
+            virtual void run() = 0;
+
+        private:
+
+            friend class ThreadPool;
+
+            enum State
+            {
+                J_IDLE,
+                J_QUEUED,
+                J_RUNNING
+            };
+
+            State state_;
+
+            Job(const Job&);
+            void operator=(const Job&);
+        };
+
+        /*!
+         * @param threads   number of threads, if 0, all jobs are executed
+         *                  in the caller thread
+         * @param queue_max maximum number of queued jobs
+         */
+        ThreadPool(size_t threads, size_t queue_max);
+
+        /* executes queued jobs and stops the threads */
+        ~ThreadPool();
+
+        /* queues the job for execution or executes it right away if the
+         * queue is full */
+        void submit(Job& job);
+
+        /* waits for the job to complete, executes it in the caller thread
+         * if it has not been started yet */
+        void wait(Job& job);
+
+        size_t size() const { return size_; }
+
+    private:
+
+        static void* start_thread(void* arg);
+
+        void start();
+        void run();
+        void exec(Job& job);
+
+        ThreadPool(const ThreadPool&);
+        void operator=(const ThreadPool&);
+
+        Mutex                  mtx_;
+        Cond                   cond_;      // job queued or exit requested
+        Cond                   done_cond_; // job done
+        std::deque<Job*>       queue_;
+        std::vector<pthread_t> threads_;
+        size_t const           size_;
+        size_t const           queue_max_;
+        bool                   exit_;
+    };
+}
+
+#endif /* _gu_thread_pool_hpp_ */
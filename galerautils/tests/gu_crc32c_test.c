@@ -8,6 +8,11 @@
 
 #include "gu_crc32c_test.h"
 
+#if defined(GU_CRC32C_X3)
+#include <cpuid.h>
+#endif
+
+#include <stdlib.h>
 #include <string.h>
 
 #define long_input                     \
@@ -129,6 +134,77 @@ START_TEST(test_hardware)
 }
 END_TEST
 
+/* compares function against slicing-by-8 for various lengths and alignments,
+ * including lengths that are split into interleaved streams */
+static void
+test_against_sw(CRC32CFunctionPtr const func)
+{
+    size_t const max_len = 3 * 8192 * 2 + 3 * 256 * 2 + 64;
+    unsigned char* const buf = malloc(max_len + 8);
+    size_t i;
+
+    fail_if(NULL == buf);
+
+    for (i = 0; i < max_len + 8; i++) buf[i] = rand();
+
+    size_t len;
+    for (len = 0; len <= max_len; len = len < 1024 ? len + 1 : len * 3 / 2)
+    {
+        size_t off;
+        for (off = 0; off < 8; off++)
+        {
+            uint32_t const sw = crc32cSlicingBy8(GU_CRC32C_INIT, buf+off, len);
+            uint32_t const hw = func(GU_CRC32C_INIT, buf + off, len);
+
+            fail_if(sw != hw, "len %zu, offset %zu: %#08x, expected %#08x",
+                    len, off, hw, sw);
+        }
+    }
+
+    /* 3 full long streams */
+    len = 3 * 8192;
+    fail_if(crc32cSlicingBy8(GU_CRC32C_INIT, buf, len) !=
+            func(GU_CRC32C_INIT, buf, len));
+
+    free(buf);
+}
+
+#if defined(GU_CRC32C_X3)
+START_TEST(test_x3_table)
+{
+    if (detectBestCRC32C() == crc32cHardware64)
+    {
+        gu_crc32c_x3_init();
+        gu_crc32c_func = gu_crc32c_x3_table;
+        test_function();
+        test_against_sw(gu_crc32c_x3_table);
+    }
+}
+END_TEST
+
+START_TEST(test_x3_clmul)
+{
+    unsigned int eax, ebx, ecx, edx;
+
+    if (detectBestCRC32C() == crc32cHardware64 &&
+        __get_cpuid (1, &eax, &ebx, &ecx, &edx) && (ecx & bit_PCLMUL))
+    {
+        gu_crc32c_x3_init();
+        gu_crc32c_func = gu_crc32c_x3_clmul;
+        test_function();
+        test_against_sw(gu_crc32c_x3_clmul);
+    }
+}
+END_TEST
+#endif /* GU_CRC32C_X3 */
+
+START_TEST(test_configured)
+{
+    gu_crc32c_configure();
+    test_against_sw(gu_crc32c_func);
+}
+END_TEST
+
 Suite *gu_crc32c_suite(void)
 {
     Suite *suite = suite_create("CRC32C implementation");
@@ -143,6 +219,11 @@ Suite *gu_crc32c_suite(void)
     TCase *hw = tcase_create("test_hw");
     suite_add_tcase (suite, hw);
     tcase_add_test  (hw, test_hardware);
+#if defined(GU_CRC32C_X3)
+    tcase_add_test  (hw, test_x3_table);
+    tcase_add_test  (hw, test_x3_clmul);
+#endif /* GU_CRC32C_X3 */
+    tcase_add_test  (hw, test_configured);
 
     return suite;
 }
@@ -0,0 +1,184 @@
+/*
+ * Copyright (C) 2014 Codership Oy <info@codership.com>
+ */
+
+/*!
+ * @file Throughput benchmark for checksum/hash implementations used on
+ *       writesets, record sets and gcache buffers: CRC-32C variants,
+ *       MurmurHash3 128 and "fast hash" for buffers from 64B to 16MB.
+ *
+ * To run:
+ * gu_hash_bench [<MB hashed per measurement>]
+ */
+
+#include "../src/gu_crc32c.h"
+#include "../src/gu_hash.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#if defined(GU_CRC32C_X3)
+#include <cpuid.h>
+#endif
+
+typedef uint64_t (*hash_func_t) (const void* buf, size_t len);
+
+static uint64_t
+crc_sw (const void* buf, size_t len)
+{
+    return crc32cSlicingBy8 (GU_CRC32C_INIT, buf, len);
+}
+
+#if !defined(CRC32C_NO_HARDWARE)
+static CRC32CFunctionPtr crc_hw_func = crc32cSlicingBy8;
+
+static uint64_t
+crc_hw (const void* buf, size_t len)
+{
+    return crc_hw_func (GU_CRC32C_INIT, buf, len);
+}
+#endif /* CRC32C_NO_HARDWARE */
+
+#if defined(GU_CRC32C_X3)
+static uint64_t
+crc_x3_table (const void* buf, size_t len)
+{
+    return gu_crc32c_x3_table (GU_CRC32C_INIT, buf, len);
+}
+
+static uint64_t
+crc_x3_clmul (const void* buf, size_t len)
+{
+    return gu_crc32c_x3_clmul (GU_CRC32C_INIT, buf, len);
+}
+#endif /* GU_CRC32C_X3 */
+
+static uint64_t
+mmh128 (const void* buf, size_t len)
+{
+    return gu_mmh128_64 (buf, len);
+}
+
+static uint64_t
+fast64 (const void* buf, size_t len)
+{
+    return gu_fast_hash64 (buf, len);
+}
+
+struct alg
+{
+    const char* name;
+    hash_func_t func;
+    int         enabled;
+};
+
+static struct alg algs[] =
+{
+    { "crc-sw",    crc_sw,       1 },
+#if !defined(CRC32C_NO_HARDWARE)
+    { "crc-hw",    crc_hw,       0 },
+#endif
+#if defined(GU_CRC32C_X3)
+    { "crc-x3",    crc_x3_table, 0 },
+    { "crc-x3clm", crc_x3_clmul, 0 },
+#endif
+    { "mmh128",    mmh128,       1 },
+    { "fast64",    fast64,       1 },
+    { NULL,        NULL,         0 }
+};
+
+static double
+now (void)
+{
+    struct timeval tv;
+    gettimeofday (&tv, NULL);
+    return (double)tv.tv_sec + 1.e-6 * tv.tv_usec;
+}
+
+/* returns throughput in MB/s */
+static double
+measure (hash_func_t const func, const void* const buf, size_t const len,
+         size_t const total)
+{
+    size_t const loops = total / len > 0 ? total / len : 1;
+    uint64_t volatile h = 0; /* prevents calls from being optimized out */
+    double begin, end;
+    size_t i;
+
+    begin = now();
+    for (i = 0; i < loops; i++) h += func (buf, len);
+    end = now();
+
+    (void)h;
+
+    return (double)len * loops / (end - begin) / (1 << 20);
+}
+
+int main (int argc, char* argv[])
+{
+    long const mb = argc > 1 ? strtol (argv[1], NULL, 10) : 128;
+    size_t const max_len = 16 << 20;
+    unsigned char* buf;
+    size_t len;
+    int i;
+
+    if (mb <= 0)
+    {
+        fprintf (stderr, "Usage: %s [<MB hashed per measurement>]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+#if !defined(CRC32C_NO_HARDWARE)
+    crc_hw_func = detectBestCRC32C();
+    if (crc_hw_func != crc32cSlicingBy8) algs[1].enabled = 1;
+#endif
+
+#if defined(GU_CRC32C_X3)
+    if (detectBestCRC32C() == crc32cHardware64)
+    {
+        unsigned int eax, ebx, ecx, edx;
+
+        gu_crc32c_x3_init();
+        algs[2].enabled = 1;
+        algs[3].enabled = __get_cpuid (1, &eax, &ebx, &ecx, &edx) &&
+            (ecx & bit_PCLMUL);
+    }
+#endif
+
+    buf = malloc (max_len);
+    if (!buf)
+    {
+        perror ("malloc()");
+        return EXIT_FAILURE;
+    }
+
+    for (len = 0; len < max_len; len++) buf[len] = rand();
+
+    printf ("%ld MB per measurement, MB/s\n%9s", mb, "size");
+    for (i = 0; algs[i].name; i++)
+        if (algs[i].enabled) printf (" %10s", algs[i].name);
+    printf ("\n");
+
+    for (len = 64; len <= max_len; len <<= 2)
+    {
+        printf ("%9zu", len);
+
+        for (i = 0; algs[i].name; i++)
+        {
+            if (algs[i].enabled)
+            {
+                printf (" %10.0f", measure (algs[i].func, buf, len,
+                                            (size_t)mb << 20));
+                fflush (stdout);
+            }
+        }
+
+        printf ("\n");
+    }
+
+    free (buf);
+
+    return EXIT_SUCCESS;
+}
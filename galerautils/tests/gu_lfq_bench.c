@@ -0,0 +1,211 @@
+/*
+ * Copyright (C) 2015 Codership Oy <info@codership.com>
+ */
+
+/*!
+ * @file Throughput benchmark of gu_lfq against gu_fifo as a receive queue:
+ *       one thread pushes items of gcs receive action size, a number of
+ *       threads pop them.
+ *
+ * To run:
+ * gu_lfq_bench [<items per measurement> [<max consumer threads>]]
+ */
+
+#include "../src/gu_lfq.h"
+#include "../src/gu_fifo.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+
+/* resembles gcs_recv_act */
+struct item
+{
+    const void* buf;
+    long long   seqno_g;
+    long long   seqno_l;
+    long        size;
+    int         type;
+    int         sender;
+};
+
+struct queue_ops
+{
+    const char* name;
+    void* (*create)  (size_t len);
+    int   (*push)    (void* q, const struct item* it);
+    int   (*pop)     (void* q, struct item* it);
+    void  (*close)   (void* q);
+    void  (*destroy) (void* q);
+};
+
+static void*
+fifo_create (size_t const len)
+{
+    return gu_fifo_create (len, sizeof(struct item));
+}
+
+static int
+fifo_push (void* q, const struct item* it)
+{
+    struct item* const tail = gu_fifo_get_tail (q);
+
+    if (!tail) return -1;
+
+    *tail = *it;
+    gu_fifo_push_tail (q);
+    return 0;
+}
+
+static int
+fifo_pop (void* q, struct item* it)
+{
+    int err;
+    struct item* const head = gu_fifo_get_head (q, &err);
+
+    if (!head) return err;
+
+    *it = *head;
+    gu_fifo_pop_head (q);
+    return 0;
+}
+
+static void fifo_close   (void* q) { gu_fifo_close (q); }
+static void fifo_destroy (void* q) { gu_fifo_destroy (q); }
+
+static void*
+lfq_create (size_t const len)
+{
+    return gu_lfq_create (len, sizeof(struct item));
+}
+
+static int
+lfq_push (void* q, const struct item* it) { return gu_lfq_push (q, it, false); }
+
+static int
+lfq_pop (void* q, struct item* it) { return gu_lfq_pop (q, it); }
+
+static void lfq_close   (void* q) { gu_lfq_close (q); }
+static void lfq_destroy (void* q) { gu_lfq_destroy (q); }
+
+static const struct queue_ops queues[] =
+{
+    { "gu_fifo", fifo_create, fifo_push, fifo_pop, fifo_close, fifo_destroy },
+    { "gu_lfq",  lfq_create,  lfq_push,  lfq_pop,  lfq_close,  lfq_destroy  },
+    { NULL,      NULL,        NULL,      NULL,     NULL,       NULL         }
+};
+
+struct consumer
+{
+    const struct queue_ops* ops;
+    void*                   q;
+    long long               sum;
+};
+
+static void*
+consumer_thread (void* arg)
+{
+    struct consumer* const c = arg;
+    struct item it;
+
+    while (0 == c->ops->pop (c->q, &it)) c->sum += it.seqno_g;
+
+    return NULL;
+}
+
+static double
+now (void)
+{
+    struct timeval tv;
+    gettimeofday (&tv, NULL);
+    return (double)tv.tv_sec + 1.e-6 * tv.tv_usec;
+}
+
+/* returns throughput in items/s or negative on error */
+static double
+measure (const struct queue_ops* const ops, long const items, int const threads)
+{
+    struct consumer* const c   = calloc (threads, sizeof(struct consumer));
+    pthread_t*       const thr = calloc (threads, sizeof(pthread_t));
+    /* like gcs recv_q, the queue never gets full: gu_fifo can't handle
+     * that and producer blocking is not what is measured here */
+    void*            const q   = ops->create (items);
+    struct item it = { NULL, 0, 0, 0, 0, 0 };
+    long long sum = 0;
+    double begin, end;
+    long i;
+    int t;
+
+    if (!c || !thr || !q) return -1.0;
+
+    for (t = 0; t < threads; t++)
+    {
+        c[t].ops = ops;
+        c[t].q   = q;
+        pthread_create (&thr[t], NULL, consumer_thread, &c[t]);
+    }
+
+    begin = now();
+
+    for (i = 1; i <= items; i++)
+    {
+        it.seqno_g = i;
+        if (ops->push (q, &it)) break;
+    }
+
+    ops->close (q);
+
+    for (t = 0; t < threads; t++)
+    {
+        pthread_join (thr[t], NULL);
+        sum += c[t].sum;
+    }
+
+    end = now();
+
+    ops->destroy (q);
+    free (thr);
+    free (c);
+
+    if (sum != (long long)items * (items + 1) / 2)
+    {
+        fprintf (stderr, "%s: lost items\n", ops->name);
+        return -1.0;
+    }
+
+    return items / (end - begin);
+}
+
+int main (int argc, char* argv[])
+{
+    long const items   = argc > 1 ? strtol (argv[1], NULL, 10) : 1000000;
+    int  const threads = argc > 2 ? strtol (argv[2], NULL, 10) : 8;
+    int t, i;
+
+    if (items <= 0 || threads <= 0)
+    {
+        fprintf (stderr, "Usage: %s [<items per measurement> "
+                 "[<max consumer threads>]]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    printf ("%ld items per measurement, Mitems/s\n%9s", items, "consumers");
+    for (i = 0; queues[i].name; i++) printf (" %10s", queues[i].name);
+    printf ("\n");
+
+    for (t = 1; t <= threads; t <<= 1)
+    {
+        printf ("%9d", t);
+
+        for (i = 0; queues[i].name; i++)
+        {
+            printf (" %10.2f", measure (&queues[i], items, t) * 1.e-6);
+            fflush (stdout);
+        }
+
+        printf ("\n");
+    }
+
+    return EXIT_SUCCESS;
+}
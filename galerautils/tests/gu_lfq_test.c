@@ -0,0 +1,260 @@
+// Copyright (C) 2015 Codership Oy <info@codership.com>
+
+// $Id$
+
+#include <check.h>
+#include "gu_lfq_test.h"
+#include "../src/galerautils.h"
+
+#define LFQ_LENGTH 10000L
+
+START_TEST (gu_lfq_test)
+{
+    gu_lfq_t* q;
+    long i;
+    long item;
+    long used;
+
+    q = gu_lfq_create (0, 1);
+    fail_if (q != NULL);
+
+    q = gu_lfq_create (1, 0);
+    fail_if (q != NULL);
+
+    q = gu_lfq_create (1, 1);
+    fail_if (q == NULL);
+    gu_lfq_close   (q);
+    mark_point();
+    gu_lfq_destroy (q);
+    mark_point();
+
+    q = gu_lfq_create (LFQ_LENGTH, sizeof(i));
+    fail_if (q == NULL);
+    fail_if (gu_lfq_length(q) != 0, "length is %ld for an empty queue",
+             gu_lfq_length(q));
+
+    // go around the queue a few times to exercise row reallocation
+    long next = 0;
+    int  round;
+    for (round = 0; round < 3; round++) {
+        for (i = 0; i < LFQ_LENGTH; i++) {
+            long const val = round * LFQ_LENGTH + i;
+            fail_if (0 != gu_lfq_push (q, &val, false),
+                     "could not push item %ld", val);
+        }
+
+        used = i;
+        fail_if (gu_lfq_length(q) != used, "length is %ld, expected %ld",
+                 gu_lfq_length(q), used);
+
+        for (i = 0; i < used; i++) {
+            fail_if (0 != gu_lfq_pop (q, &item), "could not pop item %ld", i);
+            fail_if (item != next, "got %ld, expected %ld", item, next);
+            next++;
+        }
+
+        fail_if (gu_lfq_length(q) != 0,
+                 "gu_lfq_length() for empty queue is %ld", gu_lfq_length(q));
+    }
+
+    int    q_len, q_len_max, q_len_min;
+    double q_len_avg;
+
+    gu_lfq_stats_get (q, &q_len, &q_len_max, &q_len_min, &q_len_avg);
+    fail_if (0 != q_len);
+    fail_if (LFQ_LENGTH != q_len_max, "q_len_max: %d", q_len_max);
+    fail_if (0 != q_len_min, "q_len_min: %d", q_len_min);
+    fail_if (q_len_avg != (LFQ_LENGTH - 1)/2.0, "q_len_avg: %f", q_len_avg);
+
+    gu_lfq_stats_flush (q);
+    gu_lfq_stats_get (q, &q_len, &q_len_max, &q_len_min, &q_len_avg);
+    fail_if (0 != q_len_max);
+    fail_if (0.0 != q_len_avg);
+
+    /* full queue does not block try_push */
+    for (i = 0; 0 == gu_lfq_try_push (q, &i, false); i++) {
+        fail_if (i > 2 * LFQ_LENGTH, "queue did not fill up");
+    }
+    used = i;
+    fail_if (used < LFQ_LENGTH, "queue full after %ld items", used);
+    fail_if (-EAGAIN != gu_lfq_try_push (q, &i, false));
+    fail_if (gu_lfq_length(q) != used, "length is %ld, expected %ld",
+             gu_lfq_length(q), used);
+
+    for (i = 0; i < used; i++) {
+        fail_if (0 != gu_lfq_pop (q, &item), "could not pop item %ld", i);
+        fail_if (item != i, "got %ld, expected %ld", item, i);
+    }
+    fail_if (0 != gu_lfq_try_push (q, &i, false));
+    fail_if (0 != gu_lfq_pop (q, &item));
+    fail_if (item != used, "got %ld, expected %ld", item, used);
+
+    gu_lfq_close (q);
+
+    fail_if (-ENODATA != gu_lfq_push (q, &item, false));
+    fail_if (-ENODATA != gu_lfq_try_push (q, &item, false));
+    fail_if (-ENODATA != gu_lfq_pop (q, &item));
+
+    gu_lfq_open (q);
+
+    item = 1;
+    fail_if (0 != gu_lfq_push (q, &item, false));
+    gu_lfq_close (q);
+
+    /* items pushed before close still can be popped */
+    item = 0;
+    fail_if (0 != gu_lfq_pop (q, &item));
+    fail_if (1 != item);
+    fail_if (-ENODATA != gu_lfq_pop (q, &item));
+
+    gu_lfq_destroy (q);
+}
+END_TEST
+
+START_TEST(gu_lfq_cancel_test)
+{
+    gu_lfq_t* q = gu_lfq_create (LFQ_LENGTH, sizeof(long));
+    long item;
+
+    fail_if (-EBADFD != gu_lfq_resume_gets (q));
+
+    item = 1; fail_if (0 != gu_lfq_push (q, &item, false));
+    item = 2; fail_if (0 != gu_lfq_push (q, &item, true));
+    item = 3; fail_if (0 != gu_lfq_push (q, &item, true));
+    item = 4; fail_if (0 != gu_lfq_push (q, &item, false));
+
+    /* gets are not canceled until cancelling item is popped */
+    fail_if (-EBADFD != gu_lfq_resume_gets (q));
+    fail_if (0 != gu_lfq_pop (q, &item));
+    fail_if (1 != item);
+    fail_if (0 != gu_lfq_pop (q, &item));
+    fail_if (2 != item);
+
+    fail_if (-ECANCELED != gu_lfq_pop (q, &item));
+    fail_if (-ECANCELED != gu_lfq_pop (q, &item));
+    fail_if (2 != gu_lfq_length (q));
+
+    fail_if (0 != gu_lfq_resume_gets (q));
+
+    /* next cancel is queued */
+    fail_if (0 != gu_lfq_pop (q, &item));
+    fail_if (3 != item);
+    fail_if (-ECANCELED != gu_lfq_pop (q, &item));
+
+    gu_lfq_close (q); // closes for puts, but the q still must be canceled
+    fail_if (-ECANCELED != gu_lfq_pop (q, &item));
+
+    fail_if (0 != gu_lfq_resume_gets (q));
+    fail_if (-EBADFD != gu_lfq_resume_gets (q));
+    fail_if (0 != gu_lfq_pop (q, &item));
+    fail_if (4 != item);
+    fail_if (-ENODATA != gu_lfq_pop (q, &item));
+
+    gu_lfq_destroy (q);
+}
+END_TEST
+
+START_TEST(gu_lfq_batch_test)
+{
+    gu_lfq_t* q = gu_lfq_create (LFQ_LENGTH, sizeof(long));
+    long items[700];
+    long i, next = 0;
+
+    for (i = 0; i < 3000; i++) {
+        fail_if (0 != gu_lfq_push (q, &i, 1000 == i));
+    }
+
+    /* batches span rows, but stop at the canceling item */
+    long ret;
+    while ((ret = gu_lfq_pop_batch (q, items, 700)) > 0) {
+        for (i = 0; i < ret; i++) {
+            fail_if (items[i] != next, "got %ld, expected %ld", items[i], next);
+            next++;
+        }
+    }
+
+    fail_if (-ECANCELED != ret, "ret: %ld", ret);
+    fail_if (1001 != next, "next: %ld", next);
+    fail_if (0 != gu_lfq_resume_gets (q));
+
+    while (next < 3000) {
+        ret = gu_lfq_pop_batch (q, items, 700);
+        fail_if (ret != (3000 - next < 700 ? 3000 - next : 700), "ret: %ld",
+                 ret);
+        for (i = 0; i < ret; i++) {
+            fail_if (items[i] != next, "got %ld, expected %ld", items[i], next);
+            next++;
+        }
+    }
+
+    fail_if (0 != gu_lfq_length (q));
+
+    gu_lfq_close (q);
+    fail_if (-ENODATA != gu_lfq_pop_batch (q, items, 700));
+    gu_lfq_destroy (q);
+}
+END_TEST
+
+#define LFQ_ITEMS  1000000L
+#define LFQ_GETTERS 4
+
+static long lfq_sum[LFQ_GETTERS];
+
+static void*
+getter_thread (void* arg)
+{
+    gu_lfq_t* const q = ((void**)arg)[0];
+    long*     const sum = ((void**)arg)[1];
+    long item;
+
+    while (0 == gu_lfq_pop (q, &item)) *sum += item;
+
+    return NULL;
+}
+
+START_TEST(gu_lfq_mt_test)
+{
+    /* short queue to make the producer block on full queue */
+    gu_lfq_t* q = gu_lfq_create (1, sizeof(long));
+    pthread_t threads[LFQ_GETTERS];
+    void*     args[LFQ_GETTERS][2];
+    long      i;
+
+    for (i = 0; i < LFQ_GETTERS; i++) {
+        args[i][0] = q;
+        args[i][1] = &lfq_sum[i];
+        pthread_create (&threads[i], NULL, getter_thread, args[i]);
+    }
+
+    for (i = 1; i <= LFQ_ITEMS; i++) {
+        fail_if (0 != gu_lfq_push (q, &i, false));
+    }
+
+    gu_lfq_close (q);
+
+    long sum = 0;
+    for (i = 0; i < LFQ_GETTERS; i++) {
+        pthread_join (threads[i], NULL);
+        sum += lfq_sum[i];
+    }
+
+    fail_if (sum != LFQ_ITEMS * (LFQ_ITEMS + 1) / 2,
+             "sum: %ld, expected %ld", sum, LFQ_ITEMS * (LFQ_ITEMS + 1) / 2);
+
+    gu_lfq_destroy (q);
+}
+END_TEST
+
+Suite *gu_lfq_suite(void)
+{
+    Suite *s  = suite_create("Galera lock-free queue");
+    TCase *tc = tcase_create("gu_lfq");
+
+    suite_add_tcase (s, tc);
+    tcase_add_test  (tc, gu_lfq_test);
+    tcase_add_test  (tc, gu_lfq_cancel_test);
+    tcase_add_test  (tc, gu_lfq_batch_test);
+    tcase_add_test  (tc, gu_lfq_mt_test);
+    tcase_set_timeout(tc, 60);
+    return s;
+}
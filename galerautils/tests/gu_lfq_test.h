@@ -0,0 +1,10 @@
+// Copyright (C) 2015 Codership Oy <info@codership.com>
+
+// $Id$
+
+#ifndef __gu_lfq_test__
+#define __gu_lfq_test__
+
+Suite *gu_lfq_suite(void);
+
+#endif /* __gu_lfq_test__ */
@@ -0,0 +1,202 @@
+/*
+ * Copyright (C) 2014 Codership Oy <info@codership.com>
+ *
+ * $Id$
+ */
+
+#include "../src/gu_lz.h"
+
+#include "gu_lz_test.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* fills buffer with text-like data: words from a small dictionary */
+static void
+fill_text (unsigned char* const buf, size_t const len)
+{
+    static const char* const words[] =
+        { "INSERT ", "INTO ", "t1 ", "VALUES ", "(", "), ", "'galera'", ", ",
+          "12345", "UPDATE ", "SET ", "WHERE ", "id = ", "NULL", "\n" };
+    size_t const n_words = sizeof(words) / sizeof(words[0]);
+    size_t i = 0;
+
+    while (i < len)
+    {
+        const char* const w = words[rand() % n_words];
+        size_t l = strlen (w);
+
+        if (l > len - i) l = len - i;
+        memcpy (buf + i, w, l);
+        i += l;
+    }
+}
+
+static void
+fill_random (unsigned char* const buf, size_t const len)
+{
+    size_t i;
+    for (i = 0; i < len; i++) buf[i] = rand();
+}
+
+static void
+fill_zero (unsigned char* const buf, size_t const len)
+{
+    memset (buf, 0, len);
+}
+
+typedef void (*fill_t) (unsigned char*, size_t);
+
+/* compresses and decompresses buffers of various sizes with all levels,
+ * returns total compressed size */
+static size_t
+roundtrip (fill_t const fill)
+{
+    static size_t const sizes[] =
+        { 0, 1, 4, 12, 13, 17, 100, 255, 4096, 65535, 65536, 70000, 1 << 18 };
+    size_t const max_len = 1 << 18;
+    unsigned char* const in   = malloc (max_len);
+    unsigned char* const out  = malloc (max_len);
+    unsigned char* const z    = malloc (gu_lz_bound (max_len));
+    void*          const work = malloc (gu_lz_work_size());
+    size_t total = 0;
+    size_t i;
+
+    fail_if (!in || !out || !z || !work);
+
+    for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+    {
+        size_t const len = sizes[i];
+        int level;
+
+        fill (in, len);
+
+        for (level = GU_LZ_LEVEL_MIN; level <= GU_LZ_LEVEL_MAX; level++)
+        {
+            size_t const zlen =
+                gu_lz_compress (in, len, z, gu_lz_bound (len), level, work);
+
+            fail_if (0 == zlen, "len %zu, level %d: compression failed",
+                     len, level);
+            fail_if (zlen > gu_lz_bound (len));
+
+            ssize_t const ret = gu_lz_decompress (z, zlen, out, len);
+
+            fail_if (ret != (ssize_t)len, "len %zu, level %d: "
+                     "decompressed %zd bytes", len, level, ret);
+            fail_if (len > 0 && memcmp (in, out, len),
+                     "len %zu, level %d: data mismatch", len, level);
+
+            if (len == max_len) total += zlen;
+        }
+    }
+
+    free (work);
+    free (z);
+    free (out);
+    free (in);
+
+    return total;
+}
+
+START_TEST (test_roundtrip)
+{
+    size_t const zero = roundtrip (fill_zero);
+    size_t const text = roundtrip (fill_text);
+    size_t const rnd  = roundtrip (fill_random);
+    size_t const max_len = (1 << 18) * (GU_LZ_LEVEL_MAX - GU_LZ_LEVEL_MIN + 1);
+
+    fail_if (zero > max_len / 100, "zeroes compressed to %zu", zero);
+    fail_if (text > max_len / 2,   "text compressed to %zu", text);
+    fail_if (rnd < max_len,        "random data compressed to %zu", rnd);
+}
+END_TEST
+
+START_TEST (test_levels)
+{
+    size_t const len = 1 << 18;
+    unsigned char* const in   = malloc (len);
+    unsigned char* const z    = malloc (gu_lz_bound (len));
+    void*          const work = malloc (gu_lz_work_size());
+
+    fail_if (!in || !z || !work);
+
+    fill_text (in, len);
+
+    size_t const fast = gu_lz_compress (in, len, z, gu_lz_bound (len),
+                                        GU_LZ_LEVEL_MIN, work);
+    size_t const best = gu_lz_compress (in, len, z, gu_lz_bound (len),
+                                        GU_LZ_LEVEL_MAX, work);
+
+    fail_if (best >= fast, "max level: %zu, min level: %zu", best, fast);
+
+    /* output buffer too short */
+    fail_if (0 != gu_lz_compress (in, len, z, best - 1, GU_LZ_LEVEL_MAX,
+                                  work));
+
+    free (work);
+    free (z);
+    free (in);
+}
+END_TEST
+
+START_TEST (test_malformed)
+{
+    size_t const len = 4096;
+    unsigned char* const in   = malloc (len);
+    unsigned char* const out  = malloc (len);
+    unsigned char* const z    = malloc (gu_lz_bound (len));
+    void*          const work = malloc (gu_lz_work_size());
+    size_t i;
+
+    fail_if (!in || !out || !z || !work);
+
+    fill_text (in, len);
+
+    size_t const zlen = gu_lz_compress (in, len, z, gu_lz_bound (len), 1, work);
+    fail_if (0 == zlen);
+
+    /* output too short */
+    fail_if (-EINVAL != gu_lz_decompress (z, zlen, out, len - 1));
+
+    /* truncated input */
+    for (i = 1; i < 16; i++)
+    {
+        ssize_t const ret = gu_lz_decompress (z, zlen - i, out, len);
+        fail_if (ret == (ssize_t)len && !memcmp (in, out, len));
+    }
+
+    /* offset pointing before the start of output */
+    {
+        static const unsigned char bad[] = { 0x10, 'a', 0x05, 0x00, 0x00 };
+        fail_if (-EINVAL != gu_lz_decompress (bad, sizeof(bad), out, len));
+    }
+
+    /* corrupted input must never overrun the output */
+    for (i = 0; i < 1000; i++)
+    {
+        memcpy (z + rand() % zlen, &i, 1);
+        (void)gu_lz_decompress (z, zlen, out, len);
+    }
+
+    free (work);
+    free (z);
+    free (out);
+    free (in);
+}
+END_TEST
+
+Suite *gu_lz_suite(void)
+{
+    Suite *suite = suite_create("LZ block compression");
+    TCase *tc    = tcase_create("gu_lz");
+
+    suite_add_tcase (suite, tc);
+    tcase_add_test  (tc, test_roundtrip);
+    tcase_add_test  (tc, test_levels);
+    tcase_add_test  (tc, test_malformed);
+    tcase_set_timeout(tc, 60);
+
+    return suite;
+}
@@ -0,0 +1,14 @@
+/*
+ * Copyright (C) 2014 Codership Oy <info@codership.com>
+ *
+ * $Id$
+ */
+
+#ifndef __gu_lz_test_h__
+#define __gu_lz_test_h__
+
+#include <check.h>
+
+Suite* gu_lz_suite(void);
+
+#endif /* __gu_lz_test_h__ */
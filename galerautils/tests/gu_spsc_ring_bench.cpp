@@ -0,0 +1,219 @@
+/*
+ * Copyright (C) 2015 Codership Oy <info@codership.com>
+ */
+
+/*!
+ * @file Throughput benchmark of gu::SPSCRing against deque+mutex queue
+ *       which gcs_gcomm used as RecvBuf before: one thread pushes items of
+ *       RecvBufData size, another thread pops them.
+ *
+ * To run:
+ * gu_spsc_ring_bench [<items per measurement> [<producer pause period>]]
+ *
+ * With non-zero pause period the producer sleeps 100us after every so many
+ * items, so that the consumer has to wait for items now and then.
+ */
+
+#include "../src/gu_spsc_ring.hpp"
+
+#include <boost/shared_ptr.hpp>
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+
+#include <vector>
+
+/* resembles RecvBufData: source index, Datagram and ProtoUpMeta */
+struct Item
+{
+    typedef boost::shared_ptr<std::vector<unsigned char> > Payload;
+
+    Item(long const val)
+        :
+        source_idx(0),
+        header    (),
+        header_off(128),
+        payload   (payloads[val % payloads.size()]),
+        offset    (0),
+        seqno     (val),
+        user_type (0),
+        order     (0)
+    { }
+
+    size_t        source_idx;
+    unsigned char header[128];
+    size_t        header_off;
+    Payload       payload;
+    size_t        offset;
+    long          seqno;
+    int           user_type;
+    int           order;
+
+    // distinct payloads, so that reference counting does not make
+    // producer and consumer share a cache line
+    static std::vector<Payload> payloads;
+};
+
+std::vector<Item::Payload> Item::payloads;
+
+/* RecvBuf as it was in gcs_gcomm.cpp */
+class RecvBuf
+{
+private:
+
+    class Waiting
+    {
+    public:
+        Waiting (bool& w) : w_(w) { w_ = true;  }
+        ~Waiting()                { w_ = false; }
+    private:
+        bool& w_;
+    };
+
+public:
+
+    RecvBuf() : mutex_(), cond_(), queue_(), waiting_(false) { }
+
+    void push_back(const Item& p)
+    {
+        gu::Lock lock(mutex_);
+
+        queue_.push_back(p);
+
+        if (waiting_ == true) { cond_.signal(); }
+    }
+
+    const Item& front()
+    {
+        gu::Lock lock(mutex_);
+
+        while (queue_.empty())
+        {
+            Waiting w(waiting_);
+            lock.wait(cond_);
+        }
+
+        return queue_.front();
+    }
+
+    void pop_front()
+    {
+        gu::Lock lock(mutex_);
+        queue_.pop_front();
+    }
+
+private:
+
+    gu::Mutex        mutex_;
+    gu::Cond         cond_;
+    std::deque<Item> queue_;
+    bool             waiting_;
+};
+
+template <class Q>
+struct Producer
+{
+    Q*   q;
+    long items;
+    long pause;
+};
+
+template <class Q>
+static void* producer_thread(void* arg)
+{
+    Producer<Q>* const p(static_cast<Producer<Q>*>(arg));
+
+    for (long i(1); i <= p->items; ++i)
+    {
+        p->q->push_back(Item(i));
+        if (p->pause && i % p->pause == 0) usleep(100);
+    }
+
+    return 0;
+}
+
+static double now()
+{
+    struct timeval tv;
+    gettimeofday (&tv, NULL);
+    return static_cast<double>(tv.tv_sec) + 1.e-6 * tv.tv_usec;
+}
+
+/* returns throughput in items/s or negative on error */
+template <class Q>
+static double measure(Q& q, long const items, long const pause)
+{
+    Producer<Q> p = { &q, items, pause };
+    pthread_t   thd;
+    long long   sum(0);
+
+    double const begin(now());
+
+    pthread_create(&thd, 0, producer_thread<Q>, &p);
+
+    for (long i(0); i < items; ++i)
+    {
+        sum += q.front().seqno;
+        q.pop_front();
+    }
+
+    pthread_join(thd, 0);
+
+    double const end(now());
+
+    if (sum != static_cast<long long>(items) * (items + 1) / 2)
+    {
+        fprintf (stderr, "lost items\n");
+        return -1.0;
+    }
+
+    return items / (end - begin);
+}
+
+int main(int argc, char* argv[])
+{
+    long const items(argc > 1 ? strtol(argv[1], NULL, 10) : 1000000);
+    long const pause(argc > 2 ? strtol(argv[2], NULL, 10) : 0);
+
+    if (items <= 0 || pause < 0)
+    {
+        fprintf (stderr, "Usage: %s [<items per measurement> "
+                 "[<producer pause period>]]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    for (int i(0); i < 4096; ++i)
+    {
+        Item::payloads.push_back(
+            Item::Payload(new std::vector<unsigned char>(256)));
+    }
+
+    printf ("%ld items per measurement, pause every %ld items, Mitems/s\n",
+            items, pause);
+
+    {
+        RecvBuf q;
+        printf ("%-28s %10.2f\n", "deque+mutex (old RecvBuf)",
+                measure(q, items, pause) * 1.e-6);
+    }
+
+    static size_t const sizes[] = { 64, 1024, 16384, 0 };
+    static int    const spins[] = { 0, 1000, 10000, -1 };
+
+    for (int s(0); sizes[s] != 0; ++s)
+    {
+        for (int p(0); spins[p] >= 0; ++p)
+        {
+            gu::SPSCRing<Item> q(sizes[s], spins[p]);
+            char name[64];
+            snprintf (name, sizeof(name), "SPSCRing(%lu, %d)",
+                      static_cast<unsigned long>(sizes[s]), spins[p]);
+            printf ("%-28s %10.2f\n", name, measure(q, items, pause) * 1.e-6);
+            fflush (stdout);
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
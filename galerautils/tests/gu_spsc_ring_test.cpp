@@ -0,0 +1,161 @@
+/*
+ * Copyright (C) 2015 Codership Oy <info@codership.com>
+ */
+
+#include "../src/gu_spsc_ring.hpp"
+
+#include "gu_spsc_ring_test.hpp"
+
+#include <pthread.h>
+
+// item that counts its live copies
+class Item
+{
+public:
+    Item(long val) : val_(val) { ++live_; }
+    Item(const Item& i) : val_(i.val_) { ++live_; }
+    ~Item() { --live_; }
+    long val() const { return val_; }
+
+    static gu::Atomic<long> live_;
+
+private:
+    void operator=(const Item&);
+    long val_;
+};
+
+gu::Atomic<long> Item::live_(0);
+
+START_TEST(test_spsc_ring_basic)
+{
+    {
+        gu::SPSCRing<Item> ring(5, 0); // rounded up to 8
+        long next(0);
+
+        fail_if(ring.empty() == false);
+
+        for (long i(0); i < 6; ++i) ring.push_back(Item(i));
+        fail_if(ring.size() != 6);
+
+        for (long i(0); i < 3; ++i)
+        {
+            fail_if(ring.front().val() != next, "%ld != %ld",
+                    ring.front().val(), next);
+            ring.pop_front();
+            ++next;
+        }
+
+        // fill the ring over capacity, excess items go to overflow
+        for (long i(6); i < 20; ++i) ring.push_back(Item(i));
+        fail_if(ring.size() != 17, "size: %zu", ring.size());
+
+        // pop some, including some from overflow, then push again: new
+        // items must still come after the overflow ones
+        for (long i(0); i < 10; ++i)
+        {
+            fail_if(ring.front().val() != next, "%ld != %ld",
+                    ring.front().val(), next);
+            ring.pop_front();
+            ++next;
+        }
+
+        for (long i(20); i < 30; ++i) ring.push_back(Item(i));
+
+        while (ring.empty() == false)
+        {
+            fail_if(ring.front().val() != next, "%ld != %ld",
+                    ring.front().val(), next);
+            ring.pop_front();
+            ++next;
+        }
+        fail_if(next != 30);
+
+        ring.push_back(Item(30));
+        // destructor must destroy the remaining item
+    }
+
+    fail_if(Item::live_() != 0, "live items: %ld", Item::live_());
+}
+END_TEST
+
+START_TEST(test_spsc_ring_timeout)
+{
+    gu::SPSCRing<Item> ring(4, 10);
+
+    try
+    {
+        ring.front(gu::datetime::Date::calendar() +
+                   gu::datetime::Period(10 * gu::datetime::MSec));
+        fail("front() did not time out");
+    }
+    catch (gu::Exception& e)
+    {
+        fail_if(e.get_errno() != ETIMEDOUT, "%d", e.get_errno());
+    }
+
+    ring.push_back(Item(1));
+    fail_if(ring.front().val() != 1);
+    ring.pop_front();
+}
+END_TEST
+
+#define SPSC_ITEMS 1000000L
+
+static void* producer_thread(void* arg)
+{
+    gu::SPSCRing<Item>& ring(*static_cast<gu::SPSCRing<Item>*>(arg));
+
+    for (long i(0); i < SPSC_ITEMS; ++i)
+    {
+        ring.push_back(Item(i));
+        // let consumer go to sleep now and then
+        if (i % 100000 == 0) usleep(1000);
+    }
+
+    return 0;
+}
+
+START_TEST(test_spsc_ring_mt)
+{
+    {
+        // short ring to make producer spill now and then
+        gu::SPSCRing<Item> ring(16, 100);
+        pthread_t thd;
+
+        pthread_create(&thd, 0, producer_thread, &ring);
+
+        for (long i(0); i < SPSC_ITEMS; ++i)
+        {
+            fail_if(ring.front().val() != i, "%ld != %ld",
+                    ring.front().val(), i);
+            ring.pop_front();
+        }
+
+        pthread_join(thd, 0);
+        fail_if(ring.empty() == false);
+    }
+
+    fail_if(Item::live_() != 0, "live items: %ld", Item::live_());
+}
+END_TEST
+
+Suite* gu_spsc_ring_suite()
+{
+    Suite* s = suite_create ("gu::SPSCRing");
+    TCase* t;
+
+    t = tcase_create ("test_spsc_ring_basic");
+    tcase_add_test (t, test_spsc_ring_basic);
+    suite_add_tcase (s, t);
+
+    t = tcase_create ("test_spsc_ring_timeout");
+    tcase_add_test (t, test_spsc_ring_timeout);
+    suite_add_tcase (s, t);
+
+    t = tcase_create ("test_spsc_ring_mt");
+    tcase_add_test (t, test_spsc_ring_mt);
+    tcase_set_timeout (t, 60);
+    suite_add_tcase (s, t);
+
+    return s;
+}
@@ -0,0 +1,12 @@
+/*
+ * Copyright (C) 2015 Codership Oy <info@codership.com>
+ */
+
+#ifndef __gu_spsc_ring_test__
+#define __gu_spsc_ring_test__
+
+#include <check.h>
+
+extern Suite *gu_spsc_ring_suite(void);
+
+#endif // __gu_spsc_ring_test__
@@ -25,6 +25,8 @@
 #include "gu_datetime_test.hpp"
 #include "gu_histogram_test.hpp"
 #include "gu_stats_test.hpp"
+#include "gu_thread_pool_test.hpp"
+#include "gu_spsc_ring_test.hpp"
 
 typedef Suite *(*suite_creator_t)(void);
 
@@ -45,6 +47,8 @@ static suite_creator_t suites[] =
     gu_datetime_suite,
     gu_histogram_suite,
     gu_stats_suite,
+    gu_thread_pool_suite,
+    gu_spsc_ring_suite,
     0
 };
 
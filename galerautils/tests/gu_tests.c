@@ -15,10 +15,12 @@
 #include "gu_mmh3_test.h"
 #include "gu_spooky_test.h"
 #include "gu_crc32c_test.h"
+#include "gu_lz_test.h"
 #include "gu_hash_test.h"
 #include "gu_dbug_test.h"
 #include "gu_time_test.h"
 #include "gu_fifo_test.h"
+#include "gu_lfq_test.h"
 #include "gu_uuid_test.h"
 #include "gu_lock_step_test.h"
 #include "gu_str_test.h"
@@ -35,10 +37,12 @@ static suite_creator_t suites[] =
         gu_mmh3_suite,
         gu_spooky_suite,
         gu_crc32c_suite,
+        gu_lz_suite,
         gu_hash_suite,
         gu_dbug_suite,
         gu_time_suite,
         gu_fifo_suite,
+        gu_lfq_suite,
         gu_uuid_suite,
         gu_lock_step_suite,
         gu_str_suite,
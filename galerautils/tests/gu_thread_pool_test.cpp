@@ -0,0 +1,154 @@
+/*
+ * Copyright (C) 2014 Codership Oy <info@codership.com>
+ */
+
+#include "../src/gu_thread_pool.hpp"
+#include "../src/gu_atomic.hpp"
+
+#include "gu_thread_pool_test.hpp"
+
+#include <stdexcept>
+#include <vector>
+
+#include <unistd.h>
+
+namespace
+{
+    class TestJob : public gu::ThreadPool::Job
+    {
+    public:
+
+        TestJob(gu::Atomic<long>& cnt, useconds_t const delay = 0,
+                bool const do_throw = false)
+            : cnt_(cnt), delay_(delay), throw_(do_throw), runs_(0),
+              thread_()
+        { }
+
+        void run()
+        {
+            if (delay_) usleep(delay_);
+            thread_ = pthread_self();
+            ++runs_;
+            ++cnt_;
+            if (throw_) throw std::runtime_error("test job exception");
+        }
+
+        int       runs()   const { return runs_;   }
+        pthread_t thread() const { return thread_; }
+
+    private:
+
+        gu::Atomic<long>& cnt_;
+        useconds_t const  delay_;
+        bool const        throw_;
+        int               runs_;
+        pthread_t         thread_;
+    };
+}
+
+START_TEST(test_thread_pool_basic)
+{
+    gu::Atomic<long> cnt(0);
+    gu::ThreadPool   pool(4, 16);
+
+    fail_if(pool.size() != 4);
+
+    std::vector<TestJob*> jobs;
+    for (int i(0); i < 64; ++i) jobs.push_back(new TestJob(cnt, 1000));
+
+    // more jobs than queue can hold: some will be run by this thread
+    for (size_t i(0); i < jobs.size(); ++i) pool.submit(*jobs[i]);
+
+    for (size_t i(0); i < jobs.size(); ++i)
+    {
+        pool.wait(*jobs[i]);
+        fail_if(jobs[i]->runs() != 1, "job %zu ran %d times", i,
+                jobs[i]->runs());
+    }
+
+    fail_if(cnt() != long(jobs.size()));
+
+    // wait() on a completed job returns right away
+    pool.wait(*jobs[0]);
+    fail_if(jobs[0]->runs() != 1);
+
+    // jobs can be resubmitted
+    pool.submit(*jobs[0]);
+    pool.wait(*jobs[0]);
+    fail_if(jobs[0]->runs() != 2);
+
+    for (size_t i(0); i < jobs.size(); ++i) delete jobs[i];
+}
+END_TEST
+
+START_TEST(test_thread_pool_no_threads)
+{
+    gu::Atomic<long> cnt(0);
+    gu::ThreadPool   pool(0, 16);
+    TestJob          job(cnt);
+
+    pool.submit(job);
+    fail_if(job.runs() != 1); // must run in the caller thread
+    fail_if(!pthread_equal(job.thread(), pthread_self()));
+    pool.wait(job);
+    fail_if(job.runs() != 1);
+}
+END_TEST
+
+START_TEST(test_thread_pool_exception)
+{
+    gu::Atomic<long> cnt(0);
+    gu::ThreadPool   pool(2, 4);
+    TestJob          bad(cnt, 0, true);
+    TestJob          good(cnt);
+
+    pool.submit(bad);
+    pool.submit(good);
+    pool.wait(bad);
+    pool.wait(good);
+
+    fail_if(bad.runs() != 1 || good.runs() != 1);
+}
+END_TEST
+
+START_TEST(test_thread_pool_destroy)
+{
+    gu::Atomic<long> cnt(0);
+    std::vector<TestJob*> jobs;
+    for (int i(0); i < 8; ++i) jobs.push_back(new TestJob(cnt, 1000));
+
+    {
+        gu::ThreadPool pool(1, 8);
+        for (size_t i(0); i < jobs.size(); ++i) pool.submit(*jobs[i]);
+        // destructor must complete all queued jobs
+    }
+
+    fail_if(cnt() != long(jobs.size()));
+
+    for (size_t i(0); i < jobs.size(); ++i) delete jobs[i];
+}
+END_TEST
+
+Suite* gu_thread_pool_suite()
+{
+    Suite* s = suite_create ("gu::ThreadPool");
+    TCase* t;
+
+    t = tcase_create ("test_thread_pool_basic");
+    tcase_add_test (t, test_thread_pool_basic);
+    suite_add_tcase (s, t);
+
+    t = tcase_create ("test_thread_pool_no_threads");
+    tcase_add_test (t, test_thread_pool_no_threads);
+    suite_add_tcase (s, t);
+
+    t = tcase_create ("test_thread_pool_exception");
+    tcase_add_test (t, test_thread_pool_exception);
+    suite_add_tcase (s, t);
+
+    t = tcase_create ("test_thread_pool_destroy");
+    tcase_add_test (t, test_thread_pool_destroy);
+    suite_add_tcase (s, t);
+
+    return s;
+}
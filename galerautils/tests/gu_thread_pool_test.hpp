@@ -0,0 +1,12 @@
+/*
+ * Copyright (C) 2014 Codership Oy <info@codership.com>
+ */
+
+#ifndef __gu_thread_pool_test__
+#define __gu_thread_pool_test__
+
+#include <check.h>
+
+extern Suite *gu_thread_pool_suite(void);
+
+#endif // __gu_thread_pool_test__
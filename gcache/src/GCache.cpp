@@ -6,6 +6,7 @@
 #include "gcache_bh.hpp"
 
 #include <gu_logger.hpp>
+#include <gu_utils.hpp>
 
 #include <cerrno>
 #include <unistd.h>
@@ -15,6 +16,11 @@ namespace gcache
     void
     GCache::reset()
     {
+        discard_page_history();
+
+        compress_next = SEQNO_NONE;
+        compress_gen++;
+
         mem.reset();
         rb.reset();
         ps.reset();
@@ -28,6 +34,12 @@ namespace gcache
 
         seqno2ptr.clear();
 
+        {
+            /* queued buffers are gone with the stores */
+            gu::Lock lock(free_mtx);
+            free_queue.clear();
+        }
+
 #ifndef NDEBUG
         buf_tracker.clear();
 #endif
@@ -42,35 +54,96 @@ namespace gcache
         params    (config, data_dir),
         mtx       (),
         cond      (),
+        free_mtx  (),
+        free_queue(),
+        free_batch(),
         seqno2ptr (),
         mem       (params.mem_size(), seqno2ptr),
-        rb        (params.rb_name(), params.rb_size(), seqno2ptr),
+        rb        (params.rb_name(), params.rb_size(), seqno2ptr,
+                   params.recover(), params.huge_pages(), params.numa_node()),
         ps        (params.dir_name(),
                    params.keep_pages_size(),
                    params.page_size(),
                    /* keep last page if PS is the only storage */
-                   !((params.mem_size() + params.rb_size()) > 0)),
+                   !((params.mem_size() + params.rb_size()) > 0),
+                   params.prealloc_pages()),
         mallocs   (0),
         reallocs  (0),
         frees     (0),
         seqno_locked(SEQNO_NONE),
         seqno_max   (SEQNO_NONE),
-        seqno_released(0)
+        seqno_released(0),
+        compress_cond(),
+        compress_thr(),
+        compress_running(false),
+        compress_closing(false),
+        compress_next(SEQNO_NONE),
+        compress_gen(0),
+        compress_count(0),
+        compress_raw(0),
+        compress_size(0)
 #ifndef NDEBUG
         ,buf_tracker()
 #endif
     {
         constructor_common ();
+
+        free_queue.reserve(FREE_BATCH);
+        free_batch.reserve(FREE_BATCH);
+
+        if (!seqno2ptr.empty()) /* history was recovered */
+        {
+            seqno_max      = seqno2ptr.index_back();
+            seqno_released = seqno_max;
+        }
+
+        if (params.compress_history()) compress_start();
     }
 
     GCache::~GCache ()
     {
+        compress_stop();
+
         gu::Lock lock(mtx);
+        free_queued();
+        /* to let page store remove the files */
+        discard_page_history();
         log_debug << "\n" << "GCache mallocs : " << mallocs
                   << "\n" << "GCache reallocs: " << reallocs
                   << "\n" << "GCache frees   : " << frees;
     }
 
+    void
+    GCache::get_status (gu::Status& status) const
+    {
+        size_t page_size, huge_size;
+        rb.page_usage(page_size, huge_size);
+
+        status.insert("gcache_rb_page_size", gu::to_string(page_size));
+        status.insert("gcache_rb_huge_bytes", gu::to_string(huge_size));
+
+        /* page store keeps its stats under its own lock */
+        PageStore::Stats s;
+        ps.stats(s);
+
+        status.insert("gcache_pages_created",  gu::to_string(s.created));
+        status.insert("gcache_pages_recycled", gu::to_string(s.recycled));
+        status.insert("gcache_page_stalls",    gu::to_string(s.stalls));
+        status.insert("gcache_page_stall_max_usec",
+                      gu::to_string(s.stall_usec_max));
+        status.insert("gcache_page_create_avg_usec",
+                      gu::to_string(s.create_usec_avg));
+
+        gu::Lock lock(mtx);
+
+        status.insert("gcache_history_compressed",
+                      gu::to_string(compress_count));
+        status.insert("gcache_history_compress_ratio", /* raw/compressed */
+                      gu::to_string(compress_size > 0 ?
+                                    double(compress_raw) / compress_size :
+                                    0.0));
+    }
+
     /*! prints object properties */
     void print (std::ostream& os) {}
 }
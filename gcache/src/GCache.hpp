@@ -12,14 +12,17 @@
 #include <gu_types.hpp>
 #include <gu_lock.hpp> // for gu::Mutex and gu::Cond
 #include <gu_config.hpp>
+#include <gu_status.hpp>
 
 #include <string>
 #include <iostream>
-#include <map>
+#include <vector>
 #ifndef NDEBUG
 #include <set>
 #endif
+#include <pthread.h>
 #include <stdint.h>
+#include <sys/types.h> // off_t
 
 namespace gcache
 {
@@ -57,8 +60,22 @@ namespace gcache
         /*!
          * Reinitialize seqno sequence (after SST or such)
          * Clears seqno->ptr map // and sets seqno_min to seqno.
+         * History is considered to belong to group gid from now on.
          */
-        void  seqno_reset (/*int64_t seqno*/);
+        void  seqno_reset (const gu_uuid_t& gid);
+
+        /*!
+         * UUID of the group history in cache belongs to. It is stored in
+         * the ring buffer file and is recovered with the history.
+         */
+        const gu_uuid_t& gid() const { return rb.gid(); }
+
+        /*!
+         * @return true if history in cache (e.g. recovered on startup)
+         *         belongs to group gid and ends exactly with seqno, so that
+         *         it can continue from there.
+         */
+        bool  history_matches (const gu_uuid_t& gid, int64_t seqno) const;
 
         /*!
          * Assign sequence number to buffer pointed to by ptr
@@ -79,7 +96,7 @@ namespace gcache
         {
             gu::Lock lock(mtx);
             if (gu_likely(!seqno2ptr.empty()))
-                return seqno2ptr.begin()->first;
+                return seqno2ptr.index_begin();
             else
                 return -1;
         }
@@ -92,25 +109,30 @@ namespace gcache
 
         /*!          DEPRECATED
          * Get pointer to buffer identified by seqno.
-         * Moves lock to the given seqno.
+         * Moves lock to the given seqno. Compressed history is decompressed
+         * into inflated, the pointer stays valid until it is modified.
          * @throws NotFound
          */
         const void* seqno_get_ptr (int64_t  seqno_g,
                                    int64_t& seqno_d,
-                                   ssize_t& size);
+                                   ssize_t& size,
+                                   std::vector<gu::byte_t>& inflated);
 
         class Buffer
         {
         public:
 
-            Buffer() : seqno_g_(), seqno_d_(), ptr_(), size_() { }
+            Buffer() : seqno_g_(), seqno_d_(), ptr_(), size_(), fd_(-1),
+                       offset_() { }
 
             Buffer (const Buffer& other)
                 :
                 seqno_g_(other.seqno_g_),
                 seqno_d_(other.seqno_d_),
                 ptr_    (other.ptr_),
-                size_   (other.size_)
+                size_   (other.size_),
+                fd_     (other.fd_),
+                offset_ (other.offset_)
             { }
 
             Buffer& operator= (const Buffer& other)
@@ -119,6 +141,8 @@ namespace gcache
                 seqno_d_ = other.seqno_d_;
                 ptr_     = other.ptr_;
                 size_    = other.size_;
+                fd_      = other.fd_;
+                offset_  = other.offset_;
                 return *this;
             }
 
@@ -127,6 +151,13 @@ namespace gcache
             const gu::byte_t* ptr()     const { return ptr_;     }
             ssize_type        size()    const { return size_;    }
 
+            /*! descriptor of the file the buffer is mapped from
+             *  or -1 if the buffer is allocated in memory */
+            int               fd()      const { return fd_;      }
+
+            /*! offset of ptr() in the file, valid if fd() >= 0 */
+            off_t             offset()  const { return offset_;  }
+
         protected:
 
             void set_ptr   (const void* p)
@@ -140,12 +171,19 @@ namespace gcache
                 seqno_g_ = g; seqno_d_ = d; size_ = s;
             }
 
+            void set_file  (int fd, off_t offset)
+            {
+                fd_ = fd; offset_ = offset;
+            }
+
         private:
 
             int64_t           seqno_g_;
             int64_t           seqno_d_;
             const gu::byte_t* ptr_;
             ssize_type        size_; /* same type as passed to malloc() */
+            int               fd_;
+            off_t             offset_;
 
             friend class GCache;
         };
@@ -153,11 +191,27 @@ namespace gcache
         /*!
          * Fills a vector with Buffer objects starting with seqno start
          * until either vector length or seqno map is exhausted.
-         * Moves seqno lock to start.
+         * Moves seqno lock to start. Compressed history is decompressed
+         * into inflated, which is owned by the caller, so concurrent
+         * readers must each pass their own.
          *
+         * @param readahead history is being read sequentially: advise the
+         *                  kernel to read in the returned buffers and as
+         *                  many following ones before they are accessed
          * @retval number of buffers filled (<= v.size())
          */
-        size_t seqno_get_buffers (std::vector<Buffer>& v, int64_t start);
+        size_t seqno_get_buffers (std::vector<Buffer>&     v,
+                                  std::vector<gu::byte_t>& inflated,
+                                  int64_t                  start,
+                                  bool                     readahead = false);
+
+        /*!
+         * Hints that the first n buffers filled by seqno_get_buffers() are
+         * not going to be read again, so that their pages in page store
+         * files can be dropped from memory and filesystem cache.
+         * Must be called before seqno lock is moved past these buffers.
+         */
+        void seqno_drop_buffers (const std::vector<Buffer>& v, size_t n) const;
 
         /*!
          * Releases any seqno locks present.
@@ -167,6 +221,20 @@ namespace gcache
         /*! @throws NotFound */
         void param_set (const std::string& key, const std::string& val);
 
+        /*! ring buffer memory and page file creation statistics */
+        void get_status (gu::Status& status) const;
+
+        /*!
+         * Background history compression loop, runs in its own thread if
+         * gcache.compress_history is set. Released buffers about to be
+         * evicted from the ring buffer and ones released in page store are
+         * replaced with compressed copies in page store, which are kept
+         * within gcache.keep_pages_size. Since page store is trimmed in
+         * whole pages, nothing is compressed while gcache.keep_pages_size
+         * is less than gcache.page_size (e.g. the default 0).
+         */
+        void compress_history ();
+
         static size_t const PREAMBLE_LEN;
 
     private:
@@ -175,6 +243,9 @@ namespace gcache
 
         void free_common (BufferHeader*);
 
+        /* applies queued frees, must be called with mtx locked */
+        void free_queued ();
+
         gu::Config&     config;
 
         class Params
@@ -192,10 +263,17 @@ namespace gcache
             size_t rb_size()             const { return rb_size_;         }
             size_t page_size()           const { return page_size_;       }
             size_t keep_pages_size()     const { return keep_pages_size_; }
+            bool   recover()             const { return recover_;         }
+            size_t prealloc_pages()      const { return prealloc_pages_;  }
+            RingBuffer::HugePages huge_pages() const { return huge_pages_; }
+            int    numa_node()           const { return numa_node_;       }
+            bool   compress_history()    const { return compress_history_;}
+            int    compress_level()      const { return compress_level_;  }
 
             void mem_size        (size_t s) { mem_size_        = s; }
             void page_size       (size_t s) { page_size_       = s; }
             void keep_pages_size (size_t s) { keep_pages_size_ = s; }
+            void prealloc_pages  (size_t n) { prealloc_pages_  = n; }
 
         private:
 
@@ -205,15 +283,27 @@ namespace gcache
             size_t      const rb_size_;
             size_t            page_size_;
             size_t            keep_pages_size_;
+            bool        const recover_;
+            size_t            prealloc_pages_;
+            RingBuffer::HugePages const huge_pages_;
+            int         const numa_node_;
+            bool        const compress_history_;
+            int         const compress_level_;
         }
             params;
 
         gu::Mutex       mtx;
         gu::Cond        cond;
 
-        typedef std::map<int64_t, const void*>  seqno2ptr_t;
-        typedef seqno2ptr_t::iterator           seqno2ptr_iter_t;
-        typedef std::pair<int64_t, const void*> seqno2ptr_pair_t;
+        /* free() only queues the buffer under free_mtx, the queue is applied
+         * under mtx by the next allocation or seqno operation, or by free()
+         * itself once FREE_BATCH buffers are queued */
+        static size_t const FREE_BATCH = 64;
+
+        gu::Mutex                   free_mtx;
+        std::vector<BufferHeader*>  free_queue; // protected by free_mtx
+        std::vector<BufferHeader*>  free_batch; // protected by mtx
+
         seqno2ptr_t     seqno2ptr;
 
         MemStore        mem;
@@ -228,6 +318,18 @@ namespace gcache
         int64_t         seqno_max;
         int64_t         seqno_released;
 
+        /* history compression state, protected by mtx */
+        struct Compressed;
+
+        gu::Cond        compress_cond;
+        pthread_t       compress_thr;
+        bool            compress_running;
+        bool            compress_closing;
+        int64_t         compress_next; // next seqno to consider
+        long            compress_gen;  // changes when history is reset
+        long long       compress_count;
+        long long       compress_raw;  // bytes before compression
+        long long       compress_size; // bytes after compression
 
 #ifndef NDEBUG
         std::set<const void*> buf_tracker;
@@ -238,6 +340,29 @@ namespace gcache
         /* returns true when successfully discards all seqnos up to s */
         bool discard_seqno (int64_t s);
 
+        void compress_start ();
+        void compress_stop  ();
+
+        /* picks released history to compress, returns false if none */
+        bool compress_collect (std::vector<Compressed>& batch,
+                               std::vector<gu::byte_t>& raw);
+
+        /* replaces picked buffers with their copies in page store */
+        void compress_install (const std::vector<Compressed>& batch,
+                               const std::vector<gu::byte_t>& raw,
+                               const std::vector<gu::byte_t>& z);
+
+        /* discards compressed history exceeding keep_pages_size */
+        void compress_trim ();
+
+        /* discards all history kept in page store, before reset */
+        void discard_page_history ();
+
+        /* decompresses compressed ones of the first n buffers in v
+         * into buf, which they point to afterwards */
+        static void inflate (std::vector<Buffer>& v, size_t n,
+                             std::vector<gu::byte_t>& buf);
+
         // disable copying
         GCache (const GCache&);
         GCache& operator = (const GCache&);
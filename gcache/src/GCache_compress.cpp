@@ -0,0 +1,368 @@
+/*
+ * Copyright (C) 2015 Codership Oy <info@codership.com>
+ */
+
+/*! @file background compression of history kept in page store */
+
+#include "GCache.hpp"
+#include "gcache_bh.hpp"
+
+#include <gu_lz.h>
+#include <gu_logger.hpp>
+#include <gu_throw.hpp>
+
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+    /* limits for how long mtx is held while history is copied out */
+    static size_t const COMPRESS_BATCH_BYTES = (1 << 20);
+
+    /* ring buffer history is compressed only when ring buffer free space
+     * drops below 1/COMPRESS_RB_FREE of its size: recent history stays
+     * uncompressed, while the rest of free space is the margin for the
+     * compression to keep ahead of ring buffer reuse */
+    static size_t const COMPRESS_RB_FREE = 2;
+}
+
+extern "C" void*
+run_compress_history (void* arg)
+{
+    static_cast<gcache::GCache*>(arg)->compress_history();
+    return NULL;
+}
+
+namespace gcache
+{
+    struct GCache::Compressed
+    {
+        int64_t     seqno;
+        const void* ptr;
+        size_t      raw_off;
+        size_t      raw_len;
+        size_t      z_off;
+        size_t      z_len;  /* 0 if not worth compressing */
+    };
+
+    void
+    GCache::compress_start ()
+    {
+        if (params.compress_level() < GU_LZ_LEVEL_MIN ||
+            params.compress_level() > GU_LZ_LEVEL_MAX)
+        {
+            gu_throw_error(EINVAL) << "Invalid history compression level: "
+                                   << params.compress_level() << ", must be "
+                                   << GU_LZ_LEVEL_MIN << '-' << GU_LZ_LEVEL_MAX;
+        }
+
+        int const err(pthread_create (&compress_thr, NULL,
+                                      run_compress_history, this));
+        if (0 != err)
+        {
+            gu_throw_error(err) << "Failed to start history compression thread";
+        }
+
+        compress_running = true;
+
+        if (params.keep_pages_size() < params.page_size())
+        {
+            log_warn << "History compression is idle while gcache."
+                     << "keep_pages_size (" << params.keep_pages_size()
+                     << ") is less than gcache.page_size ("
+                     << params.page_size() << ')';
+        }
+    }
+
+    void
+    GCache::compress_stop ()
+    {
+        if (!compress_running) return;
+
+        {
+            gu::Lock lock(mtx);
+            compress_closing = true;
+            compress_cond.signal();
+        }
+
+        pthread_join (compress_thr, NULL);
+        compress_running = false;
+    }
+
+    void
+    GCache::compress_history ()
+    {
+        std::vector<Compressed> batch;
+        std::vector<gu::byte_t> raw;
+        std::vector<gu::byte_t> z;
+        std::vector<gu::byte_t> work(gu_lz_work_size());
+        int const level(params.compress_level());
+
+        for (;;)
+        {
+            long gen;
+
+            {
+                gu::Lock lock(mtx);
+
+                while (!compress_closing && !compress_collect(batch, raw))
+                {
+                    lock.wait(compress_cond);
+                }
+
+                if (compress_closing) break;
+
+                gen = compress_gen;
+            }
+
+            size_t z_total(0);
+            for (size_t i(0); i < batch.size(); ++i)
+            {
+                z_total += gu_lz_bound(batch[i].raw_len);
+            }
+
+            z.resize(z_total);
+
+            size_t z_off(0);
+            for (size_t i(0); i < batch.size(); ++i)
+            {
+                Compressed&  c(batch[i]);
+                size_t const bound(gu_lz_bound(c.raw_len));
+                size_t const len(gu_lz_compress(&raw[c.raw_off], c.raw_len,
+                                                &z[z_off], bound, level,
+                                                &work[0]));
+                c.z_off = z_off;
+                c.z_len = (len > 0 && len + sizeof(uint64_t) < c.raw_len) ?
+                    len : 0;
+                z_off += bound;
+            }
+
+            gu::Lock lock(mtx);
+
+            if (gen == compress_gen) compress_install(batch, raw, z);
+        }
+    }
+
+    bool
+    GCache::compress_collect (std::vector<Compressed>& batch,
+                              std::vector<gu::byte_t>& raw)
+    {
+        batch.clear();
+        raw.clear();
+
+        if (seqno2ptr.empty()) return false;
+
+        /* compressed history is trimmed in whole pages, so with less than
+         * a page to keep compress_trim() would discard it right away, and
+         * history moved out of ring buffer would be lost earlier than if
+         * it stayed there */
+        if (params.keep_pages_size() < params.page_size()) return false;
+
+        /* locked history is being read, leave it as it is */
+        int64_t end(seqno2ptr.index_end());
+        if (seqno_locked != SEQNO_NONE && seqno_locked < end)
+        {
+            end = seqno_locked;
+        }
+
+        /* ring buffer free space once the batch is moved out of it */
+        size_t rb_free(rb.size_free());
+
+        int64_t s(std::max(compress_next, seqno2ptr.index_begin()));
+
+        for (; s < end && raw.size() < COMPRESS_BATCH_BYTES; ++s)
+        {
+            const void* const ptr(seqno2ptr.find(s));
+
+            if (0 == ptr) continue;
+
+            const BufferHeader* const bh(ptr2BH(ptr));
+
+            if (!BH_is_released(bh)) break;
+
+            if ((bh->flags & BUFFER_COMPRESSED) || BUFFER_IN_MEM == bh->store)
+            {
+                continue;
+            }
+
+            if (BUFFER_IN_RB == bh->store)
+            {
+                if (rb_free >= rb.size() / COMPRESS_RB_FREE) break;
+
+                rb_free += bh->size;
+            }
+
+            Compressed const c =
+                { s, ptr, raw.size(), size_t(bh->size - sizeof(BufferHeader)),
+                  0, 0 };
+
+            const gu::byte_t* const data(static_cast<const gu::byte_t*>(ptr));
+            raw.insert(raw.end(), data, data + c.raw_len);
+            batch.push_back(c);
+        }
+
+        compress_next = s;
+
+        return !batch.empty();
+    }
+
+    void
+    GCache::compress_install (const std::vector<Compressed>& batch,
+                              const std::vector<gu::byte_t>& raw,
+                              const std::vector<gu::byte_t>& z)
+    {
+        for (size_t i(0); i < batch.size(); ++i)
+        {
+            const Compressed& c(batch[i]);
+
+            /* could have been discarded meanwhile */
+            if (seqno2ptr.find(c.seqno) != c.ptr) continue;
+
+            /* or locked for reading, then it will be retried later */
+            if (seqno_locked != SEQNO_NONE && c.seqno >= seqno_locked)
+            {
+                compress_next = std::min(compress_next, c.seqno);
+                continue;
+            }
+
+            BufferHeader* const old(ptr2BH(c.ptr));
+
+            /* not compressible, no point in moving it within page store */
+            if (0 == c.z_len && BUFFER_IN_PAGE == old->store) continue;
+
+            uint64_t const  raw_len(c.raw_len);
+            size_type const size(sizeof(BufferHeader) +
+                                 (c.z_len > 0 ? sizeof(raw_len) + c.z_len :
+                                  c.raw_len));
+
+            gu::byte_t* const ptr(static_cast<gu::byte_t*>(ps.malloc(size)));
+
+            if (gu_unlikely(0 == ptr))
+            {
+                /* page store has logged the reason, will be retried */
+                compress_next = std::min(compress_next, c.seqno);
+                break;
+            }
+
+            BufferHeader* const bh(ptr2BH(ptr));
+
+            bh->seqno_g = c.seqno;
+            bh->seqno_d = old->seqno_d;
+            bh->flags  |= BUFFER_RELEASED;
+
+            if (c.z_len > 0)
+            {
+                bh->flags |= BUFFER_COMPRESSED;
+                memcpy (ptr, &raw_len, sizeof(raw_len));
+                memcpy (ptr + sizeof(raw_len), &z[c.z_off], c.z_len);
+
+                compress_count++;
+                compress_raw  += c.raw_len;
+                compress_size += size - sizeof(BufferHeader);
+            }
+            else
+            {
+                memcpy (ptr, &raw[c.raw_off], c.raw_len);
+            }
+
+            seqno2ptr.replace(c.seqno, ptr);
+
+            old->seqno_g = SEQNO_ILL;
+
+            if (BUFFER_IN_RB == old->store)
+                rb.discard (old);
+            else
+                ps.discard (old);
+        }
+
+        compress_trim();
+    }
+
+    void
+    GCache::compress_trim ()
+    {
+        while (ps.total_size() > params.keep_pages_size() &&
+               !seqno2ptr.empty())
+        {
+            int64_t const             s(seqno2ptr.index_begin());
+            const BufferHeader* const bh(ptr2BH(seqno2ptr.front()));
+
+            if ((seqno_locked != SEQNO_NONE && s >= seqno_locked) ||
+                BUFFER_IN_PAGE != bh->store || !BH_is_released(bh)) break;
+
+            discard_seqno (s);
+        }
+    }
+
+    void
+    GCache::discard_page_history ()
+    {
+        if (seqno2ptr.empty()) return;
+
+        for (int64_t s(seqno2ptr.index_begin()); s < seqno2ptr.index_end();
+             ++s)
+        {
+            const void* const ptr(seqno2ptr.find(s));
+
+            if (0 == ptr) continue;
+
+            BufferHeader* const bh(ptr2BH(ptr));
+
+            if (BUFFER_IN_PAGE == bh->store && BH_is_released(bh))
+            {
+                bh->seqno_g = SEQNO_ILL;
+                ps.discard (bh);
+            }
+        }
+    }
+
+    void
+    GCache::inflate (std::vector<Buffer>& v, size_t const n,
+                     std::vector<gu::byte_t>& buf)
+    {
+        size_t total(0);
+
+        for (size_t i(0); i < n; ++i)
+        {
+            if (ptr2BH(v[i].ptr())->flags & BUFFER_COMPRESSED)
+            {
+                uint64_t raw_len;
+                memcpy (&raw_len, v[i].ptr(), sizeof(raw_len));
+                total += raw_len;
+            }
+        }
+
+        if (0 == total) return;
+
+        buf.resize(total);
+
+        size_t off(0);
+
+        for (size_t i(0); i < n; ++i)
+        {
+            const BufferHeader* const bh(ptr2BH(v[i].ptr()));
+
+            if (!(bh->flags & BUFFER_COMPRESSED)) continue;
+
+            uint64_t raw_len;
+            memcpy (&raw_len, v[i].ptr(), sizeof(raw_len));
+
+            size_t const  z_len(bh->size - sizeof(BufferHeader) -
+                                sizeof(raw_len));
+            ssize_t const ret(gu_lz_decompress(v[i].ptr() + sizeof(raw_len),
+                                               z_len, &buf[off],
+                                               raw_len));
+            if (gu_unlikely(ret != ssize_t(raw_len)))
+            {
+                gu_throw_fatal << "Corrupt compressed history buffer, seqno "
+                               << bh->seqno_g;
+            }
+
+            v[i].set_ptr   (&buf[off]);
+            v[i].set_other (bh->seqno_g, bh->seqno_d, raw_len);
+            v[i].set_file  (-1, 0);
+
+            off += raw_len;
+        }
+    }
+}
@@ -11,18 +11,17 @@ namespace gcache
     bool
     GCache::discard_seqno (int64_t seqno)
     {
-        for (seqno2ptr_t::iterator i = seqno2ptr.begin();
-             i != seqno2ptr.end() && i->first <= seqno;)
+        while (!seqno2ptr.empty() && seqno2ptr.index_begin() <= seqno)
         {
-            BufferHeader* bh(ptr2BH (i->second));
+            BufferHeader* bh(ptr2BH (seqno2ptr.front()));
 
             if (gu_likely(BH_is_released(bh)))
             {
-                assert (bh->seqno_g == i->first);
+                assert (bh->seqno_g == seqno2ptr.index_begin());
                 assert (bh->seqno_g <= seqno);
                 assert (bh->seqno_g <= seqno_released);
 
-                seqno2ptr.erase (i++); // post ++ is significant!
+                seqno2ptr.pop_front();
 
                 bh->seqno_g = SEQNO_ILL; // will never be reused
 
@@ -58,6 +57,8 @@ namespace gcache
 
             gu::Lock lock(mtx);
 
+            free_queued();
+
             mallocs++;
 
             ptr = mem.malloc(size);
@@ -113,28 +114,73 @@ namespace gcache
         case BUFFER_IN_PAGE:
             if (gu_likely(bh->seqno_g > 0))
             {
-                discard_seqno (bh->seqno_g);
-            }
-            else
-            {
-                assert(bh->seqno_g != SEQNO_ILL);
-                bh->seqno_g = SEQNO_ILL;
-                ps.discard (bh);
+                if (!compress_running)
+                {
+                    discard_seqno (bh->seqno_g);
+                    break;
+                }
+
+                if (seqno2ptr.find(bh->seqno_g) == bh + 1)
+                {
+                    /* stays in history to be compressed */
+                    compress_cond.signal();
+                    break;
+                }
             }
+
+            assert(bh->seqno_g != SEQNO_ILL);
+            bh->seqno_g = SEQNO_ILL;
+            ps.discard (bh);
             break;
         }
         rb.assert_size_free();
     }
 
+    void
+    GCache::free_queued ()
+    {
+        {
+            gu::Lock lock(free_mtx);
+
+            if (gu_likely(free_queue.empty())) return;
+
+            free_queue.swap(free_batch);
+        }
+
+        /* order of frees is preserved, as free_common() checks it for
+         * seqno'd buffers */
+        for (size_t i(0); i < free_batch.size(); ++i)
+        {
+            free_common (free_batch[i]);
+        }
+
+        free_batch.clear();
+
+        /* there may be new history to compress */
+        if (compress_running) compress_cond.signal();
+    }
+
     void
     GCache::free (void* ptr)
     {
         if (gu_likely(0 != ptr))
         {
             BufferHeader* const bh(ptr2BH(ptr));
-            gu::Lock      lock(mtx);
+            bool                apply;
 
-            free_common (bh);
+            {
+                gu::Lock lock(free_mtx);
+
+                free_queue.push_back(bh);
+                apply = (free_queue.size() >= FREE_BATCH);
+            }
+
+            if (gu_unlikely(apply))
+            {
+                gu::Lock lock(mtx);
+
+                free_queued();
+            }
         }
         else {
             log_warn << "Attempt to free a null pointer";
@@ -171,6 +217,8 @@ namespace gcache
 
         gu::Lock      lock(mtx);
 
+        free_queued();
+
         reallocs++;
 
         MemOps* store(0);
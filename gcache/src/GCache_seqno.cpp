@@ -6,10 +6,64 @@
 #include "gcache_bh.hpp"
 #include "GCache.hpp"
 
+#include <gu_limits.h> // gu_page_size()
+
 #include <cerrno>
 #include <cassert>
 
 #include <sched.h> // sched_yeild()
+#include <sys/mman.h>
+
+// for posix_fadvise()
+#if !defined(_XOPEN_SOURCE)
+#define _XOPEN_SOURCE 600
+#endif
+#include <fcntl.h>
+
+namespace
+{
+    /* buffers further apart than that are advised as separate ranges */
+    static size_t const READAHEAD_MAX_GAP = (1 << 20);
+
+    /* advises the kernel to read in [start, end) */
+    static void
+    will_need (const gu::byte_t* start, const gu::byte_t* const end)
+    {
+        size_t const page_mask(gu_page_size() - 1);
+
+        start = reinterpret_cast<const gu::byte_t*>(
+            reinterpret_cast<uintptr_t>(start) & ~page_mask);
+
+        /* this is only a hint, so errors are ignored */
+        (void)posix_madvise (const_cast<gu::byte_t*>(start), end - start,
+                             POSIX_MADV_WILLNEED);
+    }
+
+    /* drops pages fully contained in file range [start, end) mapped at ptr
+     * from the process memory and filesystem cache */
+    static void
+    dont_need (int const fd, off_t start, off_t end,
+               const gu::byte_t* const ptr)
+    {
+        off_t const page_mask(gu_page_size() - 1);
+        off_t const offset(start);
+
+        start = (start + page_mask) & ~page_mask;
+        end   = end & ~page_mask;
+
+        if (start >= end) return;
+
+#if defined(__linux__)
+        /* posix_madvise(POSIX_MADV_DONTNEED) is a no-op in glibc, while
+         * MADV_DONTNEED on a shared file mapping keeps dirty data */
+        (void)madvise (const_cast<gu::byte_t*>(ptr) + (start - offset),
+                       end - start, MADV_DONTNEED);
+#endif
+#if !defined(__APPLE__) /* Darwin does not have posix_fadvise */
+        (void)posix_fadvise (fd, start, end - start, POSIX_FADV_DONTNEED);
+#endif
+    }
+}
 
 namespace gcache
 {
@@ -18,10 +72,14 @@ namespace gcache
      * Clears seqno->ptr map // and sets seqno_min to seqno.
      */
     void
-    GCache::seqno_reset ()
+    GCache::seqno_reset (const gu_uuid_t& gid)
     {
         gu::Lock lock(mtx);
 
+        free_queued();
+
+        rb.set_gid(gid);
+
         seqno_released = SEQNO_NONE;
 
         if (gu_unlikely(seqno2ptr.empty())) return;
@@ -29,8 +87,21 @@ namespace gcache
         /* order is significant here */
         rb.seqno_reset();
         mem.seqno_reset();
+        discard_page_history();
 
         seqno2ptr.clear();
+
+        compress_next = SEQNO_NONE;
+        compress_gen++;
+    }
+
+    bool
+    GCache::history_matches (const gu_uuid_t& gid, int64_t const seqno) const
+    {
+        gu::Lock lock(mtx);
+
+        return (!seqno2ptr.empty() && seqno2ptr.index_back() == seqno &&
+                gu_uuid_compare(&gid, &rb.gid()) == 0);
     }
 
     /*!
@@ -51,20 +122,17 @@ namespace gcache
 
         if (gu_likely(seqno_g > seqno_max))
         {
-            seqno2ptr.insert (seqno2ptr.end(), seqno2ptr_pair_t(seqno_g, ptr));
+            seqno2ptr.insert (seqno_g, ptr);
             seqno_max = seqno_g;
         }
         else
         {
             // this should never happen. seqnos should be assinged in TO.
-            const std::pair<seqno2ptr_iter_t, bool>& res(
-                seqno2ptr.insert (seqno2ptr_pair_t(seqno_g, ptr)));
-
-            if (false == res.second)
+            if (false == seqno2ptr.insert (seqno_g, ptr))
             {
                 gu_throw_fatal <<"Attempt to reuse the same seqno: " << seqno_g
                                <<". New ptr = " << ptr << ", previous ptr = "
-                               << res.first->second;
+                               << seqno2ptr.find(seqno_g);
             }
         }
 
@@ -97,11 +165,15 @@ namespace gcache
 
             gu::Lock lock(mtx);
 
+            /* buffers queued for free must be released before they are
+             * seen by the loop below */
+            free_queued();
+
             assert(seqno >= seqno_released);
 
-            seqno2ptr_iter_t it(seqno2ptr.upper_bound(seqno_released));
+            int64_t it(seqno2ptr.upper_bound(seqno_released));
 
-            if (gu_unlikely(it == seqno2ptr.end()))
+            if (gu_unlikely(it == seqno2ptr.index_end()))
             {
                 /* This means that there are no element with
                  * seqno following seqno_released - and this should not
@@ -122,7 +194,7 @@ namespace gcache
             batch_size += (new_gap >= old_gap) * min_batch_size;
             old_gap = new_gap;
 
-            int64_t const start(it->first - 1);
+            int64_t const start(it - 1);
             int64_t const end  (seqno - start >= 2*batch_size ?
                                 start + batch_size : seqno);
 #if 0
@@ -130,32 +202,38 @@ namespace gcache
                      << " buffers, batch_size: " << batch_size
                      << ", end: " << end;
 #endif
-            for (;(loop = (it != seqno2ptr.end())) && it->first <= end;)
+            for (;(loop = (it < seqno2ptr.index_end())) && it <= end; ++it)
             {
-                assert(it->first != SEQNO_NONE);
-                BufferHeader* const bh(ptr2BH(it->second));
-                assert (bh->seqno_g == it->first);
+                assert(it != SEQNO_NONE);
+                /* free_common() below may discard buffers preceding it,
+                 * so the index is looked up on every iteration */
+                const void* const ptr(seqno2ptr.find(it));
+
+                if (gu_unlikely(0 == ptr)) continue; /* missing seqno */
+
+                BufferHeader* const bh(ptr2BH(ptr));
+                assert (bh->seqno_g == it);
 #ifndef NDEBUG
-                if (!(seqno_released + 1 == it->first ||
+                if (!(seqno_released + 1 == it ||
                       seqno_released == SEQNO_NONE))
                 {
                     log_info << "seqno_released: " << seqno_released
-                             << "; it->first: " << it->first
-                             << "; seqno2ptr.begin: " <<seqno2ptr.begin()->first
+                             << "; it: " << it
+                             << "; seqno2ptr.begin: " << seqno2ptr.index_begin()
                              << "\nstart: " << start << "; end: " << end
                              << " batch_size: " << batch_size << "; gap: "
                              << new_gap << "; seqno_max: " << seqno_max;
-                    assert(seqno_released + 1 == it->first ||
+                    assert(seqno_released + 1 == it ||
                            seqno_released == SEQNO_NONE);
                 }
 #endif
-                ++it; /* free_common() below may erase current element,
-                       * so advance iterator before calling free_common()*/
                 if (gu_likely(!BH_is_released(bh))) free_common(bh);
             }
 
             assert (loop || seqno == seqno_released);
 
+            if (compress_running) compress_cond.signal();
+
             loop = (end < seqno) && loop;
         }
         while(loop);
@@ -169,7 +247,7 @@ namespace gcache
     {
         gu::Lock lock(mtx);
 
-        if (seqno2ptr.find(seqno_g) == seqno2ptr.end()) throw gu::NotFound();
+        if (0 == seqno2ptr.find(seqno_g)) throw gu::NotFound();
 
         if (seqno_locked != SEQNO_NONE)
         {
@@ -185,24 +263,23 @@ namespace gcache
      */
     const void* GCache::seqno_get_ptr (int64_t const seqno_g,
                                        int64_t&      seqno_d,
-                                       ssize_t&      size)
+                                       ssize_t&      size,
+                                       std::vector<gu::byte_t>& inflated)
     {
         const void* ptr(0);
 
         {
             gu::Lock lock(mtx);
 
-            seqno2ptr_iter_t p = seqno2ptr.find(seqno_g);
+            ptr = seqno2ptr.find(seqno_g);
 
-            if (p != seqno2ptr.end())
+            if (ptr != 0)
             {
                 if (seqno_locked != SEQNO_NONE)
                 {
                     cond.signal();
                 }
                 seqno_locked = seqno_g;
-
-                ptr = p->second;
             }
             else
             {
@@ -216,25 +293,37 @@ namespace gcache
         seqno_d = bh->seqno_d;
         size    = bh->size - sizeof(BufferHeader);
 
+        if (bh->flags & BUFFER_COMPRESSED)
+        {
+            std::vector<Buffer> v(1);
+            v[0].set_ptr(ptr);
+            inflate (v, 1, inflated);
+            ptr  = v[0].ptr();
+            size = v[0].size();
+        }
+
         return ptr;
     }
 
     size_t
-    GCache::seqno_get_buffers (std::vector<Buffer>& v,
-                               int64_t const start)
+    GCache::seqno_get_buffers (std::vector<Buffer>&     v,
+                               std::vector<gu::byte_t>& inflated,
+                               int64_t const            start,
+                               bool    const            readahead)
     {
         size_t const max(v.size());
 
         assert (max > 0);
 
         size_t found(0);
+        std::vector<const void*> ahead;
 
         {
             gu::Lock lock(mtx);
 
-            seqno2ptr_iter_t p = seqno2ptr.find(start);
+            const void* p(seqno2ptr.find(start));
 
-            if (p != seqno2ptr.end())
+            if (p != 0)
             {
                 if (seqno_locked != SEQNO_NONE)
                 {
@@ -244,16 +333,73 @@ namespace gcache
                 seqno_locked = start;
 
                 do {
-                    assert (p->first == int64_t(start + found));
-                    assert (p->second);
-                    v[found].set_ptr(p->second);
+                    v[found].set_ptr(p);
                 }
-                while (++found < max && ++p != seqno2ptr.end() &&
-                       p->first == int64_t(start + found));
+                while (++found < max &&
+                       (p = seqno2ptr.find(start + found)) != 0);
                 /* the latter condition ensures seqno continuty, #643 */
+
+                if (readahead)
+                {
+                    /* buffers following the ones returned are also
+                     * protected by seqno lock, so it is safe to touch
+                     * them until the lock is moved past */
+                    ahead.reserve(found + max);
+
+                    for (size_t i(0); i < found; ++i)
+                    {
+                        ahead.push_back(v[i].ptr());
+                    }
+
+                    for (int64_t s(start + found);
+                         ahead.size() < found + max &&
+                             (p = seqno2ptr.find(s)) != 0;
+                         ++s)
+                    {
+                        ahead.push_back(p);
+                    }
+                }
             }
         }
 
+        if (ahead.size() > 0)
+        {
+            /* advise headers first, so that they are read in parallel
+             * rather than one by one below */
+            for (size_t i(0); i < ahead.size(); ++i)
+            {
+                const gu::byte_t* const ptr(
+                    static_cast<const gu::byte_t*>(ahead[i]));
+
+                will_need (ptr - sizeof(BufferHeader), ptr);
+            }
+
+            /* then full buffer extents, adjacent ones in a single range */
+            const gu::byte_t* begin(0);
+            const gu::byte_t* end(0);
+
+            for (size_t i(0); i < ahead.size(); ++i)
+            {
+                const BufferHeader* const bh(ptr2BH(ahead[i]));
+                const gu::byte_t* const b_begin(
+                    reinterpret_cast<const gu::byte_t*>(bh));
+                const gu::byte_t* const b_end(b_begin + bh->size);
+
+                if (begin != 0 &&
+                    (b_begin < end || size_t(b_begin - end) > READAHEAD_MAX_GAP))
+                {
+                    will_need (begin, end);
+                    begin = 0;
+                }
+
+                if (begin == 0) begin = b_begin;
+
+                end = b_end;
+            }
+
+            will_need (begin, end);
+        }
+
         // the following may cause IO
         for (size_t i(0); i < found; ++i)
         {
@@ -265,11 +411,64 @@ namespace gcache
             v[i].set_other (bh->seqno_g,
                             bh->seqno_d,
                             bh->size - sizeof(BufferHeader));
+
+            switch (bh->store)
+            {
+            case BUFFER_IN_RB:
+                v[i].set_file (rb.fd(), rb.offset(v[i].ptr()));
+                break;
+            case BUFFER_IN_PAGE:
+            {
+                const Page* const page(static_cast<const Page*>(bh->ctx));
+                v[i].set_file (page->fd(), page->offset(v[i].ptr()));
+                break;
+            }
+            default:
+                v[i].set_file (-1, 0);
+            }
         }
 
+        inflate (v, found, inflated);
+
         return found;
     }
 
+    void
+    GCache::seqno_drop_buffers (const std::vector<Buffer>& v,
+                                size_t const n) const
+    {
+        assert (n <= v.size());
+
+        int               fd(-1);
+        off_t             begin(0);
+        off_t             end(0);
+        const gu::byte_t* ptr(0);
+
+        for (size_t i(0); i < n; ++i)
+        {
+            const Buffer& b(v[i]);
+
+            /* ring buffer is reused for new writesets, keep it cached */
+            if (b.fd() < 0 || b.fd() == rb.fd()) continue;
+
+            off_t const b_begin(b.offset() - sizeof(BufferHeader));
+            off_t const b_end  (b.offset() + b.size());
+
+            if (b.fd() != fd || b_begin != end)
+            {
+                if (fd >= 0) dont_need (fd, begin, end, ptr);
+
+                fd    = b.fd();
+                begin = b_begin;
+                ptr   = b.ptr() - sizeof(BufferHeader);
+            }
+
+            end = b_end;
+        }
+
+        if (fd >= 0) dont_need (fd, begin, end, ptr);
+    }
+
     /*!
      * Releases any history locks present.
      */
@@ -18,6 +18,9 @@
 namespace gcache
 {
     static uint32_t const BUFFER_RELEASED  = 1 << 0;
+    /* history buffer compressed by GCache: payload is uncompressed size
+     * (uint64_t) followed by gu_lz block */
+    static uint32_t const BUFFER_COMPRESSED = 1 << 1;
 
     enum StorageType
     {
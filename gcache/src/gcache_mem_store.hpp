@@ -10,18 +10,15 @@
 #include "gcache_memops.hpp"
 #include "gcache_bh.hpp"
 #include "gcache_limits.hpp"
+#include "gcache_seqno2ptr.hpp"
 
 #include <string>
 #include <set>
-#include <map>
 
 namespace gcache
 {
     class MemStore : public MemOps
     {
-        typedef std::map<int64_t, const void*> seqno2ptr_t;
-        typedef seqno2ptr_t::iterator          seqno2ptr_iter_t;
-
     public:
 
         MemStore (size_t max_size, seqno2ptr_t& seqno2ptr)
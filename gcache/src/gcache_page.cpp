@@ -15,6 +15,9 @@
 #define _XOPEN_SOURCE 600
 #endif
 #include <fcntl.h>
+#if defined(__linux__)
+#include <linux/falloc.h>
+#endif
 
 void
 gcache::Page::reset ()
@@ -28,6 +31,26 @@ gcache::Page::reset ()
 
     space_ = mmap_.size;
     next_  = static_cast<uint8_t*>(mmap_.ptr);
+    BH_clear (reinterpret_cast<BufferHeader*>(next_));
+}
+
+void
+gcache::Page::recycle ()
+{
+#if defined(FALLOC_FL_ZERO_RANGE)
+    /* Turns blocks into unwritten extents, so that they are not read back
+     * from disk on first write through the mapping. If not supported, the
+     * old contents are just overwritten. */
+    if (fallocate (fd_.get(), FALLOC_FL_ZERO_RANGE | FALLOC_FL_KEEP_SIZE,
+                   0, fd_.size()) && errno != EOPNOTSUPP)
+    {
+        int const err(errno);
+        log_warn << "Failed to zero out recycled page " << fd_.name()
+                 << ": " << err << " (" << strerror(err) << ")";
+    }
+#endif
+
+    reset();
 }
 
 void
@@ -46,9 +69,10 @@ gcache::Page::drop_fs_cache() const
 #endif
 }
 
-gcache::Page::Page (void* ps, const std::string& name, size_t size)
+gcache::Page::Page (void* ps, const std::string& name, size_t size,
+                    bool const prealloc)
     :
-    fd_   (name, size, false, false),
+    fd_   (name, size, prealloc, false),
     mmap_ (fd_),
     ps_   (ps),
     next_ (static_cast<uint8_t*>(mmap_.ptr)),
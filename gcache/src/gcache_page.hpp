@@ -21,7 +21,11 @@ namespace gcache
     {
     public:
 
-        Page (void* ps, const std::string& name, size_t size);
+        /*!
+         * @param prealloc allocate disk space for the whole file
+         */
+        Page (void* ps, const std::string& name, size_t size,
+              bool prealloc = false);
         ~Page () {}
 
         void* malloc  (size_type size);
@@ -47,8 +51,25 @@ namespace gcache
 
         const std::string& name() const { return fd_.name(); }
 
+        int   fd () const { return fd_.get(); }
+
+        /* offset of the pointer into the page file */
+        off_t offset (const void* ptr) const
+        {
+            assert (ptr >= mmap_.ptr);
+            assert (static_cast<size_t>(static_cast<const uint8_t*>(ptr) -
+                                        static_cast<uint8_t*>(mmap_.ptr))
+                    < mmap_.size);
+            return static_cast<const uint8_t*>(ptr) -
+                static_cast<const uint8_t*>(mmap_.ptr);
+        }
+
         void reset ();
 
+        /* Resets page for reuse and discards file contents, keeping disk
+         * space allocated */
+        void recycle ();
+
         /* Drop filesystem cache on the file */
         void drop_fs_cache() const;
 
@@ -10,11 +10,13 @@
 
 #include <gu_logger.hpp>
 #include <gu_throw.hpp>
+#include <gu_time.h>
 
 #include <cstdio>
 #include <cstring>
 #include <pthread.h>
 
+#include <algorithm>
 #include <iomanip>
 
 static const std::string base_name ("gcache.page.");
@@ -76,6 +78,156 @@ remove_file (void* __restrict__ arg)
     pthread_exit(NULL);
 }
 
+extern "C" void*
+run_page_creator (void* arg)
+{
+    static_cast<gcache::PageStore*>(arg)->create_pages();
+    return NULL;
+}
+
+gcache::Page*
+gcache::PageStore::create_page (const std::string& name,
+                                size_t const       size,
+                                bool const         prealloc,
+                                long long&         usec)
+{
+    long long const start(gu_time_monotonic());
+    Page* const page(new Page(this, name, size, prealloc));
+    usec = (gu_time_monotonic() - start) / 1000;
+
+    gu::Lock lock(ready_mtx_);
+    stats_.created++;
+    create_usec_total_ += usec;
+
+    return page;
+}
+
+void
+gcache::PageStore::create_pages ()
+{
+    for (;;)
+    {
+        Page*       page(0);
+        std::string name;
+        size_t      size(0);
+
+        {
+            gu::Lock lock(ready_mtx_);
+
+            while (!closing_ && recycle_.empty() &&
+                   (ready_.size() >= prealloc_ || ready_failed_))
+            {
+                lock.wait(ready_cond_);
+            }
+
+            if (closing_) break;
+
+            if (!recycle_.empty())
+            {
+                page = recycle_.front();
+                recycle_.pop_front();
+            }
+            else
+            {
+                name = make_page_name (base_name_, count_++);
+                size = ready_size_;
+            }
+        }
+
+        if (page)
+        {
+            page->recycle();
+        }
+        else
+        {
+            try
+            {
+                long long usec;
+                page = create_page (name, size, true, usec);
+            }
+            catch (gu::Exception& e)
+            {
+                log_warn << "Failed to create page file in advance: "
+                         << e.what();
+                /* will be retried when the next page is needed */
+                gu::Lock lock(ready_mtx_);
+                ready_failed_ = true;
+                continue;
+            }
+        }
+
+        gu::Lock lock(ready_mtx_);
+        ready_.push_back (page);
+    }
+}
+
+gcache::Page*
+gcache::PageStore::ready_page (size_type const size)
+{
+    gu::Lock lock(ready_mtx_);
+
+    if (0 == prealloc_ && ready_.empty()) return 0;
+
+    if (!ready_thr_running_)
+    {
+        int const err(pthread_create (&ready_thr_, NULL, run_page_creator,
+                                      this));
+        if (0 != err)
+        {
+            log_warn << "Failed to start page file creation thread: "
+                     << err << " (" << strerror(err) << ')';
+        }
+        else
+        {
+            ready_thr_running_ = true;
+        }
+    }
+
+    Page* ret(0);
+
+    if (!ready_.empty() && ready_.front()->size() + sizeof(BufferHeader)>=size)
+    {
+        ret = ready_.front();
+        ready_.pop_front();
+    }
+
+    ready_failed_ = false;
+    ready_cond_.signal();
+
+    return ret;
+}
+
+bool
+gcache::PageStore::recycle_page (Page* const page)
+{
+    gu::Lock lock(ready_mtx_);
+
+    if (closing_ || !ready_thr_running_ ||
+        ready_.size() + recycle_.size() >= 2 * prealloc_ ||
+        page->size() + sizeof(BufferHeader) != ready_size_) return false;
+
+    recycle_.push_back (page);
+    stats_.recycled++;
+    ready_cond_.signal();
+
+    return true;
+}
+
+static void
+delete_page_file (gcache::Page* const page)
+{
+    std::string const name(page->name());
+
+    delete page;
+
+    if (remove (name.c_str()))
+    {
+        int const err(errno);
+        log_error << "Failed to remove page file '" << name << "': "
+                  << err << " (" << strerror(err) << ")";
+    }
+}
+
 bool
 gcache::PageStore::delete_page ()
 {
@@ -85,12 +237,14 @@ gcache::PageStore::delete_page ()
 
     pages_.pop_front();
 
-    char* const file_name(strdup(page->name().c_str()));
-
     total_size_ -= page->size();
 
     if (current_ == page) current_ = 0;
 
+    if (recycle_page (page)) return true;
+
+    char* const file_name(strdup(page->name().c_str()));
+
     delete page;
 
 #ifdef GCACHE_DETACH_THREAD
@@ -129,20 +283,64 @@ gcache::PageStore::reset ()
 }
 
 inline void
-gcache::PageStore::new_page (size_type size)
+gcache::PageStore::new_page (size_type const size)
 {
-    Page* const page(new Page(this, make_page_name (base_name_, count_), size));
+    Page* page(ready_page (size));
+
+    if (0 == page)
+    {
+        std::string name;
+        {
+            gu::Lock lock(ready_mtx_);
+            name = make_page_name (base_name_, count_++);
+        }
+
+        long long usec;
+        page = create_page (name, std::max<size_t>(page_size_, size), false,
+                            usec);
+
+        gu::Lock lock(ready_mtx_);
+        stats_.stalls++;
+        if (usec > stats_.stall_usec_max) stats_.stall_usec_max = usec;
+    }
 
     pages_.push_back (page);
-    total_size_ += size;
+    total_size_ += page->size();
     current_ = page;
-    count_++;
+}
+
+void
+gcache::PageStore::set_page_size (size_t const size)
+{
+    page_size_ = size;
+
+    gu::Lock lock(ready_mtx_);
+    ready_size_ = size;
+}
+
+void
+gcache::PageStore::set_prealloc (size_t const n)
+{
+    gu::Lock lock(ready_mtx_);
+    prealloc_     = n;
+    ready_failed_ = false;
+    ready_cond_.signal();
+}
+
+void
+gcache::PageStore::stats (Stats& s) const
+{
+    gu::Lock lock(ready_mtx_);
+    s = stats_;
+    s.create_usec_avg = stats_.created > 0 ?
+        double(create_usec_total_) / stats_.created : 0.0;
 }
 
 gcache::PageStore::PageStore (const std::string& dir_name,
                               size_t             keep_size,
                               size_t             page_size,
-                              bool               keep_page)
+                              bool               keep_page,
+                              size_t             prealloc)
     :
     base_name_ (make_base_name(dir_name)),
     keep_size_ (keep_size),
@@ -152,10 +350,22 @@ gcache::PageStore::PageStore (const std::string& dir_name,
     pages_     (),
     current_   (0),
     total_size_(0),
-    delete_page_attr_()
+    delete_page_attr_(),
 #ifndef GCACHE_DETACH_THREAD
-    , delete_thr_(pthread_t(-1))
+    delete_thr_(pthread_t(-1)),
 #endif /* GCACHE_DETACH_THREAD */
+    ready_mtx_ (),
+    ready_cond_(),
+    ready_     (),
+    recycle_   (),
+    prealloc_  (prealloc),
+    ready_size_(page_size),
+    ready_thr_ (),
+    ready_thr_running_(false),
+    ready_failed_(false),
+    closing_   (false),
+    stats_     (),
+    create_usec_total_(0)
 {
     int err = pthread_attr_init (&delete_page_attr_);
 
@@ -179,6 +389,17 @@ gcache::PageStore::PageStore (const std::string& dir_name,
 
 gcache::PageStore::~PageStore ()
 {
+    {
+        gu::Lock lock(ready_mtx_);
+        closing_ = true;
+        ready_cond_.signal();
+    }
+
+    if (ready_thr_running_) pthread_join (ready_thr_, NULL);
+
+    for (size_t i(0); i < ready_.size();   ++i) delete_page_file(ready_[i]);
+    for (size_t i(0); i < recycle_.size(); ++i) delete_page_file(recycle_[i]);
+
     try
     {
         while (pages_.size() && delete_page()) {};
@@ -209,7 +430,7 @@ gcache::PageStore::malloc_new (size_type size)
 
     try
     {
-        new_page (page_size_ > size ? page_size_ : size);
+        new_page (size);
         ret = current_->malloc (size);
         cleanup();
     }
@@ -10,6 +10,8 @@
 #include "gcache_memops.hpp"
 #include "gcache_page.hpp"
 
+#include <gu_lock.hpp>
+
 #include <string>
 #include <deque>
 
@@ -19,10 +21,15 @@ namespace gcache
     {
     public:
 
+        /*!
+         * @param prealloc number of pages to keep created in advance by
+         *                 background thread once page store is in use
+         */
         PageStore (const std::string& dir_name,
                    size_t             keep_size,
                    size_t             page_size,
-                   bool               keep_page);
+                   bool               keep_page,
+                   size_t             prealloc = 0);
 
         ~PageStore ();
 
@@ -46,12 +53,40 @@ namespace gcache
 
         void  reset();
 
-        size_t count() const { return count_; } // for unit tests
+        size_t count() const // for unit tests
+        {
+            gu::Lock lock(ready_mtx_);
+            return count_;
+        }
+
+        size_t ready() const // for unit tests
+        {
+            gu::Lock lock(ready_mtx_);
+            return ready_.size();
+        }
 
-        void  set_page_size (size_t size) { page_size_ = size; }
+        size_t total_size() const { return total_size_; }
+
+        void  set_page_size (size_t size);
 
         void  set_keep_size (size_t size) { keep_size_ = size; }
 
+        void  set_prealloc  (size_t n);
+
+        struct Stats
+        {
+            long long created;         // page files created
+            long long recycled;        // freed pages reused for new ones
+            long long stalls;          // pages created on allocation path
+            long long stall_usec_max;  // the longest of those
+            double    create_usec_avg; // page file creation time
+        };
+
+        void  stats (Stats& s) const;
+
+        /* background page creation loop */
+        void  create_pages();
+
     private:
 
         std::string const base_name_; /* /.../.../gcache.page. */
@@ -67,8 +102,35 @@ namespace gcache
         pthread_t         delete_thr_;
 #endif /* GCACHE_DETACH_THREAD */
 
+        /* Pages created in advance or recycled, ready for use. Freed pages
+         * are recycled as long as there are less than 2*prealloc_ of them,
+         * so in steady state page files are neither created nor deleted.
+         * Everything below is protected by ready_mtx_, as well as count_. */
+        gu::Mutex         ready_mtx_;
+        gu::Cond          ready_cond_;
+        std::deque<Page*> ready_;
+        std::deque<Page*> recycle_;    /* to be cleaned by creator thread */
+        size_t            prealloc_;
+        size_t            ready_size_; /* page_size_ for creator thread */
+        pthread_t         ready_thr_;
+        bool              ready_thr_running_;
+        bool              ready_failed_; /* don't retry until needed */
+        bool              closing_;
+        Stats             stats_;
+        long long         create_usec_total_;
+
         void new_page    (size_type size);
 
+        /* takes a page from ready list if there is a fitting one */
+        Page* ready_page (size_type size);
+
+        /* puts freed page to ready list if it is still short of pages */
+        bool recycle_page (Page* page);
+
+        /* creates page file, updates stats */
+        Page* create_page (const std::string& name, size_t size,
+                           bool prealloc, long long& usec);
+
         // returns true if a page could be deleted
         bool delete_page ();
 
@@ -16,6 +16,18 @@ static const std::string GCACHE_PARAMS_PAGE_SIZE  ("gcache.page_size");
 static const std::string GCACHE_DEFAULT_PAGE_SIZE (GCACHE_DEFAULT_RB_SIZE);
 static const std::string GCACHE_PARAMS_KEEP_PAGES_SIZE("gcache.keep_pages_size");
 static const std::string GCACHE_DEFAULT_KEEP_PAGES_SIZE("0");
+static const std::string GCACHE_PARAMS_RECOVER    ("gcache.recover");
+static const std::string GCACHE_DEFAULT_RECOVER   ("no");
+static const std::string GCACHE_PARAMS_PREALLOC_PAGES("gcache.prealloc_pages");
+static const std::string GCACHE_DEFAULT_PREALLOC_PAGES("1");
+static const std::string GCACHE_PARAMS_HUGE_PAGES ("gcache.huge_pages");
+static const std::string GCACHE_DEFAULT_HUGE_PAGES("no");
+static const std::string GCACHE_PARAMS_NUMA_NODE  ("gcache.numa_node");
+static const std::string GCACHE_DEFAULT_NUMA_NODE ("-1");
+static const std::string GCACHE_PARAMS_COMPRESS   ("gcache.compress_history");
+static const std::string GCACHE_DEFAULT_COMPRESS  ("no");
+static const std::string GCACHE_PARAMS_COMPRESS_LEVEL ("gcache.compress_level");
+static const std::string GCACHE_DEFAULT_COMPRESS_LEVEL("1");
 
 void
 gcache::GCache::Params::register_params(gu::Config& cfg)
@@ -26,6 +38,12 @@ gcache::GCache::Params::register_params(gu::Config& cfg)
     cfg.add(GCACHE_PARAMS_RB_SIZE,         GCACHE_DEFAULT_RB_SIZE);
     cfg.add(GCACHE_PARAMS_PAGE_SIZE,       GCACHE_DEFAULT_PAGE_SIZE);
     cfg.add(GCACHE_PARAMS_KEEP_PAGES_SIZE, GCACHE_DEFAULT_KEEP_PAGES_SIZE);
+    cfg.add(GCACHE_PARAMS_RECOVER,         GCACHE_DEFAULT_RECOVER);
+    cfg.add(GCACHE_PARAMS_PREALLOC_PAGES,  GCACHE_DEFAULT_PREALLOC_PAGES);
+    cfg.add(GCACHE_PARAMS_HUGE_PAGES,      GCACHE_DEFAULT_HUGE_PAGES);
+    cfg.add(GCACHE_PARAMS_NUMA_NODE,       GCACHE_DEFAULT_NUMA_NODE);
+    cfg.add(GCACHE_PARAMS_COMPRESS,        GCACHE_DEFAULT_COMPRESS);
+    cfg.add(GCACHE_PARAMS_COMPRESS_LEVEL,  GCACHE_DEFAULT_COMPRESS_LEVEL);
 }
 
 static const std::string&
@@ -53,6 +71,27 @@ name_value (gu::Config& cfg, const std::string& data_dir)
     return cfg.get(GCACHE_PARAMS_RB_NAME);
 }
 
+static gcache::RingBuffer::HugePages
+huge_pages_value (gu::Config& cfg)
+{
+    std::string const val(cfg.get(GCACHE_PARAMS_HUGE_PAGES));
+
+    if ("transparent" == val) return gcache::RingBuffer::HUGE_PAGES_TRANSPARENT;
+
+    try
+    {
+        return (gu::Config::from_config<bool>(val) ?
+                gcache::RingBuffer::HUGE_PAGES_YES :
+                gcache::RingBuffer::HUGE_PAGES_NO);
+    }
+    catch (gu::Exception&)
+    {
+        gu_throw_error(EINVAL) << "Invalid value for '"
+                               << GCACHE_PARAMS_HUGE_PAGES << "': '" << val
+                               << "', expected 'no', 'transparent' or 'yes'";
+    }
+}
+
 gcache::GCache::Params::Params (gu::Config& cfg, const std::string& data_dir)
     :
     rb_name_  (name_value (cfg, data_dir)),
@@ -60,7 +99,13 @@ gcache::GCache::Params::Params (gu::Config& cfg, const std::string& data_dir)
     mem_size_ (cfg.get<size_t>(GCACHE_PARAMS_MEM_SIZE)),
     rb_size_  (cfg.get<size_t>(GCACHE_PARAMS_RB_SIZE)),
     page_size_(cfg.get<size_t>(GCACHE_PARAMS_PAGE_SIZE)),
-    keep_pages_size_(cfg.get<size_t>(GCACHE_PARAMS_KEEP_PAGES_SIZE))
+    keep_pages_size_(cfg.get<size_t>(GCACHE_PARAMS_KEEP_PAGES_SIZE)),
+    recover_  (cfg.get<bool>(GCACHE_PARAMS_RECOVER)),
+    prealloc_pages_(cfg.get<size_t>(GCACHE_PARAMS_PREALLOC_PAGES)),
+    huge_pages_(huge_pages_value (cfg)),
+    numa_node_(cfg.get<int>(GCACHE_PARAMS_NUMA_NODE)),
+    compress_history_(cfg.get<bool>(GCACHE_PARAMS_COMPRESS)),
+    compress_level_(cfg.get<int>(GCACHE_PARAMS_COMPRESS_LEVEL))
 {}
 
 void
@@ -90,6 +135,23 @@ gcache::GCache::param_set (const std::string& key, const std::string& val)
     {
         gu_throw_error(EPERM) << "Can't change ring buffer size in runtime.";
     }
+    else if (key == GCACHE_PARAMS_HUGE_PAGES ||
+             key == GCACHE_PARAMS_NUMA_NODE)
+    {
+        gu_throw_error(EPERM) << "Can't change ring buffer memory backing in "
+                              << "runtime.";
+    }
+    else if (key == GCACHE_PARAMS_COMPRESS ||
+             key == GCACHE_PARAMS_COMPRESS_LEVEL)
+    {
+        gu_throw_error(EPERM) << "Can't change history compression in "
+                              << "runtime.";
+    }
+    else if (key == GCACHE_PARAMS_RECOVER)
+    {
+        gu_throw_error(EINVAL) << "'" << key
+                               << "' has a meaning only on startup.";
+    }
     else if (key == GCACHE_PARAMS_PAGE_SIZE)
     {
         size_t tmp_size = gu::Config::from_config<size_t>(val);
@@ -114,6 +176,16 @@ gcache::GCache::param_set (const std::string& key, const std::string& val)
         params.keep_pages_size(tmp_size);
         ps.set_keep_size(params.keep_pages_size());
     }
+    else if (key == GCACHE_PARAMS_PREALLOC_PAGES)
+    {
+        size_t tmp_size = gu::Config::from_config<size_t>(val);
+
+        gu::Lock lock(mtx);
+
+        config.set<size_t>(key, tmp_size);
+        params.prealloc_pages(tmp_size);
+        ps.set_prealloc(params.prealloc_pages());
+    }
     else
     {
         throw gu::NotFound();
@@ -9,21 +9,66 @@
 
 #include <gu_logger.hpp>
 #include <gu_throw.hpp>
+#include <gu_uuid.hpp>
 
 #include <cassert>
+#include <cerrno>
+#include <map>
+#include <sstream>
+
+#include <sys/mman.h>
+
+#if defined(__linux__)
+#include <sys/statfs.h>
+#include <linux/magic.h>
+#endif
 
 namespace gcache
 {
-    static inline size_t check_size (size_t s)
+    /* @return huge page size if file is on hugetlbfs, 0 otherwise */
+    static size_t hugetlbfs_page_size (const std::string& name)
+    {
+#if defined(HUGETLBFS_MAGIC)
+        size_t const slash(name.find_last_of('/'));
+        std::string const dir(std::string::npos == slash ? "." :
+                              name.substr(0, slash + 1));
+        struct statfs st;
+
+        if (0 == statfs (dir.c_str(), &st) && HUGETLBFS_MAGIC == st.f_type)
+        {
+            return st.f_bsize;
+        }
+#endif
+        return 0;
+    }
+
+    static inline size_t check_size (size_t s, const std::string& name,
+                                     RingBuffer::HugePages const huge_pages)
     {
-        return s + RingBuffer::pad_size() + sizeof(BufferHeader);
+        s += RingBuffer::pad_size() + sizeof(BufferHeader);
+
+        if (RingBuffer::HUGE_PAGES_YES == huge_pages)
+        {
+            size_t const hp(hugetlbfs_page_size(name));
+
+            if (0 == hp)
+            {
+                gu_throw_error(EINVAL) << "Explicit huge pages require '"
+                                       << name << "' to be on hugetlbfs";
+            }
+
+            /* hugetlbfs files are allocated in whole huge pages */
+            s = (s + hp - 1) / hp * hp;
+        }
+
+        return s;
     }
 
     void
     RingBuffer::reset()
     {
-        first_ = start_;
-        next_  = start_;
+        set_first(start_);
+        set_next (start_);
 
         BH_clear (BH_cast(next_));
 
@@ -39,9 +84,12 @@ namespace gcache
     RingBuffer::constructor_common() {}
 
     RingBuffer::RingBuffer (const std::string& name, size_t size,
-                            std::map<int64_t, const void*> & seqno2ptr)
+                            seqno2ptr_t& seqno2ptr,
+                            bool const recover_history,
+                            HugePages const huge_pages,
+                            int const numa_node)
     :
-        fd_        (name, check_size(size)),
+        fd_        (name, check_size(size, name, huge_pages)),
         mmap_      (fd_),
         open_      (true),
         preamble_  (static_cast<char*>(mmap_.ptr)),
@@ -56,32 +104,254 @@ namespace gcache
         size_trail_(0),
 //        mallocs_   (0),
 //        reallocs_  (0),
-        seqno2ptr_ (seqno2ptr)
+        seqno2ptr_ (seqno2ptr),
+        gid_       (GU_UUID_NIL)
     {
+        /* before any of the buffer is touched */
+        if (HUGE_PAGES_TRANSPARENT == huge_pages) mmap_.huge_pages();
+        if (numa_node >= 0) mmap_.bind_node(numa_node);
+
         constructor_common ();
-        BH_clear (BH_cast(next_));
+
+        if (!recover_history || !recover()) reset();
+
+        header_[HEADER_VERSION] = VERSION;
+        header_[HEADER_SIZE]    = size_cache_;
+        header_[HEADER_SYNCED]  = 0;
+        memcpy (header_ + HEADER_GID, &gid_, sizeof(gid_));
+
+        write_preamble (false);
     }
 
     RingBuffer::~RingBuffer ()
     {
         open_ = false;
         mmap_.sync();
+
+        /* mark buffer as synced only after all the contents are on disk */
+        header_[HEADER_SYNCED] = 1;
+        write_preamble (true);
+        if (msync (mmap_.ptr, pad_size(), MS_SYNC) < 0)
+        {
+            log_warn << "Failed to sync ring buffer header: " << errno
+                     << " (" << strerror(errno) << ')';
+        }
+
         mmap_.unmap();
     }
 
+    void
+    RingBuffer::write_preamble (bool const synced)
+    {
+        std::ostringstream os;
+
+        os << "* GCache ring buffer *"
+           << "\nVersion: " << VERSION
+           << "\nGID: "     << gid_
+           << "\nsynced: "  << synced
+           << '\n';
+
+        std::string const str(os.str());
+        size_t const len(std::min(str.length(), PREAMBLE_LEN - 1));
+
+        memcpy (preamble_, str.c_str(), len);
+        memset (preamble_ + len, 0, PREAMBLE_LEN - len);
+    }
+
+    void
+    RingBuffer::set_gid (const gu_uuid_t& gid)
+    {
+        gid_ = gid;
+        memcpy (header_ + HEADER_GID, &gid_, sizeof(gid_));
+        write_preamble (false);
+    }
+
+    /* checks if header looks like one of a ring buffer, space is how much
+     * room there is for the buffer in its segment */
+    static inline bool
+    BH_test (const BufferHeader* const bh, size_t const space)
+    {
+        if (bh->size <= sizeof(BufferHeader) || bh->size > space ||
+            BUFFER_IN_RB != bh->store || (bh->flags & ~BUFFER_RELEASED))
+            return false;
+
+        if (bh->seqno_g > 0)
+            return (bh->seqno_d >= SEQNO_ILL && bh->seqno_d < bh->seqno_g);
+
+        return (SEQNO_NONE == bh->seqno_g || SEQNO_ILL == bh->seqno_g);
+    }
+
+    /*
+     * Walks the buffer chain left by previous process from the first_ to
+     * the next_ offsets saved in the header. Chain is cut at the first
+     * header which fails the sanity check (torn or partially written
+     * buffer), everything after it is considered free space. The buffer
+     * preceding it is dropped too as its size can't be trusted.
+     * Seqno'd buffers forming continuous sequence which ends with the
+     * highest seqno found are added to seqno2ptr_ as released, the rest
+     * are discarded.
+     *
+     * @return true if any history was recovered
+     */
+    bool
+    RingBuffer::recover ()
+    {
+        if (header_[HEADER_VERSION] != VERSION)
+        {
+            log_info << "Skipped GCache ring buffer recovery: "
+                     << "unrecognized header version "
+                     << header_[HEADER_VERSION];
+            return false;
+        }
+
+        if (header_[HEADER_SIZE] != int64_t(size_cache_))
+        {
+            log_info << "Skipped GCache ring buffer recovery: cache size "
+                     << "changed from " << header_[HEADER_SIZE] << " to "
+                     << size_cache_;
+            return false;
+        }
+
+        int64_t const first_off(header_[HEADER_FIRST]);
+        int64_t const next_off (header_[HEADER_NEXT]);
+
+        if (first_off < 0 || first_off > int64_t(size_cache_) ||
+            next_off  < 0 || next_off  > int64_t(size_cache_))
+        {
+            log_warn << "Skipped GCache ring buffer recovery: corrupt "
+                     << "header, first: " << first_off << ", next: "
+                     << next_off;
+            return false;
+        }
+
+        if (!header_[HEADER_SYNCED])
+        {
+            log_warn << "GCache ring buffer was not closed properly, "
+                     << "recovering history anyway";
+        }
+
+        uint8_t* const first(start_ + first_off);
+        uint8_t* const next (start_ + next_off);
+        bool     const wrap (first > next);
+
+        std::map<int64_t, BufferHeader*> found;
+        uint8_t* pos     (first);
+        uint8_t* prev    (0);
+        bool     wrapped (false);
+        size_t   trail   (0);
+
+        while (pos != next)
+        {
+            BufferHeader* const bh(BH_cast(pos));
+
+            if (0 == bh->size && wrap && !wrapped)
+            {
+                /* rollover */
+                trail   = end_ - pos;
+                pos     = start_;
+                wrapped = true;
+                continue;
+            }
+
+            size_t const space(wrap && !wrapped ?
+                               end_ - pos - sizeof(BufferHeader) :
+                               next - pos);
+
+            if (!BH_test (bh, space) ||
+                (bh->seqno_g > 0 &&
+                 !found.insert(std::make_pair(bh->seqno_g, bh)).second))
+            {
+                log_warn << "GCache ring buffer recovery: corrupt buffer "
+                         << "header at offset " << (pos - start_) << ": "
+                         << bh << ", discarding the rest of the buffer";
+
+                if (prev)
+                {
+                    found.erase(BH_cast(prev)->seqno_g);
+                    pos = prev;
+                }
+
+                break;
+            }
+
+            prev = pos;
+            pos += bh->size;
+        }
+
+        /* the oldest seqno to keep */
+        int64_t keep(SEQNO_NONE);
+
+        for (std::map<int64_t, BufferHeader*>::reverse_iterator
+                 r(found.rbegin()); r != found.rend(); ++r)
+        {
+            if (keep != SEQNO_NONE && r->first != keep - 1) break;
+            keep = r->first;
+        }
+
+        if (SEQNO_NONE == keep)
+        {
+            log_info << "GCache ring buffer recovery: no history found";
+            return false;
+        }
+
+        set_first (first);
+        set_next  (pos);
+        size_trail_ = (next_ < first_ ? trail : 0);
+        size_used_  = 0;
+        size_free_  = size_cache_;
+
+        /* mark all buffers released and discard those not in history */
+        long discarded(0);
+
+        for (BufferHeader* bh(BH_cast(first_)); bh != BH_cast(next_);)
+        {
+            if (0 == bh->size)
+            {
+                bh = BH_cast(start_);
+                continue;
+            }
+
+            bh->ctx    = this;
+            bh->flags |= BUFFER_RELEASED;
+
+            if (bh->seqno_g >= keep)
+            {
+                size_free_ -= bh->size;
+                seqno2ptr_.insert(bh->seqno_g, bh + 1);
+            }
+            else
+            {
+                if (bh->seqno_g != SEQNO_ILL) ++discarded;
+                bh->seqno_g = SEQNO_ILL;
+            }
+
+            bh = BH_next(bh);
+        }
+
+        BH_clear (BH_cast(next_));
+        assert_sizes();
+
+        memcpy (&gid_, header_ + HEADER_GID, sizeof(gid_));
+
+        log_info << "Recovered " << (found.rbegin()->first - keep + 1)
+                 << " seqnos " << keep << "-" << found.rbegin()->first
+                 << " of group " << gid_ << " from GCache ring buffer, "
+                 << discarded << " buffers discarded";
+
+        return true;
+    }
+
     /* discard all seqnos preceeding and including seqno */
     bool
     RingBuffer::discard_seqno (int64_t seqno)
     {
-        for (seqno2ptr_t::iterator i = seqno2ptr_.begin();
-             i != seqno2ptr_.end() && i->first <= seqno;)
+        while (!seqno2ptr_.empty() && seqno2ptr_.index_begin() <= seqno)
         {
-            seqno2ptr_t::iterator j(i); ++i;
-            BufferHeader* const bh (ptr2BH (j->second));
+            BufferHeader* const bh (ptr2BH (seqno2ptr_.front()));
 
             if (gu_likely (BH_is_released(bh)))
             {
-                seqno2ptr_.erase (j);
+                seqno2ptr_.pop_front();
                 bh->seqno_g = SEQNO_ILL;  // will never be accessed by seqno
 
                 switch (bh->store)
@@ -166,7 +436,7 @@ namespace gcache
             /* buffer is either discarded already, or it must have seqno */
             assert (SEQNO_ILL == bh->seqno_g);
 
-            first_ += bh->size;
+            set_first(first_ + bh->size);
             assert_size_free();
 
             if (gu_unlikely(0 == (BH_cast(first_))->size))
@@ -175,7 +445,7 @@ namespace gcache
                 assert(first_ >= next_);
                 assert(first_ >= ret);
 
-                first_ = start_;
+                set_first(start_);
                 assert_size_free();
 
                 if (end_ >= ret + size_next)
@@ -221,7 +491,7 @@ namespace gcache
         bh->store   = BUFFER_IN_RB;
         bh->ctx     = this;
 
-        next_ = ret + size;
+        set_next(ret + size);
         assert (next_ + sizeof(BufferHeader) <= end_);
         BH_clear (BH_cast(next_));
         assert_sizes();
@@ -307,7 +577,7 @@ namespace gcache
                 }
                 else // adjacent buffer allocation failed, return it back
                 {
-                    next_ = adj_ptr;
+                    set_next(adj_ptr);
                     BH_clear (BH_cast(next_));
                     size_used_ -= adj_size;
                     size_free_ += adj_size;
@@ -341,17 +611,21 @@ namespace gcache
          * end of released buffers chain. */
         BufferHeader* bh(0);
 
-        for (seqno2ptr_t::reverse_iterator r(seqno2ptr_.rbegin());
-             r != seqno2ptr_.rend(); ++r)
+        for (int64_t s(seqno2ptr_.index_end() - 1);
+             s >= seqno2ptr_.index_begin(); --s)
         {
-            BufferHeader* const b(ptr2BH(r->second));
+            const void* const ptr(seqno2ptr_.find(s));
+
+            if (0 == ptr) continue;
+
+            BufferHeader* const b(ptr2BH(ptr));
             if (BUFFER_IN_RB == b->store)
             {
 #ifndef NDEBUG
                 if (!BH_is_released(b))
                 {
                     log_fatal << "Buffer "
-                              << reinterpret_cast<const void*>(r->second)
+                              << ptr
                               << ", seqno_g " << b->seqno_g << ", seqno_d "
                               << b->seqno_d << " is not released.";
                     assert(0);
@@ -375,17 +649,17 @@ namespace gcache
         size_t const old(size_free_);
 
         assert (0 == size_trail_ || first_ > next_);
-        first_ = reinterpret_cast<uint8_t*>(bh);
+        set_first(reinterpret_cast<uint8_t*>(bh));
 
         while (BH_is_released(bh)) // next_ is never released - no endless loop
         {
-             first_ = reinterpret_cast<uint8_t*>(BH_next(bh));
+             set_first(reinterpret_cast<uint8_t*>(BH_next(bh)));
 
              if (gu_unlikely (0 == bh->size && first_ != next_))
              {
                  // rollover
                  assert (first_ > next_);
-                 first_ = start_;
+                 set_first(start_);
              }
 
              bh = BH_cast(first_);
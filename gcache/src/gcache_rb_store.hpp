@@ -9,12 +9,13 @@
 
 #include "gcache_memops.hpp"
 #include "gcache_bh.hpp"
+#include "gcache_seqno2ptr.hpp"
 
 #include <gu_fdesc.hpp>
 #include <gu_mmap.hpp>
+#include <gu_uuid.h>
 
 #include <string>
-#include <map>
 #include <stdint.h>
 
 namespace gcache
@@ -23,8 +24,27 @@ namespace gcache
     {
     public:
 
+        /*! what pages should back the buffer memory */
+        enum HugePages
+        {
+            HUGE_PAGES_NO,          /* regular pages                      */
+            HUGE_PAGES_TRANSPARENT, /* ask for transparent huge pages     */
+            HUGE_PAGES_YES          /* file must be on hugetlbfs mount    */
+        };
+
+        /*!
+         * @param recover if true, try to recover seqno'd buffers left in
+         *                the file by previous process and add them to
+         *                seqno2ptr (as released)
+         * @param huge_pages with HUGE_PAGES_YES the size is rounded up to
+         *                the huge page size
+         * @param numa_node bind buffer memory to this node, -1 for none
+         */
         RingBuffer (const std::string& name, size_t size,
-                    std::map<int64_t, const void*>& seqno2ptr);
+                    seqno2ptr_t& seqno2ptr,
+                    bool      recover    = false,
+                    HugePages huge_pages = HUGE_PAGES_NO,
+                    int       numa_node  = -1);
 
         ~RingBuffer ();
 
@@ -44,14 +64,37 @@ namespace gcache
 
         size_t size      () const { return size_cache_; }
 
+        size_t size_free () const { return size_free_; }
+
         size_t rb_size   () const { return fd_.size(); }
 
         const std::string& rb_name() const { return fd_.name(); }
 
+        int   fd () const { return fd_.get(); }
+
+        /* page size obtained for the buffer and bytes in huge pages */
+        void  page_usage (size_t& page_size, size_t& huge_size) const
+        {
+            mmap_.page_usage (page_size, huge_size);
+        }
+
+        /* offset of the pointer into the cache file */
+        off_t offset (const void* ptr) const
+        {
+            assert (ptr >= start_ && ptr < end_);
+            return static_cast<const uint8_t*>(ptr) -
+                static_cast<const uint8_t*>(mmap_.ptr);
+        }
+
         void  reset();
 
         void  seqno_reset();
 
+        /* UUID of the group history in the buffer belongs to */
+        const gu_uuid_t& gid() const { return gid_; }
+
+        void  set_gid (const gu_uuid_t& gid);
+
         /* returns true when successfully discards all seqnos up to s */
         bool  discard_seqno  (int64_t s);
 
@@ -106,6 +149,21 @@ namespace gcache
         static size_t const PREAMBLE_LEN = 1024;
         static size_t const HEADER_LEN = 32;
 
+        /* binary header layout, it is updated as the buffer is used, so
+         * that buffer chain can be found after restart */
+        enum
+        {
+            HEADER_VERSION,
+            HEADER_SYNCED,   // buffer was synced to disk on close
+            HEADER_SIZE,     // size_cache_
+            HEADER_FIRST,    // first_ offset from start_
+            HEADER_NEXT,     // next_ offset from start_
+            HEADER_GID,      // 2 words
+            HEADER_GID_END = HEADER_GID + 2
+        };
+
+        static int64_t const VERSION = 1;
+
         gu::FileDescriptor fd_;
         gu::MMap           mmap_;
         bool               open_;
@@ -121,14 +179,29 @@ namespace gcache
         size_t             size_used_;
         size_t             size_trail_;
 
-        typedef std::map<int64_t, const void*> seqno2ptr_t;
-
         seqno2ptr_t&    seqno2ptr_;
+        gu_uuid_t       gid_;
+
+        void set_first (uint8_t* const p)
+        {
+            first_ = p;
+            header_[HEADER_FIRST] = p - start_;
+        }
+
+        void set_next (uint8_t* const p)
+        {
+            next_ = p;
+            header_[HEADER_NEXT] = p - start_;
+        }
 
         BufferHeader*   get_new_buffer (size_type size);
 
         void            constructor_common();
 
+        bool            recover ();
+
+        void            write_preamble (bool synced);
+
         RingBuffer(const gcache::RingBuffer&);
         RingBuffer& operator=(const gcache::RingBuffer&);
     };
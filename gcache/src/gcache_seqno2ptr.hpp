@@ -0,0 +1,206 @@
+/*
+ * Copyright (C) 2015 Codership Oy <info@codership.com>
+ */
+
+/*! @file seqno to buffer pointer index */
+
+#ifndef _gcache_seqno2ptr_hpp_
+#define _gcache_seqno2ptr_hpp_
+
+#include "SeqnoNone.hpp"
+
+#include <gu_macros.h>
+
+#include <cassert>
+#include <cstddef>
+#include <vector>
+
+namespace gcache
+{
+    /*!
+     * Maps seqnos to buffer pointers. Seqnos are assigned densely and
+     * mostly in order, so pointers are kept in a ring of slots indexed by
+     * offset from the first seqno. Lookup is O(1) and nothing is allocated
+     * unless the range of seqnos in the index outgrows the ring.
+     *
+     * Missing seqnos are represented by null pointers. The first and the
+     * last slots are never null, so index_begin() and index_back() are the
+     * lowest and the highest seqnos present.
+     */
+    class Seqno2Ptr
+    {
+    public:
+
+        typedef const void* value_type;
+
+        Seqno2Ptr()
+            : ring_ (),
+              mask_ (0),
+              head_ (0),
+              size_ (0),
+              begin_(SEQNO_NONE)
+        {}
+
+        bool   empty() const { return 0 == size_; }
+
+        /*! @return number of slots between the first and the last seqno,
+         *          including missing ones */
+        size_t size()  const { return size_; }
+
+        int64_t index_begin() const { return begin_; }
+        int64_t index_end()   const { return begin_ + size_; }
+        int64_t index_back()  const { assert(!empty()); return index_end()-1; }
+
+        value_type front() const { assert(!empty()); return slot(0); }
+        value_type back()  const { assert(!empty()); return slot(size_ - 1); }
+
+        /*! @return pointer for seqno or 0 if it is not in the index */
+        value_type find(int64_t const seqno) const
+        {
+            uint64_t const off(seqno - begin_);
+            return (off < size_ ? slot(off) : 0);
+        }
+
+        /*! @return the first seqno in the index which is greater than seqno
+         *          or index_end() if there is none */
+        int64_t upper_bound(int64_t seqno) const
+        {
+            if (seqno < begin_) return begin_;
+
+            while (++seqno < index_end() && 0 == find(seqno)) {}
+
+            return (seqno < index_end() ? seqno : index_end());
+        }
+
+        /*! @return false if seqno is already in the index */
+        bool insert(int64_t const seqno, value_type const ptr)
+        {
+            assert(ptr);
+
+            if (gu_unlikely(empty()))
+            {
+                reserve(1);
+                begin_ = seqno;
+                size_  = 1;
+                slot(0) = ptr;
+                return true;
+            }
+
+            if (gu_likely(seqno >= index_end()))
+            {
+                size_t const n(seqno - begin_ + 1);
+
+                reserve(n);
+                for (size_t i(size_); i < n - 1; ++i) slot(i) = 0;
+                size_ = n;
+                slot(n - 1) = ptr;
+                return true;
+            }
+
+            if (seqno < begin_)
+            {
+                size_t const gap(begin_ - seqno);
+
+                reserve(size_ + gap);
+                head_  = (head_ - gap) & mask_;
+                size_ += gap;
+                begin_ = seqno;
+                slot(0) = ptr;
+                for (size_t i(1); i < gap; ++i) slot(i) = 0;
+                return true;
+            }
+
+            value_type& s(slot(seqno - begin_));
+
+            if (s) return false;
+
+            s = ptr;
+            return true;
+        }
+
+        /*! changes pointer of a seqno present in the index */
+        void replace(int64_t const seqno, value_type const ptr)
+        {
+            assert(ptr);
+            assert(find(seqno));
+            slot(seqno - begin_) = ptr;
+        }
+
+        /*! removes the first seqno and any missing ones following it */
+        void pop_front()
+        {
+            assert(!empty());
+
+            do
+            {
+                head_ = (head_ + 1) & mask_;
+                --size_;
+                ++begin_;
+            }
+            while (size_ > 0 && 0 == slot(0));
+        }
+
+        void erase(int64_t const seqno)
+        {
+            if (seqno == begin_)
+            {
+                pop_front();
+            }
+            else if (find(seqno))
+            {
+                slot(seqno - begin_) = 0;
+
+                while (0 == back()) --size_;
+            }
+        }
+
+        /*! empties the index, preserves the allocated ring */
+        void clear()
+        {
+            head_  = 0;
+            size_  = 0;
+            begin_ = SEQNO_NONE;
+        }
+
+    private:
+
+        std::vector<value_type> ring_;
+        size_t                  mask_;  // ring_.size() - 1, size is 2^n
+        size_t                  head_;  // slot of begin_
+        size_t                  size_;
+        int64_t                 begin_;
+
+        value_type& slot(size_t const off)
+        {
+            return ring_[(head_ + off) & mask_];
+        }
+
+        value_type  slot(size_t const off) const
+        {
+            return ring_[(head_ + off) & mask_];
+        }
+
+        /* makes sure the ring can hold n slots */
+        void reserve(size_t const n)
+        {
+            if (gu_likely(n <= ring_.size())) return;
+
+            size_t cap(ring_.size());
+            if (0 == cap) cap = MIN_CAPACITY;
+            while (cap < n) cap <<= 1;
+
+            std::vector<value_type> tmp(cap, value_type(0));
+            for (size_t i(0); i < size_; ++i) tmp[i] = slot(i);
+
+            ring_.swap(tmp);
+            mask_ = cap - 1;
+            head_ = 0;
+        }
+
+        static size_t const MIN_CAPACITY = 1 << 10;
+    };
+
+    typedef Seqno2Ptr seqno2ptr_t;
+}
+
+#endif /* _gcache_seqno2ptr_hpp_ */
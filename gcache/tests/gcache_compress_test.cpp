@@ -0,0 +1,256 @@
+/*
+ * Copyright (C) 2015 Codership Oy <info@codership.com>
+ *
+ * $Id$
+ */
+
+#include "GCache.hpp"
+#include "gcache_compress_test.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <pthread.h>
+#include <unistd.h>
+
+using namespace gcache;
+
+static size_t const WS_SIZE = 4096;
+
+/* text-like writeset contents, reproducible from seqno */
+static void
+ws_fill (gu::byte_t* const buf, int64_t const seqno)
+{
+    static const char* const words[] =
+        { "INSERT ", "INTO ", "t1 ", "VALUES ", "(", "), ", "'galera'", ", ",
+          "UPDATE ", "SET ", "WHERE ", "id = ", "NULL", "\n" };
+    size_t const n_words(sizeof(words) / sizeof(words[0]));
+    unsigned int seed(seqno);
+    size_t i(0);
+
+    while (i < WS_SIZE)
+    {
+        const char* const w(words[rand_r(&seed) % n_words]);
+        size_t const l(std::min(strlen(w), WS_SIZE - i));
+
+        memcpy (buf + i, w, l);
+        i += l;
+    }
+}
+
+static std::string
+status_value (const GCache& gc, const std::string& key)
+{
+    gu::Status status;
+    gc.get_status(status);
+
+    for (gu::Status::const_iterator i(status.begin()); i != status.end(); ++i)
+    {
+        if (i->first == key) return i->second;
+    }
+
+    return "";
+}
+
+static void
+config_init (gu::Config& conf)
+{
+    GCache::register_params(conf);
+    conf.set("gcache.name",             "gcache_compress_test.rb");
+    conf.set("gcache.size",             "1M");
+    conf.set("gcache.page_size",        "256K");
+    conf.set("gcache.keep_pages_size",  "4M");
+    conf.set("gcache.compress_history", "yes");
+}
+
+static int64_t const LAST(2000); // ~8M of writesets, 8 times the ring buffer
+static size_t const  RB_HISTORY((1 << 20) / WS_SIZE);
+
+static void
+fill_history (GCache& gc)
+{
+    for (int64_t seqno(1); seqno <= LAST; ++seqno)
+    {
+        void* const ptr(gc.malloc(WS_SIZE));
+        fail_if (0 == ptr, "seqno %lld", static_cast<long long>(seqno));
+
+        ws_fill (static_cast<gu::byte_t*>(ptr), seqno);
+        gc.seqno_assign (ptr, seqno, seqno - 1);
+        gc.free (ptr);
+
+        /* let compression keep up */
+        if (0 == seqno % 32) usleep (20000);
+    }
+}
+
+/* reads history from first to LAST like IST sender does,
+ * returns seqno of the first missing or mismatching writeset */
+static int64_t
+read_history (GCache& gc, int64_t const first, size_t& compressed)
+{
+    std::vector<GCache::Buffer> v(100);
+    std::vector<gu::byte_t>     inflated;
+    std::vector<gu::byte_t>     ws(WS_SIZE);
+    int64_t                     seqno(first);
+    size_t                      n;
+
+    compressed = 0;
+
+    while (seqno <= LAST &&
+           (n = gc.seqno_get_buffers(v, inflated, seqno)) > 0)
+    {
+        for (size_t i(0); i < n; ++i, ++seqno)
+        {
+            if (v[i].seqno_g() != seqno || v[i].size() != ssize_t(WS_SIZE))
+            {
+                return seqno;
+            }
+
+            ws_fill (&ws[0], seqno);
+            if (memcmp(v[i].ptr(), &ws[0], WS_SIZE)) return seqno;
+
+            /* decompressed ones are sent from memory */
+            if (v[i].fd() < 0) ++compressed;
+        }
+    }
+
+    return seqno;
+}
+
+START_TEST(test_history)
+{
+    gu::Config conf;
+    config_init (conf);
+
+    {
+        GCache gc(conf, "");
+
+        fill_history (gc);
+
+        fail_if (status_value(gc, "gcache_history_compressed") == "0");
+
+        int64_t const first(gc.seqno_min());
+        fail_if (first < 1 || LAST - first < int64_t(2 * RB_HISTORY),
+                 "history %lld-%lld is too short",
+                 static_cast<long long>(first), static_cast<long long>(LAST));
+
+        /* all history is there and intact */
+        size_t        compressed;
+        int64_t const end(read_history(gc, first, compressed));
+
+        gc.seqno_unlock();
+
+        fail_if (end != LAST + 1, "history breaks at %lld",
+                 static_cast<long long>(end));
+        fail_if (0 == compressed);
+    }
+
+    unlink ("gcache_compress_test.rb");
+}
+END_TEST
+
+struct Reader
+{
+    GCache*   gc;
+    int64_t   first;
+    int64_t   end;
+    size_t    compressed;
+    pthread_t thr;
+};
+
+extern "C" void*
+run_reader (void* arg)
+{
+    Reader& r(*static_cast<Reader*>(arg));
+    r.end = read_history(*r.gc, r.first, r.compressed);
+    return NULL;
+}
+
+/* each reader decompresses into its own memory, so concurrent ones
+ * don't overwrite each other's buffers */
+START_TEST(test_concurrent_readers)
+{
+    gu::Config conf;
+    config_init (conf);
+
+    {
+        GCache gc(conf, "");
+
+        fill_history (gc);
+
+        /* no history changes below once compression is done with it */
+        std::string compressed(status_value(gc, "gcache_history_compressed"));
+        do
+        {
+            usleep (200000);
+        }
+        while (compressed !=
+               (compressed = status_value(gc, "gcache_history_compressed")));
+
+        fail_if ("0" == compressed);
+
+        int64_t const first(gc.seqno_min());
+        Reader r[2];
+
+        for (size_t i(0); i < sizeof(r)/sizeof(r[0]); ++i)
+        {
+            r[i].gc    = &gc;
+            r[i].first = first;
+            fail_if (pthread_create(&r[i].thr, NULL, run_reader, &r[i]));
+        }
+
+        for (size_t i(0); i < sizeof(r)/sizeof(r[0]); ++i)
+        {
+            pthread_join (r[i].thr, NULL);
+
+            fail_if (r[i].end != LAST + 1, "reader %zu: history breaks at %lld",
+                     i, static_cast<long long>(r[i].end));
+            fail_if (0 == r[i].compressed, "reader %zu: nothing compressed", i);
+        }
+
+        gc.seqno_unlock();
+    }
+
+    unlink ("gcache_compress_test.rb");
+}
+END_TEST
+
+/* compressed history kept under less than a page would be trimmed right
+ * away, so nothing is compressed and history stays in ring buffer */
+START_TEST(test_keep_pages_size_0)
+{
+    gu::Config conf;
+    config_init (conf);
+    conf.set("gcache.keep_pages_size", "0");
+
+    {
+        GCache gc(conf, "");
+
+        fill_history (gc);
+
+        fail_if (status_value(gc, "gcache_history_compressed") != "0");
+
+        int64_t const first(gc.seqno_min());
+        fail_if (first < 1 || LAST - first < int64_t(RB_HISTORY / 2),
+                 "history %lld-%lld is too short",
+                 static_cast<long long>(first), static_cast<long long>(LAST));
+    }
+
+    unlink ("gcache_compress_test.rb");
+}
+END_TEST
+
+Suite* gcache_compress_suite()
+{
+    Suite* ts = suite_create("gcache::Compress");
+    TCase* tc = tcase_create("test");
+
+    tcase_set_timeout(tc, 120);
+    tcase_add_test(tc, test_history);
+    tcase_add_test(tc, test_concurrent_readers);
+    tcase_add_test(tc, test_keep_pages_size_0);
+    suite_add_tcase(ts, tc);
+
+    return ts;
+}
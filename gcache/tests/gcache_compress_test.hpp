@@ -0,0 +1,15 @@
+/*
+ * Copyright (C) 2015 Codership Oy <info@codership.com>
+ *
+ * $Id$
+ */
+#ifndef __gcache_compress_test_hpp__
+#define __gcache_compress_test_hpp__
+
+extern "C" {
+#include <check.h>
+}
+
+extern Suite* gcache_compress_suite();
+
+#endif // __gcache_compress_test_hpp__
@@ -0,0 +1,189 @@
+/*
+ * Copyright (C) 2015 Codership Oy <info@codership.com>
+ */
+
+/*!
+ * @file IST donor history replay benchmark
+ *
+ * Fills gcache with a history of writesets large enough to spill into page
+ * store and reads it back the way IST sender does, first with plain
+ * seqno_get_buffers() and then with read-ahead and dropping of sent
+ * buffers. Before every pass the history is flushed and dropped from page
+ * cache, so that it is read from disk.
+ *
+ * To run:
+ * gcache_ist_bench [<history MB> [<writeset bytes> [<directory>]]]
+ */
+
+#include "GCache.hpp"
+
+#include <gu_hash.h>
+
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <set>
+#include <vector>
+
+#include <sys/resource.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+static double
+now()
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return double(tv.tv_sec) + 1.e-6 * tv.tv_usec;
+}
+
+static long
+major_faults()
+{
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    return ru.ru_majflt;
+}
+
+static size_t const BATCH(4096); // same as IST sender
+
+/* writes history back to disk and drops it from memory */
+static void
+drop_history(gcache::GCache& gc, int64_t const last)
+{
+    std::vector<gcache::GCache::Buffer> v(BATCH);
+    std::vector<gu::byte_t> inflated;
+    std::set<int> synced;
+    int64_t seqno(1);
+    size_t n;
+
+    while (seqno <= last && (n = gc.seqno_get_buffers(v, inflated, seqno)) > 0)
+    {
+        for (size_t i(0); i < n; ++i)
+        {
+            if (v[i].fd() >= 0 && synced.insert(v[i].fd()).second)
+            {
+                fdatasync(v[i].fd());
+            }
+        }
+
+        gc.seqno_drop_buffers(v, n);
+        seqno += n;
+    }
+
+    gc.seqno_unlock();
+}
+
+/* reads history like IST sender does, returns MB/s */
+static double
+replay(gcache::GCache& gc, int64_t const last, bool const readahead,
+       long& faults)
+{
+    std::vector<gcache::GCache::Buffer> v(BATCH);
+    std::vector<gu::byte_t> inflated;
+    uint64_t volatile h(0);
+    size_t  bytes(0);
+    int64_t seqno(1);
+    size_t  n;
+
+    faults = major_faults();
+    double const begin(now());
+
+    while (seqno <= last && (n = gc.seqno_get_buffers(v, inflated, seqno,
+                                                       readahead)))
+    {
+        for (size_t i(0); i < n; ++i)
+        {
+            h += gu_fast_hash64(v[i].ptr(), v[i].size());
+            bytes += v[i].size();
+        }
+
+        if (readahead) gc.seqno_drop_buffers(v, n);
+
+        seqno += n;
+    }
+
+    double const end(now());
+    faults = major_faults() - faults;
+
+    gc.seqno_unlock();
+
+    (void)h;
+
+    return double(bytes) / (end - begin) / (1 << 20);
+}
+
+int main(int argc, char* argv[])
+{
+    long const mb (argc > 1 ? strtol(argv[1], NULL, 10) : 10240);
+    long const ws (argc > 2 ? strtol(argv[2], NULL, 10) : 4096);
+    std::string const dir(argc > 3 ? argv[3] : ".");
+
+    if (mb <= 0 || ws <= 0)
+    {
+        fprintf(stderr, "Usage: %s [<history MB> [<writeset bytes> "
+                "[<directory>]]]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    gu_conf_self_tstamp_on();
+
+    gu::Config conf;
+    gcache::GCache::register_params(conf);
+    conf.set("gcache.dir",       dir);
+    conf.set("gcache.name",      "gcache_ist_bench.rb");
+    conf.set("gcache.size",      "128M");
+    conf.set("gcache.page_size", "128M");
+
+    std::vector<void*> bufs;
+
+    {
+        gcache::GCache gc(conf, dir);
+
+        int64_t const last((int64_t(mb) << 20) / ws);
+        bufs.reserve(last);
+
+        printf("Filling %ld MB of history with %ld byte writesets...\n",
+               mb, ws);
+        fflush(stdout);
+
+        double const begin(now());
+
+        for (int64_t seqno(1); seqno <= last; ++seqno)
+        {
+            void* const ptr(gc.malloc(ws));
+
+            if (!ptr)
+            {
+                fprintf(stderr, "Failed to allocate seqno %lld\n",
+                        static_cast<long long>(seqno));
+                return EXIT_FAILURE;
+            }
+
+            memset(ptr, int(seqno), ws);
+            /* buffers are not freed to keep them in history */
+            gc.seqno_assign(ptr, seqno, seqno - 1);
+            bufs.push_back(ptr);
+        }
+
+        printf("Filled in %.1f sec\n\n%10s %10s %12s\n", now() - begin,
+               "mode", "MB/s", "major faults");
+
+        long faults;
+
+        drop_history(gc, last);
+        double const plain(replay(gc, last, false, faults));
+        printf("%10s %10.0f %12ld\n", "plain", plain, faults);
+        fflush(stdout);
+
+        drop_history(gc, last);
+        double const ahead(replay(gc, last, true, faults));
+        printf("%10s %10.0f %12ld\n", "readahead", ahead, faults);
+
+        for (size_t i(0); i < bufs.size(); ++i) gc.free(bufs[i]);
+    }
+
+    unlink(conf.get("gcache.name").c_str());
+
+    return EXIT_SUCCESS;
+}
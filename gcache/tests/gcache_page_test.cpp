@@ -8,6 +8,8 @@
 #include "gcache_bh.hpp"
 #include "gcache_page_test.hpp"
 
+#include <unistd.h>
+
 using namespace gcache;
 
 void ps_free (void* ptr)
@@ -100,6 +102,68 @@ START_TEST(test3) // check that all page size is efficiently used
 }
 END_TEST
 
+/* waits for background thread to prepare n pages */
+static bool
+wait_ready (const gcache::PageStore& ps, size_t const n)
+{
+    for (int i(0); i < 1000 && ps.ready() != n; ++i) usleep(10000);
+
+    return (ps.ready() == n);
+}
+
+START_TEST(test_prealloc) // pages are created in advance and recycled
+{
+    const char* const dir_name = "";
+    ssize_t const keep_size = 1;
+    ssize_t const page_size = 1024;
+
+    {
+        gcache::PageStore ps (dir_name, keep_size, page_size, false, 1);
+
+        void* ptr1 = ps.malloc (page_size / 2);
+        fail_if (0 == ptr1);
+        fail_if (!wait_ready(ps, 1), "ps.ready() = %zd, expected 1",
+                 ps.ready());
+        fail_if (ps.count() != 2, "ps.count() = %zd, expected 2", ps.count());
+
+        // does not fit into the first page, ready page should be taken
+        void* ptr2 = ps.malloc (page_size - 24);
+        fail_if (0 == ptr2);
+        fail_if (!wait_ready(ps, 1), "ps.ready() = %zd, expected 1",
+                 ps.ready());
+        fail_if (ps.count() != 3, "ps.count() = %zd, expected 3", ps.count());
+
+        // freeing the first page should put it back to ready list
+        ps_free(ptr1);
+        ps.discard (ptr2BH(ptr1));
+        fail_if (!wait_ready(ps, 2), "ps.ready() = %zd, expected 2",
+                 ps.ready());
+        fail_if (ps.count() != 3, "ps.count() = %zd, expected 3", ps.count());
+
+        gcache::PageStore::Stats st;
+        ps.stats(st);
+        fail_if (st.created  != 3, "created: %lld",  st.created);
+        fail_if (st.recycled != 1, "recycled: %lld", st.recycled);
+        fail_if (st.stalls   != 1, "stalls: %lld",   st.stalls);
+
+        // recycled page is reused
+        void* ptr3 = ps.malloc (page_size - 24);
+        fail_if (0 == ptr3);
+        fail_if (ps.count() != 3, "ps.count() = %zd, expected 3", ps.count());
+
+        ps_free(ptr2);
+        ps.discard (ptr2BH(ptr2));
+        ps_free(ptr3);
+        ps.discard (ptr2BH(ptr3));
+    }
+
+    // all page files are removed with the store
+    fail_if (0 == access("gcache.page.000000", F_OK));
+    fail_if (0 == access("gcache.page.000001", F_OK));
+    fail_if (0 == access("gcache.page.000002", F_OK));
+}
+END_TEST
+
 Suite* gcache_page_suite()
 {
     Suite* s = suite_create("gcache::PageStore");
@@ -109,6 +173,7 @@ Suite* gcache_page_suite()
     tcase_add_test(tc, test1);
     tcase_add_test(tc, test2);
     tcase_add_test(tc, test3);
+    tcase_add_test(tc, test_prealloc);
     suite_add_tcase(s, tc);
 
     return s;
@@ -8,6 +8,14 @@
 #include "gcache_bh.hpp"
 #include "gcache_rb_test.hpp"
 
+#include <gu_exception.hpp>
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include <unistd.h>
+
 using namespace gcache;
 
 START_TEST(test1)
@@ -16,7 +24,7 @@ START_TEST(test1)
     size_t const bh_size = sizeof(gcache::BufferHeader);
     size_t const rb_size (4 + 2*bh_size);
 
-    std::map<int64_t, const void*> s2p;
+    seqno2ptr_t s2p;
     RingBuffer rb(rb_name, rb_size, s2p);
 
     fail_if (rb.size() != rb_size, "Expected %zd, got %zd", rb_size, rb.size());
@@ -83,6 +91,258 @@ START_TEST(test1)
 }
 END_TEST
 
+/* allocates buffer filled with seqno pattern, assigns seqno if positive */
+static void*
+rb_alloc (RingBuffer& rb, seqno2ptr_t& s2p,
+          size_t const size, int64_t const seqno)
+{
+    void* const ptr(rb.malloc(size + sizeof(BufferHeader)));
+    fail_if (NULL == ptr, "Failed to allocate seqno %lld",
+             static_cast<long long>(seqno));
+
+    memset (ptr, int(seqno), size);
+
+    if (seqno > 0)
+    {
+        BufferHeader* const bh(ptr2BH(ptr));
+        bh->seqno_g = seqno;
+        bh->seqno_d = seqno - 1;
+        s2p.insert(seqno, ptr);
+    }
+
+    return ptr;
+}
+
+static void
+rb_release (RingBuffer& rb, const void* const ptr)
+{
+    BufferHeader* const bh(ptr2BH(ptr));
+    BH_release(bh);
+    rb.free(bh);
+}
+
+/* checks that recovered history is seqnos first-last with correct contents */
+static void
+rb_check (const seqno2ptr_t& s2p, size_t const size,
+          int64_t const first, int64_t const last)
+{
+    fail_if (s2p.empty());
+    fail_if (s2p.index_begin() != first, "Expected first %lld, got %lld",
+             static_cast<long long>(first),
+             static_cast<long long>(s2p.index_begin()));
+    fail_if (s2p.index_back() != last, "Expected last %lld, got %lld",
+             static_cast<long long>(last),
+             static_cast<long long>(s2p.index_back()));
+    fail_if (s2p.size() != size_t(last - first + 1));
+
+    std::vector<char> pattern(size);
+
+    for (int64_t seqno(first); seqno <= last; ++seqno)
+    {
+        const void* const ptr(s2p.find(seqno));
+        fail_if (NULL == ptr, "Seqno %lld missing",
+                 static_cast<long long>(seqno));
+
+        const BufferHeader* const bh(ptr2BH(ptr));
+
+        fail_if (bh->seqno_g != seqno);
+        fail_if (!BH_is_released(bh));
+        fail_if (bh->size != size + sizeof(BufferHeader));
+
+        memset (&pattern[0], int(seqno), size);
+        fail_if (memcmp(&pattern[0], ptr, size),
+                 "Seqno %lld contents mismatch",
+                 static_cast<long long>(seqno));
+    }
+}
+
+START_TEST(test_recover)
+{
+    std::string const rb_name = "rb_recover_test";
+    size_t const rb_size (1 << 20);
+    size_t const ws_size (1000);
+
+    gu_uuid_t gid;
+    gu_uuid_generate (&gid, NULL, 0);
+
+    {
+        seqno2ptr_t s2p;
+        RingBuffer rb(rb_name, rb_size, s2p);
+
+        rb.set_gid(gid);
+
+        for (int64_t seqno(1); seqno <= 100; ++seqno)
+        {
+            void* const ptr(rb_alloc(rb, s2p, ws_size, seqno));
+
+            /* the last ones are still in use on shutdown */
+            if (seqno <= 90) rb_release(rb, ptr);
+
+            /* unassigned buffer is not a part of history */
+            if (50 == seqno) rb_alloc(rb, s2p, ws_size, SEQNO_NONE);
+        }
+    }
+
+    int64_t last(100);
+
+    {
+        seqno2ptr_t s2p;
+        RingBuffer rb(rb_name, rb_size, s2p, true);
+
+        rb_check (s2p, ws_size, 1, last);
+        fail_if (gu_uuid_compare(&rb.gid(), &gid));
+
+        /* continue history and roll over the end of the buffer a few times,
+         * discarding the oldest seqnos */
+        for (; last < 5000; ++last)
+        {
+            if (s2p.size() >= 400)
+            {
+                fail_if (!rb.discard_seqno(s2p.index_begin()));
+            }
+
+            rb_release(rb, rb_alloc(rb, s2p, ws_size, last + 1));
+        }
+    }
+
+    {
+        seqno2ptr_t s2p;
+        RingBuffer rb(rb_name, rb_size, s2p, true);
+
+        fail_if (s2p.size() < 100);
+        rb_check (s2p, ws_size, s2p.index_begin(), last);
+
+        /* recovered ring buffer is fully usable */
+        for (; last < 6000; ++last)
+        {
+            if (s2p.size() >= 400)
+            {
+                fail_if (!rb.discard_seqno(s2p.index_begin()));
+            }
+
+            rb_release(rb, rb_alloc(rb, s2p, ws_size, last + 1));
+        }
+    }
+
+    {
+        seqno2ptr_t s2p;
+        RingBuffer rb(rb_name, rb_size, s2p, false);
+
+        fail_if (!s2p.empty());
+    }
+
+    {
+        /* previous instance did not recover, so nothing to recover now */
+        seqno2ptr_t s2p;
+        RingBuffer rb(rb_name, rb_size, s2p, true);
+
+        fail_if (!s2p.empty());
+    }
+
+    unlink (rb_name.c_str());
+}
+END_TEST
+
+START_TEST(test_recover_torn)
+{
+    std::string const rb_name = "rb_recover_torn_test";
+    size_t const rb_size (1 << 20);
+    size_t const ws_size (1000);
+    off_t torn;
+
+    {
+        seqno2ptr_t s2p;
+        RingBuffer rb(rb_name, rb_size, s2p);
+
+        for (int64_t seqno(1); seqno <= 100; ++seqno)
+        {
+            rb_release(rb, rb_alloc(rb, s2p, ws_size, seqno));
+        }
+
+        torn = rb.offset(s2p.find(60)) - sizeof(BufferHeader);
+    }
+
+    /* garble the header of seqno 60 */
+    {
+        FILE* const f(fopen(rb_name.c_str(), "r+"));
+        fail_if (NULL == f);
+
+        char garbage[sizeof(BufferHeader)];
+        memset (garbage, 0xab, sizeof(garbage));
+
+        fail_if (fseek(f, torn, SEEK_SET));
+        fail_if (fwrite(garbage, sizeof(garbage), 1, f) != 1);
+        fail_if (fclose(f));
+    }
+
+    {
+        seqno2ptr_t s2p;
+        RingBuffer rb(rb_name, rb_size, s2p, true);
+
+        /* seqno 59 size can't be trusted either */
+        rb_check (s2p, ws_size, 1, 58);
+
+        /* the space of discarded buffers is reused */
+        void* const ptr(rb_alloc(rb, s2p, ws_size, 59));
+        fail_if (rb.offset(ptr) != torn - off_t(ws_size));
+    }
+
+    {
+        seqno2ptr_t s2p;
+        RingBuffer rb(rb_name, rb_size / 2, s2p, true);
+
+        /* cache size changed */
+        fail_if (!s2p.empty());
+    }
+
+    unlink (rb_name.c_str());
+}
+END_TEST
+
+START_TEST(test_huge_pages)
+{
+    std::string const rb_name = "rb_test";
+    size_t const rb_size (1 << 22);
+
+    {
+        /* not supported everywhere, must not fail though */
+        seqno2ptr_t s2p;
+        RingBuffer rb(rb_name, rb_size, s2p, false,
+                      RingBuffer::HUGE_PAGES_TRANSPARENT, 0);
+
+        for (int64_t s(1); s <= 100; ++s)
+        {
+            void* const ptr(rb.malloc(4096));
+            fail_if (NULL == ptr);
+            memset (ptr, 0, 4096);
+        }
+
+        size_t page_size, huge_size;
+        rb.page_usage (page_size, huge_size);
+        fail_if (page_size < size_t(sysconf(_SC_PAGESIZE)),
+                 "page size: %zu", page_size);
+        fail_if (huge_size > rb.rb_size(), "huge size: %zu", huge_size);
+    }
+
+    unlink (rb_name.c_str());
+
+    /* current directory is not expected to be on hugetlbfs */
+    try
+    {
+        seqno2ptr_t s2p;
+        RingBuffer rb(rb_name, rb_size, s2p, false,
+                      RingBuffer::HUGE_PAGES_YES);
+        fail_if (true, "explicit huge pages outside hugetlbfs should fail");
+    }
+    catch (gu::Exception& e)
+    {
+        fail_if (e.get_errno() != EINVAL);
+    }
+
+    unlink (rb_name.c_str());
+}
+END_TEST
+
 Suite* gcache_rb_suite()
 {
     Suite* ts = suite_create("gcache::RbStore");
@@ -90,6 +350,9 @@ Suite* gcache_rb_suite()
 
     tcase_set_timeout(tc, 60);
     tcase_add_test(tc, test1);
+    tcase_add_test(tc, test_recover);
+    tcase_add_test(tc, test_recover_torn);
+    tcase_add_test(tc, test_huge_pages);
     suite_add_tcase(ts, tc);
 
     return ts;
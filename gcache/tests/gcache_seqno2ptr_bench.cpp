@@ -0,0 +1,112 @@
+/*
+ * Copyright (C) 2015 Codership Oy <info@codership.com>
+ */
+
+/*!
+ * @file seqno2ptr index benchmark
+ *
+ * Replays the way GCache uses its seqno index: every writeset seqno is
+ * assigned, looked up a few times (release, IST), and discarded when the
+ * history exceeds the window size. Compares std::map which was used before
+ * with the Seqno2Ptr ring.
+ *
+ * To run:
+ * gcache_seqno2ptr_bench [<writesets> [<history window>]]
+ */
+
+#include "gcache_seqno2ptr.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+
+#include <sys/time.h>
+
+static double
+now()
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return double(tv.tv_sec) + 1.e-6 * tv.tv_usec;
+}
+
+static const void*
+ptr (int64_t const seqno)
+{
+    return reinterpret_cast<const void*>(seqno * 64);
+}
+
+typedef std::map<int64_t, const void*> map_t;
+
+static void
+s2p_insert (map_t& m, int64_t s)
+{
+    m.insert(m.end(), map_t::value_type(s, ptr(s)));
+}
+
+static const void*
+s2p_find (const map_t& m, int64_t s)
+{
+    map_t::const_iterator const i(m.find(s));
+    return (i != m.end() ? i->second : 0);
+}
+
+static void
+s2p_pop (map_t& m) { m.erase(m.begin()); }
+
+static void
+s2p_insert (gcache::seqno2ptr_t& m, int64_t s) { m.insert(s, ptr(s)); }
+
+static const void*
+s2p_find (const gcache::seqno2ptr_t& m, int64_t s) { return m.find(s); }
+
+static void
+s2p_pop (gcache::seqno2ptr_t& m) { m.pop_front(); }
+
+/* returns nanoseconds per writeset */
+template <typename Index> static double
+run (long const n, long const window)
+{
+    Index    idx;
+    uint64_t sum(0);
+
+    double const begin(now());
+
+    for (int64_t s(1); s <= n; ++s)
+    {
+        s2p_insert(idx, s);
+
+        /* release and IST reads hit recent and older history */
+        sum += reinterpret_cast<uintptr_t>(s2p_find(idx, s));
+        sum += reinterpret_cast<uintptr_t>(s2p_find(idx, s - (s % window)));
+
+        if (s > window) s2p_pop(idx);
+    }
+
+    double const end(now());
+
+    if (0 == sum) printf("impossible\n"); /* keep the lookups */
+
+    return (end - begin) * 1.e9 / n;
+}
+
+int main(int argc, char* argv[])
+{
+    long const n      (argc > 1 ? strtol(argv[1], NULL, 10) : 10000000);
+    long const window (argc > 2 ? strtol(argv[2], NULL, 10) : 100000);
+
+    if (n <= 0 || window <= 0)
+    {
+        fprintf(stderr, "Usage: %s [<writesets> [<history window>]]\n",
+                argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    printf("%ld writesets, history of %ld\n\n%10s %10s\n", n, window,
+           "index", "ns/ws");
+
+    printf("%10s %10.1f\n", "std::map", run<map_t>(n, window));
+    printf("%10s %10.1f\n", "Seqno2Ptr", run<gcache::seqno2ptr_t>(n, window));
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,164 @@
+/*
+ * Copyright (C) 2015 Codership Oy <info@codership.com>
+ *
+ * $Id$
+ */
+
+#include "gcache_seqno2ptr.hpp"
+#include "gcache_seqno2ptr_test.hpp"
+
+#include <cstdlib>
+#include <iterator>
+#include <map>
+
+using namespace gcache;
+
+static const void*
+s2p_ptr (int64_t const seqno)
+{
+    return reinterpret_cast<const void*>(seqno * 8 + 0x1000);
+}
+
+START_TEST(test_basic)
+{
+    seqno2ptr_t s2p;
+
+    fail_if (!s2p.empty());
+    fail_if (0 != s2p.find(1));
+    fail_if (s2p.upper_bound(0) != s2p.index_end());
+
+    fail_if (!s2p.insert(5, s2p_ptr(5)));
+    fail_if (s2p.insert(5, s2p_ptr(6))); // already there
+    fail_if (s2p.find(5) != s2p_ptr(5));
+    fail_if (s2p.index_begin() != 5 || s2p.index_back() != 5);
+
+    /* holes at the end and in front */
+    fail_if (!s2p.insert(8, s2p_ptr(8)));
+    fail_if (!s2p.insert(2, s2p_ptr(2)));
+    fail_if (s2p.size() != 7);
+    fail_if (s2p.index_begin() != 2 || s2p.index_back() != 8);
+    fail_if (0 != s2p.find(3) || 0 != s2p.find(7) || 0 != s2p.find(9));
+    fail_if (s2p.front() != s2p_ptr(2) || s2p.back() != s2p_ptr(8));
+
+    fail_if (s2p.upper_bound(0) != 2);
+    fail_if (s2p.upper_bound(2) != 5);
+    fail_if (s2p.upper_bound(5) != 8);
+    fail_if (s2p.upper_bound(8) != s2p.index_end());
+
+    /* pop_front() skips missing seqnos */
+    s2p.pop_front();
+    fail_if (s2p.index_begin() != 5);
+
+    /* erasing the last seqno trims the trailing hole */
+    s2p.erase(8);
+    fail_if (s2p.index_back() != 5);
+    fail_if (s2p.size() != 1);
+
+    s2p.pop_front();
+    fail_if (!s2p.empty());
+    fail_if (s2p.index_end() != 6);
+
+    s2p.insert(100, s2p_ptr(100));
+    s2p.clear();
+    fail_if (!s2p.empty());
+    fail_if (0 != s2p.find(100));
+}
+END_TEST
+
+/* random operations checked against std::map, the index is made to roll
+ * over and grow a few times */
+START_TEST(test_random)
+{
+    seqno2ptr_t                    s2p;
+    std::map<int64_t, const void*> ref;
+    int64_t                        next(1);
+
+    srand(42);
+
+    for (int i(0); i < 200000; ++i)
+    {
+        int const op(rand() % 100);
+        int64_t seqno(0);
+        bool    insert(true);
+
+        if (op < 60 || ref.empty())
+        {
+            /* mostly in order, sometimes skipping a seqno */
+            seqno = next + (rand() % 10 == 0);
+            next  = seqno + 1;
+        }
+        else if (op < 62)
+        {
+            seqno = ref.begin()->first - 1 - rand() % 3;
+        }
+        else if (op < 64)
+        {
+            seqno = ref.begin()->first + rand() % (next - ref.begin()->first);
+        }
+        else
+        {
+            insert = false;
+        }
+
+        if (insert)
+        {
+            bool const ins(ref.insert(std::make_pair(seqno,
+                                                     s2p_ptr(seqno))).second);
+            fail_if (s2p.insert(seqno, s2p_ptr(seqno)) != ins,
+                     "insert(%lld) mismatch", static_cast<long long>(seqno));
+        }
+        else if (op < 96 || ref.size() < 2)
+        {
+            /* queue grows in the long run */
+            if (op < 80 || ref.size() > 3000)
+            {
+                ref.erase(ref.begin());
+                s2p.pop_front();
+            }
+        }
+        else
+        {
+            std::map<int64_t, const void*>::iterator it(ref.begin());
+            std::advance(it, rand() % ref.size());
+            s2p.erase(it->first);
+            ref.erase(it);
+        }
+
+        fail_if (s2p.empty() != ref.empty());
+
+        if (ref.empty()) continue;
+
+        fail_if (s2p.index_begin() != ref.begin()->first);
+        fail_if (s2p.index_back()  != ref.rbegin()->first);
+        fail_if (s2p.front() != ref.begin()->second);
+        fail_if (s2p.back()  != ref.rbegin()->second);
+
+        if (i % 1000 == 0)
+        {
+            for (int64_t s(s2p.index_begin() - 1); s <= s2p.index_end(); ++s)
+            {
+                std::map<int64_t, const void*>::iterator it(ref.find(s));
+                fail_if (s2p.find(s) != (it == ref.end() ? 0 : it->second),
+                         "find(%lld) mismatch", static_cast<long long>(s));
+
+                it = ref.upper_bound(s);
+                fail_if (s2p.upper_bound(s) !=
+                         (it == ref.end() ? s2p.index_end() : it->first));
+            }
+        }
+    }
+}
+END_TEST
+
+Suite* gcache_seqno2ptr_suite()
+{
+    Suite* ts = suite_create("gcache::Seqno2Ptr");
+    TCase* tc = tcase_create("test");
+
+    tcase_set_timeout(tc, 60);
+    tcase_add_test(tc, test_basic);
+    tcase_add_test(tc, test_random);
+    suite_add_tcase(ts, tc);
+
+    return ts;
+}
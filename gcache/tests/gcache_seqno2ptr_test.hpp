@@ -0,0 +1,15 @@
+/*
+ * Copyright (C) 2015 Codership Oy <info@codership.com>
+ *
+ * $Id$
+ */
+#ifndef __gcache_seqno2ptr_test_hpp__
+#define __gcache_seqno2ptr_test_hpp__
+
+extern "C" {
+#include <check.h>
+}
+
+extern Suite* gcache_seqno2ptr_suite();
+
+#endif // __gcache_seqno2ptr_test_hpp__
@@ -0,0 +1,217 @@
+/*
+ * Copyright (C) 2015 Codership Oy <info@codership.com>
+ */
+
+/*!
+ * @file multi-threaded GCache stress benchmark
+ *
+ * Models the concurrent GCache use of a node under load:
+ * - the replication thread allocates writesets and assigns seqnos to them,
+ * - the service thread releases committed seqnos in batches,
+ * - the rest of the threads allocate and free unordered buffers (state
+ *   messages, fragments of actions being defragmented and such).
+ * Reports operations per second of each kind.
+ *
+ * To run:
+ * gcache_stress_bench [<seconds> [<free threads> [<directory>]]]
+ */
+
+#include "GCache.hpp"
+
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+#include <vector>
+
+#include <pthread.h>
+#include <stdint.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+static double
+now()
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return double(tv.tv_sec) + 1.e-6 * tv.tv_usec;
+}
+
+struct Bench
+{
+    gcache::GCache& gc;
+    bool volatile   stop;
+    int64_t volatile assigned;   // last seqno assigned
+    int64_t volatile released;   // last seqno released
+    long volatile   frees;       // unordered buffers freed
+
+    explicit Bench(gcache::GCache& g)
+        : gc(g), stop(false), assigned(0), released(0), frees(0) {}
+};
+
+/* how far replication can go ahead of commits, like with flow control */
+static int64_t const MAX_UNRELEASED(4096);
+
+/* seqnos released at once, like by the service thread */
+static int64_t const RELEASE_BATCH(64);
+
+static size_t
+ws_size (unsigned int* const seed)
+{
+    return 128 + rand_r(seed) % 4096;
+}
+
+/* allocates writesets and assigns seqnos in order */
+extern "C" void*
+replicator (void* arg)
+{
+    Bench&       b(*static_cast<Bench*>(arg));
+    unsigned int seed(1);
+
+    while (!b.stop)
+    {
+        if (b.assigned - b.released >= MAX_UNRELEASED)
+        {
+            sched_yield();
+            continue;
+        }
+
+        size_t const size(ws_size(&seed));
+        void* const  ptr(b.gc.malloc(size));
+
+        if (!ptr)
+        {
+            fprintf(stderr, "Failed to allocate %lu bytes\n",
+                    static_cast<unsigned long>(size));
+            abort();
+        }
+
+        memset(ptr, 0, size);
+        b.gc.seqno_assign(ptr, b.assigned + 1, b.assigned);
+        __sync_synchronize();
+        b.assigned = b.assigned + 1;
+    }
+
+    return NULL;
+}
+
+/* releases assigned seqnos in batches */
+extern "C" void*
+releaser (void* arg)
+{
+    Bench& b(*static_cast<Bench*>(arg));
+
+    while (!b.stop)
+    {
+        int64_t const assigned(b.assigned);
+        int64_t const a(std::min(assigned, b.released + RELEASE_BATCH));
+
+        if (a > b.released)
+        {
+            b.gc.seqno_release(a);
+            b.released = a;
+        }
+        else
+        {
+            sched_yield();
+        }
+    }
+
+    return NULL;
+}
+
+/* allocates and frees unordered buffers */
+extern "C" void*
+freer (void* arg)
+{
+    Bench&       b(*static_cast<Bench*>(arg));
+    unsigned int seed(reinterpret_cast<uintptr_t>(&seed));
+    long         n(0);
+
+    std::vector<void*> held;
+
+    while (!b.stop)
+    {
+        size_t const size(ws_size(&seed));
+        void* const  ptr(b.gc.malloc(size));
+
+        if (!ptr)
+        {
+            fprintf(stderr, "Failed to allocate %lu bytes\n",
+                    static_cast<unsigned long>(size));
+            abort();
+        }
+
+        memset(ptr, 0, size);
+        held.push_back(ptr);
+
+        /* buffers live for a while, like actions being processed */
+        if (held.size() >= 8)
+        {
+            for (size_t i(0); i < held.size(); ++i) b.gc.free(held[i]);
+            n += held.size();
+            held.clear();
+        }
+    }
+
+    for (size_t i(0); i < held.size(); ++i) b.gc.free(held[i]);
+
+    __sync_fetch_and_add(&b.frees, n);
+
+    return NULL;
+}
+
+int main(int argc, char* argv[])
+{
+    int const seconds (argc > 1 ? strtol(argv[1], NULL, 10) : 10);
+    int const threads (argc > 2 ? strtol(argv[2], NULL, 10) : 4);
+    std::string const dir(argc > 3 ? argv[3] : ".");
+
+    if (seconds <= 0 || threads < 0)
+    {
+        fprintf(stderr, "Usage: %s [<seconds> [<free threads> "
+                "[<directory>]]]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    gu::Config conf;
+    gcache::GCache::register_params(conf);
+    conf.set("gcache.dir",       dir);
+    conf.set("gcache.name",      "gcache_stress_bench.rb");
+    conf.set("gcache.size",      "128M");
+    conf.set("gcache.page_size", "128M");
+
+    {
+        gcache::GCache gc(conf, dir);
+        Bench          b(gc);
+
+        std::vector<pthread_t> t(threads + 2);
+
+        pthread_create(&t[0], NULL, replicator, &b);
+        pthread_create(&t[1], NULL, releaser,   &b);
+        for (int i(0); i < threads; ++i)
+        {
+            pthread_create(&t[i + 2], NULL, freer, &b);
+        }
+
+        double const begin(now());
+        sleep(seconds);
+        b.stop = true;
+
+        for (size_t i(0); i < t.size(); ++i) pthread_join(t[i], NULL);
+
+        double const time(now() - begin);
+
+        /* let page store clean up */
+        if (b.assigned > b.released) gc.seqno_release(b.assigned);
+
+        printf("%d free threads, %.1f sec\n"
+               "%12s %12s %12s\n%12.0f %12.0f %12.0f\n",
+               threads, time, "seqnos/s", "released/s", "frees/s",
+               b.assigned / time, b.released / time, b.frees / time);
+    }
+
+    unlink(conf.get("gcache.name").c_str());
+
+    return EXIT_SUCCESS;
+}
@@ -20,11 +20,102 @@
 
 #include <fstream>
 
+#include <pthread.h>
+
+//
+// Socket I/O thread. Each thread runs an io_service of its own: asio
+// services which serialize operations internally (SSL streams do) then
+// don't serialize sockets of different threads with each other.
+//
+class gcomm::AsioProtonet::IoThread
+{
+public:
+
+    IoThread(AsioProtonet& net)
+        :
+        net_       (net),
+        io_service_(),
+        work_      (io_service_),
+        thd_       (),
+        running_   (false)
+    {
+        int const err(pthread_create(&thd_, 0, &run_fn, this));
+
+        if (err != 0)
+        {
+            gu_throw_error(err) << "failed to start socket I/O thread";
+        }
+
+        running_ = true;
+    }
+
+    ~IoThread() { stop(); }
+
+    void stop()
+    {
+        if (running_ == true)
+        {
+            io_service_.stop();
+            pthread_join(thd_, 0);
+            running_ = false;
+        }
+    }
+
+    asio::io_service& io_service() { return io_service_; }
+
+private:
+
+    IoThread(const IoThread&);
+    void operator=(const IoThread&);
+
+    static void* run_fn(void* arg)
+    {
+        static_cast<IoThread*>(arg)->run();
+        return 0;
+    }
+
+    static void rethrow(const gu::Exception& e) { throw e; }
+
+    void run()
+    {
+        while (true)
+        {
+            try
+            {
+                io_service_.run();
+                return; // stopped
+            }
+            // handlers run without event loop to catch exceptions,
+            // pass them to protocol thread to be dealt with there
+            catch (gu::Exception& e)
+            {
+                log_error << "exception in socket I/O thread: " << e.what();
+                net_.io_service_.post(boost::bind(&IoThread::rethrow, e));
+            }
+            catch (std::exception& e)
+            {
+                log_error << "exception in socket I/O thread: " << e.what();
+                net_.io_service_.post(
+                    boost::bind(&IoThread::rethrow,
+                                gu::Exception(e.what(), ENOTRECOVERABLE)));
+            }
+        }
+    }
+
+    AsioProtonet&           net_;
+    asio::io_service        io_service_;
+    asio::io_service::work  work_;
+    pthread_t               thd_;
+    bool                    running_;
+};
+
 
 gcomm::AsioProtonet::AsioProtonet(gu::Config& conf, int version)
     :
     gcomm::Protonet(conf, "asio", version),
     mutex_(),
+    io_threads_(),
+    next_io_thread_(0),
     poll_until_(gu::datetime::Date::max()),
     io_service_(),
     timer_(io_service_),
@@ -34,9 +125,19 @@ gcomm::AsioProtonet::AsioProtonet(gu::Config& conf, int version)
     mtu_(1 << 15),
     checksum_(NetHeader::checksum_type(
                   conf.get<int>(gcomm::Conf::SocketChecksum,
-                                NetHeader::CS_CRC32C)))
+                                NetHeader::CS_CRC32C))),
+    recv_pool_(mtu_ + NetHeader::serial_size_, 256)
 {
     conf.set(gcomm::Conf::SocketChecksum, checksum_);
+
+    const int io_threads(conf.get<int>(gcomm::Conf::SocketIoThreads, 0));
+    if (io_threads < 0)
+    {
+        gu_throw_error(EINVAL) << "invalid value " << io_threads
+                               << " for " << gcomm::Conf::SocketIoThreads;
+    }
+    conf.set(gcomm::Conf::SocketIoThreads, io_threads);
+
 #ifdef HAVE_ASIO_SSL_HPP
     // use ssl if either private key or cert file is specified
     bool use_ssl(conf_.is_set(gu::conf::ssl_key)  == true ||
@@ -55,11 +156,26 @@ gcomm::AsioProtonet::AsioProtonet(gu::Config& conf, int version)
         gu::ssl_prepare_context(conf_, ssl_context_);
     }
 #endif // HAVE_ASIO_SSL_HPP
+
+    for (int i(0); i < io_threads; ++i)
+    {
+        io_threads_.push_back(boost::shared_ptr<IoThread>(new IoThread(*this)));
+    }
+
+    if (io_threads > 0)
+    {
+        log_info << "using " << io_threads << " socket I/O threads";
+    }
 }
 
 gcomm::AsioProtonet::~AsioProtonet()
 {
-
+    // threads must not run handlers while the rest is torn down,
+    // io_services with pending handlers are destroyed with members
+    for (size_t i(0); i < io_threads_.size(); ++i)
+    {
+        io_threads_[i]->stop();
+    }
 }
 
 void gcomm::AsioProtonet::enter()
@@ -90,6 +206,17 @@ gcomm::SocketPtr gcomm::AsioProtonet::socket(const gu::URI& uri)
     }
 }
 
+asio::io_service& gcomm::AsioProtonet::socket_io_service()
+{
+    if (io_threads_.empty() == true) return io_service_;
+
+    Critical<AsioProtonet> crit(*this);
+
+    const size_t i(next_io_thread_);
+    next_io_thread_ = (next_io_thread_ + 1) % io_threads_.size();
+    return io_threads_[i]->io_service();
+}
+
 gcomm::Acceptor* gcomm::AsioProtonet::acceptor(const gu::URI& uri)
 {
     return new AsioTcpAcceptor(*this, uri);
@@ -136,7 +263,15 @@ void gcomm::AsioProtonet::dispatch(const SocketId& id,
 
 void gcomm::AsioProtonet::interrupt()
 {
-    io_service_.stop();
+    // Posted stop survives io_service reset in event_loop(), so interrupt
+    // is not lost if it happens while event loop is not running.
+    io_service_.post(boost::bind(&asio::io_service::stop, &io_service_));
+}
+
+
+void gcomm::AsioProtonet::post(Handler* handler)
+{
+    io_service_.post(boost::bind(&Handler::handle, handler));
 }
 
 
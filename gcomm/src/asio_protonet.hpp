@@ -7,10 +7,13 @@
 
 #include "gcomm/protonet.hpp"
 #include "socket.hpp"
+#include "buffer_pool.hpp"
 
 #include "gu_monitor.hpp"
 #include "gu_asio.hpp"
 
+#include <boost/shared_ptr.hpp>
+
 #include <vector>
 #include <deque>
 #include <list>
@@ -31,6 +34,7 @@ public:
                   const Datagram&,
                   const ProtoUpMeta&);
     void interrupt();
+    void post(Handler* handler);
     SocketPtr socket(const gu::URI&);
     gcomm::Acceptor* acceptor(const gu::URI&);
     void enter();
@@ -50,7 +54,17 @@ private:
 
     void handle_wait(const asio::error_code& ec);
 
+    // io_service for a new TCP socket: one of the I/O threads' in turn
+    // or io_service_ if socket I/O is done in event_loop()
+    asio::io_service& socket_io_service();
+
+    class IoThread;
+
     gu::RecursiveMutex          mutex_;
+    // socket I/O threads, declared before io_service_ so that socket
+    // objects released with its pending handlers can still use them
+    std::vector<boost::shared_ptr<IoThread> > io_threads_;
+    size_t                      next_io_thread_;
     gu::datetime::Date          poll_until_;
     asio::io_service            io_service_;
     asio::deadline_timer        timer_;
@@ -60,6 +74,7 @@ private:
     size_t                      mtu_;
 
     NetHeader::checksum_t       checksum_;
+    BufferPool                  recv_pool_; // receive buffers of sockets
 };
 
 #endif // GCOMM_ASIO_PROTONET_HPP
@@ -13,13 +13,16 @@ gcomm::AsioTcpSocket::AsioTcpSocket(AsioProtonet& net, const gu::URI& uri)
     :
     Socket       (uri),
     net_         (net),
-    socket_      (net.io_service_),
+    io_service_  (net.socket_io_service()),
+    socket_      (io_service_),
 #ifdef HAVE_ASIO_SSL_HPP
     ssl_socket_  (0),
 #endif /* HAVE_ASIO_SSL_HPP */
     send_q_      (),
-    recv_buf_    (net_.mtu() + NetHeader::serial_size_),
+    recv_buf_    (net_.recv_pool_.acquire(net_.mtu() +
+                                          NetHeader::serial_size_)),
     recv_offset_ (0),
+    recv_batch_  (),
     state_       (S_CLOSED),
     local_addr_  (),
     remote_addr_ ()
@@ -41,6 +44,8 @@ void gcomm::AsioTcpSocket::failed_handler(const asio::error_code& ec,
                                           const std::string& func,
                                           int line)
 {
+    Critical<AsioProtonet> crit(net_);
+
     log_debug << "failed handler from " << func << ":" << line
               << " socket " << id() << " " << socket_.native()
               << " error " << ec
@@ -61,13 +66,15 @@ void gcomm::AsioTcpSocket::failed_handler(const asio::error_code& ec,
 
     if (prev_state != S_FAILED && prev_state != S_CLOSED)
     {
-        net_.dispatch(id(), Datagram(), ProtoUpMeta(ec.value()));
+        dispatch_event(ec.value());
     }
 }
 
 #ifdef HAVE_ASIO_SSL_HPP
 void gcomm::AsioTcpSocket::handshake_handler(const asio::error_code& ec)
 {
+    Critical<AsioProtonet> crit(net_);
+
     if (ec)
     {
         log_error << "handshake with remote endpoint "
@@ -93,7 +100,7 @@ void gcomm::AsioTcpSocket::handshake_handler(const asio::error_code& ec)
              << " cipher: " << gu::cipher(*ssl_socket_)
              << " compression: " << gu::compression(*ssl_socket_);
     state_ = S_CONNECTED;
-    net_.dispatch(id(), Datagram(), ProtoUpMeta(ec.value()));
+    dispatch_event(ec.value());
     async_receive();
 }
 #endif /* HAVE_ASIO_SSL_HPP */
@@ -138,7 +145,7 @@ void gcomm::AsioTcpSocket::connect_handler(const asio::error_code& ec)
                           << remote_addr() << " local endpoint "
                           << local_addr();
                 state_ = S_CONNECTED;
-                net_.dispatch(id(), Datagram(), ProtoUpMeta(ec.value()));
+                dispatch_event(ec.value());
                 async_receive();
 
 #ifdef HAVE_ASIO_SSL_HPP
@@ -171,7 +178,7 @@ void gcomm::AsioTcpSocket::connect(const gu::URI& uri)
         if (uri.get_scheme() == gu::scheme::ssl)
         {
             ssl_socket_ = new asio::ssl::stream<asio::ip::tcp::socket>(
-                net_.io_service_, net_.ssl_context_
+                io_service_, net_.ssl_context_
             );
 
             ssl_socket_->lowest_layer().async_connect(
@@ -220,7 +227,17 @@ void gcomm::AsioTcpSocket::close()
 
     if (send_q_.empty() == true || state() != S_CONNECTED)
     {
-        close_socket();
+        if (io_threaded() == true)
+        {
+            // SSL stream must not be shut down while I/O thread may be
+            // in the middle of an operation on it
+            io_service_.post(boost::bind(&AsioTcpSocket::close_socket,
+                                         shared_from_this()));
+        }
+        else
+        {
+            close_socket();
+        }
         state_ = S_CLOSED;
     }
     else
@@ -335,8 +352,23 @@ int gcomm::AsioTcpSocket::send(const Datagram& dg)
 void gcomm::AsioTcpSocket::read_handler(const asio::error_code& ec,
                                         const size_t bytes_transferred)
 {
-    Critical<AsioProtonet> crit(net_);
+    if (io_threaded() == true)
+    {
+        // Once connected, I/O thread is the only one to touch the receive
+        // state. Datagrams are dispatched in protocol thread which enters
+        // the protonet then.
+        handle_read(ec, bytes_transferred);
+    }
+    else
+    {
+        Critical<AsioProtonet> crit(net_);
+        handle_read(ec, bytes_transferred);
+    }
+}
 
+void gcomm::AsioTcpSocket::handle_read(const asio::error_code& ec,
+                                       const size_t bytes_transferred)
+{
     if (ec)
     {
         if (ec.category() == asio::error::get_ssl_category())
@@ -348,7 +380,9 @@ void gcomm::AsioTcpSocket::read_handler(const asio::error_code& ec,
         return;
     }
 
-    if (state() != S_CONNECTED && state() != S_CLOSING)
+    // with I/O thread state is checked when datagrams are dispatched
+    if (io_threaded() == false &&
+        state() != S_CONNECTED && state() != S_CLOSING)
     {
         log_debug << "read handler for " << id()
                   << " state " << state();
@@ -357,12 +391,19 @@ void gcomm::AsioTcpSocket::read_handler(const asio::error_code& ec,
 
     recv_offset_ += bytes_transferred;
 
-    while (recv_offset_ >= NetHeader::serial_size_)
+    // Messages larger than this are passed up in the receive buffer itself
+    // instead of being copied out of it.
+    const size_t zero_copy_len(net_.mtu() / 2);
+
+    size_t begin(0); // start of the first unprocessed message in recv_buf_
+
+    while (recv_offset_ - begin >= NetHeader::serial_size_)
     {
         NetHeader hdr;
         try
         {
-            unserialize(&recv_buf_[0], recv_buf_.size(), 0, hdr);
+            unserialize(&(*recv_buf_)[0] + begin, recv_offset_ - begin, 0,
+                        hdr);
         }
         catch (gu::Exception& e)
         {
@@ -370,55 +411,91 @@ void gcomm::AsioTcpSocket::read_handler(const asio::error_code& ec,
                                             asio::error::system_category));
             return;
         }
-        if (recv_offset_ >= hdr.len() + NetHeader::serial_size_)
+
+        const size_t msg_end(begin + NetHeader::serial_size_ + hdr.len());
+
+        if (recv_offset_ < msg_end)
         {
-            Datagram dg(
-                gu::SharedBuffer(
-                    new gu::Buffer(&recv_buf_[0] + NetHeader::serial_size_,
-                                   &recv_buf_[0] + NetHeader::serial_size_
-                                   + hdr.len())));
-            if (net_.checksum_ != NetHeader::CS_NONE)
+            break;
+        }
+
+        gu::SharedBuffer payload;
+        size_t           payload_offset(0);
+
+        if (hdr.len() >= zero_copy_len)
+        {
+            // hand the receive buffer over to datagram, only the data
+            // following the message needs to be copied to the new one
+            payload        = recv_buf_;
+            payload_offset = begin + NetHeader::serial_size_;
+            recv_buf_      = net_.recv_pool_.acquire(payload->size());
+            recv_offset_  -= msg_end;
+            if (recv_offset_ > 0)
             {
-#ifdef TEST_NET_CHECKSUM_ERROR
-                long rnd(rand());
-                if (rnd % 10000 == 0)
-                {
-                    hdr.set_crc32(net_.checksum_, static_cast<uint32_t>(rnd));
-                }
-#endif /* TEST_NET_CHECKSUM_ERROR */
+                memcpy(&(*recv_buf_)[0], &(*payload)[0] + msg_end,
+                       recv_offset_);
+            }
+            payload->resize(msg_end);
+            begin = 0;
+        }
+        else
+        {
+            payload = net_.recv_pool_.acquire(
+                &(*recv_buf_)[0] + begin + NetHeader::serial_size_,
+                &(*recv_buf_)[0] + msg_end);
+            begin = msg_end;
+        }
 
-                if (check_cs (hdr, dg))
-                {
-                    log_warn << "checksum failed, hdr: len=" << hdr.len()
-                             << " has_crc32="  << hdr.has_crc32()
-                             << " has_crc32c=" << hdr.has_crc32c()
-                             << " crc32=" << hdr.crc32();
-                    FAILED_HANDLER(asio::error_code(
-                                       EPROTO,
-                                       asio::error::system_category));
-                    return;
-                }
+        Datagram dg(payload, payload_offset);
+        if (net_.checksum_ != NetHeader::CS_NONE)
+        {
+#ifdef TEST_NET_CHECKSUM_ERROR
+            long rnd(rand());
+            if (rnd % 10000 == 0)
+            {
+                hdr.set_crc32(net_.checksum_, static_cast<uint32_t>(rnd));
             }
-            ProtoUpMeta um;
-            net_.dispatch(id(), dg, um);
-            recv_offset_ -= NetHeader::serial_size_ + hdr.len();
+#endif /* TEST_NET_CHECKSUM_ERROR */
 
-            if (recv_offset_ > 0)
+            if (check_cs (hdr, dg))
             {
-                memmove(&recv_buf_[0],
-                        &recv_buf_[0] + NetHeader::serial_size_ + hdr.len(),
-                        recv_offset_);
+                log_warn << "checksum failed, hdr: len=" << hdr.len()
+                         << " has_crc32="  << hdr.has_crc32()
+                         << " has_crc32c=" << hdr.has_crc32c()
+                         << " crc32=" << hdr.crc32();
+                FAILED_HANDLER(asio::error_code(
+                                   EPROTO,
+                                   asio::error::system_category));
+                return;
             }
         }
+        if (io_threaded() == true)
+        {
+            recv_batch_.push_back(dg);
+        }
         else
         {
-            break;
+            ProtoUpMeta um;
+            net_.dispatch(id(), dg, um);
+        }
+    }
+
+    post_received();
+
+    if (begin > 0)
+    {
+        // move incomplete message to the beginning of the buffer
+        recv_offset_ -= begin;
+        if (recv_offset_ > 0)
+        {
+            memmove(&(*recv_buf_)[0], &(*recv_buf_)[0] + begin,
+                    recv_offset_);
         }
     }
 
     boost::array<asio::mutable_buffer, 1> mbs;
-    mbs[0] = asio::mutable_buffer(&recv_buf_[0] + recv_offset_,
-                                  recv_buf_.size() - recv_offset_);
+    mbs[0] = asio::mutable_buffer(&(*recv_buf_)[0] + recv_offset_,
+                                  recv_buf_->size() - recv_offset_);
     read_one(mbs);
 }
 
@@ -426,6 +503,12 @@ size_t gcomm::AsioTcpSocket::read_completion_condition(
     const asio::error_code& ec,
     const size_t bytes_transferred)
 {
+    if (io_threaded() == true)
+    {
+        // error is handled in read_handler(), which is called next
+        return (ec ? 0 : read_remaining(bytes_transferred));
+    }
+
     Critical<AsioProtonet> crit(net_);
     if (ec)
     {
@@ -445,18 +528,23 @@ size_t gcomm::AsioTcpSocket::read_completion_condition(
         return 0;
     }
 
+    return read_remaining(bytes_transferred);
+}
+
+size_t gcomm::AsioTcpSocket::read_remaining(
+    const size_t bytes_transferred) const
+{
     if (recv_offset_ + bytes_transferred >= NetHeader::serial_size_)
     {
         NetHeader hdr;
         try
         {
-            unserialize(&recv_buf_[0], NetHeader::serial_size_, 0, hdr);
+            unserialize(&(*recv_buf_)[0], NetHeader::serial_size_, 0, hdr);
         }
         catch (gu::Exception& e)
         {
+            // read_handler() fails the socket on the same header
             log_warn << "unserialize error " << e.what();
-            FAILED_HANDLER(asio::error_code(e.get_errno(),
-                                            asio::error::system_category));
             return 0;
         }
         if (recv_offset_ + bytes_transferred >= NetHeader::serial_size_ + hdr.len())
@@ -465,7 +553,7 @@ size_t gcomm::AsioTcpSocket::read_completion_condition(
         }
     }
 
-    return (recv_buf_.size() - recv_offset_);
+    return (recv_buf_->size() - recv_offset_);
 }
 
 
@@ -477,10 +565,67 @@ void gcomm::AsioTcpSocket::async_receive()
 
     boost::array<asio::mutable_buffer, 1> mbs;
 
-    mbs[0] = asio::mutable_buffer(&recv_buf_[0], recv_buf_.size());
+    mbs[0] = asio::mutable_buffer(&(*recv_buf_)[0], recv_buf_->size());
     read_one(mbs);
 }
 
+void gcomm::AsioTcpSocket::dispatch_event(int err)
+{
+    if (io_threaded() == true)
+    {
+        post_received();
+        net_.io_service_.post(
+            boost::bind(&AsioTcpSocket::dispatch_posted_event,
+                        shared_from_this(), err));
+    }
+    else
+    {
+        net_.dispatch(id(), Datagram(), ProtoUpMeta(err));
+    }
+}
+
+void gcomm::AsioTcpSocket::post_received()
+{
+    if (recv_batch_.empty() == true) return;
+
+    boost::shared_ptr<std::vector<Datagram> > batch(
+        new std::vector<Datagram>());
+    batch->swap(recv_batch_);
+    net_.io_service_.post(boost::bind(&AsioTcpSocket::dispatch_received,
+                                      shared_from_this(), batch));
+}
+
+void gcomm::AsioTcpSocket::dispatch_posted_event(int err)
+{
+    Critical<AsioProtonet> crit(net_);
+
+    // socket was closed in the meantime
+    if (state() == S_CLOSED) return;
+
+    net_.dispatch(id(), Datagram(), ProtoUpMeta(err));
+}
+
+void gcomm::AsioTcpSocket::dispatch_received(
+    const boost::shared_ptr<std::vector<Datagram> >& batch)
+{
+    Critical<AsioProtonet> crit(net_);
+
+    for (std::vector<Datagram>::const_iterator i(batch->begin());
+         i != batch->end(); ++i)
+    {
+        if (state() != S_CONNECTED && state() != S_CLOSING)
+        {
+            log_debug << "dropping " << batch->end() - i
+                      << " received datagrams for " << id()
+                      << " state " << state();
+            return;
+        }
+
+        ProtoUpMeta um;
+        net_.dispatch(id(), *i, um);
+    }
+}
+
 size_t gcomm::AsioTcpSocket::mtu() const
 {
     return net_.mtu();
@@ -655,6 +800,9 @@ void gcomm::AsioTcpAcceptor::accept_handler(
     SocketPtr socket,
     const asio::error_code& error)
 {
+    // handshake handler of accepted socket may run in I/O thread
+    Critical<AsioProtonet> crit(net_);
+
     if (!error)
     {
         AsioTcpSocket* s(static_cast<AsioTcpSocket*>(socket.get()));
@@ -672,12 +820,12 @@ void gcomm::AsioTcpAcceptor::accept_handler(
                           << s->id() << " connected, remote endpoint "
                           << s->remote_addr() << " local endpoint "
                           << s->local_addr();
+                s->state_ = Socket::S_CONNECTING;
                 s->ssl_socket_->async_handshake(
                     asio::ssl::stream<asio::ip::tcp::socket>::server,
                     boost::bind(&AsioTcpSocket::handshake_handler,
                                 s->shared_from_this(),
                                 asio::placeholders::error));
-                s->state_ = Socket::S_CONNECTING;
             }
             else
             {
@@ -704,7 +852,7 @@ void gcomm::AsioTcpAcceptor::accept_handler(
         {
             new_socket->ssl_socket_ =
                 new asio::ssl::stream<asio::ip::tcp::socket>(
-                    net_.io_service_, net_.ssl_context_);
+                    new_socket->io_service_, net_.ssl_context_);
             acceptor_.async_accept(new_socket->ssl_socket_->lowest_layer(),
                                    boost::bind(&AsioTcpAcceptor::accept_handler,
                                                this,
@@ -752,7 +900,7 @@ void gcomm::AsioTcpAcceptor::listen(const gu::URI& uri)
         {
             new_socket->ssl_socket_ =
                 new asio::ssl::stream<asio::ip::tcp::socket>(
-                    net_.io_service_, net_.ssl_context_);
+                    new_socket->io_service_, net_.ssl_context_);
             acceptor_.async_accept(new_socket->ssl_socket_->lowest_layer(),
                                    boost::bind(&AsioTcpAcceptor::accept_handler,
                                                this,
@@ -11,6 +11,7 @@
 #include <boost/bind.hpp>
 #include <boost/array.hpp>
 #include <boost/enable_shared_from_this.hpp>
+#include <boost/shared_ptr.hpp>
 #include <vector>
 #include <deque>
 
@@ -60,19 +61,35 @@ private:
     void write_one(const boost::array<asio::const_buffer, 2>& cbs);
     void close_socket();
 
+    // number of bytes still to read to complete message in recv_buf_
+    size_t read_remaining(size_t bytes_transferred) const;
+    void handle_read(const asio::error_code& ec, size_t bytes_transferred);
+
+    // Socket served by I/O thread (see Conf::SocketIoThreads) passes
+    // datagrams and events to protonet in protocol thread, in the order
+    // they happened. Otherwise they are dispatched directly.
+    bool io_threaded() const { return (&io_service_ != &net_.io_service_); }
+    void dispatch_event(int err);
+    void post_received();
+    void dispatch_posted_event(int err);
+    void dispatch_received(
+        const boost::shared_ptr<std::vector<Datagram> >& batch);
+
     // call to assign local/remote addresses at the point where it
     // is known that underlying socket is live
     void assign_local_addr();
     void assign_remote_addr();
 
     AsioProtonet&                             net_;
+    asio::io_service&                         io_service_;
     asio::ip::tcp::socket                     socket_;
 #ifdef HAVE_ASIO_SSL_HPP
     asio::ssl::stream<asio::ip::tcp::socket>* ssl_socket_;
 #endif // HAVE_ASIO_SSL_HPP
     std::deque<Datagram>                      send_q_;
-    std::vector<gu::byte_t>                   recv_buf_;
+    gu::SharedBuffer                          recv_buf_;
     size_t                                    recv_offset_;
+    std::vector<Datagram>                     recv_batch_;
     State                                     state_;
     // Querying addresses from failed socket does not work,
     // so need to maintain copy for diagnostics logging
@@ -0,0 +1,171 @@
+//
+// Copyright (C) 2015 Codership Oy <info@codership.com>
+//
+
+#include "buffer_pool.hpp"
+
+#include "gu_lock.hpp"
+
+#include <vector>
+
+//
+// Free buffers are kept in power of two size classes, so that a buffer
+// handed out for a message is never more than twice as big as the message.
+//
+class gcomm::BufferPool::Impl
+{
+public:
+
+    Impl(size_t max_size, size_t max_pooled)
+        :
+        mutex_     (),
+        max_size_  (max_size),
+        max_pooled_(max_pooled),
+        free_      (size_class(max_size) + 1)
+    { }
+
+    ~Impl()
+    {
+        for (size_t c(0); c < free_.size(); ++c)
+        {
+            for (size_t i(0); i < free_[c].size(); ++i)
+            {
+                delete free_[c][i];
+            }
+        }
+    }
+
+    gu::Buffer* get(size_t size)
+    {
+        const size_t c(size_class(size));
+        {
+            gu::Lock lock(mutex_);
+            if (free_[c].empty() == false)
+            {
+                gu::Buffer* const ret(free_[c].back());
+                free_[c].pop_back();
+                return ret;
+            }
+        }
+
+        gu::Buffer* const ret(new gu::Buffer());
+        ret->reserve(class_size(c));
+        return ret;
+    }
+
+    void put(gu::Buffer* buf)
+    {
+        const size_t cap(buf->capacity());
+
+        if (cap >= class_size(0))
+        {
+            // capacity may be anything if the buffer was modified by the
+            // user, file it under the largest class that it satisfies
+            size_t c(size_class(cap));
+            if (class_size(c) > cap) --c;
+
+            gu::Lock lock(mutex_);
+            if (c < free_.size() && free_[c].size() < max_pooled_)
+            {
+                free_[c].push_back(buf);
+                return;
+            }
+        }
+
+        delete buf;
+    }
+
+    size_t pooled() const
+    {
+        gu::Lock lock(mutex_);
+        size_t ret(0);
+        for (size_t c(0); c < free_.size(); ++c) ret += free_[c].size();
+        return ret;
+    }
+
+    size_t max_size() const { return max_size_; }
+
+private:
+
+    static const size_t min_class_ = 6; // 64 bytes
+
+    static size_t class_size(size_t c)
+    {
+        return (size_t(1) << (c + min_class_));
+    }
+
+    // index of the smallest class that holds size bytes
+    static size_t size_class(size_t size)
+    {
+        size_t c(0);
+        while (class_size(c) < size) ++c;
+        return c;
+    }
+
+    Impl(const Impl&);
+    void operator=(const Impl&);
+
+    gu::Mutex                              mutex_;
+    size_t const                           max_size_;
+    size_t const                           max_pooled_;
+    std::vector<std::vector<gu::Buffer*> > free_;
+};
+
+// Custom deleter of pooled gu::SharedBuffer, holds the pool alive
+class gcomm::BufferPool::Release
+{
+public:
+
+    Release(const boost::shared_ptr<Impl>& impl) : impl_(impl) { }
+
+    void operator()(gu::Buffer* buf) { impl_->put(buf); }
+
+private:
+
+    boost::shared_ptr<Impl> impl_;
+};
+
+gcomm::BufferPool::BufferPool(size_t max_size, size_t max_pooled)
+    :
+    impl_(new Impl(max_size, max_pooled))
+{ }
+
+gcomm::BufferPool::~BufferPool()
+{ }
+
+gu::SharedBuffer gcomm::BufferPool::acquire(size_t size)
+{
+    if (size > impl_->max_size())
+    {
+        return gu::SharedBuffer(new gu::Buffer(size));
+    }
+
+    gu::SharedBuffer ret(impl_->get(size), Release(impl_));
+    ret->resize(size);
+    return ret;
+}
+
+gu::SharedBuffer gcomm::BufferPool::acquire(const gu::byte_t* begin,
+                                            const gu::byte_t* end)
+{
+    const size_t size(end - begin);
+
+    if (size > impl_->max_size())
+    {
+        return gu::SharedBuffer(new gu::Buffer(begin, end));
+    }
+
+    gu::SharedBuffer ret(impl_->get(size), Release(impl_));
+    ret->assign(begin, end);
+    return ret;
+}
+
+size_t gcomm::BufferPool::max_size() const
+{
+    return impl_->max_size();
+}
+
+size_t gcomm::BufferPool::pooled() const
+{
+    return impl_->pooled();
+}
@@ -0,0 +1,65 @@
+//
+// Copyright (C) 2015 Codership Oy <info@codership.com>
+//
+
+//!
+// @file buffer_pool.hpp Pool of reusable receive buffers.
+//
+// Buffers are handed out as gu::SharedBuffer. When the last reference to
+// the buffer is dropped the buffer is returned to the pool instead of being
+// deleted, so that in steady state receiving a message does not involve
+// heap allocation. Buffers can be released from any thread and may outlive
+// the pool object.
+//
+
+#ifndef GCOMM_BUFFER_POOL_HPP
+#define GCOMM_BUFFER_POOL_HPP
+
+#include "gu_buffer.hpp"
+
+#include <boost/shared_ptr.hpp>
+
+namespace gcomm
+{
+    class BufferPool;
+}
+
+class gcomm::BufferPool
+{
+public:
+
+    //!
+    // @param max_size   Largest buffer capacity worth pooling, larger
+    //                   buffers are allocated and freed as usual
+    // @param max_pooled Maximum number of free buffers kept per size class
+    //
+    BufferPool(size_t max_size, size_t max_pooled);
+    ~BufferPool();
+
+    //!
+    // @return Buffer of given size, contents are unspecified
+    //
+    gu::SharedBuffer acquire(size_t size);
+
+    //!
+    // @return Buffer holding a copy of [begin, end)
+    //
+    gu::SharedBuffer acquire(const gu::byte_t* begin, const gu::byte_t* end);
+
+    size_t max_size() const;
+
+    //! Number of free buffers currently held by the pool
+    size_t pooled() const;
+
+private:
+
+    BufferPool(const BufferPool&);
+    void operator=(const BufferPool&);
+
+    class Impl;
+    class Release;
+
+    boost::shared_ptr<Impl> impl_;
+};
+
+#endif // GCOMM_BUFFER_POOL_HPP
@@ -11,6 +11,7 @@ static std::string const Delim = ".";
 // Protonet
 std::string const gcomm::Conf::ProtonetBackend("protonet.backend");
 std::string const gcomm::Conf::ProtonetVersion("protonet.version");
+std::string const gcomm::Conf::ProtonetSendQueue("protonet.send_queue");
 
 // TCP
 static std::string const SocketPrefix("socket" + Delim);
@@ -18,6 +19,8 @@ std::string const gcomm::Conf::TcpNonBlocking =
     SocketPrefix + "non_blocking";
 std::string const gcomm::Conf::SocketChecksum =
     SocketPrefix + "checksum";
+std::string const gcomm::Conf::SocketIoThreads =
+    SocketPrefix + "io_threads";
 
 // GMCast
 std::string const gcomm::Conf::GMCastScheme = "gmcast";
@@ -121,9 +124,11 @@ gcomm::Conf::register_params(gu::Config& cnf)
 
     GCOMM_CONF_ADD_DEFAULT(ProtonetBackend);
     GCOMM_CONF_ADD_DEFAULT(ProtonetVersion);
+    GCOMM_CONF_ADD_DEFAULT(ProtonetSendQueue);
 
     GCOMM_CONF_ADD        (TcpNonBlocking);
     GCOMM_CONF_ADD_DEFAULT(SocketChecksum);
+    GCOMM_CONF_ADD_DEFAULT(SocketIoThreads);
 
     GCOMM_CONF_ADD_DEFAULT(GMCastVersion);
     GCOMM_CONF_ADD        (GMCastGroup);
@@ -15,7 +15,9 @@ namespace gcomm
 #endif /* HAVE_ASIO_HPP */
 
     std::string const Defaults::ProtonetVersion         = "0";
+    std::string const Defaults::ProtonetSendQueue       = "false";
     std::string const Defaults::SocketChecksum          = "2";
+    std::string const Defaults::SocketIoThreads         = "0";
     std::string const Defaults::GMCastVersion           = "0";
     std::string const Defaults::GMCastTcpPort           = BASE_PORT_DEFAULT;
     std::string const Defaults::GMCastSegment           = "0";
@@ -182,7 +182,6 @@ gcomm::evs::Proto::Proto(gu::Config&    conf,
                     gu::from_string<seqno_t>(Defaults::EvsUserSendWindowMin),
                     send_window_ + 1)),
     output_(),
-    send_buf_(),
     max_output_size_(128),
     mtu_(mtu),
     use_aggregate_(param<bool>(conf, uri, Conf::EvsUseAggregate, "true")),
@@ -234,10 +233,6 @@ gcomm::evs::Proto::Proto(gu::Config&    conf,
         previous_views_.insert(
             std::make_pair(rst_view -> id(), gu::datetime::Date::now()));
     }
-    if (mtu_ != std::numeric_limits<size_t>::max())
-    {
-        send_buf_.reserve(mtu_);
-    }
 }
 
 
@@ -1608,8 +1603,11 @@ int gcomm::evs::Proto::send_user(const seqno_t win)
     size_t alen;
     if (use_aggregate_ == true && (alen = aggregate_len()) > 0)
     {
-        // Messages can be aggregated into single message
-        send_buf_.resize(alen);
+        // Messages can be aggregated into single message. Serialize
+        // directly into the buffer that is handed to input map and
+        // transport, no intermediate copy is needed.
+        gu::SharedBuffer abuf(new gu::Buffer(alen));
+        gu::byte_t* const ab(&(*abuf)[0]);
         size_t offset(0);
         size_t n(0);
 
@@ -1623,21 +1621,21 @@ int gcomm::evs::Proto::send_user(const seqno_t win)
             AggregateMessage am(0, dg.len(), dm.user_type());
             gcomm_assert(alen >= dg.len() + am.serial_size());
 
-            gu_trace(offset = am.serialize(&send_buf_[0],
-                                           send_buf_.size(), offset));
-            std::copy(dg.header() + dg.header_offset(),
-                      dg.header() + dg.header_size(),
-                      &send_buf_[0] + offset);
-            offset += (dg.header_len());
-            std::copy(dg.payload().begin(), dg.payload().end(),
-                      &send_buf_[0] + offset);
+            gu_trace(offset = am.serialize(ab, abuf->size(), offset));
+            memcpy(ab + offset, dg.header() + dg.header_offset(),
+                   dg.header_len());
+            offset += dg.header_len();
+            if (dg.payload().empty() == false)
+            {
+                memcpy(ab + offset, &dg.payload()[0], dg.payload().size());
+            }
             offset += dg.payload().size();
             alen -= dg.len() + am.serial_size();
             ++n;
             ++i;
         }
-        Datagram dg(gu::SharedBuffer(new gu::Buffer(send_buf_.begin(),
-                                                        send_buf_.end())));
+        gcomm_assert(offset == abuf->size());
+        Datagram dg(abuf);
         if ((ret = send_user(dg, 0xff, ord, win, -1, n)) == 0)
         {
             while (n-- > 0)
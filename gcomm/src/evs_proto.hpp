@@ -481,7 +481,6 @@ private:
     seqno_t user_send_window_;
     // Output message queue
     std::deque<std::pair<Datagram, ProtoDownMeta> > output_;
-    std::vector<gu::byte_t> send_buf_;
     uint32_t max_output_size_;
     size_t mtu_;
     bool use_aggregate_;
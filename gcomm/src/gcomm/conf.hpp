@@ -47,6 +47,18 @@ namespace gcomm
         static std::string const ProtonetBackend;
         static std::string const ProtonetVersion;
 
+        /*!
+         * @brief Hand replicated messages over to the protocol thread
+         *        through a send queue ("protonet.send_queue").
+         *
+         * Sending threads then do not enter Protonet critical section but
+         * wait for the protocol thread to send the message. This costs a
+         * thread hand-off per message, so it is off by default and is
+         * meant for the case when the protocol thread has a core of its
+         * own. When the queue is full, messages are sent directly.
+         */
+        static std::string const ProtonetSendQueue;
+
         /*!
          * @brief TCP non-blocking flag ("socket.non_blocking")
          *
@@ -63,6 +75,16 @@ namespace gcomm
          */
         static std::string const SocketChecksum;
 
+        /*!
+         * @brief Number of threads doing TCP socket I/O, including SSL,
+         *        message framing and checksum verification.
+         *
+         * Received messages are handed over to the protocol thread, which
+         * remains the only one to run the protocol stack. With 0 all
+         * socket I/O is done in the protocol thread.
+         */
+        static std::string const SocketIoThreads;
+
         /*!
          * @brief GMCast scheme for transport URI ("gmcast")
          */
@@ -285,14 +285,16 @@ namespace gcomm
     uint32_t crc32(NetHeader::checksum_t type, const Datagram& dg,
                    size_t offset = 0);
 
-    /* returns true if checksum fails */
+    /* returns true if checksum fails, checksum covers data from dg.offset() */
     inline bool check_cs (const NetHeader& hdr, const Datagram& dg)
     {
         if (hdr.has_crc32c())
-            return (crc32(NetHeader::CS_CRC32C, dg) != hdr.crc32());
+            return (crc32(NetHeader::CS_CRC32C, dg, dg.offset()) !=
+                    hdr.crc32());
 
         if (hdr.has_crc32())
-            return (crc32(NetHeader::CS_CRC32, dg)  != hdr.crc32());
+            return (crc32(NetHeader::CS_CRC32, dg, dg.offset())  !=
+                    hdr.crc32());
 
         return (hdr.crc32() != 0);
     }
@@ -97,10 +97,30 @@ public:
     gu::datetime::Date handle_timers();
 
     //!
-    // Interrupt event loop
+    // Interrupt event loop. If event loop is not running, next call
+    // to event_loop() returns promptly. May be called from any thread.
     //
     virtual void interrupt() = 0;
 
+    //!
+    // Interface for work posted to event loop, see post()
+    //
+    class Handler
+    {
+    public:
+        virtual ~Handler() { }
+        virtual void handle() = 0;
+    };
+
+    //!
+    // Run handler from event loop without interrupting it. If event loop
+    // is not running, handler is run during next call to event_loop().
+    // May be called from any thread.
+    //
+    // @param handler Handler to run, must stay valid until run
+    //
+    virtual void post(Handler* handler) = 0;
+
     //!
     // Enter Protonet critical section
     //
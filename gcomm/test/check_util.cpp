@@ -6,6 +6,7 @@
 #include "gcomm/protonet.hpp"
 #include "gcomm/datagram.hpp"
 #include "gcomm/conf.hpp"
+#include "buffer_pool.hpp"
 
 #ifdef HAVE_ASIO_HPP
 #include "asio_protonet.hpp"
@@ -165,6 +166,112 @@ START_TEST(test_asio)
 
 }
 END_TEST
+
+// Collects what protonet passes up, socket events and datagrams must be
+// dispatched in the thread running event loop
+class AsioRecvLayer : public Toplay
+{
+public:
+    AsioRecvLayer(gu::Config& conf)
+        :
+        Toplay (conf),
+        thread_(pthread_self()),
+        events_(0),
+        dgs_   ()
+    { }
+
+    void handle_up(const void* id, const Datagram& dg, const ProtoUpMeta& um)
+    {
+        fail_unless(pthread_equal(pthread_self(), thread_) != 0);
+        fail_unless(um.err_no() == 0, "error %d", um.err_no());
+        if (dg.len() == 0)
+        {
+            ++events_;
+        }
+        else
+        {
+            dgs_.push_back(dg);
+        }
+    }
+
+    size_t events() const { return events_; }
+    const vector<Datagram>& dgs() const { return dgs_; }
+
+private:
+    pthread_t        thread_;
+    size_t           events_;
+    vector<Datagram> dgs_;
+};
+
+START_TEST(test_asio_io_threads)
+{
+    gu::Config conf;
+    gu::ssl_register_params(conf);
+    gcomm::Conf::register_params(conf);
+    conf.set(gcomm::Conf::SocketIoThreads, 2);
+    AsioProtonet pn(conf);
+    AsioRecvLayer rl(conf);
+    Protostack pstack;
+    pstack.push_proto(&rl);
+    pn.insert(&pstack);
+
+    string uri_str("tcp://127.0.0.1:0");
+    Acceptor* acc = pn.acceptor(uri_str);
+    acc->listen(uri_str);
+    uri_str = acc->listen_addr();
+
+    SocketPtr cl = pn.socket(uri_str);
+    cl->connect(uri_str);
+
+    // accept and connect events
+    for (int i(0); i < 100 && rl.events() < 2; ++i)
+    {
+        pn.event_loop(gu::datetime::Sec/10);
+    }
+    fail_unless(rl.events() == 2, "events: %zu", rl.events());
+
+    SocketPtr sr = acc->accept();
+    fail_unless(sr->state() == Socket::S_CONNECTED);
+    fail_unless(cl->state() == Socket::S_CONNECTED);
+
+    // mix of messages copied out of receive buffer and passed up in it
+    const size_t n_msgs(200);
+    for (size_t i = 0; i < n_msgs; ++i)
+    {
+        vector<byte_t> buf(i % 3 ? 100 + i : cl->mtu() - i);
+        for (size_t j = 0; j < buf.size(); ++j)
+        {
+            buf[j] = static_cast<byte_t>((i + j) & 0xff);
+        }
+        Datagram dg(Buffer(&buf[0], &buf[0] + buf.size()));
+        fail_unless(cl->send(dg) == 0);
+    }
+
+    for (int i(0); i < 100 && rl.dgs().size() < n_msgs; ++i)
+    {
+        pn.event_loop(gu::datetime::Sec/10);
+    }
+    fail_unless(rl.dgs().size() == n_msgs, "received: %zu",
+                rl.dgs().size());
+
+    for (size_t i = 0; i < n_msgs; ++i)
+    {
+        const Datagram& dg(rl.dgs()[i]);
+        fail_unless(dg.len() - dg.offset() ==
+                    (i % 3 ? 100 + i : cl->mtu() - i));
+        for (size_t j = 0; j < dg.len() - dg.offset(); ++j)
+        {
+            fail_unless(dg.payload()[dg.offset() + j] ==
+                        static_cast<byte_t>((i + j) & 0xff));
+        }
+    }
+
+    cl->close();
+    sr->close();
+    pn.erase(&pstack);
+    delete acc;
+}
+END_TEST
 #endif // HAVE_ASIO_HPP
 
 START_TEST(test_protonet)
@@ -177,6 +284,49 @@ START_TEST(test_protonet)
 }
 END_TEST
 
+START_TEST(test_buffer_pool)
+{
+    std::auto_ptr<BufferPool> pool(new BufferPool(1 << 12, 2));
+
+    const byte_t* data;
+    {
+        gu::SharedBuffer sb(pool->acquire(100));
+        fail_unless(sb->size() == 100);
+        fail_unless(pool->pooled() == 0);
+        data = &(*sb)[0];
+    }
+    // released buffer goes back to pool and is reused
+    fail_unless(pool->pooled() == 1);
+    {
+        gu::SharedBuffer sb(pool->acquire(120));
+        fail_unless(pool->pooled() == 0);
+        fail_unless(&(*sb)[0] == data);
+    }
+
+    byte_t src[200];
+    for (size_t i(0); i < sizeof(src); ++i) src[i] = static_cast<byte_t>(i);
+    {
+        gu::SharedBuffer sb(pool->acquire(src, src + sizeof(src)));
+        fail_unless(sb->size() == sizeof(src));
+        fail_unless(memcmp(&(*sb)[0], src, sizeof(src)) == 0);
+    }
+
+    // buffers over max size are not pooled
+    const size_t pooled(pool->pooled());
+    {
+        gu::SharedBuffer sb(pool->acquire((1 << 12) + 1));
+        fail_unless(sb->size() == (1 << 12) + 1);
+    }
+    fail_unless(pool->pooled() == pooled);
+
+    // buffer may outlive the pool
+    gu::SharedBuffer sb(pool->acquire(10));
+    pool.reset();
+    sb->resize(1000);
+    sb.reset();
+}
+END_TEST
+
 START_TEST(test_view_state)
 {
     // compare view.
@@ -244,12 +394,21 @@ Suite* util_suite()
     tc = tcase_create("test_asio");
     tcase_add_test(tc, test_asio);
     suite_add_tcase(s, tc);
+
+    tc = tcase_create("test_asio_io_threads");
+    tcase_add_test(tc, test_asio_io_threads);
+    tcase_set_timeout(tc, 30);
+    suite_add_tcase(s, tc);
 #endif // HAVE_ASIO_HPP
 
     tc = tcase_create("test_protonet");
     tcase_add_test(tc, test_protonet);
     suite_add_tcase(s, tc);
 
+    tc = tcase_create("test_buffer_pool");
+    tcase_add_test(tc, test_buffer_pool);
+    suite_add_tcase(s, tc);
+
     tc = tcase_create("test_view_state");
     tcase_add_test(tc, test_view_state);
     suite_add_tcase(s, tc);
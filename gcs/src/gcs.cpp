@@ -16,6 +16,9 @@
 #include <assert.h>
 
 #include <galerautils.h>
+#include <gu_utils.hpp>
+
+#include <algorithm>
 
 #include "gcs_priv.hpp"
 #include "gcs_params.hpp"
@@ -100,6 +103,17 @@ struct gcs_fc_event
 }
 __attribute__((__packed__));
 
+/** Rate hint message (gcs.fc_rate): asks the group to replicate no faster
+ *  than rate actions per second. Distinguished from FC_STOP/FC_CONT by size,
+ *  so it is sent only when the whole group runs GCS_ACT_PROTO_FC_RATE. */
+struct gcs_fc_rate_event
+{
+    uint32_t conf_id; // least significant part of configuraiton seqno
+    uint32_t stop;    // always GCS_FC_CONT
+    uint32_t rate;    // actions per second, 0 cancels the hint
+}
+__attribute__((__packed__));
+
 struct gcs_conn
 {
     long  my_idx;
@@ -125,9 +139,22 @@ struct gcs_conn
     gcs_fifo_lite_t* repl_q;
     gu_thread_t      send_thread;
 
+    /* Aggregation of small replicated actions (gcs.agg_max_acts) */
+    gu_mutex_t            agg_lock;
+    gu_cond_t             agg_cond;  // signaled when aggregate is full
+    struct gcs_repl_act*  agg_head;  // actions pending aggregation
+    struct gcs_repl_act*  agg_tail;
+    long                  agg_num;   // number of pending actions
+    long                  agg_size;  // size of pending actions with headers
+    struct gcs_repl_act** agg_batch; // the rest is used only in send monitor
+    uint32_t*             agg_hdrs;
+    struct gu_buf*        agg_bufs;
+    long                  agg_bufs_len;
+
     /* A queue for threads waiting for received actions */
-    gu_fifo_t*   recv_q;
+    gu_lfq_t*    recv_q;
     ssize_t      recv_q_size;
+    gu_mutex_t   recv_lock;   // protects flow control state of recv_q
     gu_thread_t  recv_thread;
 
     /* Message receiving timeout - absolute date in nanoseconds */
@@ -138,7 +165,7 @@ struct gcs_conn
     uint32_t     conf_id;             // configuration ID
     long         stop_sent;           // how many STOPs - CONTs were sent
     long         stop_count;          // counts stop requests received
-    long         queue_len;           // slave queue length
+    long         queue_len;           // slave queue length (recv_lock)
     long         upper_limit;         // upper slave queue limit
     long         lower_limit;         // lower slave queue limit
     long         fc_offset;           // offset for catchup phase
@@ -147,6 +174,14 @@ struct gcs_conn
     long         stats_fc_received;   //
     gcs_fc_t     stfc; // state transfer FC object
 
+    /* Rate-based flow control */
+    gcs_fc_rate_t fc_rate;            // protected by fc_lock
+    bool          fc_rate_proto;      // group understands rate hints
+    gu_mutex_t    pace_lock;
+    gcs_fc_pace_t pace;               // protected by pace_lock
+    long          stats_fc_rate_sent;
+    long          stats_fc_rate_received;
+
     /* #603, #606 join control */
     bool        volatile need_to_join;
     gcs_seqno_t volatile join_seqno;
@@ -175,10 +210,16 @@ struct gcs_repl_act
     struct gcs_action*   action;
     gu_mutex_t           wait_mutex;
     gu_cond_t            wait_cond;
+    struct gcs_repl_act* agg_next;  // next action pending aggregation
+    long                 agg_ret;   // aggregation state or error code
+    bool                 delivered; // set under wait_mutex
     gcs_repl_act(const struct gu_buf* a_act_in, struct gcs_action* a_action)
       :
         act_in(a_act_in),
-        action(a_action)
+        action(a_action),
+        agg_next(NULL),
+        agg_ret(0),
+        delivered(false)
     { }
 };
 
@@ -268,7 +309,7 @@ gcs_create (gu_config_t* const conf, gcache_t* const gcache,
         size_t recv_q_len = gu_avphys_bytes() / sizeof(struct gcs_recv_act) / 4;
 
         gu_debug ("Requesting recv queue len: %zu", recv_q_len);
-        conn->recv_q = gu_fifo_create (recv_q_len, sizeof(struct gcs_recv_act));
+        conn->recv_q = gu_lfq_create (recv_q_len, sizeof(struct gcs_recv_act));
     }
     if (!conn->recv_q) {
         gu_error ("Failed to create recv_q.");
@@ -282,6 +323,17 @@ gcs_create (gu_config_t* const conf, gcache_t* const gcache,
         goto sm_create_failed;
     }
 
+    if (conn->params.agg_max_acts > 1) {
+        conn->agg_batch = GU_CALLOC (conn->params.agg_max_acts,
+                                     struct gcs_repl_act*);
+        conn->agg_hdrs  = GU_CALLOC (conn->params.agg_max_acts, uint32_t);
+
+        if (!conn->agg_batch || !conn->agg_hdrs) {
+            gu_error ("Failed to allocate aggregation buffers");
+            goto agg_alloc_failed;
+        }
+    }
+
     conn->state        = GCS_CONN_CLOSED;
     conn->my_idx       = -1;
     conn->local_act_id = GCS_SEQNO_FIRST;
@@ -293,12 +345,27 @@ gcs_create (gu_config_t* const conf, gcache_t* const gcache,
         GCS_CONN_DONOR : GCS_CONN_JOINED;
 
     gu_mutex_init (&conn->fc_lock, NULL);
+    gu_mutex_init (&conn->recv_lock, NULL);
+
+    conn->fc_rate_proto = false;
+    gcs_fc_rate_reset (&conn->fc_rate, gcs_fc_now());
+    gcs_fc_rate_debug (&conn->fc_rate, conn->params.fc_debug);
+    gu_mutex_init (&conn->pace_lock, NULL);
+
+    gu_mutex_init (&conn->agg_lock, NULL);
+    gu_cond_init  (&conn->agg_cond, NULL);
 
     return conn; // success
 
+agg_alloc_failed:
+
+    gu_free (conn->agg_batch);
+    gu_free (conn->agg_hdrs);
+    gcs_sm_destroy (conn->sm);
+
 sm_create_failed:
 
-    gu_fifo_destroy (conn->recv_q);
+    gu_lfq_destroy (conn->recv_q);
 
 recv_q_failed:
 
@@ -371,7 +438,8 @@ gcs_send_fc_event (gcs_conn_t* conn, bool stop)
     return gcs_core_send_fc (conn->core, &fc, sizeof(fc));
 }
 
-/* To be called under slave queue lock. Returns true if FC_STOP must be sent */
+/* To be called under recv_lock with queue_len just updated.
+ * Returns true if FC_STOP must be sent */
 static inline bool
 gcs_fc_stop_begin (gcs_conn_t* conn)
 {
@@ -420,7 +488,8 @@ gcs_fc_stop_end (gcs_conn_t* conn)
     return ret;
 }
 
-/* To be called under slave queue lock. Returns true if FC_CONT must be sent */
+/* To be called under recv_lock with queue_len just updated.
+ * Returns true if FC_CONT must be sent */
 static inline bool
 gcs_fc_cont_begin (gcs_conn_t* conn)
 {
@@ -468,7 +537,92 @@ gcs_fc_cont_end (gcs_conn_t* conn)
     return ret;
 }
 
-/* To be called under slave queue lock. Returns true if SYNC must be sent */
+static inline long
+gcs_send_fc_rate (gcs_conn_t* conn, double rate)
+{
+    struct gcs_fc_rate_event fc = { htogl(conn->conf_id), GCS_FC_CONT,
+                                    htogl(uint32_t(ceil(rate))) };
+    return gcs_core_send_fc (conn->core, &fc, sizeof(fc));
+}
+
+/* slave queue length at which rate hints try to keep it */
+static inline long
+gcs_fc_rate_target (gcs_conn_t* conn)
+{
+    return std::max (conn->upper_limit / 2, 1L) + conn->fc_offset;
+}
+
+/* To be called under recv_lock. Returns true if rate hint must be sent,
+ * then fc_lock is left locked */
+static inline bool
+gcs_fc_rate_begin (gcs_conn_t* conn, long const acts)
+{
+    if (gu_likely(!conn->params.fc_rate ||
+                  conn->state > conn->max_fc_state)) return false;
+
+    long err;
+
+    if (gu_unlikely(err = gu_mutex_lock (&conn->fc_lock))) {
+        gu_fatal ("Mutex lock failed: %d (%s)", err, strerror(err));
+        abort();
+    }
+
+    /* old nodes would take a hint for FC_CONT */
+    double const hint = conn->fc_rate_proto ?
+        gcs_fc_rate_process (&conn->fc_rate, acts, conn->queue_len,
+                             gcs_fc_rate_target (conn), gcs_fc_now()) : -1.0;
+
+    if (hint < 0.0) {
+        gu_mutex_unlock (&conn->fc_lock);
+        return false;
+    }
+
+    return true;
+}
+
+/* Complement to gcs_fc_rate_begin() */
+static inline long
+gcs_fc_rate_end (gcs_conn_t* conn)
+{
+    long ret;
+
+    gu_debug ("SENDING FC_RATE %.1f (local seqno: %lld, queue: %ld)",
+              conn->fc_rate.hint, conn->local_act_id, conn->queue_len);
+
+    ret = gcs_send_fc_rate (conn, conn->fc_rate.hint);
+
+    if (gu_likely (ret >= 0)) {
+        ret = 0;
+        conn->stats_fc_rate_sent++;
+    }
+    else {
+        gcs_fc_rate_undo (&conn->fc_rate); // will retry with the next action
+    }
+
+    gu_mutex_unlock (&conn->fc_lock);
+
+    ret = gcs_check_error (ret, "Failed to send FC_RATE hint");
+
+    return ret;
+}
+
+/* Delays local replication according to rate hints from the group */
+static inline void
+gcs_fc_pace_wait (gcs_conn_t* conn)
+{
+    if (gu_likely(!conn->params.fc_rate)) return;
+
+    long long delay;
+
+    gu_mutex_lock (&conn->pace_lock);
+    delay = gcs_fc_pace_delay (&conn->pace, gcs_fc_now());
+    gu_mutex_unlock (&conn->pace_lock);
+
+    if (delay > 0) gcs_fc_sleep (delay);
+}
+
+/* To be called under recv_lock with queue_len just updated.
+ * Returns true if SYNC must be sent */
 static inline bool
 gcs_send_sync_begin (gcs_conn_t* conn)
 {
@@ -515,7 +669,16 @@ gcs_send_sync_end (gcs_conn_t* conn)
 static inline long
 gcs_send_sync (gcs_conn_t* conn)
 {
-    if (gcs_send_sync_begin (conn)) {
+    bool send_sync;
+
+    gu_mutex_lock (&conn->recv_lock);
+    {
+        conn->queue_len = gu_lfq_length (conn->recv_q);
+        send_sync = gcs_send_sync_begin (conn);
+    }
+    gu_mutex_unlock (&conn->recv_lock);
+
+    if (send_sync) {
         return gcs_send_sync_end (conn);
     }
     else {
@@ -604,6 +767,26 @@ _release_flow_control (gcs_conn_t* conn)
         gu_mutex_unlock (&conn->fc_lock);
     }
 
+    if (!err && conn->params.fc_rate) {
+        /* cancel rate hint, if any */
+        gu_mutex_lock (&conn->recv_lock);
+        if (gu_unlikely(err = gu_mutex_lock (&conn->fc_lock))) {
+            gu_fatal ("Mutex lock failed: %d (%s)", err, strerror(err));
+            abort();
+        }
+        bool const cancel = (conn->fc_rate.hint > 0.0);
+        if (cancel) {
+            conn->fc_rate.prev = conn->fc_rate.hint;
+            conn->fc_rate.hint = 0.0;
+        }
+        else {
+            gu_mutex_unlock (&conn->fc_lock);
+        }
+        gu_mutex_unlock (&conn->recv_lock);
+
+        if (cancel) err = gcs_fc_rate_end (conn);
+    }
+
     return err;
 }
 
@@ -716,7 +899,7 @@ gcs_become_joined (gcs_conn_t* conn)
 
     /* See also gcs_handle_act_conf () for a case of cluster bootstrapping */
     if (gcs_shift_state (conn, GCS_CONN_JOINED)) {
-        conn->fc_offset    = conn->queue_len;
+        conn->fc_offset    = gu_lfq_length (conn->recv_q);
         conn->need_to_join = false;
         gu_debug("Become joined, FC offset %ld", conn->fc_offset);
         /* One of the cases when the node can become SYNCED */
@@ -738,7 +921,7 @@ gcs_become_synced (gcs_conn_t* conn)
     conn->fc_offset = 0;
 }
 
-/* to be called under protection of both recv_q and fc_lock */
+/* to be called under protection of both recv_lock and fc_lock */
 static void
 _set_fc_limits (gcs_conn_t* conn)
 {
@@ -754,17 +937,42 @@ _set_fc_limits (gcs_conn_t* conn)
              conn->lower_limit, conn->upper_limit);
 }
 
+/*! Handles rate hint from a group member */
+static void
+gcs_handle_fc_rate (gcs_conn_t*                     conn,
+                    const struct gcs_fc_rate_event* fc,
+                    long                            sender_idx)
+{
+    double const rate = gtohl(fc->rate);
+
+    conn->stats_fc_rate_received += (rate > 0.0);
+
+    gu_mutex_lock (&conn->pace_lock);
+    gcs_fc_pace_hint (&conn->pace, sender_idx, rate);
+    gu_mutex_unlock (&conn->pace_lock);
+}
+
 /*! Handles flow control events
  *  (this is frequent, so leave it inlined) */
 static inline void
 gcs_handle_flow_control (gcs_conn_t*                conn,
-                         const struct gcs_fc_event* fc)
+                         const struct gcs_fc_event* fc,
+                         size_t                     fc_size,
+                         long                       sender_idx)
 {
     if (gtohl(fc->conf_id) != (uint32_t)conn->conf_id) {
         // obsolete fc request
         return;
     }
 
+    if (sizeof(struct gcs_fc_rate_event) == fc_size) {
+        gcs_handle_fc_rate (conn, (const struct gcs_fc_rate_event*)fc,
+                            sender_idx);
+        return;
+    }
+
+    assert (sizeof(struct gcs_fc_event) == fc_size);
+
     conn->stop_count += ((fc->stop != 0) << 1) - 1; // +1 if !0, -1 if 0
     conn->stats_fc_received += (fc->stop != 0);
 
@@ -823,7 +1031,7 @@ gcs_handle_act_conf (gcs_conn_t* conn, const void* action)
 
     conn->my_idx = conf->my_idx;
 
-    gu_fifo_lock(conn->recv_q);
+    gu_mutex_lock (&conn->recv_lock);
     {
         /* reset flow control as membership is most likely changed */
         if (!gu_mutex_lock (&conn->fc_lock)) {
@@ -834,6 +1042,22 @@ gcs_handle_act_conf (gcs_conn_t* conn, const void* action)
 
             _set_fc_limits (conn);
 
+            /* rate hints are sent anew by the members that still need them */
+            gcs_fc_rate_reset (&conn->fc_rate, gcs_fc_now());
+            conn->fc_rate_proto =
+                (conf->conf_id >= 0 && /* no protocol outside PRIM */
+                 gcs_core_group_protocol_version (conn->core) >=
+                 GCS_ACT_PROTO_FC_RATE);
+
+            gu_mutex_lock (&conn->pace_lock);
+            if (conf->memb_num > 0 &&
+                gcs_fc_pace_init (&conn->pace, conf->memb_num)) {
+                gu_fatal ("Failed to allocate rate hints for %d members.",
+                          conf->memb_num);
+                abort();
+            }
+            gu_mutex_unlock (&conn->pace_lock);
+
             gu_mutex_unlock (&conn->fc_lock);
         }
         else {
@@ -846,7 +1070,7 @@ gcs_handle_act_conf (gcs_conn_t* conn, const void* action)
         // need to wake up send monitor if it was paused during CC
         gcs_sm_continue(conn->sm);
     }
-    gu_fifo_release (conn->recv_q);
+    gu_mutex_unlock (&conn->recv_lock);
 
     if (conf->conf_id < 0) {
         if (0 == conf->memb_num) {
@@ -918,11 +1142,12 @@ gcs_handle_act_conf (gcs_conn_t* conn, const void* action)
     {
         bool send_sync = false;
 
-        gu_fifo_lock(conn->recv_q);
+        gu_mutex_lock (&conn->recv_lock);
         {
+            conn->queue_len = gu_lfq_length (conn->recv_q);
             send_sync = gcs_send_sync_begin(conn);
         }
-        gu_fifo_release (conn->recv_q);
+        gu_mutex_unlock (&conn->recv_lock);
 
         if (send_sync && (ret = gcs_send_sync_end (conn))) {
             gu_warn ("CC: sending SYNC failed: %ld (%s)", ret, strerror (-ret));
@@ -999,8 +1224,8 @@ gcs_handle_actions (gcs_conn_t*          conn,
 
     switch (rcvd->act.type) {
     case GCS_ACT_FLOW:
-        assert (sizeof(struct gcs_fc_event) == rcvd->act.buf_len);
-        gcs_handle_flow_control (conn, (const gcs_fc_event*)rcvd->act.buf);
+        gcs_handle_flow_control (conn, (const gcs_fc_event*)rcvd->act.buf,
+                                 rcvd->act.buf_len, rcvd->sender_idx);
         break;
     case GCS_ACT_CONF:
         gcs_handle_act_conf (conn, rcvd->act.buf);
@@ -1028,11 +1253,20 @@ gcs_handle_actions (gcs_conn_t*          conn,
     return ret;
 }
 
-static inline void
-GCS_FIFO_PUSH_TAIL (gcs_conn_t* conn, ssize_t size)
+/* configuration change cancels recv_q gets until gcs_resume_recv() */
+static inline long
+GCS_FIFO_PUSH_TAIL (gcs_conn_t* conn, const struct gcs_recv_act* act)
 {
-    conn->recv_q_size += size;
-    gu_fifo_push_tail(conn->recv_q);
+    ssize_t const size = act->rcvd.act.buf_len;
+
+    gu_atomic_fetch_and_add (&conn->recv_q_size, size);
+
+    long const ret = gu_lfq_push (conn->recv_q, act,
+                                  GCS_ACT_CONF == act->rcvd.act.type);
+
+    if (gu_unlikely (ret)) gu_atomic_fetch_and_sub (&conn->recv_q_size, size);
+
+    return ret;
 }
 
 /* Returns true if timeout was handled and false otherwise */
@@ -1150,6 +1384,7 @@ _close(gcs_conn_t* conn, bool join_recv_thread)
              * they'll quit on their own,
              * they don't depend on the conn object after waking */
             gu_mutex_lock   (&act->wait_mutex);
+            act->delivered = true;
             gu_cond_signal  (&act->wait_cond);
             gu_mutex_unlock (&act->wait_mutex);
         }
@@ -1159,12 +1394,183 @@ _close(gcs_conn_t* conn, bool join_recv_thread)
         // FIXME: this can block waiting for applicaiton threads to fetch all
         // items. In certain situations this can block forever. Ticket #113
         gu_info ("Closing slave action queue.");
-        gu_fifo_close (conn->recv_q);
+        gu_lfq_close (conn->recv_q);
     }
 
     return ret;
 }
 
+/*
+ * Delivers received action either to the waiting gcs_repl() thread or to
+ * recv_q. agg_local means that the action came out of local aggregate and
+ * belongs to the head of repl_q regardless of its local buffer.
+ *
+ * @return 0 on success or negative error code
+ */
+static long
+gcs_deliver (gcs_conn_t* conn, struct gcs_act_rcvd* rcvd, bool agg_local)
+{
+    gcs_seqno_t this_act_id = GCS_SEQNO_ILL;
+    struct gcs_repl_act** repl_act_ptr;
+    long ret;
+
+    /* deliver to application (note matching assert in the bottom-half of
+     * gcs_repl()) */
+    if (gu_likely (rcvd->act.type != GCS_ACT_TORDERED ||
+                   (rcvd->id > 0 && (conn->global_seqno = rcvd->id)))) {
+        /* successful delivery - increment local order */
+        this_act_id = gu_atomic_fetch_and_add(&conn->local_act_id, 1);
+
+        if (conn->params.fc_rate && GCS_ACT_TORDERED == rcvd->act.type) {
+            gu_mutex_lock (&conn->pace_lock);
+            gcs_fc_pace_account (&conn->pace,
+                                 conn->my_idx == rcvd->sender_idx);
+            gu_mutex_unlock (&conn->pace_lock);
+        }
+    }
+
+    if (NULL != rcvd->local                                          &&
+        (repl_act_ptr = (struct gcs_repl_act**)
+         gcs_fifo_lite_get_head (conn->repl_q))                     &&
+        (gu_likely ((*repl_act_ptr)->act_in == rcvd->local || agg_local) ||
+         /* at this point repl_q is locked and we need to unlock it and
+          * return false to fall to the 'else' branch; unlikely case */
+         (gcs_fifo_lite_release (conn->repl_q), false)))
+    {
+        /* local action from repl_q */
+        struct gcs_repl_act* repl_act = *repl_act_ptr;
+        gcs_fifo_lite_pop_head (conn->repl_q);
+
+        assert (repl_act->action->type == rcvd->act.type);
+        assert (repl_act->action->size == rcvd->act.buf_len ||
+                repl_act->action->type == GCS_ACT_STATE_REQ);
+
+        repl_act->action->buf     = rcvd->act.buf;
+        repl_act->action->seqno_g = rcvd->id;
+        repl_act->action->seqno_l = this_act_id;
+
+        gu_mutex_lock   (&repl_act->wait_mutex);
+        repl_act->delivered = true;
+        gu_cond_signal  (&repl_act->wait_cond);
+        gu_mutex_unlock (&repl_act->wait_mutex);
+    }
+    else if (gu_likely(this_act_id >= 0))
+    {
+        /* remote/non-repl'ed action */
+        struct gcs_recv_act recv_act;
+
+        recv_act.rcvd     = *rcvd;
+        recv_act.local_id = this_act_id;
+
+        long const queue_len = gu_lfq_length (conn->recv_q) + 1;
+        bool       send_stop = false;
+
+        if (gu_unlikely(queue_len > conn->upper_limit + conn->fc_offset)) {
+            /* STOP must be accounted before the action is seen by
+             * gcs_recv(), otherwise CONT might be never sent */
+            gu_mutex_lock (&conn->recv_lock);
+            conn->queue_len = gu_lfq_length (conn->recv_q) + 1;
+            send_stop = gcs_fc_stop_begin (conn);
+            gu_mutex_unlock (&conn->recv_lock);
+        }
+
+        if (gu_likely (0 == GCS_FIFO_PUSH_TAIL (conn, &recv_act))) {
+
+            if (gu_unlikely(GCS_CONN_JOINER == conn->state)) {
+                ret = _check_recv_queue_growth (conn, rcvd->act.buf_len);
+                assert (ret <= 0);
+                if (ret < 0) return ret;
+            }
+
+            if (gu_unlikely(send_stop) && (ret = gcs_fc_stop_end(conn))) {
+                gu_error ("gcs_fc_stop() returned %d: %s",
+                          ret, strerror(-ret));
+                return ret;
+            }
+        }
+        else {
+            if (send_stop) gcs_fc_stop_end (conn); // releases fc_lock
+            assert (GCS_CONN_CLOSED == conn->state);
+            return -EBADFD;
+        }
+//        gu_info("Received foreign action of type %d, size %d, id=%llu, "
+//                "action %p", rcvd->act.type, rcvd->act.buf_len,
+//                this_act_id, rcvd->act.buf);
+    }
+    else if (conn->my_idx == rcvd->sender_idx)
+    {
+        gu_fatal("Protocol violation: unordered local action not in repl_q:"
+                 " { {%p, %zd, %s}, %ld, %lld }.",
+                 rcvd->act.buf, rcvd->act.buf_len,
+                 gcs_act_type_to_str(rcvd->act.type), rcvd->sender_idx,
+                 rcvd->id);
+        assert(0);
+        return -ENOTRECOVERABLE;
+    }
+    else
+    {
+        gu_fatal ("Protocol violation: unordered remote action: "
+                  "{ {%p, %zd, %s}, %ld, %lld }",
+                  rcvd->act.buf, rcvd->act.buf_len,
+                  gcs_act_type_to_str(rcvd->act.type), rcvd->sender_idx,
+                  rcvd->id);
+        assert (0);
+        return -ENOTRECOVERABLE;
+    }
+
+    return 0;
+}
+
+/*
+ * Delivers aggregated action as act_num separate actions with consecutive
+ * seqnos. Defragmenter has already put every action into its own gcache
+ * buffer (see gcs_defrag_handle_frag()), so that it can be released
+ * independently of others, here we only release the buffer array.
+ *
+ * @return 0 on success or negative error code
+ */
+static long
+gcs_deliver_aggregate (gcs_conn_t* conn, struct gcs_act_rcvd* rcvd)
+{
+    assert (GCS_ACT_TORDERED == rcvd->act.type);
+    assert (rcvd->act_num > 1);
+
+    bool const agg_local = (NULL != rcvd->local);
+#ifndef GCS_FOR_GARB
+    const struct gu_buf* const acts =
+        static_cast<const struct gu_buf*>(rcvd->act.buf);
+#endif
+    long ret = 0;
+    int  i;
+
+    for (i = 0; i < rcvd->act_num && 0 == ret; ++i)
+    {
+        struct gcs_act_rcvd sub(*rcvd);
+
+        sub.act_num = 1;
+        if (rcvd->id > 0) sub.id = rcvd->id + i; // else error code for all
+
+#ifndef GCS_FOR_GARB
+        sub.act.buf     = acts[i].ptr;
+        sub.act.buf_len = acts[i].size;
+#else
+        sub.act.buf     = NULL;
+        sub.act.buf_len = 0;
+#endif /* GCS_FOR_GARB */
+
+        ret = gcs_deliver (conn, &sub, agg_local);
+    }
+
+#ifndef GCS_FOR_GARB
+    /* release actions that were not delivered because of error */
+    for (; i < rcvd->act_num; ++i) gcs_gcache_free (conn->gcache, acts[i].ptr);
+
+    gu_free (const_cast<struct gu_buf*>(acts));
+#endif /* GCS_FOR_GARB */
+
+    return ret;
+}
+
 /*
  * gcs_recv_thread() receives whatever actions arrive from group,
  * and performs necessary actions based on action type.
@@ -1183,8 +1589,6 @@ static void *gcs_recv_thread (void *arg)
 
     while (conn->state < GCS_CONN_CLOSED)
     {
-        gcs_seqno_t this_act_id = GCS_SEQNO_ILL;
-        struct gcs_repl_act** repl_act_ptr;
         struct gcs_act_rcvd   rcvd;
 
         ret = gcs_core_recv (conn->core, &rcvd, conn->timeout);
@@ -1193,18 +1597,17 @@ static void *gcs_recv_thread (void *arg)
 
             if (-ETIMEDOUT == ret && _handle_timeout(conn)) continue;
 
-            struct gcs_recv_act* err_act =
-                (struct gcs_recv_act*) gu_fifo_get_tail(conn->recv_q);
+            struct gcs_recv_act err_act;
 
             assert (NULL          == rcvd.act.buf);
             assert (0             == rcvd.act.buf_len);
             assert (GCS_ACT_ERROR == rcvd.act.type);
             assert (GCS_SEQNO_ILL == rcvd.id);
 
-            err_act->rcvd     = rcvd;
-            err_act->local_id = GCS_SEQNO_ILL;
+            err_act.rcvd     = rcvd;
+            err_act.local_id = GCS_SEQNO_ILL;
 
-            GCS_FIFO_PUSH_TAIL (conn, rcvd.act.buf_len);
+            GCS_FIFO_PUSH_TAIL (conn, &err_act); // fails only if closed
 
             gu_debug ("gcs_core_recv returned %d: %s", ret, strerror(-ret));
             break;
@@ -1228,98 +1631,11 @@ static void *gcs_recv_thread (void *arg)
             if (gu_likely(ret <= 0)) continue; // not for application
         }
 
-        /* deliver to application (note matching assert in the bottom-half of
-         * gcs_repl()) */
-        if (gu_likely (rcvd.act.type != GCS_ACT_TORDERED ||
-                       (rcvd.id > 0 && (conn->global_seqno = rcvd.id)))) {
-            /* successful delivery - increment local order */
-            this_act_id = gu_atomic_fetch_and_add(&conn->local_act_id, 1);
-        }
-
-        if (NULL != rcvd.local                                          &&
-            (repl_act_ptr = (struct gcs_repl_act**)
-             gcs_fifo_lite_get_head (conn->repl_q))                     &&
-            (gu_likely ((*repl_act_ptr)->act_in == rcvd.local)  ||
-             /* at this point repl_q is locked and we need to unlock it and
-              * return false to fall to the 'else' branch; unlikely case */
-             (gcs_fifo_lite_release (conn->repl_q), false)))
-        {
-            /* local action from repl_q */
-            struct gcs_repl_act* repl_act = *repl_act_ptr;
-            gcs_fifo_lite_pop_head (conn->repl_q);
-
-            assert (repl_act->action->type == rcvd.act.type);
-            assert (repl_act->action->size == rcvd.act.buf_len ||
-                    repl_act->action->type == GCS_ACT_STATE_REQ);
-
-            repl_act->action->buf     = rcvd.act.buf;
-            repl_act->action->seqno_g = rcvd.id;
-            repl_act->action->seqno_l = this_act_id;
-
-            gu_mutex_lock   (&repl_act->wait_mutex);
-            gu_cond_signal  (&repl_act->wait_cond);
-            gu_mutex_unlock (&repl_act->wait_mutex);
-        }
-        else if (gu_likely(this_act_id >= 0))
-        {
-            /* remote/non-repl'ed action */
-            struct gcs_recv_act* recv_act =
-                (struct gcs_recv_act*)gu_fifo_get_tail (conn->recv_q);
-
-            if (gu_likely (NULL != recv_act)) {
-
-                recv_act->rcvd     = rcvd;
-                recv_act->local_id = this_act_id;
-
-                conn->queue_len = gu_fifo_length (conn->recv_q) + 1;
-                bool send_stop  = gcs_fc_stop_begin (conn);
-
-                // release queue
-                GCS_FIFO_PUSH_TAIL (conn, rcvd.act.buf_len);
-
-                if (gu_unlikely(GCS_CONN_JOINER == conn->state)) {
-                    ret = _check_recv_queue_growth (conn, rcvd.act.buf_len);
-                    assert (ret <= 0);
-                    if (ret < 0) break;
-                }
-
-                if (gu_unlikely(send_stop) && (ret = gcs_fc_stop_end(conn))) {
-                    gu_error ("gcs_fc_stop() returned %d: %s",
-                              ret, strerror(-ret));
-                    break;
-                }
-            }
-            else {
-                assert (GCS_CONN_CLOSED == conn->state);
-                ret = -EBADFD;
-                break;
-            }
-//            gu_info("Received foreign action of type %d, size %d, id=%llu, "
-//                    "action %p", rcvd.act.type, rcvd.act.buf_len,
-//                    this_act_id, rcvd.act.buf);
-        }
-        else if (conn->my_idx == rcvd.sender_idx)
-        {
-            gu_fatal("Protocol violation: unordered local action not in repl_q:"
-                     " { {%p, %zd, %s}, %ld, %lld }.",
-                     rcvd.act.buf, rcvd.act.buf_len,
-                     gcs_act_type_to_str(rcvd.act.type), rcvd.sender_idx,
-                     rcvd.id);
-            assert(0);
-            ret = -ENOTRECOVERABLE;
-            break;
-        }
-        else
-        {
-            gu_fatal ("Protocol violation: unordered remote action: "
-                      "{ {%p, %zd, %s}, %ld, %lld }",
-                      rcvd.act.buf, rcvd.act.buf_len,
-                      gcs_act_type_to_str(rcvd.act.type), rcvd.sender_idx,
-                      rcvd.id);
-            assert (0);
-            ret = -ENOTRECOVERABLE;
-            break;
+        /* deliver to application */
+        if (gu_likely(1 == rcvd.act_num)) {
+            if ((ret = gcs_deliver (conn, &rcvd, false)) < 0) break;
         }
+        else if ((ret = gcs_deliver_aggregate (conn, &rcvd)) < 0) break;
     }
 
     if (ret > 0) {
@@ -1361,7 +1677,7 @@ long gcs_open (gcs_conn_t* conn, const char* channel, const char* url,
             if (!(ret = gu_thread_create (&conn->recv_thread, NULL,
                                           gcs_recv_thread, conn))) {
                 gcs_fifo_lite_open(conn->repl_q);
-                gu_fifo_open(conn->recv_q);
+                gu_lfq_open(conn->recv_q);
                 gcs_shift_state (conn, GCS_CONN_OPEN);
                 gu_info ("Opened channel '%s'", channel);
                 conn->inner_close_count = 0;
@@ -1443,7 +1759,7 @@ long gcs_destroy (gcs_conn_t *conn)
         }
 
         /* this should cancel all recv calls */
-        gu_fifo_destroy (conn->recv_q);
+        gu_lfq_destroy (conn->recv_q);
 
         gcs_shift_state (conn, GCS_CONN_DESTROYED);
 //DELETE        conn->err   = -EBADFD;
@@ -1472,6 +1788,16 @@ long gcs_destroy (gcs_conn_t *conn)
 
     /* This must not last for long */
     while (gu_mutex_destroy (&conn->fc_lock));
+    while (gu_mutex_destroy (&conn->recv_lock));
+    while (gu_mutex_destroy (&conn->pace_lock));
+    while (gu_mutex_destroy (&conn->agg_lock));
+    gu_cond_destroy (&conn->agg_cond);
+
+    gcs_fc_pace_free (&conn->pace);
+
+    gu_free (conn->agg_batch);
+    gu_free (conn->agg_hdrs);
+    gu_free (conn->agg_bufs);
 
     _cleanup_params (conn);
 
@@ -1494,6 +1820,8 @@ long gcs_sendv (gcs_conn_t*          const conn,
     /*! locking connection here to avoid race with gcs_close()
      *  @note: gcs_repl() and gcs_recv() cannot lock connection
      *         because they block indefinitely waiting for actions */
+    if (GCS_ACT_TORDERED == act_type) gcs_fc_pace_wait (conn);
+
     gu_cond_t tmp_cond;
     gu_cond_init (&tmp_cond, NULL);
 
@@ -1524,6 +1852,371 @@ gcs_seqno_t gcs_caused(gcs_conn_t* conn)
     return gcs_core_caused(conn->core);
 }
 
+/*! Sorts out the result of replication after the action was delivered
+ *  (or the waiter was woken by _close()) */
+static long
+gcs_repl_result (gcs_conn_t*        const conn,
+                 struct gcs_action* const act,
+                 const void*        const orig_buf,
+                 long                     ret)
+{
+#ifndef GCS_FOR_GARB
+    /* assert (act->buf != 0); */
+    if (act->buf == 0)
+    {
+        /* Recv thread purged repl_q before action was delivered */
+        return -ENOTCONN;
+    }
+#else
+    assert (act->buf == 0);
+#endif /* GCS_FOR_GARB */
+
+    if (act->seqno_g < 0) {
+        assert (GCS_SEQNO_ILL    == act->seqno_l ||
+                GCS_ACT_TORDERED != act->type);
+
+        if (act->seqno_g == GCS_SEQNO_ILL) {
+            /* action was not replicated for some reason */
+            assert (orig_buf == act->buf);
+            ret = -EINTR;
+        }
+        else {
+            /* core provided an error code in global seqno */
+            assert (orig_buf != act->buf);
+            ret = act->seqno_g;
+            act->seqno_g = GCS_SEQNO_ILL;
+        }
+
+        if (orig_buf != act->buf) // action was allocated in gcache
+        {
+            gu_debug("Freeing gcache buffer %p after receiving %d",
+                     act->buf, ret);
+            gcs_gcache_free (conn->gcache, act->buf);
+            act->buf = orig_buf;
+        }
+    }
+
+    return ret;
+}
+
+/*
+ * Aggregation of small totally ordered actions (gcs.agg_max_acts).
+ *
+ * Replicating threads register their actions in agg queue before entering
+ * send monitor. Whoever enters the monitor first, takes pending actions
+ * (possibly waiting up to gcs.agg_max_delay for more) and sends them in one
+ * message. The rest find their actions already sent when their turn comes.
+ * Aggregated message is a sequence of [32-bit size][action] records.
+ */
+static size_t const GCS_AGG_HDR_SIZE = sizeof(uint32_t);
+
+static long const GCS_AGG_PENDING = 1; // action is in agg queue
+static long const GCS_AGG_TAKEN   = 0; // action is being sent or was sent
+
+static inline bool
+gcs_agg_eligible (const gcs_conn_t* const conn, const struct gcs_action* act)
+{
+    return (conn->params.agg_max_acts > 1 && GCS_ACT_TORDERED == act->type &&
+            act->size + GCS_AGG_HDR_SIZE <= size_t(conn->params.agg_max_size));
+}
+
+static inline long
+gcs_agg_act_size (const struct gcs_repl_act* const repl_act)
+{
+    return repl_act->action->size + GCS_AGG_HDR_SIZE;
+}
+
+/*! Must be called under agg_lock */
+static void
+gcs_agg_append (gcs_conn_t* const conn, struct gcs_repl_act* const repl_act)
+{
+    repl_act->agg_ret  = GCS_AGG_PENDING;
+    repl_act->agg_next = NULL;
+
+    if (conn->agg_tail) conn->agg_tail->agg_next = repl_act;
+    else                conn->agg_head = repl_act;
+
+    conn->agg_tail  = repl_act;
+    conn->agg_num  += 1;
+    conn->agg_size += gcs_agg_act_size (repl_act);
+
+    if (conn->agg_num  >= conn->params.agg_max_acts ||
+        conn->agg_size >= conn->params.agg_max_size) {
+        gu_cond_signal (&conn->agg_cond);
+    }
+}
+
+/*! Must be called under agg_lock */
+static void
+gcs_agg_remove (gcs_conn_t* const conn, struct gcs_repl_act* const repl_act)
+{
+    struct gcs_repl_act* prev = NULL;
+    struct gcs_repl_act* a    = conn->agg_head;
+
+    while (a != repl_act) { prev = a; a = a->agg_next; }
+
+    assert (a);
+
+    if (prev) prev->agg_next = a->agg_next;
+    else      conn->agg_head = a->agg_next;
+
+    if (conn->agg_tail == a) conn->agg_tail = prev;
+
+    conn->agg_num  -= 1;
+    conn->agg_size -= gcs_agg_act_size (a);
+}
+
+/*! Waits up to agg_max_delay for the aggregate to fill up.
+ *  Must be called under agg_lock */
+static void
+gcs_agg_wait (gcs_conn_t* const conn)
+{
+    if (conn->params.agg_max_delay <= 0) return;
+
+    long long const deadline(gu_time_calendar() +
+                             conn->params.agg_max_delay * 1000LL);
+    struct timespec const ts = { time_t(deadline / 1000000000LL),
+                                 long(deadline % 1000000000LL) };
+
+    while (conn->agg_num  < conn->params.agg_max_acts &&
+           conn->agg_size < conn->params.agg_max_size &&
+           0 == gu_cond_timedwait (&conn->agg_cond, &conn->agg_lock, &ts)) {}
+}
+
+/*! Moves actions from the head of agg queue to agg_batch.
+ *  Must be called under agg_lock
+ *  @return number of actions taken */
+static long
+gcs_agg_take (gcs_conn_t* const conn, size_t* const size)
+{
+    long num = 0;
+
+    *size = 0;
+
+    while (conn->agg_head && num < conn->params.agg_max_acts &&
+           (0 == num || *size + gcs_agg_act_size(conn->agg_head) <=
+            size_t(conn->params.agg_max_size)))
+    {
+        struct gcs_repl_act* const a = conn->agg_head;
+
+        conn->agg_head = a->agg_next;
+        conn->agg_num  -= 1;
+        conn->agg_size -= gcs_agg_act_size (a);
+        *size += gcs_agg_act_size (a);
+
+        a->agg_next = NULL;
+        a->agg_ret  = GCS_AGG_TAKEN;
+        conn->agg_batch[num++] = a;
+    }
+
+    if (!conn->agg_head) conn->agg_tail = NULL;
+
+    return num;
+}
+
+/*! Fails actions of agg_batch starting with from, wakes up their owners */
+static void
+gcs_agg_fail (gcs_conn_t* const conn, long from, long const num, long const err)
+{
+    assert (err < 0);
+
+    for (; from < num; ++from) {
+        struct gcs_repl_act* const a = conn->agg_batch[from];
+
+        gu_mutex_lock   (&a->wait_mutex);
+        a->agg_ret = err;
+        gu_cond_signal  (&a->wait_cond);
+        gu_mutex_unlock (&a->wait_mutex);
+        /* NOTE! a cannot be used after this point */
+    }
+}
+
+/*! Builds aggregated message out of agg_batch actions in agg_bufs */
+static long
+gcs_agg_build (gcs_conn_t* const conn, long const num)
+{
+    long bufs = num + 1; // header per action + terminating element
+
+    for (long i = 0; i < num; ++i) {
+        ssize_t left = conn->agg_batch[i]->action->size;
+        for (long j = 0; left > 0; ++j, ++bufs) {
+            left -= conn->agg_batch[i]->act_in[j].size;
+        }
+    }
+
+    if (bufs > conn->agg_bufs_len) {
+        struct gu_buf* const tmp = static_cast<struct gu_buf*>(
+            gu_realloc (conn->agg_bufs, bufs * sizeof(struct gu_buf)));
+
+        if (!tmp) return -ENOMEM;
+
+        conn->agg_bufs     = tmp;
+        conn->agg_bufs_len = bufs;
+    }
+
+    long b = 0;
+
+    for (long i = 0; i < num; ++i) {
+        const struct gcs_repl_act* const a = conn->agg_batch[i];
+
+        conn->agg_hdrs[i] = htogl(uint32_t(a->action->size));
+        conn->agg_bufs[b].ptr  = &conn->agg_hdrs[i];
+        conn->agg_bufs[b].size = GCS_AGG_HDR_SIZE;
+        ++b;
+
+        ssize_t left = a->action->size;
+        for (long j = 0; left > 0; ++j, ++b) {
+            conn->agg_bufs[b] = a->act_in[j];
+            left -= a->act_in[j].size;
+        }
+    }
+
+    conn->agg_bufs[b].ptr  = NULL;
+    conn->agg_bufs[b].size = 0;
+
+    return 0;
+}
+
+/*! Sends actions from agg_batch, must be called from within send monitor.
+ *  Unsent actions are failed with error code. */
+static void
+gcs_agg_send (gcs_conn_t* const conn, long const num, size_t const size)
+{
+    long ret;
+    long queued;
+    long sent = 0;
+
+    /* same as in gcs_replv(): -EAGAIN is a workaround for #569 */
+    if (conn->upper_limit < gu_lfq_length (conn->recv_q)) {
+        gcs_agg_fail (conn, 0, num, -EAGAIN);
+        return;
+    }
+
+    for (queued = 0; queued < num; ++queued) {
+        struct gcs_repl_act** act_ptr;
+
+        if (GCS_CONN_OPEN < conn->state ||
+            !(act_ptr = (struct gcs_repl_act**)
+              gcs_fifo_lite_get_tail (conn->repl_q))) {
+            ret = -ENOTCONN;
+            goto unqueue;
+        }
+
+        *act_ptr = conn->agg_batch[queued];
+        gcs_fifo_lite_push_tail (conn->repl_q);
+    }
+
+    if (num > 1 && !(ret = gcs_agg_build (conn, num))) {
+        while ((ret = gcs_core_send_aggregate (conn->core, conn->agg_bufs,
+                                               size, num)) == -ERESTART) {}
+
+        if (ret >= 0) {
+            assert ((size_t)ret == size);
+            return;
+        }
+
+        if (-EPROTO != ret) goto unqueue;
+        /* group does not support aggregation yet, send one by one */
+    }
+
+    for (sent = 0; sent < num; ++sent) {
+        const struct gcs_repl_act* const a = conn->agg_batch[sent];
+
+        while ((ret = gcs_core_send (conn->core, a->act_in, a->action->size,
+                                     GCS_ACT_TORDERED)) == -ERESTART) {}
+
+        if (ret < 0) goto unqueue;
+    }
+
+    return;
+
+unqueue:
+    /* actions before sent were sent and will be delivered */
+    gu_warn ("Send of %ld aggregated action(s) returned %ld (%s)",
+             num - sent, ret, strerror(-ret));
+
+    for (long i = sent; i < queued; ++i) {
+        if (!gcs_fifo_lite_remove (conn->repl_q)) {
+            gu_fatal ("Failed to remove unsent item from repl_q");
+            assert(0);
+            ret = -ENOTRECOVERABLE;
+        }
+    }
+
+    gcs_agg_fail (conn, sent, num, ret);
+}
+
+/*! Replicates action as a part of aggregated message */
+static long
+gcs_replv_aggregate (gcs_conn_t*          const conn,
+                     struct gcs_repl_act* const repl_act,
+                     bool                 const scheduled)
+{
+    struct gcs_action* const act = repl_act->action;
+    const void* const orig_buf = act->buf;
+    long ret;
+
+    gu_mutex_lock (&conn->agg_lock);
+    gcs_agg_append (conn, repl_act);
+    gu_mutex_unlock (&conn->agg_lock);
+
+    gu_cond_t tmp_cond;
+    gu_cond_init (&tmp_cond, NULL);
+
+    if (!(ret = gcs_sm_enter (conn->sm, &tmp_cond, scheduled, true)))
+    {
+        gu_mutex_lock (&conn->agg_lock);
+
+        /* send pending actions until own action is taken */
+        while (GCS_AGG_PENDING == repl_act->agg_ret) {
+            size_t size;
+
+            gcs_agg_wait (conn);
+            long const num = gcs_agg_take (conn, &size);
+
+            gu_mutex_unlock (&conn->agg_lock);
+            gcs_agg_send (conn, num, size);
+            gu_mutex_lock (&conn->agg_lock);
+        }
+
+        gu_mutex_unlock (&conn->agg_lock);
+        gcs_sm_leave (conn->sm);
+    }
+    else {
+        /* could not enter monitor, withdraw action unless already taken */
+        gu_mutex_lock (&conn->agg_lock);
+        bool const pending(GCS_AGG_PENDING == repl_act->agg_ret);
+        if (pending) gcs_agg_remove (conn, repl_act);
+        gu_mutex_unlock (&conn->agg_lock);
+
+        if (pending) {
+            gu_cond_destroy (&tmp_cond);
+            return ret;
+        }
+    }
+
+    gu_cond_destroy (&tmp_cond);
+
+    /* now wait for delivery or for the sender to report failure */
+    gu_mutex_lock (&repl_act->wait_mutex);
+
+    while (!repl_act->delivered && GCS_AGG_TAKEN == repl_act->agg_ret) {
+        gu_cond_wait (&repl_act->wait_cond, &repl_act->wait_mutex);
+    }
+
+    if (repl_act->delivered) {
+        ret = gcs_repl_result (conn, act, orig_buf, act->size);
+    }
+    else {
+        ret = repl_act->agg_ret;
+        assert (ret < 0);
+    }
+
+    gu_mutex_unlock (&repl_act->wait_mutex);
+
+    return ret;
+}
+
 /* Puts action in the send queue and returns after it is replicated */
 long gcs_replv (gcs_conn_t*          const conn,      //!<in
                 const struct gu_buf* const act_in,    //!<in
@@ -1540,15 +2233,21 @@ long gcs_replv (gcs_conn_t*          const conn,      //!<in
     act->seqno_l = GCS_SEQNO_ILL;
     act->seqno_g = GCS_SEQNO_ILL;
 
+    if (GCS_ACT_TORDERED == act->type) gcs_fc_pace_wait (conn);
+
     /* This is good - we don't have to do a copy because we wait */
     struct gcs_repl_act repl_act(act_in, act);
 
     gu_mutex_init (&repl_act.wait_mutex, NULL);
     gu_cond_init  (&repl_act.wait_cond,  NULL);
 
+    if (gcs_agg_eligible (conn, act))
+    {
+        ret = gcs_replv_aggregate (conn, &repl_act, scheduled);
+    }
     /* Send action and wait for signal from recv_thread
      * we need to lock a mutex before we can go wait for signal */
-    if (!(ret = gu_mutex_lock (&repl_act.wait_mutex)))
+    else if (!(ret = gu_mutex_lock (&repl_act.wait_mutex)))
     {
         // Lock here does the following:
         // 1. serializes gcs_core_send() access between gcs_repl() and
@@ -1567,7 +2266,7 @@ long gcs_replv (gcs_conn_t*          const conn,      //!<in
             // if (conn->state >= GCS_CONN_CLOSE) or (act_ptr == NULL)
             // ret will be -ENOTCONN
             if ((ret = -EAGAIN,
-                 conn->upper_limit >= conn->queue_len ||
+                 conn->upper_limit >= gu_lfq_length (conn->recv_q) ||
                  act->type         != GCS_ACT_TORDERED)         &&
                 (ret = -ENOTCONN, GCS_CONN_OPEN >= conn->state) &&
                 (act_ptr = (struct gcs_repl_act**)gcs_fifo_lite_get_tail (conn->repl_q)))
@@ -1603,47 +2302,9 @@ long gcs_replv (gcs_conn_t*          const conn,      //!<in
             /* now we can go waiting for action delivery */
             if (ret >= 0) {
                 gu_cond_wait (&repl_act.wait_cond, &repl_act.wait_mutex);
-#ifndef GCS_FOR_GARB
-                /* assert (act->buf != 0); */
-                if (act->buf == 0)
-                {
-                    /* Recv thread purged repl_q before action was delivered */
-                    ret = -ENOTCONN;
-                    goto out;
-                }
-#else
-                assert (act->buf == 0);
-#endif /* GCS_FOR_GARB */
-
-                if (act->seqno_g < 0) {
-                    assert (GCS_SEQNO_ILL    == act->seqno_l ||
-                            GCS_ACT_TORDERED != act->type);
-
-                    if (act->seqno_g == GCS_SEQNO_ILL) {
-                        /* action was not replicated for some reason */
-                        assert (orig_buf == act->buf);
-                        ret = -EINTR;
-                    }
-                    else {
-                        /* core provided an error code in global seqno */
-                        assert (orig_buf != act->buf);
-                        ret = act->seqno_g;
-                        act->seqno_g = GCS_SEQNO_ILL;
-                    }
-
-                    if (orig_buf != act->buf) // action was allocated in gcache
-                    {
-                        gu_debug("Freeing gcache buffer %p after receiving %d",
-                                 act->buf, ret);
-                        gcs_gcache_free (conn->gcache, act->buf);
-                        act->buf = orig_buf;
-                    }
-                }
+                ret = gcs_repl_result (conn, act, orig_buf, ret);
             }
         }
-#ifndef GCS_FOR_GARB
-    out:
-#endif /* GCS_FOR_GARB */
         gu_mutex_unlock  (&repl_act.wait_mutex);
     }
     gu_mutex_destroy (&repl_act.wait_mutex);
@@ -1766,87 +2427,158 @@ long gcs_desync (gcs_conn_t* conn, gcs_seqno_t* local)
     }
 }
 
+/* pops up to max actions, returns the number of actions popped */
+static inline long
+GCS_FIFO_POP_HEAD (gcs_conn_t* conn, struct gcs_recv_act* acts, long max)
+{
+    long const ret = gu_lfq_pop_batch (conn->recv_q, acts, max);
+
+    if (gu_likely (ret > 0)) {
+        ssize_t size = 0;
+
+        for (long i = 0; i < ret; ++i) size += acts[i].rcvd.act.buf_len;
+
+        gu_atomic_fetch_and_sub (&conn->recv_q_size, size);
+        assert (conn->recv_q_size >= 0);
+    }
+
+    return ret;
+}
+
+/* Returns true if flow control might need to act on slave queue shrinking,
+ * so that recv_lock is taken only then */
+static inline bool
+gcs_fc_recv_check (gcs_conn_t* conn, long queue_len)
+{
+    return (conn->stop_sent > 0 || conn->fc_offset > queue_len ||
+            conn->params.fc_rate || GCS_CONN_JOINED == conn->state);
+}
+
+/* Flow control and SYNC bookkeeping once per batch of acts actions taken
+ * from recv_q */
+static void
+gcs_recv_fc (gcs_conn_t* conn, long const acts)
+{
+    long queue_len = gu_lfq_length (conn->recv_q);
+    bool send_cont = false;
+    bool send_rate = false;
+    bool send_sync = false;
+    long err;
+
+    if (gu_unlikely (gcs_fc_recv_check (conn, queue_len))) {
+        gu_mutex_lock (&conn->recv_lock);
+        conn->queue_len = queue_len = gu_lfq_length (conn->recv_q);
+        send_cont = gcs_fc_cont_begin   (conn);
+        send_rate = !send_cont && gcs_fc_rate_begin (conn, acts);
+        send_sync = gcs_send_sync_begin (conn);
+        gu_mutex_unlock (&conn->recv_lock);
+    }
+
+    if (gu_unlikely(send_cont) && (err = gcs_fc_cont_end(conn))) {
+        // We have successfully received an action, but failed to send
+        // important control message. What do we do? Inability to send CONT
+        // can block the whole cluster. There are only queue_len - 1
+        // attempts to do that (that's how many times we'll get here).
+        // Perhaps if the last attempt fails, we should crash.
+        if (queue_len > 0) {
+            gu_warn ("Failed to send CONT message: %ld (%s). "
+                     "Attempts left: %ld",
+                     err, strerror(-err), queue_len);
+        }
+        else {
+            gu_fatal ("Last opportunity to send CONT message failed: "
+                      "%ld (%s). Aborting to avoid cluster lock-up...",
+                      err, strerror(-err));
+            gcs_close(conn);
+            gu_abort();
+        }
+    }
+    else if (gu_unlikely(send_rate) && (err = gcs_fc_rate_end (conn))) {
+        gu_warn ("Failed to send FC_RATE message: %ld (%s). "
+                 "Will try later.", err, strerror(-err));
+    }
+    else if (gu_unlikely(send_sync) && (err = gcs_send_sync_end (conn))) {
+        gu_warn ("Failed to send SYNC message: %ld (%s). Will try later.",
+                 err, strerror(-err));
+    }
+}
+
 static inline void
-GCS_FIFO_POP_HEAD (gcs_conn_t* conn, ssize_t size)
+gcs_recv_act_to_action (const struct gcs_recv_act& recv_act,
+                        struct gcs_action* const   action)
 {
-    assert (conn->recv_q_size >= size);
-    conn->recv_q_size -= size;
-    gu_fifo_pop_head (conn->recv_q);
+    action->buf     = (void*)recv_act.rcvd.act.buf;
+    action->size    = recv_act.rcvd.act.buf_len;
+    action->type    = recv_act.rcvd.act.type;
+    action->seqno_g = recv_act.rcvd.id;
+    action->seqno_l = recv_act.local_id;
+}
+
+static long
+gcs_recv_error (gcs_conn_t* conn, struct gcs_action* action, long const err)
+{
+    action->buf     = NULL;
+    action->size    = 0;
+    action->type    = GCS_ACT_ERROR;
+    action->seqno_g = GCS_SEQNO_ILL;
+    action->seqno_l = GCS_SEQNO_ILL;
+
+    switch (err) {
+    case -ENODATA:
+        assert (GCS_CONN_CLOSED == conn->state);
+        return GCS_CLOSED_ERROR;
+    default:
+        return err;
+    }
 }
 
 /* Returns when an action from another process is received */
 long gcs_recv (gcs_conn_t*        conn,
                struct gcs_action* action)
 {
-    int                  err;
-    struct gcs_recv_act* recv_act = NULL;
+    struct gcs_recv_act recv_act;
 
     assert (action);
 
-    if ((recv_act = (struct gcs_recv_act*)gu_fifo_get_head (conn->recv_q, &err)))
+    long const ret = GCS_FIFO_POP_HEAD (conn, &recv_act, 1);
+
+    if (gu_likely (ret > 0))
     {
-        conn->queue_len = gu_fifo_length (conn->recv_q) - 1;
-        bool send_cont  = gcs_fc_cont_begin   (conn);
-        bool send_sync  = gcs_send_sync_begin (conn);
-
-        action->buf     = (void*)recv_act->rcvd.act.buf;
-        action->size    = recv_act->rcvd.act.buf_len;
-        action->type    = recv_act->rcvd.act.type;
-        action->seqno_g = recv_act->rcvd.id;
-        action->seqno_l = recv_act->local_id;
-
-        if (gu_unlikely (GCS_ACT_CONF == action->type)) {
-            err = gu_fifo_cancel_gets (conn->recv_q);
-            if (err) {
-                gu_fatal ("Internal logic error: failed to cancel recv_q "
-                          "\"gets\": %d (%s). Aborting.",
-                          err, strerror(-err));
-                gu_abort();
-            }
-        }
+        gcs_recv_fc (conn, 1);
+        gcs_recv_act_to_action (recv_act, action);
+
+        return action->size;
+    }
+    else {
+        return gcs_recv_error (conn, action, ret);
+    }
+}
 
-        GCS_FIFO_POP_HEAD (conn, action->size); // release the queue
+long gcs_recv_batch (gcs_conn_t*        conn,
+                     struct gcs_action* actions,
+                     long               max)
+{
+    struct gcs_recv_act recv_acts[GCS_RECV_BATCH_MAX];
 
-        if (gu_unlikely(send_cont) && (err = gcs_fc_cont_end(conn))) {
-            // We have successfully received an action, but failed to send
-            // important control message. What do we do? Inability to send CONT
-            // can block the whole cluster. There are only conn->queue_len - 1
-            // attempts to do that (that's how many times we'll get here).
-            // Perhaps if the last attempt fails, we should crash.
-            if (conn->queue_len > 0) {
-                gu_warn ("Failed to send CONT message: %d (%s). "
-                         "Attempts left: %ld",
-                         err, strerror(-err), conn->queue_len);
-            }
-            else {
-                gu_fatal ("Last opportunity to send CONT message failed: "
-                          "%d (%s). Aborting to avoid cluster lock-up...",
-                          err, strerror(-err));
-                gcs_close(conn);
-                gu_abort();
-            }
-        }
-        else if (gu_unlikely(send_sync) && (err = gcs_send_sync_end (conn))) {
-            gu_warn ("Failed to send SYNC message: %d (%s). Will try later.",
-                     err, strerror(-err));
+    assert (actions);
+    assert (max > 0);
+
+    if (max > GCS_RECV_BATCH_MAX) max = GCS_RECV_BATCH_MAX;
+
+    long const ret = GCS_FIFO_POP_HEAD (conn, recv_acts, max);
+
+    if (gu_likely (ret > 0))
+    {
+        gcs_recv_fc (conn, ret);
+
+        for (long i = 0; i < ret; ++i) {
+            gcs_recv_act_to_action (recv_acts[i], &actions[i]);
         }
 
-        return action->size;
+        return ret;
     }
     else {
-        action->buf     = NULL;
-        action->size    = 0;
-        action->type    = GCS_ACT_ERROR;
-        action->seqno_g = GCS_SEQNO_ILL;
-        action->seqno_l = GCS_SEQNO_ILL;
-
-        switch (err) {
-        case -ENODATA:
-            assert (GCS_CONN_CLOSED == conn->state);
-            return GCS_CLOSED_ERROR;
-        default:
-            return err;
-        }
+        return gcs_recv_error (conn, actions, ret);
     }
 }
 
@@ -1855,7 +2587,7 @@ gcs_resume_recv (gcs_conn_t* conn)
 {
     int ret = GCS_CLOSED_ERROR;
 
-    ret = gu_fifo_resume_gets (conn->recv_q);
+    ret = gu_lfq_resume_gets (conn->recv_q);
 
     if (ret) {
         if (conn->state < GCS_CONN_CLOSED) {
@@ -1876,7 +2608,8 @@ long
 gcs_wait (gcs_conn_t* conn)
 {
     if (gu_likely(GCS_CONN_SYNCED == conn->state)) {
-       return (conn->stop_count > 0 || (conn->queue_len > conn->upper_limit));
+       return (conn->stop_count > 0 ||
+               (gu_lfq_length (conn->recv_q) > conn->upper_limit));
     }
     else {
         switch (conn->state) {
@@ -1934,11 +2667,11 @@ gcs_seqno_t gcs_local_sequence(gcs_conn_t* conn)
 void
 gcs_get_stats (gcs_conn_t* conn, struct gcs_stats* stats)
 {
-    gu_fifo_stats_get (conn->recv_q,
-                       &stats->recv_q_len,
-                       &stats->recv_q_len_max,
-                       &stats->recv_q_len_min,
-                       &stats->recv_q_len_avg);
+    gu_lfq_stats_get (conn->recv_q,
+                      &stats->recv_q_len,
+                      &stats->recv_q_len_max,
+                      &stats->recv_q_len_min,
+                      &stats->recv_q_len_avg);
 
     stats->recv_q_size = conn->recv_q_size;
 
@@ -1957,16 +2690,41 @@ gcs_get_stats (gcs_conn_t* conn, struct gcs_stats* stats)
 void
 gcs_flush_stats(gcs_conn_t* conn)
 {
-    gu_fifo_stats_flush(conn->recv_q);
+    gu_lfq_stats_flush(conn->recv_q);
     gcs_sm_stats_flush (conn->sm);
     conn->stats_fc_sent     = 0;
     conn->stats_fc_received = 0;
+    conn->stats_fc_rate_sent     = 0;
+    conn->stats_fc_rate_received = 0;
 }
 
 void gcs_get_status(gcs_conn_t* conn, gu::Status& status)
 {
     if (conn->state < GCS_CONN_CLOSED)
     {
+        if (conn->params.fc_rate)
+        {
+            double    rate;
+            long long sleeps;
+            long long sleep_ns;
+
+            gu_mutex_lock (&conn->pace_lock);
+            rate     = gcs_fc_pace_rate (&conn->pace);
+            sleeps   = conn->pace.sleeps;
+            sleep_ns = conn->pace.sleep_ns;
+            gu_mutex_unlock (&conn->pace_lock);
+
+            status.insert("gcs_fc_rate_hints_sent",
+                          gu::to_string(conn->stats_fc_rate_sent));
+            status.insert("gcs_fc_rate_hints_received",
+                          gu::to_string(conn->stats_fc_rate_received));
+            status.insert("gcs_fc_apply_rate",
+                          gu::to_string(conn->fc_rate.apply_rate));
+            status.insert("gcs_fc_rate_limit", gu::to_string(rate));
+            status.insert("gcs_fc_paced", gu::to_string(sleeps));
+            status.insert("gcs_fc_paced_ns", gu::to_string(sleep_ns));
+        }
+
         gcs_core_get_status(conn->core, status);
     }
 }
@@ -1981,7 +2739,7 @@ _set_fc_limit (gcs_conn_t* conn, const char* value)
 
         if (limit > LONG_MAX) limit = LONG_MAX;
 
-        gu_fifo_lock(conn->recv_q);
+        gu_mutex_lock (&conn->recv_lock);
         {
             if (!gu_mutex_lock (&conn->fc_lock)) {
                 conn->params.fc_base_limit = limit;
@@ -1995,7 +2753,7 @@ _set_fc_limit (gcs_conn_t* conn, const char* value)
                 abort();
             }
         }
-        gu_fifo_release (conn->recv_q);
+        gu_mutex_unlock (&conn->recv_lock);
 
         return 0;
     }
@@ -2014,7 +2772,7 @@ _set_fc_factor (gcs_conn_t* conn, const char* value)
 
         if (factor == conn->params.fc_resume_factor) return 0;
 
-        gu_fifo_lock(conn->recv_q);
+        gu_mutex_lock (&conn->recv_lock);
         {
             if (!gu_mutex_lock (&conn->fc_lock)) {
                 conn->params.fc_resume_factor = factor;
@@ -2028,7 +2786,7 @@ _set_fc_factor (gcs_conn_t* conn, const char* value)
                 abort();
             }
         }
-        gu_fifo_release (conn->recv_q);
+        gu_mutex_unlock (&conn->recv_lock);
 
         return 0;
     }
@@ -2049,6 +2807,7 @@ _set_fc_debug (gcs_conn_t* conn, const char* value)
 
         conn->params.fc_debug = debug;
         gcs_fc_debug (&conn->stfc, debug);
+        gcs_fc_rate_debug (&conn->fc_rate, debug);
         gu_config_set_bool (conn->config, GCS_PARAMS_FC_DEBUG, debug);
 
         return 0;
@@ -244,6 +244,24 @@ static inline long gcs_repl (gcs_conn_t*        const conn,
 extern long gcs_recv (gcs_conn_t*        conn,
                       struct gcs_action* action);
 
+/*! Maximum number of actions returned by one gcs_recv_batch() call */
+#define GCS_RECV_BATCH_MAX 64
+
+/*! @brief Receives a batch of consecutive actions from group.
+ * Like gcs_recv(), but returns up to max actions which are ready at once,
+ * without waiting for more. Actions must be processed in the array order.
+ * A configuration change action is always the last one in the batch.
+ *
+ * @param conn    group connection handle
+ * @param actions array of at least max action objects
+ * @param max     maximum number of actions to return,
+ *                capped at GCS_RECV_BATCH_MAX
+ * @return        negative error code, number of actions in case of success
+ */
+extern long gcs_recv_batch (gcs_conn_t*        conn,
+                            struct gcs_action* actions,
+                            long               max);
+
 /*!
  * @brief Schedules entry to CGS send monitor.
  * Locks send monitor and should be quickly followed by gcs_repl()/gcs_send()
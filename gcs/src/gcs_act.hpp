@@ -35,6 +35,7 @@ struct gcs_act_rcvd
     const struct gu_buf* local; // local buffer vector if any
     gcs_seqno_t    id;          // global total order seqno
     int            sender_idx;
+    int            act_num;     // number of actions aggregated in act
     gcs_act_rcvd() { }
     gcs_act_rcvd(const gcs_act& a, const struct gu_buf* loc,
                  gcs_seqno_t i, int si)
@@ -42,7 +43,8 @@ struct gcs_act_rcvd
         act(a),
         local(loc),
         id(i),
-        sender_idx(si)
+        sender_idx(si),
+        act_num(1)
     { }
 };
 
@@ -5,7 +5,7 @@
  */
 /*
  * Interface to action protocol
- * (to be extended to support protocol versions, currently supports only v0)
+ * (supports versions 0 and 1, v1 adds the number of aggregated actions)
  */
 #include <errno.h>
 #include "gcs_act_proto.hpp"
@@ -22,10 +22,21 @@ bytes: 00 01                07 08       11 12       15 16       19 20
 PV - protocol version
 AT - action type
 
+  Version 1 header structure
+
+bytes: 00 01                07 08       11 12       15 16 17 18 19 20
+      +--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+---
+      |PV|      act_id        |  act_size |  frag_no  |AT|R |  AN |  data...
+      +--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+---
+
+R  - reserved
+AN - number of actions aggregated in this one (see gcs_core_send_aggregate())
+
 */
 
 static const size_t PROTO_PV_OFFSET       = 0;
 static const size_t PROTO_AT_OFFSET       = 16;
+static const size_t PROTO_AN_OFFSET       = 18; // v1
 static const size_t PROTO_DATA_OFFSET     = 20;
 // static const size_t PROTO_ACT_ID_OFFSET   = 0;
 // static const size_t PROTO_ACT_SIZE_OFFSET = 8;
@@ -34,6 +45,7 @@ static const size_t PROTO_DATA_OFFSET     = 20;
 // static const gcs_seqno_t   PROTO_ACT_ID_MAX   = 0x00FFFFFFFFFFFFLL;
 // static const unsigned int  PROTO_FRAG_NO_MAX  = 0xFFFFFFFF;
 // static const unsigned char PROTO_AT_MAX       = 0xFF;
+static const int PROTO_AN_MAX = 0xFFFF;
 
 static const int PROTO_VERSION = GCS_ACT_PROTO_MAX;
 
@@ -58,7 +70,7 @@ gcs_act_proto_write (gcs_act_frag_t* frag, void* buf, size_t buf_len)
                   frag->act_type, PROTO_AT_MAX);
         return -EOVERFLOW;
     }
-    if (frag->proto_ver != PROTO_VERSION) return -EPROTO;
+    if (frag->proto_ver > PROTO_VERSION) return -EPROTO;
     if (buf_len      < PROTO_DATA_OFFSET) return -EMSGSIZE;
 #endif
 
@@ -71,6 +83,22 @@ gcs_act_proto_write (gcs_act_frag_t* frag, void* buf, size_t buf_len)
     ((uint8_t *)buf)[PROTO_PV_OFFSET] = frag->proto_ver;
     ((uint8_t *)buf)[PROTO_AT_OFFSET] = frag->act_type;
 
+    if (frag->proto_ver >= GCS_ACT_PROTO_AGG) {
+        if (gu_unlikely(frag->act_num < 1 || frag->act_num > PROTO_AN_MAX)) {
+            gu_error ("Number of aggregated actions %d out of range [1, %d]",
+                      frag->act_num, PROTO_AN_MAX);
+            return -EOVERFLOW;
+        }
+        ((uint8_t *)buf)[PROTO_AT_OFFSET + 1] = 0;
+        *(uint16_t*)((uint8_t*)buf + PROTO_AN_OFFSET) =
+            htogs((uint16_t)frag->act_num);
+    }
+    else if (gu_unlikely(frag->act_num != 1)) {
+        gu_error ("Protocol version %d does not support action aggregation",
+                  frag->proto_ver);
+        return -EPROTO;
+    }
+
     frag->frag     = (uint8_t*)buf + PROTO_DATA_OFFSET;
     frag->frag_len = buf_len - PROTO_DATA_OFFSET;
 
@@ -104,6 +132,18 @@ gcs_act_proto_read (gcs_act_frag_t* frag, const void* buf, size_t buf_len)
     frag->frag_no  = gtohl  (((uint32_t*)buf)[3]);
     frag->act_type = static_cast<gcs_act_type_t>(
         ((uint8_t*)buf)[PROTO_AT_OFFSET]);
+
+    if (frag->proto_ver >= GCS_ACT_PROTO_AGG) {
+        frag->act_num = gtohs(*(uint16_t*)((uint8_t*)buf + PROTO_AN_OFFSET));
+
+        if (gu_unlikely(frag->act_num < 1)) {
+            gu_error ("Bad number of aggregated actions: %d", frag->act_num);
+            return -EBADMSG;
+        }
+    }
+    else {
+        frag->act_num = 1;
+    }
     frag->frag     = ((uint8_t*)buf) + PROTO_DATA_OFFSET;
     frag->frag_len = buf_len - PROTO_DATA_OFFSET;
 
@@ -5,7 +5,7 @@
  */
 /*
  * Interface to action protocol
- * (to be extended to support protocol versions, currently supports only v0)
+ * (supports versions 0 and 1, v1 adds the number of aggregated actions)
  */
 
 #ifndef _gcs_act_proto_h_
@@ -17,8 +17,14 @@
 #include <stdint.h>
 typedef uint8_t gcs_proto_t;
 
-/*! Supported protocol range (for now only version 0 is supported) */
-#define GCS_ACT_PROTO_MAX 0
+/*! Supported protocol range (versions 0 and 1 are supported) */
+#define GCS_ACT_PROTO_MAX 1
+
+/*! Lowest protocol version that supports action aggregation */
+#define GCS_ACT_PROTO_AGG 1
+
+/*! Lowest protocol version that understands flow control rate hints */
+#define GCS_ACT_PROTO_FC_RATE 1
 
 /*! Internal action fragment data representation */
 typedef struct gcs_act_frag
@@ -30,6 +36,7 @@ typedef struct gcs_act_frag
     unsigned long  frag_no;
     gcs_act_type_t act_type;
     int            proto_ver;
+    int            act_num;  // number of aggregated actions (v1), 1 otherwise
 }
 gcs_act_frag_t;
 
@@ -99,7 +99,7 @@ typedef struct causal_act
     gu_cond_t*   cond;
 } causal_act_t;
 
-static int const GCS_PROTO_MAX = 0;
+static int const GCS_PROTO_MAX = 1;
 
 gcs_core_t*
 gcs_core_create (gu_config_t* const conf,
@@ -297,11 +297,12 @@ core_msg_send_retry (gcs_core_t*    core,
     return ret;
 }
 
-ssize_t
-gcs_core_send (gcs_core_t*          const conn,
+static ssize_t
+core_send_act (gcs_core_t*          const conn,
                const struct gu_buf* const action,
                size_t                     act_size,
-               gcs_act_type_t       const act_type)
+               gcs_act_type_t       const act_type,
+               int                  const act_num)
 {
     ssize_t        ret  = 0;
     ssize_t        sent = 0;
@@ -327,6 +328,7 @@ gcs_core_send (gcs_core_t*          const conn,
     frg.act_id    = conn->send_act_no; /* incremented for every new action */
     frg.frag_no   = 0;
     frg.proto_ver = proto_ver;
+    frg.act_num   = act_num;
 
     if ((ret = gcs_act_proto_write (&frg, conn->send_buf, conn->send_buf_len)))
         return ret;
@@ -453,6 +455,30 @@ out:
     return ret;
 }
 
+ssize_t
+gcs_core_send (gcs_core_t*          const conn,
+               const struct gu_buf* const action,
+               size_t                     act_size,
+               gcs_act_type_t       const act_type)
+{
+    return core_send_act (conn, action, act_size, act_type, 1);
+}
+
+ssize_t
+gcs_core_send_aggregate (gcs_core_t*          const conn,
+                         const struct gu_buf* const action,
+                         size_t                     act_size,
+                         int                  const act_num)
+{
+    assert (act_num > 0);
+
+    if (gu_unlikely(act_num > 1 && conn->proto_ver < GCS_ACT_PROTO_AGG)) {
+        return -EPROTO;
+    }
+
+    return core_send_act (conn, action, act_size, GCS_ACT_TORDERED, act_num);
+}
+
 /* A helper for gcs_core_recv().
  * Deals with fetching complete message from backend
  * and reallocates recv buf if needed */
@@ -1109,6 +1135,9 @@ ssize_t gcs_core_recv (gcs_core_t*          conn,
         case GCS_MSG_FLOW:
             ret = core_msg_to_action (conn, recv_msg, &recv_act->act);
             assert (ret == recv_act->act.buf_len || ret <= 0);
+            // rate hints are accounted per sender
+            if (GCS_MSG_FLOW == recv_msg->type && ret > 0)
+                recv_act->sender_idx = recv_msg->sender_idx;
             break;
         case GCS_MSG_CAUSAL:
             ret = core_msg_causal(conn, recv_msg);
@@ -1142,7 +1171,11 @@ out:
         assert (recv_act->id < 0);
 
         if (GCS_ACT_TORDERED == recv_act->act.type && recv_act->act.buf) {
-            gcs_gcache_free (conn->cache, recv_act->act.buf);
+            if (gu_likely(1 == recv_act->act_num))
+                gcs_gcache_free (conn->cache, recv_act->act.buf);
+            else
+                gcs_defrag_free_acts (conn->cache, recv_act->act.buf,
+                                      recv_act->act_num);
             recv_act->act.buf = NULL;
         }
 
@@ -105,6 +105,23 @@ gcs_core_send (gcs_core_t*          core,
                size_t               act_size,
                gcs_act_type_t       act_type);
 
+/*
+ * gcs_core_send_aggregate() sends act_num totally ordered actions as one.
+ * act contains act_num records, each consisting of a 32-bit action size
+ * (in galera byte order) followed by the action itself. On delivery the
+ * aggregate gets act_num consecutive seqnos (see gcs_act_rcvd::act_num).
+ *
+ * NOT THREAD SAFE! Access should be serialized.
+ *
+ * Return values: as gcs_core_send(),
+ *                -EPROTO - group protocol does not support aggregation
+ */
+extern ssize_t
+gcs_core_send_aggregate (gcs_core_t*          core,
+                         const struct gu_buf* act,
+                         size_t               act_size,
+                         int                  act_num);
+
 /*
  * gcs_core_recv() blocks until some action is received from group.
  *
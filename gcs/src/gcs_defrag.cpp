@@ -10,6 +10,8 @@
 #include <unistd.h>
 #include <string.h>
 
+#include <algorithm>
+
 #define DF_ALLOC()                                              \
     do {                                                        \
         df->head = static_cast<uint8_t*>(gcs_gcache_malloc (df->cache, df->size)); \
@@ -24,6 +26,95 @@
         }                                                       \
     } while (0)
 
+/* buffers for aggregated actions are allocated as their headers arrive */
+#define DF_ALLOC_ACTS()                                         \
+    do {                                                        \
+        df->acts = GU_CALLOC (frg->act_num, struct gu_buf);     \
+                                                                \
+        if(gu_likely(df->acts != NULL)) {                       \
+            df->act_num = frg->act_num;                         \
+            df->head    = NULL;                                 \
+            df->tail    = NULL;                                 \
+        }                                                       \
+        else {                                                  \
+            gu_error ("Could not allocate memory for %d "       \
+                      "aggregated actions", frg->act_num);      \
+            assert(0);                                          \
+            return -ENOMEM;                                     \
+        }                                                       \
+    } while (0)
+
+/*!
+ * Copies fragment of aggregated action. Every action in the aggregate is
+ * preceded by its 32-bit size and gets a separate buffer, so that the
+ * aggregate can be delivered without copying it once more.
+ *
+ * @return 0 on success, negative error code otherwise
+ */
+static long
+df_copy_acts (gcs_defrag_t* df, const uint8_t* ptr, size_t len)
+{
+    while (len > 0) {
+
+        if (NULL == df->head) {
+            /* size header of the next action, may span fragments */
+            size_t const n = std::min (len, sizeof(df->hdr) - df->hdr_len);
+
+            memcpy (df->hdr + df->hdr_len, ptr, n);
+            df->hdr_len += n;
+            ptr         += n;
+            len         -= n;
+
+            if (df->hdr_len < sizeof(df->hdr)) break;
+
+            uint32_t size;
+            memcpy (&size, df->hdr, sizeof(size));
+            size = gtohl(size);
+
+            /* df->received already accounts for the rest of fragment */
+            if (gu_unlikely(df->act_idx >= df->act_num || 0 == size ||
+                            size > df->size - df->received + len)) {
+                gu_error ("Malformed aggregated action %lld: action %d of %d,"
+                          " size %u", df->sent_id, df->act_idx, df->act_num,
+                          size);
+                assert(0);
+                return -EPROTO;
+            }
+
+            df->head = static_cast<uint8_t*>(gcs_gcache_malloc (df->cache,
+                                                                size));
+            if (gu_unlikely(NULL == df->head)) {
+                gu_error ("Could not allocate memory for new "
+                          "action of size: %u", size);
+                assert(0);
+                return -ENOMEM;
+            }
+
+            df->tail    = df->head;
+            df->hdr_len = 0;
+            df->acts[df->act_idx].ptr  = df->head;
+            df->acts[df->act_idx].size = size;
+        }
+
+        size_t const left = df->acts[df->act_idx].size - (df->tail - df->head);
+        size_t const n    = std::min (len, left);
+
+        memcpy (df->tail, ptr, n);
+        df->tail += n;
+        ptr      += n;
+        len      -= n;
+
+        if (n == left) {
+            /* action complete */
+            df->act_idx++;
+            df->head = NULL;
+            df->tail = NULL;
+        }
+    }
+
+    return 0;
+}
+
 /*!
  * Handle action fragment
  *
@@ -66,19 +157,31 @@ gcs_defrag_handle_frag (gcs_defrag_t*         df,
                 df->tail     = df->head;
                 df->reset    = false;
 
-                if (df->size != frg->act_size) {
+                if (df->size != frg->act_size || df->acts ||
+                    frg->act_num > 1) {
 
                     df->size = frg->act_size;
 
 #ifndef GCS_FOR_GARB
-                    if (df->cache !=NULL) {
+                    if (df->acts) {
+                        gcs_defrag_free_acts (df->cache, df->acts,
+                                              df->act_idx + (NULL != df->head));
+                        df->acts    = NULL;
+                        df->act_num = 0;
+                        df->act_idx = 0;
+                        df->hdr_len = 0;
+                    }
+                    else if (df->cache !=NULL) {
                         gcache_free (df->cache, df->head);
                     }
                     else {
                         free ((void*)df->head);
                     }
 
-                    DF_ALLOC();
+                    if (gu_likely(1 == frg->act_num))
+                        DF_ALLOC();
+                    else
+                        DF_ALLOC_ACTS();
 #endif /* GCS_FOR_GARB */
                 }
             }
@@ -106,12 +209,24 @@ gcs_defrag_handle_frag (gcs_defrag_t*         df,
         /* new action */
         if (gu_likely(0 == frg->frag_no)) {
 
+            if (gu_unlikely(frg->act_num > 1 &&
+                            GCS_ACT_TORDERED != frg->act_type)) {
+                gu_error ("Aggregated action of type %s received. "
+                          "Protocol error.",
+                          gcs_act_type_to_str(frg->act_type));
+                assert(0);
+                return -EPROTO;
+            }
+
             df->size    = frg->act_size;
             df->sent_id = frg->act_id;
             df->reset   = false;
 
 #ifndef GCS_FOR_GARB
-            DF_ALLOC();
+            if (gu_likely(1 == frg->act_num))
+                DF_ALLOC();
+            else
+                DF_ALLOC_ACTS();
 #else
             /* we don't store actions locally at all */
             df->head = NULL;
@@ -145,9 +260,16 @@ gcs_defrag_handle_frag (gcs_defrag_t*         df,
     assert (df->received <= df->size);
 
 #ifndef GCS_FOR_GARB
-    assert (df->tail);
-    memcpy (df->tail, frg->frag, frg->frag_len);
-    df->tail += frg->frag_len;
+    if (gu_likely(NULL == df->acts)) {
+        assert (df->tail);
+        memcpy (df->tail, frg->frag, frg->frag_len);
+        df->tail += frg->frag_len;
+    }
+    else {
+        long const ret = df_copy_acts (
+            df, static_cast<const uint8_t*>(frg->frag), frg->frag_len);
+        if (gu_unlikely(ret)) return ret;
+    }
 #else
     /* we skip memcpy since have not allocated any buffer */
     assert (NULL == df->tail);
@@ -156,7 +278,19 @@ gcs_defrag_handle_frag (gcs_defrag_t*         df,
 
 #if 1
     if (df->received == df->size) {
-        act->buf     = df->head;
+        if (gu_unlikely(NULL != df->acts)) {
+            if (gu_unlikely(df->act_idx != df->act_num)) {
+                gu_error ("Malformed aggregated action %lld: "
+                          "%d of %d actions received", df->sent_id,
+                          df->act_idx, df->act_num);
+                assert(0);
+                return -EPROTO;
+            }
+            act->buf = df->acts;
+        }
+        else {
+            act->buf = df->head;
+        }
         act->buf_len = df->received;
         gcs_defrag_init (df, df->cache);
         return act->buf_len;
@@ -29,6 +29,13 @@ typedef struct gcs_defrag
     size_t         received;
     ulong          frag_no; // number of fragment received
     bool           reset;
+    /* aggregated action is received into a separate buffer per action,
+     * head and tail then refer to the action being received */
+    struct gu_buf* acts;    // buffers of aggregated actions
+    int            act_num; // number of aggregated actions
+    int            act_idx; // number of actions received completely
+    size_t         hdr_len; // received bytes of the action size header
+    uint8_t        hdr[sizeof(uint32_t)];
 }
 gcs_defrag_t;
 
@@ -43,6 +50,11 @@ gcs_defrag_init (gcs_defrag_t* df, gcache_t* cache)
 /*!
  * Handle received action fragment
  *
+ * Aggregated action (frg->act_num > 1) is returned as act->buf pointing to
+ * an array of act_num gu_buf structures, one per action, each action in its
+ * own buffer. act->buf_len is the size of the aggregate as it was sent.
+ * Use gcs_defrag_free_acts() to release it.
+ *
  * @return 0              - success,
  *         size of action - success, full action received,
  *         negative       - error.
@@ -53,6 +65,19 @@ gcs_defrag_handle_frag (gcs_defrag_t*         df,
                         struct gcs_act*       act,
                         bool                  local);
 
+/*! Free the first act_num buffers of aggregated action and the array */
+static inline void
+gcs_defrag_free_acts (gcache_t* cache, const void* acts, int act_num)
+{
+    const struct gu_buf* const bufs = static_cast<const struct gu_buf*>(acts);
+
+    if (NULL == bufs) return; // GCS_FOR_GARB
+
+    for (int i = 0; i < act_num; ++i) gcs_gcache_free (cache, bufs[i].ptr);
+
+    gu_free (const_cast<void*>(acts));
+}
+
 /*! Deassociate, but don't deallocate action resources */
 static inline void
 gcs_defrag_forget (gcs_defrag_t* df)
@@ -65,12 +90,18 @@ static inline void
 gcs_defrag_free (gcs_defrag_t* df)
 {
 #ifndef GCS_FOR_GARB
-    if (df->head) {
+    if (df->acts) {
+        /* completely received actions and the one being received */
+        gcs_defrag_free_acts (df->cache, df->acts,
+                              df->act_idx + (NULL != df->head));
+    }
+    else if (df->head) {
         gcs_gcache_free (df->cache, df->head);
         // df->head, df->tail will be zeroed in gcs_defrag_init() below
     }
 #else
     assert(NULL == df->head);
+    assert(NULL == df->acts);
 #endif
 
     gcs_defrag_init (df, df->cache);
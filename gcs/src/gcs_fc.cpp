@@ -11,6 +11,9 @@
 
 #include <galerautils.h>
 #include <string.h>
+#include <math.h>
+
+#include <algorithm>
 
 double const gcs_fc_hard_limit_fix = 0.9; //! allow for some overhead
 
@@ -204,3 +207,255 @@ gcs_fc_process (gcs_fc_t* fc, ssize_t act_size)
 }
 
 void gcs_fc_debug (gcs_fc_t* fc, long debug_level) { fc->debug = debug_level; }
+
+static double const rate_period  = 0.05; //! apply rate sample period (s)
+static double const rate_smooth  = 0.5;  //! weight of a new rate sample
+static double const rate_horizon = 0.05; //! time to settle at target (s)
+static double const rate_min     = 0.1;  //! lowest hint, fraction of apply rate
+static double const hint_period  = 0.01; //! minimum interval between hints (s)
+
+void
+gcs_fc_rate_reset (gcs_fc_rate_t* const fc, long long const now)
+{
+    assert (fc != NULL);
+
+    fc->apply_rate = 0.0;
+    fc->hint       = 0.0;
+    fc->prev       = 0.0;
+    fc->hint_time  = now;
+    fc->start      = now;
+    fc->count      = 0;
+    fc->drained    = false;
+    fc->act_count  = 0;
+}
+
+/*
+ * Apply rate is measured over sample periods. If the queue ran empty during
+ * the period, the applier was idle at times and the sample is only a lower
+ * bound of its rate.
+ *
+ * Once the queue exceeds half of the target length, the node asks for
+ *
+ *     rate = apply_rate - (queue_len - target) / rate_horizon
+ *
+ * at which the queue settles at target length in about rate_horizon seconds,
+ * and keeps on updating it as long as the queue stays over quarter of target.
+ */
+double
+gcs_fc_rate_process (gcs_fc_rate_t* const fc,
+                     long           const acts,
+                     long           const queue_len,
+                     long           const target,
+                     long long      const now)
+{
+    fc->count     += acts;
+    fc->act_count += acts;
+    fc->drained = fc->drained || (0 == queue_len);
+
+    double const period = (now - fc->start) * 1.0e-9;
+
+    if (period >= rate_period ||
+        /* first estimate is needed sooner, but not from a couple of actions */
+        (0.0 == fc->apply_rate && period >= hint_period)) {
+
+        double const rate = fc->count / period;
+
+        if (fc->drained) {
+            if (rate > fc->apply_rate) fc->apply_rate = rate;
+        }
+        else if (fc->apply_rate > 0.0) {
+            fc->apply_rate += rate_smooth * (rate - fc->apply_rate);
+        }
+        else {
+            fc->apply_rate = rate;
+        }
+
+        fc->start   = now;
+        fc->count   = 0;
+        fc->drained = false;
+    }
+
+    if (gu_unlikely(fc->debug > 0 &&
+                    fc->act_count / fc->debug !=
+                    (fc->act_count - acts) / fc->debug)) {
+        gu_info ("FC: queue length: %ld (target %ld), apply rate: %.1f act/s, "
+                 "drain time: %.3fs, rate hint: %.1f act/s",
+                 queue_len, target, fc->apply_rate,
+                 gcs_fc_rate_drain_time (fc, queue_len), fc->hint);
+    }
+
+    if (0.0 == fc->apply_rate) return -1.0;
+
+    double hint = 0.0;
+
+    if (fc->hint > 0.0) {
+        if ((now - fc->hint_time) * 1.0e-9 < hint_period) return -1.0;
+
+        if (4 * queue_len > target) {
+            hint = fc->apply_rate - (queue_len - target) / rate_horizon;
+            hint = std::max (hint, fc->apply_rate * rate_min);
+            hint = std::max (hint, 1.0);
+
+            /* not worth sending if the difference would not accumulate
+             * to a quarter of target queue length over the horizon */
+            if (fabs (hint - fc->hint) * rate_horizon <
+                std::max (target / 4, 1L)) return -1.0;
+        }
+        /* else caught up, cancel */
+    }
+    else if (2 * queue_len > target) {
+        hint = fc->apply_rate - (queue_len - target) / rate_horizon;
+        hint = std::max (hint, fc->apply_rate * rate_min);
+        hint = std::max (hint, 1.0);
+    }
+    else {
+        return -1.0;
+    }
+
+    fc->prev      = fc->hint;
+    fc->hint      = hint;
+    fc->hint_time = now;
+
+    return hint;
+}
+
+void
+gcs_fc_rate_debug (gcs_fc_rate_t* fc, long debug_level)
+{
+    fc->debug = debug_level;
+}
+
+static long   const pace_window = 256; //! actions per share estimate
+static double const pace_burst  = 4.0; //! actions allowed at once after idle
+
+int
+gcs_fc_pace_init (gcs_fc_pace_t* const pace, long const memb_num)
+{
+    assert (memb_num > 0);
+
+    if (pace->memb_num != memb_num) {
+        void* const tmp = gu_realloc (pace->hints, memb_num * sizeof(double));
+
+        if (NULL == tmp) return -ENOMEM;
+
+        pace->hints    = static_cast<double*>(tmp);
+        pace->memb_num = memb_num;
+    }
+
+    for (long i = 0; i < memb_num; ++i) pace->hints[i] = 0.0;
+
+    pace->group_rate = 0.0;
+    pace->share      = 0.0;
+    pace->local      = 0;
+    pace->total      = 0;
+    pace->next       = 0;
+
+    return 0;
+}
+
+void
+gcs_fc_pace_free (gcs_fc_pace_t* const pace)
+{
+    gu_free (pace->hints);
+    pace->hints    = NULL;
+    pace->memb_num = 0;
+}
+
+void
+gcs_fc_pace_hint (gcs_fc_pace_t* const pace,
+                  long           const memb_idx,
+                  double         const rate)
+{
+    if (memb_idx < 0 || memb_idx >= pace->memb_num) return;
+
+    pace->hints[memb_idx] = rate;
+    pace->group_rate      = 0.0;
+
+    for (long i = 0; i < pace->memb_num; ++i) {
+        double const h = pace->hints[i];
+
+        if (h > 0.0 && (0.0 == pace->group_rate || h < pace->group_rate)) {
+            pace->group_rate = h;
+        }
+    }
+}
+
+void
+gcs_fc_pace_account (gcs_fc_pace_t* const pace, bool const local)
+{
+    pace->local += local;
+    pace->total++;
+
+    if (pace->total >= pace_window) {
+        pace->share = 0.5 * (pace->share + (double)pace->local / pace->total);
+        pace->local = 0;
+        pace->total = 0;
+    }
+}
+
+double
+gcs_fc_pace_rate (const gcs_fc_pace_t* const pace)
+{
+    if (0.0 == pace->group_rate) return 0.0;
+
+    /* every member is entitled to at least its equal share of the rate:
+     * the feedback through the hints corrects any excess */
+    double const min_share = pace->memb_num > 0 ? 1.0 / pace->memb_num : 1.0;
+
+    return pace->group_rate * std::max (pace->share, min_share);
+}
+
+/*
+ * Virtual scheduling: each action is given a slot 1/rate after the previous
+ * one. After idle time slots are not accumulated beyond a small burst.
+ */
+long long
+gcs_fc_pace_delay (gcs_fc_pace_t* const pace, long long const now)
+{
+    double const rate = gcs_fc_pace_rate (pace);
+
+    if (0.0 == rate) {
+        pace->next = 0;
+        return 0;
+    }
+
+    long long const interval = 1.0e9 / rate;
+    long long const earliest = now - interval * pace_burst;
+
+    if (pace->next < earliest) pace->next = earliest;
+
+    long long const slot = pace->next;
+
+    pace->next = slot + interval;
+
+    if (slot > now) {
+        pace->sleeps++;
+        pace->sleep_ns += slot - now;
+        return slot - now;
+    }
+
+    return 0;
+}
+
+#ifdef GCS_CORE_TESTING
+
+static long long
+fc_real_now (void) { return gu_time_monotonic(); }
+
+static long long (*fc_now)   (void)      = fc_real_now;
+static void      (*fc_sleep) (long long) = gcs_fc_nanosleep;
+
+long long
+gcs_fc_now (void) { return fc_now(); }
+
+void
+gcs_fc_sleep (long long const nsec) { fc_sleep (nsec); }
+
+void
+gcs_fc_set_clock (long long (*now)(void), void (*sleep)(long long nsec))
+{
+    fc_now   = now   ? now   : fc_real_now;
+    fc_sleep = sleep ? sleep : gcs_fc_nanosleep;
+}
+
+#endif /* GCS_CORE_TESTING */
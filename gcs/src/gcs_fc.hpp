@@ -14,6 +14,8 @@
 #include <unistd.h>
 #include <errno.h>
 
+#include <gu_time.h>
+
 typedef struct gcs_fc
 {
     ssize_t hard_limit; // hard limit for slave queue size
@@ -56,4 +58,131 @@ gcs_fc_process (gcs_fc_t* fc, ssize_t act_size);
 extern void
 gcs_fc_debug (gcs_fc_t* fc, long debug_level);
 
+/*
+ * Rate-based flow control.
+ *
+ * Instead of stopping the whole group when its slave queue grows too long,
+ * a lagging node estimates its apply rate and asks the group to replicate
+ * no faster than the rate at which its queue would settle at target length.
+ * Senders then pace their actions to the lowest rate asked.
+ */
+
+/*! Apply rate estimator of the receiving side */
+typedef struct gcs_fc_rate
+{
+    double    apply_rate; // estimated apply rate (actions/s), 0 - unknown
+    double    hint;       // rate hint in effect (actions/s), 0 - none
+    double    prev;       // hint which was in effect before the last one
+    long long hint_time;  // when the last hint was sent (nanosec, monotonic)
+    long long start;      // beginning of the sample period (nanosec, monotonic)
+    long      count;      // actions applied in the sample period
+    bool      drained;    // queue was empty during the sample period
+    long      act_count;  // action count
+    long      debug;      // how often to print debug messages, 0 - never
+}
+gcs_fc_rate_t;
+
+/*! Resets estimation, cancels the hint in effect */
+extern void
+gcs_fc_rate_reset (gcs_fc_rate_t* fc, long long now);
+
+/*! Accounts for actions taken from slave queue.
+ *  @param acts      number of actions taken at once
+ *  @param queue_len slave queue length after the actions were taken
+ *  @param target    desired slave queue length
+ *  @param now       current time (nanosec, monotonic)
+ *  @return rate hint to send to group: positive rate in actions/s,
+ *          0 to cancel the hint in effect, negative if nothing to send */
+extern double
+gcs_fc_rate_process (gcs_fc_rate_t* fc, long acts, long queue_len,
+                     long target, long long now);
+
+/*! Restores the hint that was in effect before the one that failed to send */
+static inline void
+gcs_fc_rate_undo (gcs_fc_rate_t* fc) { fc->hint = fc->prev; }
+
+/*! @return time to drain the queue at the estimated apply rate (s) */
+static inline double
+gcs_fc_rate_drain_time (const gcs_fc_rate_t* fc, long queue_len)
+{
+    return (fc->apply_rate > 0.0 ? queue_len / fc->apply_rate : 0.0);
+}
+
+/*! Print debug info every debug_level actions taken from slave queue. */
+extern void
+gcs_fc_rate_debug (gcs_fc_rate_t* fc, long debug_level);
+
+/*! Paces local replication according to rate hints received from group */
+typedef struct gcs_fc_pace
+{
+    double*   hints;      // hints by member index (actions/s), 0 - none
+    long      memb_num;   // number of members in the group
+    double    group_rate; // lowest hint in the group, 0 - no limit
+    double    share;      // fraction of group actions replicated locally
+    long      local;      // local actions in the share estimation window
+    long      total;      // all actions in the share estimation window
+    long long next;       // when the next local action is due (nanosec)
+    long long sleeps;     // number of delays imposed
+    long long sleep_ns;   // total length of delays imposed
+}
+gcs_fc_pace_t;
+
+/*! Clears all hints for a new group configuration.
+ *  @return 0 or -ENOMEM */
+extern int
+gcs_fc_pace_init (gcs_fc_pace_t* pace, long memb_num);
+
+extern void
+gcs_fc_pace_free (gcs_fc_pace_t* pace);
+
+/*! Records rate hint of a group member, 0 cancels the member's hint */
+extern void
+gcs_fc_pace_hint (gcs_fc_pace_t* pace, long memb_idx, double rate);
+
+/*! Accounts for a replicated action to estimate local share of the load */
+extern void
+gcs_fc_pace_account (gcs_fc_pace_t* pace, bool local);
+
+/*! @return local replication rate limit (actions/s), 0 - no limit */
+extern double
+gcs_fc_pace_rate (const gcs_fc_pace_t* pace);
+
+/*! Schedules the next local action.
+ *  @return nanoseconds to wait before sending it */
+extern long long
+gcs_fc_pace_delay (gcs_fc_pace_t* pace, long long now);
+
+static inline void
+gcs_fc_nanosleep (long long const nsec)
+{
+    struct timespec const ts = { time_t(nsec / 1000000000LL),
+                                 long(nsec % 1000000000LL) };
+    nanosleep (&ts, NULL);
+}
+
+#ifndef GCS_CORE_TESTING
+
+/*! Clock of rate-based flow control (nanosec, monotonic) */
+static inline long long
+gcs_fc_now (void) { return gu_time_monotonic(); }
+
+/*! Sleeps for nsec by the flow control clock */
+static inline void
+gcs_fc_sleep (long long const nsec) { gcs_fc_nanosleep (nsec); }
+
+#else
+
+extern long long
+gcs_fc_now (void);
+
+extern void
+gcs_fc_sleep (long long nsec);
+
+/*! Makes rate-based flow control run on a simulated clock,
+ *  NULL restores the real one */
+extern void
+gcs_fc_set_clock (long long (*now)(void), void (*sleep)(long long nsec));
+
+#endif /* GCS_CORE_TESTING */
+
 #endif /* _gcs_fc_h_ */
@@ -4,10 +4,6 @@
 
 /*!
  * @file GComm GCS Backend implementation
- *
- * @todo Figure out if there is lock-free way to handle RecvBuf
- *       push/pop operations.
- *
  */
 
 
@@ -32,6 +28,8 @@
 #include <gu_throw.hpp>
 #include <gu_logger.hpp>
 #include <gu_prodcons.hpp>
+#include <gu_stats.hpp>
+#include <gu_spsc_ring.hpp>
 
 #include <deque>
 
@@ -63,85 +61,61 @@ private:
     ProtoUpMeta um_;
 };
 
-#if defined(GALERA_USE_BOOST_POOL_ALLOC)
+// gcomm thread is the only producer (or the thread closing the backend after
+// gcomm thread has been joined) and gcs receiving thread the only consumer
+typedef gu::SPSCRing<RecvBufData> RecvBuf;
 
-#include <boost/pool/pool_alloc.hpp>
 
-typedef deque<RecvBufData,
-              boost::fast_pool_allocator<
-                  RecvBufData,
-                  boost::default_user_allocator_new_delete,
-                  boost::details::pool::null_mutex
-                  >
-              >
-#else
-
-typedef deque<RecvBufData>
-
-#endif /* GALERA_USE_BOOST_POOL_ALLOC */
-
-RecvBufQueue;
-
-class RecvBuf
+/*!
+ * Send request submitted to gcomm thread by gcomm_send(). Lives on the
+ * stack of the sending thread, which waits until gcomm thread completes it.
+ */
+class SendReq
 {
-private:
-
-    class Waiting
-    {
-    public:
-        Waiting (bool& w) : w_(w) { w_ = true;  }
-        ~Waiting()                { w_ = false; }
-    private:
-        bool& w_;
-    };
-
 public:
 
-    RecvBuf() : mutex_(), cond_(), queue_(), waiting_(false) { }
-
-    void push_back(const RecvBufData& p)
-    {
-        Lock lock(mutex_);
-
-        queue_.push_back(p);
+    SendReq(const Datagram& dg, const ProtoDownMeta& dm)
+        :
+        dg_       (dg),
+        dm_       (dm),
+        submitted_(Date::monotonic()),
+        mutex_    (),
+        cond_     (),
+        err_      (0),
+        done_     (false)
+    { }
 
-        if (waiting_ == true) { cond_.signal(); }
-    }
+    Datagram&            dg()              { return dg_; }
+    const ProtoDownMeta& dm()        const { return dm_; }
+    const Date&          submitted() const { return submitted_; }
 
-    const RecvBufData& front(const Date& timeout)
+    void complete(int err)
     {
         Lock lock(mutex_);
-
-        while (queue_.empty())
-        {
-            Waiting w(waiting_);
-            if (gu_likely (timeout == GU_TIME_ETERNITY))
-            {
-                lock.wait(cond_);
-            }
-            else
-            {
-                lock.wait(cond_, timeout);
-            }
-        }
-        assert (false == waiting_);
-
-        return queue_.front();
+        err_  = err;
+        done_ = true;
+        cond_.signal();
     }
 
-    void pop_front()
+    int wait()
     {
         Lock lock(mutex_);
-        assert(queue_.empty() == false);
-        queue_.pop_front();
+        while (false == done_) lock.wait(cond_);
+        return err_;
     }
 
 private:
 
-    Mutex mutex_;
-    Cond cond_;
-    RecvBufQueue queue_;
-    bool waiting_;
+    SendReq(const SendReq&);
+    void operator=(const SendReq&);
+
+    Datagram      dg_;
+    ProtoDownMeta dm_;
+    Date          submitted_;
+    Mutex         mutex_;
+    Cond          cond_;
+    int           err_;
+    bool          done_;
 };
 
 
@@ -168,7 +142,7 @@ public:
 };
 
 
-class GCommConn : public Consumer, public Toplay
+class GCommConn : public Consumer, public Toplay, public Protonet::Handler
 {
 public:
 
@@ -184,15 +158,32 @@ public:
         refcnt_(0),
         terminated_(false),
         error_(0),
-        recv_buf_(),
+        recv_buf_(recv_buf_len_),
+        send_q_(0),
+        send_mutex_(),
+        send_q_posted_(false),
+        send_q_delay_(),
         current_view_(),
         prof_("gcs_gcomm")
     {
+        if (conf_.get<bool>(gcomm::Conf::ProtonetSendQueue))
+        {
+            send_q_ = gu_lfq_create(send_q_len_, sizeof(SendReq*));
+
+            if (send_q_ == 0)
+            {
+                delete net_;
+                gu_throw_error(ENOMEM) << "failed to create send queue";
+            }
+
+            log_info << "sending through protonet send queue";
+        }
         log_info << "backend: " << net_->type();
     }
 
     ~GCommConn()
     {
+        if (send_q_ != 0) gu_lfq_destroy(send_q_);
         delete net_;
     }
 
@@ -306,6 +297,11 @@ public:
 
     void queue_and_wait(const Message& msg, Message* ack);
 
+    // Sends datagram down. With send queue enabled passes it to gcomm
+    // thread and waits for the result instead of entering Protonet
+    // critical section.
+    int send(Datagram& dg, const ProtoDownMeta& dm);
+
     RecvBuf&    get_recv_buf()            { return recv_buf_; }
     size_t      get_mtu()           const
     {
@@ -323,6 +319,17 @@ public:
 
     void        get_status(gu::Status& status) const
     {
+        if (send_q_ != 0)
+        {
+            int    q_len, q_len_max, q_len_min;
+            double q_len_avg;
+
+            gu_lfq_stats_get(send_q_, &q_len, &q_len_max, &q_len_min,
+                             &q_len_avg);
+            status.insert("gcomm_send_q_len_avg", gu::to_string(q_len_avg));
+            status.insert("gcomm_send_q_delay", send_q_delay_.to_string());
+        }
+
         if (tp_ != 0) tp_->get_status(status);
     }
 
@@ -373,6 +380,17 @@ private:
 
     void unref() { }
 
+    // Protonet::Handler, posted to event loop to drain send queue
+    void handle();
+
+    void handle_send_q();
+    void close_send_q();
+
+    // Max number of send requests taken from send queue at once
+    static const long send_q_batch_ = 64;
+    static const long send_q_len_   = 1024;
+    static const long recv_buf_len_ = 1024;
+
     gu::Config& conf_;
     gcomm::UUID        uuid_;
     pthread_t   thd_;
@@ -384,6 +402,10 @@ private:
     bool        terminated_;
     int         error_;
     RecvBuf     recv_buf_;
+    gu_lfq_t*   send_q_;       // send requests to gcomm thread or 0
+    Mutex       send_mutex_;   // serializes pushes to send_q_
+    bool        send_q_posted_; // handle() is pending in event loop
+    gu::Stats   send_q_delay_; // time requests spend in send_q_
     View        current_view_;
     Profile     prof_;
 };
@@ -444,6 +466,118 @@ void GCommConn::queue_and_wait(const Message& msg, Message* ack)
 }
 
 
+int GCommConn::send(Datagram& dg, const ProtoDownMeta& dm)
+{
+    if (send_q_ != 0)
+    {
+        SendReq        req(dg, dm);
+        SendReq* const ptr(&req);
+        int            err;
+
+        {
+            // push must not block: handle() needs send_mutex_ to make
+            // room in the queue
+            Lock lock(send_mutex_);
+            err = gu_lfq_try_push(send_q_, &ptr, false);
+
+            if (gu_likely(err == 0) && send_q_posted_ == false)
+            {
+                // one pending handler drains everything pushed before it
+                send_q_posted_ = true;
+                net_->post(this);
+            }
+        }
+
+        if (gu_likely(err == 0))
+        {
+            return req.wait();
+        }
+        else if (err != -EAGAIN)
+        {
+            return ECONNABORTED; // send queue closed, gcomm thread is gone
+        }
+        // queue is full, send directly
+    }
+
+    gcomm::Critical<Protonet> crit(*net_);
+
+    if (gu_unlikely(error_ != 0))
+    {
+        return ECONNABORTED;
+    }
+
+    return send_down(dg, dm);
+}
+
+
+void GCommConn::handle()
+{
+    {
+        // requests pushed after this point will post a new handler
+        Lock lock(send_mutex_);
+        send_q_posted_ = false;
+    }
+
+    handle_send_q();
+}
+
+
+void GCommConn::handle_send_q()
+{
+    SendReq* reqs[send_q_batch_];
+
+    // gcomm thread is the only consumer, so pop does not block as long
+    // as queue length is non-zero
+    while (gu_lfq_length(send_q_) > 0)
+    {
+        long const n(gu_lfq_pop_batch(send_q_, reqs, send_q_batch_));
+
+        if (n <= 0) break;
+
+        const Date now(Date::monotonic());
+        long i(0);
+
+        try
+        {
+            gcomm::Critical<Protonet> crit(*net_);
+
+            for (; i < n; ++i)
+            {
+                send_q_delay_.insert(
+                    double((now - reqs[i]->submitted()).get_nsecs())/Sec);
+
+                int const err(gu_unlikely(error_ != 0) ? ECONNABORTED :
+                              send_down(reqs[i]->dg(), reqs[i]->dm()));
+                reqs[i]->complete(err);
+            }
+        }
+        catch (...)
+        {
+            for (; i < n; ++i) reqs[i]->complete(ECONNABORTED);
+            throw;
+        }
+    }
+}
+
+
+void GCommConn::close_send_q()
+{
+    if (send_q_ == 0) return;
+
+    // no push may be in flight while the queue is closed and drained,
+    // otherwise its sender would never be completed
+    Lock lock(send_mutex_);
+
+    gu_lfq_close(send_q_);
+
+    SendReq* req;
+    while (0 == gu_lfq_pop(send_q_, &req))
+    {
+        req->complete(ECONNABORTED);
+    }
+}
+
+
 void GCommConn::run()
 {
     while (true)
@@ -504,6 +638,8 @@ void GCommConn::run()
         }
 #endif
     }
+
+    close_send_q();
 }
 
 
@@ -540,12 +676,7 @@ static GCS_BACKEND_SEND_FN(gcomm_send)
         SharedBuffer(
             new Buffer(reinterpret_cast<const byte_t*>(buf),
                        reinterpret_cast<const byte_t*>(buf) + len)));
-    gcomm::Critical<Protonet> crit(conn.get_pnet());
-    if (gu_unlikely(conn.get_error() != 0))
-    {
-        return -ECONNABORTED;
-    }
-    int err = conn.send_down(
+    int err = conn.send(
         dg,
         ProtoDownMeta(msg_type, msg_type == GCS_MSG_CAUSAL ?
                       O_LOCAL_CAUSAL : O_SAFE));
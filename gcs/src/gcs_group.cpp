@@ -1263,13 +1263,17 @@ void
 gcs_group_ignore_action (gcs_group_t* group, struct gcs_act_rcvd* act)
 {
     if (act->act.type <= GCS_ACT_STATE_REQ) {
-        gcs_gcache_free (group->cache, act->act.buf);
+        if (gu_likely(1 == act->act_num))
+            gcs_gcache_free (group->cache, act->act.buf);
+        else
+            gcs_defrag_free_acts (group->cache, act->act.buf, act->act_num);
     }
 
     act->act.buf     = NULL;
     act->act.buf_len = 0;
     act->act.type    = GCS_ACT_ERROR;
     act->sender_idx  = -1;
+    act->act_num     = 1;
     assert (GCS_SEQNO_ILL == act->id);
 }
 
@@ -165,6 +165,7 @@ gcs_group_handle_act_msg (gcs_group_t*          const group,
         assert (ret == rcvd->act.buf_len);
 
         rcvd->act.type = frg->act_type;
+        rcvd->act_num  = frg->act_num;
 
         if (gu_likely(GCS_ACT_TORDERED  == rcvd->act.type &&
                       GCS_GROUP_PRIMARY == group->state   &&
@@ -173,8 +174,11 @@ gcs_group_handle_act_msg (gcs_group_t*          const group,
                       commonly_supported_version)) {
             /* Common situation -
              * increment and assign act_id only for totally ordered actions
-             * and only in PRIM (skip messages while in state exchange) */
-            rcvd->id = ++group->act_id_;
+             * and only in PRIM (skip messages while in state exchange).
+             * Aggregated action takes act_num consecutive seqnos starting
+             * with rcvd->id */
+            rcvd->id = group->act_id_ + 1;
+            group->act_id_ += frg->act_num;
         }
         else if (GCS_ACT_TORDERED  == rcvd->act.type) {
             /* Rare situations */
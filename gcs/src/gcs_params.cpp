@@ -14,21 +14,29 @@ const char* const GCS_PARAMS_FC_FACTOR         = "gcs.fc_factor";
 const char* const GCS_PARAMS_FC_LIMIT          = "gcs.fc_limit";
 const char* const GCS_PARAMS_FC_MASTER_SLAVE   = "gcs.fc_master_slave";
 const char* const GCS_PARAMS_FC_DEBUG          = "gcs.fc_debug";
+const char* const GCS_PARAMS_FC_RATE           = "gcs.fc_rate";
 const char* const GCS_PARAMS_SYNC_DONOR        = "gcs.sync_donor";
 const char* const GCS_PARAMS_MAX_PKT_SIZE      = "gcs.max_packet_size";
 const char* const GCS_PARAMS_RECV_Q_HARD_LIMIT = "gcs.recv_q_hard_limit";
 const char* const GCS_PARAMS_RECV_Q_SOFT_LIMIT = "gcs.recv_q_soft_limit";
 const char* const GCS_PARAMS_MAX_THROTTLE      = "gcs.max_throttle";
+const char* const GCS_PARAMS_AGG_MAX_ACTS      = "gcs.agg_max_acts";
+const char* const GCS_PARAMS_AGG_MAX_SIZE      = "gcs.agg_max_size";
+const char* const GCS_PARAMS_AGG_MAX_DELAY     = "gcs.agg_max_delay";
 
 static const char* const GCS_PARAMS_FC_FACTOR_DEFAULT         = "1.0";
 static const char* const GCS_PARAMS_FC_LIMIT_DEFAULT          = "16";
 static const char* const GCS_PARAMS_FC_MASTER_SLAVE_DEFAULT   = "no";
 static const char* const GCS_PARAMS_FC_DEBUG_DEFAULT          = "0";
+static const char* const GCS_PARAMS_FC_RATE_DEFAULT           = "no";
 static const char* const GCS_PARAMS_SYNC_DONOR_DEFAULT        = "no";
 static const char* const GCS_PARAMS_MAX_PKT_SIZE_DEFAULT      = "64500";
 static ssize_t const GCS_PARAMS_RECV_Q_HARD_LIMIT_DEFAULT     = SSIZE_MAX;
 static const char* const GCS_PARAMS_RECV_Q_SOFT_LIMIT_DEFAULT = "0.25";
 static const char* const GCS_PARAMS_MAX_THROTTLE_DEFAULT      = "0.25";
+static const char* const GCS_PARAMS_AGG_MAX_ACTS_DEFAULT      = "1";
+static const char* const GCS_PARAMS_AGG_MAX_SIZE_DEFAULT      = "32768";
+static const char* const GCS_PARAMS_AGG_MAX_DELAY_DEFAULT     = "0";
 
 bool
 gcs_params_register(gu_config_t* conf)
@@ -43,6 +51,8 @@ gcs_params_register(gu_config_t* conf)
                           GCS_PARAMS_FC_MASTER_SLAVE_DEFAULT);
     ret |= gu_config_add (conf, GCS_PARAMS_FC_DEBUG,
                           GCS_PARAMS_FC_DEBUG_DEFAULT);
+    ret |= gu_config_add (conf, GCS_PARAMS_FC_RATE,
+                          GCS_PARAMS_FC_RATE_DEFAULT);
     ret |= gu_config_add (conf, GCS_PARAMS_SYNC_DONOR,
                           GCS_PARAMS_SYNC_DONOR_DEFAULT);
     ret |= gu_config_add (conf, GCS_PARAMS_MAX_PKT_SIZE,
@@ -57,6 +67,12 @@ gcs_params_register(gu_config_t* conf)
                           GCS_PARAMS_RECV_Q_SOFT_LIMIT_DEFAULT);
     ret |= gu_config_add (conf, GCS_PARAMS_MAX_THROTTLE,
                           GCS_PARAMS_MAX_THROTTLE_DEFAULT);
+    ret |= gu_config_add (conf, GCS_PARAMS_AGG_MAX_ACTS,
+                          GCS_PARAMS_AGG_MAX_ACTS_DEFAULT);
+    ret |= gu_config_add (conf, GCS_PARAMS_AGG_MAX_SIZE,
+                          GCS_PARAMS_AGG_MAX_SIZE_DEFAULT);
+    ret |= gu_config_add (conf, GCS_PARAMS_AGG_MAX_DELAY,
+                          GCS_PARAMS_AGG_MAX_DELAY_DEFAULT);
 
     return ret;
 }
@@ -186,6 +202,16 @@ gcs_params_init (struct gcs_params* params, gu_config_t* config)
     if ((ret = params_init_long (config, GCS_PARAMS_MAX_PKT_SIZE, 0,LONG_MAX,
                                  &params->max_packet_size))) return ret;
 
+    /* number of actions must fit into 16-bit protocol field */
+    if ((ret = params_init_long (config, GCS_PARAMS_AGG_MAX_ACTS, 1, 0xFFFF,
+                                 &params->agg_max_acts))) return ret;
+
+    if ((ret = params_init_long (config, GCS_PARAMS_AGG_MAX_SIZE, 0,LONG_MAX,
+                                 &params->agg_max_size))) return ret;
+
+    if ((ret = params_init_long (config, GCS_PARAMS_AGG_MAX_DELAY, 0, LONG_MAX,
+                                 &params->agg_max_delay))) return ret;
+
     if ((ret = params_init_double (config, GCS_PARAMS_FC_FACTOR, 0.0, 1.0,
                                    &params->fc_resume_factor))) return ret;
 
@@ -205,6 +231,9 @@ gcs_params_init (struct gcs_params* params, gu_config_t* config)
     if ((ret = params_init_bool (config, GCS_PARAMS_FC_MASTER_SLAVE,
                                  &params->fc_master_slave))) return ret;
 
+    if ((ret = params_init_bool (config, GCS_PARAMS_FC_RATE,
+                                 &params->fc_rate))) return ret;
+
     if ((ret = params_init_bool (config, GCS_PARAMS_SYNC_DONOR,
                                  &params->sync_donor))) return ret;
     return 0;
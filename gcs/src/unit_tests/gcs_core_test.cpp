@@ -701,6 +701,82 @@ START_TEST (gcs_core_test_own)
 }
 END_TEST
 
+// aggregated action gets consecutive seqnos, one for every action in it
+START_TEST (gcs_core_test_aggregate)
+{
+    core_test_init ();
+
+    const char* const act_strs[]  = { act1_str, act2_str, act3_str };
+    size_t      const act_sizes[] = {
+        sizeof(act1_str), sizeof(act2_str), sizeof(act3_str)
+    };
+    int const act_num = sizeof(act_strs)/sizeof(act_strs[0]);
+
+    // every action is preceded by its 32-bit size in galera byte order
+    uint32_t      hdrs[act_num];
+    struct gu_buf agg[2 * act_num];
+    size_t        agg_size = 0;
+
+    for (int i = 0; i < act_num; ++i) {
+        hdrs[i] = htogl(uint32_t(act_sizes[i]));
+        agg[2*i].ptr      = &hdrs[i];
+        agg[2*i].size     = sizeof(hdrs[i]);
+        agg[2*i + 1].ptr  = act_strs[i];
+        agg[2*i + 1].size = act_sizes[i];
+        agg_size += sizeof(hdrs[i]) + act_sizes[i];
+    }
+
+    gcs_core_send_lock_step (Core, false);
+
+    long ret = gcs_core_send_aggregate (Core, agg, agg_size, act_num);
+    fail_if (ret != (long)agg_size, "gcs_core_send_aggregate(): %ld (%s)",
+             ret, strerror(-ret));
+
+    struct gcs_act_rcvd rcvd;
+    ret = gcs_core_recv (Core, &rcvd, GU_TIME_ETERNITY);
+    fail_if (ret != (long)agg_size, "gcs_core_recv(): %ld (%s)",
+             ret, strerror(-ret));
+    fail_if (GCS_ACT_TORDERED != rcvd.act.type);
+    fail_if (rcvd.local != agg);
+    fail_if (rcvd.act_num != act_num, "act_num: %d", rcvd.act_num);
+    fail_if (rcvd.id != Seqno + 1, "expected seqno %lld, got %lld",
+             (long long)(Seqno + 1), (long long)rcvd.id);
+
+    // every action comes in its own buffer, check it and its seqno
+    const struct gu_buf* const acts =
+        static_cast<const struct gu_buf*>(rcvd.act.buf);
+
+    for (int i = 0; i < act_num; ++i) {
+        fail_if (acts[i].size != (ssize_t)act_sizes[i],
+                 "action %d size: expected %zu, got %zd",
+                 i, act_sizes[i], acts[i].size);
+        fail_if (memcmp (acts[i].ptr, act_strs[i], act_sizes[i]),
+                 "action %d: expected '%s', got '%s'", i, act_strs[i],
+                 (const char*)acts[i].ptr);
+
+        gcs_seqno_t const seqno = rcvd.id + i;
+        fail_if (seqno != Seqno + 1, "action %d: expected seqno %lld, "
+                 "got %lld", i, (long long)(Seqno + 1), (long long)seqno);
+        Seqno = seqno;
+    }
+
+    gcs_defrag_free_acts (NULL, rcvd.act.buf, act_num);
+
+    // next action is ordered right after the last one in aggregate
+    ret = gcs_core_send (Core, act1, sizeof(act1_str), GCS_ACT_TORDERED);
+    fail_if (ret != sizeof(act1_str), "gcs_core_send(): %ld (%s)",
+             ret, strerror(-ret));
+    action_t act(act1, NULL, NULL, -1, (gcs_act_type_t)-1, -1,
+                 (gu_thread_t)-1);
+    fail_if (CORE_RECV_ACT (&act, act1_str, sizeof(act1_str),GCS_ACT_TORDERED));
+    free (act.out);
+
+    gcs_core_send_lock_step (Core, true);
+
+    core_test_cleanup ();
+}
+END_TEST
+
 /*
  * Disabled test because it is too slow and timeouts on crowded
  * build systems like e.g. build.opensuse.org
@@ -738,6 +814,7 @@ START_TEST (gcs_core_test_gh74)
     frg.act_id = 1;
     frg.act_size = act_size;
     frg.act_type = GCS_ACT_STATE_REQ;
+    frg.act_num = 1;
     char msg_buf[1024];
     fail_if(gcs_act_proto_write(&frg, msg_buf, sizeof(msg_buf)));
     memcpy(const_cast<void*>(frg.frag), act_ptr, act_size);
@@ -948,6 +1025,7 @@ Suite *gcs_core_suite(void)
   if (skip == false) {
       tcase_add_test  (tcase, gcs_core_test_api);
       tcase_add_test  (tcase, gcs_core_test_own);
+      tcase_add_test  (tcase, gcs_core_test_aggregate);
       //  tcase_add_test  (tcase, gcs_core_test_foreign);
       // tcase_add_test (tcase, gcs_core_test_gh74);
   }
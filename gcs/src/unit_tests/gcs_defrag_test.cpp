@@ -9,6 +9,8 @@
 #include <string.h>
 #include <errno.h>
 
+#include <algorithm>
+
 #include "gcs_defrag_test.hpp"
 #include "../gcs_defrag.hpp"
 
@@ -67,6 +69,7 @@ START_TEST (gcs_defrag_test)
     frg1.frag_no   = 0;
     frg1.act_type  = GCS_ACT_TORDERED;
     frg1.proto_ver = 0;
+    frg1.act_num   = 1;
 
     // normal fragments
     frg2 = frg3 = frg1;
@@ -164,6 +167,74 @@ START_TEST (gcs_defrag_test)
 }
 END_TEST
 
+// aggregated action must come out as separate actions in separate buffers
+// regardless of how it is fragmented
+START_TEST (gcs_defrag_aggregate)
+{
+    const char* const act_strs[] = { "Test", "action", "smuction" };
+    int const         act_num    = sizeof(act_strs)/sizeof(act_strs[0]);
+
+    char   act_buf[64];
+    size_t act_len = 0;
+
+    for (int i = 0; i < act_num; ++i) {
+        uint32_t const size = strlen(act_strs[i]) + 1;
+        uint32_t const hdr  = htogl(size);
+        memcpy (act_buf + act_len, &hdr, sizeof(hdr));
+        act_len += sizeof(hdr);
+        memcpy (act_buf + act_len, act_strs[i], size);
+        act_len += size;
+    }
+
+    gcs_defrag_t defrag;
+    gcs_defrag_init (&defrag, NULL);
+
+    // every fragment length, so that size headers are split in every way
+    for (size_t frag_len = 1; frag_len <= act_len; ++frag_len) {
+
+        gcs_act_frag_t frg;
+        struct gcs_act recv_act;
+        ssize_t        ret = 0;
+
+        frg.act_id    = getpid() + frag_len;
+        frg.act_size  = act_len;
+        frg.frag_no   = 0;
+        frg.act_type  = GCS_ACT_TORDERED;
+        frg.proto_ver = GCS_ACT_PROTO_AGG;
+        frg.act_num   = act_num;
+
+        for (size_t offset = 0; offset < act_len; offset += frg.frag_len) {
+            frg.frag     = act_buf + offset;
+            frg.frag_len = std::min (frag_len, act_len - offset);
+
+            fail_if (ret != 0, "frag_len %zu: premature action completion",
+                     frag_len);
+            ret = gcs_defrag_handle_frag (&defrag, &frg, &recv_act, FALSE);
+            frg.frag_no++;
+        }
+
+        fail_if (ret != (ssize_t)act_len, "frag_len %zu: ret %zd",
+                 frag_len, ret);
+        fail_if (recv_act.buf_len != (ssize_t)act_len);
+
+        const struct gu_buf* const acts =
+            static_cast<const struct gu_buf*>(recv_act.buf);
+
+        for (int i = 0; i < act_num; ++i) {
+            fail_if (acts[i].size != (ssize_t)strlen(act_strs[i]) + 1,
+                     "frag_len %zu, action %d: size %zd", frag_len, i,
+                     acts[i].size);
+            fail_if (strcmp ((const char*)acts[i].ptr, act_strs[i]),
+                     "frag_len %zu: expected '%s', received '%s'",
+                     frag_len, act_strs[i], (const char*)acts[i].ptr);
+        }
+
+        gcs_defrag_free_acts (NULL, recv_act.buf, act_num);
+        defrag_check_init (&defrag); // should be empty
+    }
+}
+END_TEST
+
 Suite *gcs_defrag_suite(void)
 {
   Suite *suite = suite_create("GCS defragmenter");
@@ -171,6 +242,7 @@ Suite *gcs_defrag_suite(void)
 
   suite_add_tcase (suite, tcase);
   tcase_add_test  (tcase, gcs_defrag_test);
+  tcase_add_test  (tcase, gcs_defrag_aggregate);
   return suite;
 }
 
@@ -4,8 +4,12 @@
 
 #include "gcs_fc_test.hpp"
 #include "../gcs_fc.hpp"
+#include "../gcs.hpp"
+
+#include <galerautils.h>
 
 #include <stdbool.h>
+#include <stdlib.h>
 #include <string.h>
 
 START_TEST(gcs_fc_test_limits)
@@ -120,6 +124,393 @@ START_TEST(gcs_fc_test_precise)
 }
 END_TEST
 
+/* Discrete event simulation of a single node group in rate FC mode:
+ * the sender replicates at offered rate, paced by the hints, while
+ * the applier applies at apply rate. Returns actions applied. */
+struct fc_rate_sim
+{
+    gcs_fc_rate_t rate;
+    gcs_fc_pace_t pace;
+    long long     now;        // nanoseconds
+    long long     next_send;  // when the next action is replicated
+    long long     next_apply; // when the applier takes the next action
+    long          queue;
+    long          target;
+};
+
+static long
+fc_rate_simulate (fc_rate_sim* const sim,
+                  double       const offered,
+                  double       const apply,
+                  double       const seconds,
+                  long*        const queue_max,
+                  long*        const window_min) // min applied in 100ms
+{
+    long long const end     = sim->now + seconds * 1.0e9;
+    long long const window  = 100000000LL;
+    long long window_end    = sim->now + window;
+    long      window_count  = 0;
+    long      applied       = 0;
+    bool      paced         = false;
+
+    *queue_max  = 0;
+    *window_min = -1;
+
+    while (sim->now < end) {
+
+        if (sim->next_send <= sim->next_apply) {
+            sim->now = sim->next_send;
+
+            long long const delay =
+                paced ? 0 : gcs_fc_pace_delay (&sim->pace, sim->now);
+
+            if (delay > 0) {
+                sim->next_send = sim->now + delay; // sleeping in gcs_repl()
+                paced = true;
+                continue;
+            }
+
+            paced = false;
+            sim->queue++;
+            sim->next_send = sim->now + 1.0e9 / offered;
+            gcs_fc_pace_account (&sim->pace, true);
+
+            if (sim->queue > *queue_max) *queue_max = sim->queue;
+        }
+        else {
+            sim->now = sim->next_apply;
+            sim->next_apply = sim->now + 1.0e9 / apply;
+
+            if (sim->queue > 0) {
+                sim->queue--;
+                applied++;
+                window_count++;
+
+                double const hint = gcs_fc_rate_process (&sim->rate, 1,
+                                                         sim->queue,
+                                                         sim->target,
+                                                         sim->now);
+                if (hint >= 0.0) gcs_fc_pace_hint (&sim->pace, 0, hint);
+            }
+        }
+
+        if (sim->now >= window_end) {
+            if (*window_min < 0 || window_count < *window_min)
+                *window_min = window_count;
+            window_count = 0;
+            window_end  += window;
+        }
+    }
+
+    return applied;
+}
+
+START_TEST(gcs_fc_test_rate)
+{
+    fc_rate_sim sim;
+    long        queue_max, window_min, applied;
+
+    memset (&sim, 0, sizeof(sim));
+    sim.target = 8;
+    gcs_fc_rate_reset (&sim.rate, 0);
+    fail_if (gcs_fc_pace_init (&sim.pace, 1));
+
+    /* warm up: the applier is 5 times slower than the sender */
+    fc_rate_simulate (&sim, 5000.0, 1000.0, 0.5, &queue_max, &window_min);
+    fail_if (sim.rate.hint <= 0.0, "No rate hint at queue %ld", sim.queue);
+    fail_if (gcs_fc_pace_rate (&sim.pace) <= 0.0);
+
+    /* steady state: replication goes at apply rate and the queue stays
+     * around target without ever stopping */
+    applied = fc_rate_simulate (&sim, 5000.0, 1000.0, 2.0,
+                                &queue_max, &window_min);
+    fail_if (applied < 1900, "Applied %ld, expected ~2000", applied);
+    fail_if (queue_max > 2 * sim.target, "Queue grew to %ld", queue_max);
+    fail_if (window_min < 90, "Only %ld applied in 100ms", window_min);
+    fail_if (sim.rate.apply_rate < 900.0 || sim.rate.apply_rate > 1100.0,
+             "Estimated apply rate: %f", sim.rate.apply_rate);
+    fail_if (gcs_fc_rate_drain_time (&sim.rate, sim.queue) > 0.02);
+
+    /* applier slows down, the hints follow */
+    fc_rate_simulate (&sim, 5000.0, 400.0, 1.0, &queue_max, &window_min);
+    applied = fc_rate_simulate (&sim, 5000.0, 400.0, 2.0,
+                                &queue_max, &window_min);
+    fail_if (applied < 760, "Applied %ld, expected ~800", applied);
+    fail_if (queue_max > 2 * sim.target, "Queue grew to %ld", queue_max);
+    fail_if (window_min < 36, "Only %ld applied in 100ms", window_min);
+    fail_if (gcs_fc_pace_rate (&sim.pace) > 500.0,
+             "Rate limit %f", gcs_fc_pace_rate (&sim.pace));
+
+    /* applier outpaces the sender, the hint is cancelled */
+    applied = fc_rate_simulate (&sim, 5000.0, 20000.0, 1.0,
+                                &queue_max, &window_min);
+    fail_if (applied < 4900, "Applied %ld, expected ~5000", applied);
+    fail_if (sim.rate.hint != 0.0, "Hint still in effect: %f", sim.rate.hint);
+    fail_if (gcs_fc_pace_rate (&sim.pace) != 0.0);
+
+    gcs_fc_pace_free (&sim.pace);
+}
+END_TEST
+
+START_TEST(gcs_fc_test_pace)
+{
+    gcs_fc_pace_t pace;
+
+    memset (&pace, 0, sizeof(pace));
+    fail_if (gcs_fc_pace_init (&pace, 3));
+
+    fail_if (gcs_fc_pace_delay (&pace, 0) != 0);
+
+    /* the lowest hint in the group counts */
+    gcs_fc_pace_hint (&pace, 1, 3000.0);
+    gcs_fc_pace_hint (&pace, 2, 1500.0);
+    fail_if (pace.group_rate != 1500.0);
+    gcs_fc_pace_hint (&pace, 2, 0.0);
+    fail_if (pace.group_rate != 3000.0);
+    gcs_fc_pace_hint (&pace, 5, 1.0); // not a member
+    fail_if (pace.group_rate != 3000.0);
+
+    /* nothing replicated yet, equal share of three */
+    fail_if (gcs_fc_pace_rate (&pace) != 1000.0,
+             "Rate: %f", gcs_fc_pace_rate (&pace));
+
+    /* all actions are local */
+    for (int i = 0; i < 2048; ++i) gcs_fc_pace_account (&pace, true);
+    fail_if (gcs_fc_pace_rate (&pace) < 2950.0,
+             "Rate: %f", gcs_fc_pace_rate (&pace));
+
+    /* half of actions are local */
+    for (int i = 0; i < 4096; ++i) gcs_fc_pace_account (&pace, i & 1);
+    double const rate = gcs_fc_pace_rate (&pace);
+    fail_if (rate < 1450.0 || rate > 1550.0, "Rate: %f", rate);
+
+    /* small burst is let through, then actions are 1/rate apart */
+    long long const interval = 1.0e9 / rate;
+    long long const now      = 1000000000LL;
+    long long delay;
+    int i;
+    for (i = 0; (delay = gcs_fc_pace_delay (&pace, now)) == 0; ++i) {}
+    fail_if (i != 5, "Burst of %d", i);
+    fail_if (delay < interval || delay > interval + 1,
+             "Delay %lld, interval %lld", delay, interval);
+
+    /* a new configuration clears the hints */
+    fail_if (gcs_fc_pace_init (&pace, 2));
+    fail_if (gcs_fc_pace_rate (&pace) != 0.0);
+    fail_if (gcs_fc_pace_delay (&pace, now) != 0);
+
+    gcs_fc_pace_free (&pace);
+}
+END_TEST
+
+/* Single node group on the dummy backend: the node replicates to itself
+ * faster than it applies. Flow control runs on a simulated clock which
+ * advances by the apply time of each action and jumps through the pacing
+ * delays when there is nothing to apply, so the outcome does not depend on
+ * how fast the test threads are scheduled. */
+struct fc_dummy_sim
+{
+    gcs_conn_t*   conn;
+    bool volatile stop;
+    long volatile sent;
+    long volatile applied;
+};
+
+/* actions in flight, like that many clients waiting for replication */
+static long const fc_dummy_window = 64;
+
+static long long const fc_dummy_apply_time = 1000000; // 1ms
+
+static fc_dummy_sim* fc_dummy_current = NULL;
+static long long     fc_dummy_clock   = 0;
+
+static long long
+fc_dummy_now (void)
+{
+    long long ret;
+    gu_atomic_get (&fc_dummy_clock, &ret);
+    return ret;
+}
+
+/* called by the sender only, so no more actions arrive while it sleeps */
+static void
+fc_dummy_sleep (long long const nsec)
+{
+    long long const until = fc_dummy_now() + nsec;
+    long long       now;
+
+    while ((now = fc_dummy_now()) < until) {
+        if (fc_dummy_current->applied == fc_dummy_current->sent) {
+            /* applier is idle, nothing else moves the clock */
+            gu_atomic_bool_compare_and_swap (&fc_dummy_clock, now, until);
+        }
+        else {
+            usleep (10);
+        }
+    }
+}
+
+static void*
+fc_dummy_sender (void* arg)
+{
+    fc_dummy_sim* const sim = static_cast<fc_dummy_sim*>(arg);
+    char const          act[64] = { 0, };
+
+    while (!sim->stop) {
+        if (sim->sent - sim->applied >= fc_dummy_window) {
+            usleep (100);
+            continue;
+        }
+
+        long const ret = gcs_send (sim->conn, act, sizeof(act),
+                                   GCS_ACT_TORDERED, false);
+        if (ret < 0)
+            usleep (1000); // not in primary component yet
+        else
+            gu_atomic_fetch_and_add (&sim->sent, 1);
+    }
+
+    return NULL;
+}
+
+static void*
+fc_dummy_applier (void* arg)
+{
+    fc_dummy_sim* const sim = static_cast<fc_dummy_sim*>(arg);
+    struct gcs_action   act;
+    long                ret;
+
+    while ((ret = gcs_recv (sim->conn, &act)) > 0 || -ECANCELED == ret) {
+
+        if (ret < 0) continue;
+
+        switch (act.type) {
+        case GCS_ACT_TORDERED:
+            /* let gcs threads deliver what was sent meanwhile before the
+             * clock moves on, even on a single CPU */
+            usleep (100);
+            gu_atomic_fetch_and_add (&fc_dummy_clock, fc_dummy_apply_time);
+            gu_atomic_fetch_and_add (&sim->applied, 1);
+            break;
+        case GCS_ACT_CONF:
+            gcs_resume_recv (sim->conn);
+            break;
+        default:
+            break;
+        }
+
+        free (const_cast<void*>(act.buf));
+    }
+
+    return NULL;
+}
+
+static long
+fc_dummy_stops (gcs_conn_t* const conn)
+{
+    struct gcs_stats stats;
+    gcs_get_stats (conn, &stats);
+    return stats.fc_sent;
+}
+
+/* waits until the simulated clock reaches t */
+static void
+fc_dummy_wait (long long const t)
+{
+    while (fc_dummy_now() < t) usleep (1000);
+}
+
+/* Runs the group for warm-up + seconds of simulated time,
+ * counts what happened after warm-up */
+static void
+fc_dummy_run (bool const rate, double const seconds,
+              long* const applied, long* const stops, long* const hints)
+{
+    gu_config_t* const conf = gu_config_create ();
+    fail_if (NULL == conf);
+    fail_if (gcs_register_params (conf));
+    gu_config_set_bool (conf, "gcs.fc_rate", rate);
+
+    fc_dummy_sim sim = { NULL, false, 0, 0 };
+
+    fc_dummy_current = &sim;
+    fc_dummy_clock   = 1000000000LL;
+    gcs_fc_set_clock (fc_dummy_now, fc_dummy_sleep);
+
+    sim.conn = gcs_create (conf, NULL, "fc_test", "", 0, 0);
+    fail_if (NULL == sim.conn);
+
+    long ret = gcs_open (sim.conn, "fc_test", "dummy://", true);
+    fail_if (0 != ret, "gcs_open(): %ld (%s)", ret, strerror(-ret));
+
+    gu_thread_t sender, applier;
+    fail_if (gu_thread_create (&applier, NULL, fc_dummy_applier, &sim));
+    fail_if (gu_thread_create (&sender,  NULL, fc_dummy_sender,  &sim));
+
+    /* warm-up: let the queue fill up and rate settle */
+    fc_dummy_wait (fc_dummy_now() + 500000000LL);
+
+    long      const applied_begin = sim.applied;
+    long      const stops_begin   = fc_dummy_stops (sim.conn);
+    long long const end           = fc_dummy_now() + seconds * 1.0e9;
+
+    fc_dummy_wait (end);
+
+    *applied = sim.applied - applied_begin;
+    *stops   = fc_dummy_stops (sim.conn) - stops_begin;
+
+    sim.stop = true;
+    gu_thread_join (sender, NULL);
+
+    /* let the applier catch up, so that it does not send FC messages
+     * after the backend is closed */
+    while (sim.applied < sim.sent) usleep (10000);
+    usleep (100000);
+
+    gu::Status status;
+    gcs_get_status (sim.conn, status);
+    *hints = 0;
+    for (gu::Status::const_iterator i = status.begin(); i != status.end(); ++i)
+    {
+        if (i->first == "gcs_fc_rate_hints_sent")
+            *hints = strtol (i->second.c_str(), NULL, 10);
+    }
+
+    gu_info ("FC %s mode: applied %ld, FC_STOP sent %ld, rate hints sent %ld",
+             rate ? "rate" : "stop", *applied, *stops, *hints);
+
+    fail_if (gcs_close (sim.conn));
+    gu_thread_join (applier, NULL);
+    fail_if (gcs_destroy (sim.conn));
+    gu_config_destroy (conf);
+
+    gcs_fc_set_clock (NULL, NULL);
+    fc_dummy_current = NULL;
+}
+
+START_TEST(gcs_fc_test_rate_dummy)
+{
+    double const seconds = 2.0;
+    long stop_applied, stop_stops, stop_hints;
+    long rate_applied, rate_stops, rate_hints;
+
+    fc_dummy_run (false, seconds, &stop_applied, &stop_stops, &stop_hints);
+    fc_dummy_run (true,  seconds, &rate_applied, &rate_stops, &rate_hints);
+
+    fail_if (stop_hints != 0);
+    fail_if (stop_stops < 10, "Only %ld FC_STOPs in stop mode", stop_stops);
+
+    /* replication is paced instead of being stopped... */
+    fail_if (rate_hints == 0, "No rate hints sent");
+    fail_if (rate_stops * 4 > stop_stops, "FC_STOPs: %ld in rate mode, "
+             "%ld in stop mode", rate_stops, stop_stops);
+
+    /* ...without loss of throughput */
+    fail_if (rate_applied * 10 < stop_applied * 8, "Applied: %ld in rate mode,"
+             " %ld in stop mode", rate_applied, stop_applied);
+}
+END_TEST
+
 Suite *gcs_fc_suite(void)
 {
     Suite *s  = suite_create("GCS state transfer FC");
@@ -130,5 +521,12 @@ Suite *gcs_fc_suite(void)
     tcase_add_test  (tc, gcs_fc_test_basic);
     tcase_add_test  (tc, gcs_fc_test_precise);
 
+    tc = tcase_create("gcs_fc_rate");
+    suite_add_tcase (s, tc);
+    tcase_set_timeout (tc, 60);
+    tcase_add_test  (tc, gcs_fc_test_rate);
+    tcase_add_test  (tc, gcs_fc_test_pace);
+    tcase_add_test  (tc, gcs_fc_test_rate_dummy);
+
     return s;
 }
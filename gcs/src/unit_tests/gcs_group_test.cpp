@@ -111,6 +111,7 @@ START_TEST (gcs_group_configuration)
     frg1.frag_no   = 0;
     frg1.act_type  = GCS_ACT_TORDERED;
     frg1.proto_ver = 0;
+    frg1.act_num   = 1;
 
     // normal fragments
     frg2 = frg3 = frg1;
@@ -497,6 +498,107 @@ START_TEST(gcs_group_last_applied)
 }
 END_TEST
 
+// This tests that aggregated action gets consecutive seqnos
+START_TEST(gcs_group_aggregate)
+{
+    ssize_t         ret;
+    gcs_group_t     group;
+    gcs_comp_msg_t* comp;
+
+    const char*  agg_strs[] = { "three", "actions", "in one" };
+    const char   act_buf[]  = "one action";
+    const long   buf_len    = 64;
+    char         buf1[buf_len], buf2[buf_len];
+
+    // every action in aggregate is preceded by its 32-bit size
+    char   agg_buf[buf_len];
+    size_t agg_len = 0;
+
+    for (int i = 0; i < 3; ++i) {
+        uint32_t const size = strlen(agg_strs[i]) + 1;
+        uint32_t const hdr  = htogl(size);
+        memcpy (agg_buf + agg_len, &hdr, sizeof(hdr));
+        agg_len += sizeof(hdr);
+        memcpy (agg_buf + agg_len, agg_strs[i], size);
+        agg_len += size;
+    }
+
+    gcs_recv_msg_t msg1, msg2;
+    gcs_act_frag_t frg1, frg2, frg;
+
+    struct gcs_act_rcvd r_act;
+    struct gcs_act* act = &r_act.act;
+
+    frg1.act_id    = getpid();
+    frg1.act_size  = agg_len;
+    frg1.frag      = NULL;
+    frg1.frag_len  = 0;
+    frg1.frag_no   = 0;
+    frg1.act_type  = GCS_ACT_TORDERED;
+    frg1.proto_ver = GCS_ACT_PROTO_AGG;
+    frg1.act_num   = 3;
+
+    frg2 = frg1;
+    frg2.act_id    = frg1.act_id + 1;
+    frg2.act_size  = sizeof(act_buf);
+    frg2.act_num   = 1;
+
+    msg_write (&msg1, &frg1, buf1, buf_len, agg_buf, agg_len, 0,
+               GCS_MSG_ACTION);
+    msg_write (&msg2, &frg2, buf2, buf_len, act_buf, sizeof(act_buf), 0,
+               GCS_MSG_ACTION);
+
+    gcs_group_init (&group, NULL, "my node", "my addr", GCS_ACT_PROTO_AGG,0,0);
+
+    // single node primary component
+    comp = gcs_comp_msg_new (TRUE, false, 0, 1, 0);
+    fail_if (comp == NULL);
+    fail_if (gcs_comp_msg_add (comp, LOCALHOST, 0));
+    ret = new_component (&group, comp);
+    fail_if (ret < 0);
+    // modelling state exchange is really tedious here, just fake it
+    fail_if (group.state != GCS_GROUP_WAIT_STATE_UUID);
+    group.state = GCS_GROUP_PRIMARY;
+
+    // aggregated action takes 3 seqnos starting with the next one
+    memset (&r_act, 0, sizeof(r_act));
+    fail_if (gcs_act_proto_read (&frg, msg1.buf, msg1.size));
+    fail_if (frg.act_num != 3, "act_num: %d", frg.act_num);
+    ret = gcs_group_handle_act_msg (&group, &frg, &msg1, &r_act, true);
+    fail_if (ret != (ssize_t)agg_len, "ret: %zd", ret);
+    fail_if (act->type != GCS_ACT_TORDERED);
+    fail_if (r_act.id != 1, "Expected seqno 1, found %lld",
+             (long long)r_act.id);
+    fail_if (r_act.act_num != 3, "act_num: %d", r_act.act_num);
+
+    // every action is in its own buffer
+    const struct gu_buf* const acts =
+        static_cast<const struct gu_buf*>(act->buf);
+
+    for (int i = 0; i < 3; ++i) {
+        fail_if (acts[i].size != (ssize_t)strlen(agg_strs[i]) + 1);
+        fail_if (strcmp ((const char*)acts[i].ptr, agg_strs[i]),
+                 "Expected '%s', found '%s'", agg_strs[i],
+                 (const char*)acts[i].ptr);
+    }
+
+    gcs_defrag_free_acts (NULL, act->buf, r_act.act_num);
+
+    // next action gets the seqno right after the aggregate
+    memset (&r_act, 0, sizeof(r_act));
+    fail_if (gcs_act_proto_read (&frg, msg2.buf, msg2.size));
+    ret = gcs_group_handle_act_msg (&group, &frg, &msg2, &r_act, true);
+    fail_if (ret != sizeof(act_buf), "ret: %zd", ret);
+    fail_if (r_act.id != 4, "Expected seqno 4, found %lld",
+             (long long)r_act.id);
+    fail_if (r_act.act_num != 1, "act_num: %d", r_act.act_num);
+    free ((void*)act->buf);
+
+    gcs_comp_msg_delete (comp);
+    gcs_group_free (&group);
+}
+END_TEST
+
 START_TEST(test_gcs_group_find_donor)
 {
     gcs_group_t group;
@@ -612,6 +714,7 @@ Suite *gcs_group_suite(void)
     suite_add_tcase (suite, tcase);
     tcase_add_test  (tcase_ignore, gcs_group_configuration);
     tcase_add_test  (tcase_ignore, gcs_group_last_applied);
+    tcase_add_test  (tcase, gcs_group_aggregate);
     tcase_add_test  (tcase, test_gcs_group_find_donor);
 
     return suite;
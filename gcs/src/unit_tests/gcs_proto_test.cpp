@@ -6,6 +6,7 @@
 
 #include <unistd.h>
 #include <string.h>
+#include <errno.h>
 #include <check.h>
 
 #include "../gcs_act_proto.hpp"
@@ -19,6 +20,7 @@ frgcmp (gcs_act_frag_t* f1, gcs_act_frag_t* f2)
 	(f1->act_id   == f2->act_id)   &&
 	(f1->act_size == f2->act_size) &&
 	(f1->act_type == f2->act_type) &&
+	(f1->act_num  == f2->act_num)  &&
 	(f1->frag_len == f2->frag_len) && // expect to point
 	(f1->frag     == f2->frag)        // at the same buffer here
 	) return 0;
@@ -44,6 +46,7 @@ START_TEST (gcs_proto_test)
     frg_send.frag_no   = 0;
     frg_send.act_type  = (gcs_act_type_t)0;
     frg_send.proto_ver = 0;
+    frg_send.act_num   = 1;
 
     // set up action header
     ret = gcs_act_proto_write (&frg_send, buf, buf_len);
@@ -105,6 +108,60 @@ START_TEST (gcs_proto_test)
 }
 END_TEST
 
+START_TEST (gcs_proto_agg_test)
+{
+    const size_t buf_len = 64;
+    char         buf[buf_len];
+    gcs_act_frag_t frg_send, frg_recv;
+    long         ret;
+
+    frg_send.act_id    = getpid();
+    frg_send.act_size  = 40;
+    frg_send.frag      = NULL;
+    frg_send.frag_len  = 0;
+    frg_send.frag_no   = 0;
+    frg_send.act_type  = GCS_ACT_TORDERED;
+    frg_send.proto_ver = 0;
+    frg_send.act_num   = 3;
+
+    // v0 can't carry aggregated actions
+    ret = gcs_act_proto_write (&frg_send, buf, buf_len);
+    fail_if (-EPROTO != ret, "error code: %d", ret);
+
+    frg_send.proto_ver = 1;
+    ret = gcs_act_proto_write (&frg_send, buf, buf_len);
+    fail_if (ret, "error code: %d", ret);
+
+    ret = gcs_act_proto_read (&frg_recv, buf, buf_len);
+    fail_if (ret, "error code: %d", ret);
+    fail_if (1 != frg_recv.proto_ver);
+    fail_if (frgcmp (&frg_send, &frg_recv),
+	     "Sent and recvd headers are not identical");
+
+    // number of actions survives fragment counter increment
+    gcs_act_proto_inc (buf);
+    buf[0] = 1; // gcs_act_proto_read() clears protocol version byte
+    ret = gcs_act_proto_read (&frg_recv, buf, buf_len);
+    fail_if (ret, "error code: %d", ret);
+    fail_if (3 != frg_recv.act_num, "act_num: %d", frg_recv.act_num);
+    fail_if (1 != frg_recv.frag_no, "frag_no: %lu", frg_recv.frag_no);
+
+    // v0 message reads as a single action
+    frg_send.proto_ver = 0;
+    frg_send.act_num   = 1;
+    ret = gcs_act_proto_write (&frg_send, buf, buf_len);
+    fail_if (ret, "error code: %d", ret);
+    ret = gcs_act_proto_read (&frg_recv, buf, buf_len);
+    fail_if (ret, "error code: %d", ret);
+    fail_if (1 != frg_recv.act_num, "act_num: %d", frg_recv.act_num);
+
+    frg_send.proto_ver = 1;
+    frg_send.act_num   = 0;
+    ret = gcs_act_proto_write (&frg_send, buf, buf_len);
+    fail_if (-EOVERFLOW != ret, "error code: %d", ret);
+}
+END_TEST
+
 Suite *gcs_proto_suite(void)
 {
   Suite *suite = suite_create("GCS core protocol");
@@ -112,6 +169,7 @@ Suite *gcs_proto_suite(void)
 
   suite_add_tcase (suite, tcase);
   tcase_add_test  (tcase, gcs_proto_test);
+  tcase_add_test  (tcase, gcs_proto_agg_test);
   return suite;
 }
 